@@ -0,0 +1,209 @@
+/* Filename:      ADCSampler.cpp
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Library for sampling an analog pin in the background with the ADC
+ *    in free running mode, see ADCSampler.h.
+ *
+ * Hardware:
+ *    MCU:          ATmega328
+ *
+ * Notes:
+ *    - On the ATmega328 the ADC registers are set up directly and
+ *      ADC_vect feeds the active sampler. The host build starts the
+ *      emulated ADC of the simulated board instead.
+ */
+
+//Include libraries.
+#include "Arduino.h"
+#include "ADCSampler.h"
+
+ADCSampler* ADCSampler::_active = 0;
+
+#ifdef __AVR__
+//Every finished conversion goes to the active sampler.
+ISR(ADC_vect){
+  ADCSampler::isr(ADC);
+}
+#endif
+
+/* Constructor: ADCSampler::ADCSampler(uint8_t pin, uint8_t extraBits)
+ * 
+ * Purpose:     Setup for the class ADCSampler. Declaring private 
+ *              variables.
+ * 
+ * Input:       Analog pin to sample                   (uint8_t pin)
+ *              Extra bits by oversampling, 0 to 3     (uint8_t extraBits)
+ * 
+ * Output:      None
+*/
+ADCSampler::ADCSampler(uint8_t pin, uint8_t extraBits){
+  _pin = pin;
+  _extraBits = extraBits > 3 ? 3 : extraBits;
+  _perValue = 1 << (2*_extraBits);
+  _sum = 0;
+  _summed = 0;
+  _overruns = 0;
+  _latest = 0;
+  _values = 0;
+  _seenOverruns = 0;
+}
+
+/* Function:    void ADCSampler::begin()
+ * 
+ * Purpose:     Start the ADC in free running mode with the interrupt
+ *              enabled. Waits for the first decimated value.
+ * 
+ * Input:       None
+ * 
+ * Output:      None
+*/
+void ADCSampler::begin(){
+  end();
+  _sum = 0;
+  _summed = 0;
+  _overruns = 0;
+  _seenOverruns = 0;
+  _values = 0;
+  _buffer.clear();
+  _active = this;
+
+#ifdef __AVR__
+  //AVcc reference, channel of the pin, free running, interrupt on every
+  //conversion, ADC clock 16 MHz/128.
+  ADMUX = (1 << REFS0) | ((_pin - A0) & 0x07);
+  ADCSRB = 0;
+  ADCSRA = (1 << ADEN) | (1 << ADSC) | (1 << ADATE) | (1 << ADIE)
+         | (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0);
+#else
+  simAdcStart(_pin, &ADCSampler::isr);
+#endif
+
+  //Wait for the first value, so code() is valid from the start.
+  while(_buffer.count() == 0){
+    delayMicroseconds(100);
+  }
+  code();
+}
+
+/* Function:    void ADCSampler::end()
+ * 
+ * Purpose:     Stop the free running ADC. analogRead() can be used again
+ *              afterwards.
+ * 
+ * Input:       None
+ * 
+ * Output:      None
+*/
+void ADCSampler::end(){
+  if(_active != this){
+    return;
+  }
+#ifdef __AVR__
+  ADCSRA &= ~((1 << ADATE) | (1 << ADIE));
+  while(ADCSRA & (1 << ADSC)){
+  }
+#else
+  simAdcStop();
+#endif
+  _active = 0;
+}
+
+/* Function:    double ADCSampler::code()
+ * 
+ * Purpose:     Take the decimated values waiting in the buffer and 
+ *              return the latest one. Only waits, for at most one value,
+ *              if values were dropped since the last call.
+ * 
+ * Input:       None
+ * 
+ * Output:      The latest value as a, fractional, 10 bit ADC code.
+*/
+double ADCSampler::code(){
+  uint16_t value;
+  while(_buffer.pop(value)){
+    _latest = value;
+    _values += 1;
+  }
+
+  //Values were dropped on a full buffer, so the latest one taken is old.
+  //The buffer is empty now, wait for the next one.
+  uint16_t dropped = overruns();
+  if(dropped != _seenOverruns){
+    _seenOverruns = dropped;
+    while(!_buffer.pop(value)){
+      delayMicroseconds(100);
+    }
+    _latest = value;
+    _values += 1;
+  }
+  return _latest*(1.0/(1 << _extraBits));
+}
+
+/* Function:    unsigned long ADCSampler::values()
+ * 
+ * Purpose:     Number of decimated values taken from the buffer.
+ * 
+ * Input:       None
+ * 
+ * Output:      Values since begin().
+*/
+unsigned long ADCSampler::values(){
+  return _values;
+}
+
+/* Function:    unsigned int ADCSampler::overruns()
+ * 
+ * Purpose:     Number of decimated values dropped because the buffer was
+ *              full, read with the ADC interrupt held off since it is
+ *              two bytes.
+ * 
+ * Input:       None
+ * 
+ * Output:      Dropped values since begin().
+*/
+unsigned int ADCSampler::overruns(){
+#ifdef __AVR__
+  uint8_t sreg = SREG;
+  cli();
+  uint16_t overruns = _overruns;
+  SREG = sreg;
+  return overruns;
+#else
+  return _overruns;
+#endif
+}
+
+/* Function:    void ADCSampler::isr(uint16_t conversion)
+ * 
+ * Purpose:     Add one conversion to the running sum of the active 
+ *              sampler and push the decimated value when the sum is 
+ *              complete. The sum is rounded when shifted down. 
+ * 
+ * Input:       Result of the conversion          (uint16_t conversion)
+ * 
+ * Output:      None
+*/
+void ADCSampler::isr(uint16_t conversion){
+  ADCSampler* sampler = _active;
+  if(!sampler){
+    return;
+  }
+  sampler->_sum += conversion;
+  sampler->_summed += 1;
+  if(sampler->_summed < sampler->_perValue){
+    return;
+  }
+
+  uint8_t bits = sampler->_extraBits;
+  uint16_t value = bits ? (sampler->_sum + (1 << (bits - 1))) >> bits : sampler->_sum;
+  sampler->_sum = 0;
+  sampler->_summed = 0;
+  if(!sampler->_buffer.push(value)){
+    sampler->_overruns = sampler->_overruns + 1;
+  }
+}
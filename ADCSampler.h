@@ -0,0 +1,141 @@
+/* Filename:      ADCSampler.h
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Header for ADCSampler library.
+ *
+ *    Runs the ADC free on one analog pin and decimates the conversions
+ *    in the ADC interrupt: 4^extraBits conversions are summed and 
+ *    shifted down by extraBits, which gives extraBits more bits of
+ *    resolution as long as the signal carries about one LSB of noise.
+ *    The decimated values are passed to loop() through a RingBuffer, so
+ *    reading the latest value never waits for a conversion.
+ *
+ * Hardware:
+ *    MCU:          ATmega328, ADC clock 125 kHz (prescaler 128),
+ *                  9615 conversions per second.
+ *
+ * Notes:
+ *    - There is one ADC, so only one sampler can run at a time. While it
+ *      runs, analogRead() must not be called, since it waits for a 
+ *      single conversion that never ends in free running mode.
+ *    - extraBits can be at most 3, 64 conversions per value.
+ *    - With extraBits 3 a value is ready every 6.7 ms and the buffer 
+ *      holds 213 ms. If the values are read less often than that, new 
+ *      values are dropped until there is space, see overruns(), and the
+ *      next code() waits for a fresh value.
+ *    - The host build emulates the ADC and its interrupt on the 
+ *      simulated board.
+ */
+
+#ifndef ADCSampler_h      //Include guard.
+#define ADCSampler_h
+#include "Arduino.h"
+#include "RingBuffer.h"
+
+//Class for sampling one analog pin in the background.
+class ADCSampler {
+  public:
+    /* Constructor: ADCSampler::ADCSampler(uint8_t pin, uint8_t extraBits)
+     * 
+     * Purpose:     Setup for the class ADCSampler. Declaring private
+     *              variables.
+     * 
+     * Input:       Analog pin to sample                   (uint8_t pin)
+     *              Extra bits by oversampling, 0 to 3     (uint8_t extraBits)
+     * 
+     * Output:      None
+    */
+    ADCSampler(uint8_t pin, uint8_t extraBits);
+
+    /* Function:    void ADCSampler::begin()
+     * 
+     * Purpose:     Start the ADC in free running mode with the interrupt
+     *              enabled. Waits for the first decimated value.
+     * 
+     * Input:       None
+     * 
+     * Output:      None
+    */
+    void begin();
+
+    /* Function:    void ADCSampler::end()
+     * 
+     * Purpose:     Stop the free running ADC. analogRead() can be used
+     *              again afterwards.
+     * 
+     * Input:       None
+     * 
+     * Output:      None
+    */
+    void end();
+
+    /* Function:    double ADCSampler::code()
+     * 
+     * Purpose:     Take the decimated values waiting in the buffer and
+     *              return the latest one. Only waits, for at most one
+     *              value, if values were dropped since the last call.
+     * 
+     * Input:       None
+     * 
+     * Output:      The latest value as a, fractional, 10 bit ADC code.
+    */
+    double code();
+
+    /* Function:    unsigned long ADCSampler::values()
+     * 
+     * Purpose:     Number of decimated values taken from the buffer.
+     * 
+     * Input:       None
+     * 
+     * Output:      Values since begin().
+    */
+    unsigned long values();
+
+    /* Function:    unsigned int ADCSampler::overruns()
+     * 
+     * Purpose:     Number of decimated values dropped because the buffer
+     *              was full.
+     * 
+     * Input:       None
+     * 
+     * Output:      Dropped values since begin().
+    */
+    unsigned int overruns();
+
+    /* Function:    void ADCSampler::isr(uint16_t conversion)
+     * 
+     * Purpose:     Add one conversion to the running sum of the active
+     *              sampler and push the decimated value when the sum is
+     *              complete. Called from the ADC interrupt.
+     * 
+     * Input:       Result of the conversion          (uint16_t conversion)
+     * 
+     * Output:      None
+    */
+    static void isr(uint16_t conversion);
+
+  private:
+    static ADCSampler* _active;       //Sampler fed by the interrupt.
+
+    uint8_t _pin;                     //Analog pin to sample.
+    uint8_t _extraBits;               //Extra bits by oversampling.
+    uint8_t _perValue;                //Conversions per decimated value.
+    
+    //Written by the interrupt only.
+    uint16_t _sum;                    //Running sum of conversions.
+    uint8_t _summed;                  //Conversions in the running sum.
+    volatile uint16_t _overruns;      //Values dropped on a full buffer.
+
+    //Written by loop() only.
+    uint16_t _latest;                 //Latest decimated value.
+    unsigned long _values;            //Values taken from the buffer.
+    uint16_t _seenOverruns;           //Overruns at the last code().
+
+    RingBuffer<uint16_t, 32> _buffer; //Decimated values.
+};
+#endif
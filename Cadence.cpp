@@ -0,0 +1,122 @@
+/* Filename:      Cadence.cpp
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Library for the adaptive sampling cadence, see Cadence.h.
+ */
+
+//Include libraries.
+#include "Arduino.h"
+#include "Cadence.h"
+
+//Time constants of the level and the trend [s].
+static const double levelSeconds = 2;
+static const double trendSeconds = 10;
+
+//Periods between scans.
+static const uint8_t rescanPeriods = 10;
+
+/* Constructor: Cadence::Cadence(double allowed, double sigma)
+ *
+ * Purpose:     Setup for the class Cadence. Declaring private variables,
+ *              with periods of 100 ms to 4 s, a rise of 0.5 m/s per
+ *              second and a scan at least every minute.
+ *
+ * Input:       Allowed wind speed [m/s]                (double allowed)
+ *              Spread of the samples [m/s]             (double sigma)
+ *
+ * Output:      None
+*/
+Cadence::Cadence(double allowed, double sigma){
+  _allowed = allowed;
+  _sigma = sigma;
+  _rise = 0.5;
+  _denseMs = 100;
+  _sparseMs = 4000;
+  _maxRescanMs = 60000;
+  _level = 0;
+  _trend = 0;
+  _lastSample = 0;
+  _started = false;
+  _period = _denseMs;
+  _lastScan = 0;
+  _scanned = false;
+}
+
+void Cadence::setPeriods(unsigned int denseMs, unsigned int sparseMs){
+  _denseMs = denseMs;
+  _sparseMs = sparseMs > denseMs ? sparseMs : denseMs;
+  _period = _denseMs;
+}
+
+void Cadence::setRise(double rise){
+  _rise = rise > 0.01 ? rise : 0.01;
+}
+
+void Cadence::setRescan(unsigned long maxMs){
+  _maxRescanMs = maxMs;
+}
+
+void Cadence::setAllowed(double allowed){
+  _allowed = allowed;
+}
+
+/* Function:    void Cadence::add(double sample, unsigned long timeMs)
+ *
+ * Purpose:     Update the level and the trend with a sample, weighted by
+ *              the time since the last one, and choose the period to the
+ *              next sample from the margin below the limit.
+ *
+ * Input:       Wind speed [m/s]                        (double sample)
+ *              Time of the sample, millis()            (unsigned long timeMs)
+ *
+ * Output:      None
+*/
+void Cadence::add(double sample, unsigned long timeMs){
+  if(!_started){
+    _level = sample;
+    _trend = 0;
+    _started = true;
+  }
+  else if(timeMs != _lastSample){
+    double dt = (timeMs - _lastSample)*0.001;
+    double predicted = _level + _trend*dt;
+    double level = predicted + dt/(levelSeconds + dt)*(sample - predicted);
+    _trend += dt/(trendSeconds + dt)*((level - _level)/dt - _trend);
+    _level = level;
+  }
+  _lastSample = timeMs;
+
+  //Margin below the limit beyond the spread of the samples.
+  double margin = _allowed - _sigma - (sample > _level ? sample : _level);
+  if(margin <= 0){
+    _period = _denseMs;
+    return;
+  }
+  double rise = _rise + (_trend > 0 ? _trend : 0);
+  double ms = margin/rise*500;
+  _period = ms < _denseMs ? _denseMs : (ms > _sparseMs ? _sparseMs : (unsigned int)ms);
+}
+
+/* Function:    bool Cadence::rescanDue(unsigned long timeMs)
+ *
+ * Purpose:     Check if the heading should be scanned or tracked again.
+ *
+ * Input:       Time now, millis()                      (unsigned long timeMs)
+ *
+ * Output:      True if a scan is due, always before the first.
+*/
+bool Cadence::rescanDue(unsigned long timeMs){
+  unsigned long interval = (unsigned long)_period*rescanPeriods;
+  interval = interval < _maxRescanMs ? interval : _maxRescanMs;
+  return !_scanned || timeMs - _lastScan >= interval;
+}
+
+void Cadence::scanned(unsigned long timeMs){
+  _lastScan = timeMs;
+  _scanned = true;
+}
@@ -0,0 +1,186 @@
+/* Filename:      Cadence.h
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Header for Cadence library.
+ *
+ *    Chooses the time to the next wind sample and when to scan again
+ *    from how far the wind is below the allowed speed and how fast it
+ *    rises. The level and the trend of the wind are smoothed from the
+ *    samples at the times they were taken (Holt's linear method). The
+ *    margin is the allowed speed less the spread of the samples and
+ *    the level, or the latest sample if it is higher. Within the
+ *    spread of the limit, or above it, the samples are dense. Below it
+ *    the wind gets time to reach the limit at the assumed rise plus the
+ *    trend, and the period is half that time, so at least two samples
+ *    are taken on the way:
+ *
+ *      period = margin/(rise + trend)/2,  dense <= period <= sparse
+ *
+ *    A scan is due after ten periods, but at least every maxRescan ms,
+ *    so the heading is followed closely near the limit and rarely in
+ *    calm air.
+ *
+ * Notes:
+ *    - One sample above the level shortens the period at once, the
+ *      smoothing only holds the period short while the wind drops.
+ *    - The rise is the fastest the wind is assumed to grow between two
+ *      samples in calm air, 0.5 m/s per second by default. A faster gust
+ *      is seen up to one sparse period late.
+ *    - Add only the samples taken at the heading, not those of a scan,
+ *      which point the sensor away from the wind.
+ */
+
+#ifndef Cadence_h       //Include guard.
+#define Cadence_h
+#include "Arduino.h"
+
+//Class for the adaptive sampling cadence.
+class Cadence {
+  public:
+    /* Constructor: Cadence::Cadence(double allowed, double sigma)
+     *
+     * Purpose:     Setup for the class Cadence, with periods of 100 ms to
+     *              4 s, a rise of 0.5 m/s per second and a scan at least
+     *              every minute.
+     *
+     * Input:       Allowed wind speed [m/s]                (double allowed)
+     *              Spread of the samples [m/s]             (double sigma)
+     *
+     * Output:      None
+    */
+    Cadence(double allowed, double sigma);
+
+    /* Function:    void Cadence::setPeriods(unsigned int denseMs, unsigned int sparseMs)
+     *
+     * Purpose:     Set the shortest and the longest time between samples.
+     *
+     * Input:       Period near the limit [ms]              (unsigned int denseMs)
+     *              Period in calm air [ms]                 (unsigned int sparseMs)
+     *
+     * Output:      None
+    */
+    void setPeriods(unsigned int denseMs, unsigned int sparseMs);
+
+    /* Function:    void Cadence::setRise(double rise)
+     *
+     * Purpose:     Set the fastest rise of the wind assumed between two
+     *              samples in calm air. A faster rise gives shorter
+     *              periods below the limit.
+     *
+     * Input:       Rise of the wind [m/s per s]            (double rise)
+     *
+     * Output:      None
+    */
+    void setRise(double rise);
+
+    /* Function:    void Cadence::setRescan(unsigned long maxMs)
+     *
+     * Purpose:     Set the longest time between two scans, whatever the
+     *              period.
+     *
+     * Input:       Longest time between scans [ms]         (unsigned long maxMs)
+     *
+     * Output:      None
+    */
+    void setRescan(unsigned long maxMs);
+
+    /* Function:    void Cadence::setAllowed(double allowed)
+     *
+     * Purpose:     Change the allowed wind speed the margin is taken
+     *              from. Used from the next sample.
+     *
+     * Input:       Allowed wind speed [m/s]                (double allowed)
+     *
+     * Output:      None
+    */
+    void setAllowed(double allowed);
+
+    /* Function:    void Cadence::add(double sample, unsigned long timeMs)
+     *
+     * Purpose:     Update the level and the trend with a sample and
+     *              choose the period to the next one.
+     *
+     * Input:       Wind speed [m/s]                        (double sample)
+     *              Time of the sample, millis()            (unsigned long timeMs)
+     *
+     * Output:      None
+    */
+    void add(double sample, unsigned long timeMs);
+
+    /* Function:    unsigned int Cadence::period()
+     *
+     * Purpose:     The time to wait before the next sample, chosen by
+     *              the last add().
+     *
+     * Input:       None
+     *
+     * Output:      Period to the next sample [ms], dense until the
+     *              first sample.
+    */
+    unsigned int period() { return _period; }
+
+    /* Function:    bool Cadence::rescanDue(unsigned long timeMs)
+     *
+     * Purpose:     Check if the heading should be scanned or tracked
+     *              again, ten periods or maxRescan after the last scan.
+     *
+     * Input:       Time now, millis()                      (unsigned long timeMs)
+     *
+     * Output:      True if a scan is due, always before the first.
+    */
+    bool rescanDue(unsigned long timeMs);
+
+    /* Function:    void Cadence::scanned(unsigned long timeMs)
+     *
+     * Purpose:     Count a scan, the next is due ten periods or 
+     *              maxRescan after it.
+     *
+     * Input:       End of the scan, millis()               (unsigned long timeMs)
+     *
+     * Output:      None
+    */
+    void scanned(unsigned long timeMs);
+
+    /* Function:    double Cadence::level()
+     *
+     * Purpose:     The smoothed wind speed the margin is taken from.
+     *
+     * Input:       None
+     *
+     * Output:      Level of the wind [m/s].
+    */
+    double level() { return _level; }
+
+    /* Function:    double Cadence::trend()
+     *
+     * Purpose:     The smoothed rise of the wind, added to the assumed
+     *              rise when it is positive.
+     *
+     * Input:       None
+     *
+     * Output:      Trend of the wind [m/s per s].
+    */
+    double trend() { return _trend; }
+
+  private:
+    double _allowed;                  //Allowed wind speed [m/s].
+    double _sigma;                    //Spread of the samples [m/s].
+    double _rise;                     //Assumed rise of the wind [m/s per s].
+    unsigned int _denseMs;            //Shortest period [ms].
+    unsigned int _sparseMs;           //Longest period [ms].
+    unsigned long _maxRescanMs;       //Longest time between scans [ms].
+
+    double _level;                    //Smoothed wind speed [m/s].
+    double _trend;                    //Smoothed trend [m/s per s].
+    unsigned long _lastSample;        //Time of the last sample [ms].
+    bool _started;                    //A sample has been added.
+    unsigned int _period;             //Period to the next sample [ms].
+    unsigned long _lastScan;          //End of the last scan [ms].
+    bool _scanned;                    //A scan has ended.
+};
+#endif
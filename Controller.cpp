@@ -15,20 +15,27 @@
  *    Driver:         ULN2003 IC
  *    
  * Notes: 
- *    - In order for this library to work, please install the library
- *      CheapStepper created by tyhenry via: 
- *      https://github.com/tyhenry/CheapStepper
+ *    - The motor is driven by FastStepper, or by CheapStepper with
+ *      FLAGPOLE_CHEAPSTEPPER, see Controller.h.
  */
 
 //Includes necessary libraries. 
 #include "Arduino.h"
 #include "Controller.h"
-#include "CheapStepper.h"
 #include "FS5.h"
+#include "FS5Array.h"
+#include "LimitSwitch.h"
+#include "Motion.h"
+#include "Storage.h"
+#include "Profiler.h"
+
+static_assert((int)SCAN_TRACK < (int)PROFILE_FS5_READ, "every scan phase needs its own profile section");
 
 /* Constructor: Control::Control(int limitSwitch, int IN1, int IN2, int IN3, int IN4, int pin, double U0, double U50, double v50, double n)
  *
  * Purpose:     Setup for the class Control. Declaring private variables. 
+ *              Initialize the controller for the stepper motor and the 
+ *              FS5 sensor used during the scan.
  *
  * Input:       Pin for limitSwitch                     (int limitSwitch) 
  *              Pins for stepper motor                  (int IN1 - int IN4) 
@@ -41,140 +48,949 @@
  * Output:      None
 */
 
-Control::Control(int limitSwitch, int IN1, int IN2, int IN3, int IN4, int pin, double U0, double U50, double v50, double n){
-  _limitSwitch = limitSwitch; 
-  _IN1 = IN1;
-  _IN2 = IN2;
-  _IN3 = IN3;
-  _IN4 = IN4;
-  _pin = pin; 
-  _U0 = U0;
-  _U50 = U50;
-  _v50 = v50;
-  _n = n;  
-  pinMode(limitSwitch,INPUT);
+Control::Control(int limitSwitch, int IN1, int IN2, int IN3, int IN4, int pin, double U0, double U50, double v50, double n)
+  : _stepper(IN1, IN2, IN3, IN4), _motion(defaultMaxRate, defaultAcceleration, defaultStartRate),
+#if FLAGPOLE_FIXED_CONFIG
+    _FS5(), 
+#else
+    _FS5(pin, U0, U50, v50, n), 
+#endif
+    _switch(limitSwitch, switchDebounce){
+#if FLAGPOLE_FIXED_CONFIG
+  //The FS5 is that of the pole.
+  (void)pin;
+  (void)U0;
+  (void)U50;
+  (void)v50;
+  (void)n;
+#else
+  _headingOffset = FLAGPOLE_CONFIG::calibrationSteps;
+#endif
+  _phase = SCAN_IDLE;
+  _mode = SCAN_EXHAUSTIVE;
+  _tracking = false;
+  _messages = true;
+  _homed = false;
+  _heading = 0;
+  _trackLevel = 0;
+  _trackCycles = 0;
+  _profileCount = 0;
+  _profileBest = 0;
+  _profileStride = profileStride;
+  _profileFirst = 0;
+  _peakHeading = 0;
+  _alignHeading = 0;
+  _cw = true;
+  _stepInterval = 0;
+  _lastStep = 0;
+  _sweepRate = defaultStartRate;
+  _storage = 0;
+  _span = 0;
+  _savedHeading = 0;
+  _savedSpan = 0;
+  _lastSave = 0;
+  _saved = false;
+  _resumed = false;
+  _verify = false;
+  _array = 0;
+#if FLAGPOLE_CHEAPSTEPPER
+  _stepper.setRpm(24);            //Shortest step delay, tick() paces the steps.
+#endif
 }
 
 /* Function:    void Control::scan()
  * 
  * Purpose:     Find the direction of, and align the sensor to, the wind
- *              current by scanning a span of approximately 180 degrees.  
+ *              current by scanning a span of approximately 180 degrees.
+ *              Blocks until the scan is complete. 
  * 
  * Input:       None
  * 
  * Output:      None
 */
 void Control::scan(){
-  
-  //Setup for the stepper motor and the FS5 sensor.
-  CheapStepper stepper (_IN1,_IN2,_IN3,_IN4);   //Initialize controller 
-                                                   //for stepper motor.
-  stepper.setRpm(16);                              //Set the rpm of the
-                                                   //stepper motor.
-  FS5sensor FS5(_pin, _U0, _U50, _v50, _n);        //Initialize FS5 sensor. 
-
-  int stepCounter = 0;      //Counter for step rotation. 
-  int state = 0;            //The state for the switch case.
-  bool startFind = true;    //State variable used to find start position. 
-  bool cw = true;           //The state variable for the direction.
-  int Position = 0;         //Current step position.
-  int scaning = true;       //State variable for the scanning process.
-  double maxFS5 = 0;        //Placeholder for the maximum voltage.
-  int maxPosition;          //Placeholder for the step position at maxFS5. 
-  int LSSafteyStep = 400;   //The number of steps to release limit switch.
-  bool safetyState;         //State variable for releasing of limit switch.
-  int calibration = 300;    //Extra steps for calibration. 
-  
-  
-  
-  
-  
+  begin();
+
   //While scanning is true, scan until the maximum wind speed is found and the sensor is aligned to the wind current.
-  while(scaning){          
-      //Switch statement for controlling logic of controller.   
-      switch(state){      
-        
-        /* Case 0: 
-         * Rotate the stepper motor cw until the limit switch is activated. 
-         * Then release the limit switch. 
-         */
-        case 0:                                        
-          Serial.println("Detecting start position...");
-
-          while(startFind){         //While startFind is true...
-            stepper.step(cw);       //Rotate steper motor one step cw.
-            
-            //If the limit switch is activated the start position is found, change state variable to false.
-            if(digitalRead(_limitSwitch) == HIGH){      
-              startFind = false;    
-              
-              //Rotate stepper motor ccw to release the limit switch.
-              for (int p = 0; p < LSSafteyStep; p++){   
-                stepper.step(!cw);  //Rotate ccw one step.
-                }
-              state = 1;              //Change state and go to case 1. 
-            }
-          }
-          Serial.println("Start position detected");
-        break; 
-
-        /* Case 1: 
-         * Scans the span for the maximum value of the voltage from 
-         * the FS5 sensor. The scan is done when limit switch is activated. 
-         * Release the limit switch. 
-         */
-        case 1:  
-          Serial.println("Scanning...");
-          
-          //While limitSwitch is not activated...
-          while(digitalRead(_limitSwitch) == LOW){  
-            stepper.step(!cw);                     //Rotate one step ccw.
-            double FS5valVolt = FS5.voltage();  //Get the current voltage.
-            Position += 1;                         //Increase Position by one.
-            stepCounter += 1;                      //Keep track of steps.
-
-            //If the current voltage from the FS5 is greater than the old, update the old value to the new.
-            if (FS5valVolt > maxFS5){               
-              maxFS5 = FS5valVolt;              //Update the max voltage.
-              maxPosition = Position;           //Update position at max FS5.
-             }
-            }
-
-           //Move the stepper motor cw to release the limit switch.
-           for (int p = 0; p < LSSafteyStep; p++){  
-            stepper.step(cw);                   //Rotate one step cw.
-           }
-           
-           state = 2;                           //Go to case 2. 
-           Serial.println("Scanning complete");
-        break; 
-
-        /* Case 2: 
-         * Rotates the stepper motor to align FS5 sensor to the wind current.
-         */
-        case 2:   
-            Serial.println("Aligning sensor...");
-            Position = 0;                   //Reset Position to zero.
-            safetyState = true;             //Reset safetyState to true.
-
-            //Rotates the stepper motor cw to the correct step to align the FS5 properly.
-            while((Position < stepCounter-maxPosition+LSSafteyStep+calibration) && safetyState){    
-              stepper.step(cw);             //Rotate one step cw.
-              Position = Position + 1;      //Increase Position by one. 
-              
-              //If the limit switch is activated, move the stepper motor ccw to release the limit switch.
-              if(digitalRead(_limitSwitch) == HIGH){      
-                for (int p = 0; p < LSSafteyStep; p++){   
-                  stepper.step(!cw);        //Rotate one step ccw. 
-                }
-                safetyState = false;        //Set safetyState to false. 
-              }
-            }
-    
-            //When the sensor has been aligned to the wind direction, the state varible is set to false and the scan is done. 
-            scaning = false;                              
-            Serial.println("Alignment complete");
-            break; 
+  while(tick(micros())){
+  }
+}
+
+/* Function:    void Control::begin()
+ * 
+ * Purpose:     Start a scan without blocking. The scan is then advanced
+ *              by calling tick() until it returns false. When tracking,
+ *              a tracking cycle is started instead if the position is
+ *              known, and with an array a cycle of the array.
+ * 
+ * Input:       None
+ * 
+ * Output:      None
+*/
+void Control::begin(){
+  _switch.begin();
+
+  //After a resume the sensor already points where it did before the
+  //reset, sample the wind there first.
+  if(_resumed){
+    message(F("Resuming at stored heading"));
+    _resumed = false;
+    _phase = SCAN_IDLE;
+    return;
+  }
+  //The array gives the direction without the start position.
+  if(_array && _trackCycles < trackRehome){
+    arrayCycle();
+    return;
+  }
+  if(_tracking && _homed && _trackCycles < trackRehome){
+    message(F("Tracking wind direction..."));
+    _trackCycles += 1;
+    _trackCenter = _heading + _headingOffset;
+    _trackTarget = _trackCenter;
+    _trackStep = 0;
+    _phase = SCAN_TRACK;
+    _motion.start(_headingOffset > 0 ? _headingOffset : -_headingOffset);
+    return;
+  }
+  startScan();
+}
+
+/* Function:    void Control::arrayCycle()
+ * 
+ * Purpose:     Start a tracking cycle with the array. One pass gives the
+ *              direction, and the cycle only moves the sensor to it,
+ *              headingOffset steps cw of it. With a known span the
+ *              target is kept arrayDeadband steps inside it, going the
+ *              other way round if needed.
+ * 
+ * Input:       None
+ * 
+ * Output:      None
+*/
+void Control::arrayCycle(){
+  message(F("Estimating wind direction..."));
+  _trackCycles += 1;
+  _trackCenter = _heading;
+  _trackTarget = _heading;
+  _trackStep = 3;                 //No probes, only the move.
+  _phase = SCAN_TRACK;
+  _array->pass();
+
+  long offset = lround(_array->direction()*expectedSweep/180) - _headingOffset;
+  if(_array->speed() >= arrayCalm && (offset > arrayDeadband || offset < -arrayDeadband)){
+    long target = _heading + offset;
+    if(_homed){
+      //The span may be more than half a turn, then the wind can be
+      //reached the other way round.
+      long far = (_span > 0 ? _span : expectedSweep) - arrayDeadband;
+      long around = target + (offset > 0 ? -2L : 2L)*expectedSweep;
+      if((target < arrayDeadband || target > far) && around >= arrayDeadband && around <= far){
+        target = around;
+      }
+      target = target < arrayDeadband ? arrayDeadband : (target > far ? far : target);
+    }
+    _trackTarget = (int)target;
+  }
+  _motion.start(_trackTarget > _heading ? _trackTarget - _heading : _heading - _trackTarget);
+}
+
+/* Function:    void Control::startScan()
+ * 
+ * Purpose:     Start a full scan from the search for the start position.
+ * 
+ * Input:       None
+ * 
+ * Output:      None
+*/
+void Control::startScan(){
+  _trackCycles = 0;
+  _trackLevel = 0;
+  _stepCounter = 0;       //Counter for step rotation. 
+  _position = 0;          //Current step position.
+  _releaseCount = 0;      //Steps taken to release the limit switch.
+  _moveSteps = 0;         //Steps of the final move to the peak.
+  _profileCount = 0;      //Number of profile values.
+  _profileBest = 0;       //Index of the highest profile value.
+  _profileStride = _mode == SCAN_COARSE_FINE ? coarseStride : profileStride;
+  _binSum = 0;            //Sum of the readings of the current bin.
+  _phase = SCAN_HOMING;
+  _switch.clear();
+
+  //With a known heading the homing is fast until shortly before the 
+  //start position. A resumed heading is not trusted that far.
+  bool fast = _homed && !_verify && _heading > homeApproach;
+  _verify = false;
+  _motion.start(fast ? _heading - homeApproach : 0);
+  message(F("Detecting start position..."));
+}
+
+/* Function:    bool Control::tick(unsigned long now)
+ * 
+ * Purpose:     Advance the scan started by begin() by at most one step
+ *              of the stepper motor. The phases follow the cases of the
+ *              scanning procedure:
+ * 
+ *              Case 0: Rotate the stepper motor cw until the limit switch
+ *              is activated. Then release the limit switch.
+ * 
+ *              Case 1: Scans the span and records the profile of the
+ *              voltage from the FS5 sensor. The scan is done when limit
+ *              switch is activated. Fit the peak and release the limit
+ *              switch.
+ * 
+ *              Case 2: Rotates the stepper motor to align FS5 sensor to
+ *              the wind current at the peak.
+ * 
+ *              When the scan ends the coils of the motor are turned off.
+ * 
+ * Input:       Current time from micros()        (unsigned long now)
+ * 
+ * Output:      True while the scan is in progress.
+*/
+bool Control::tick(unsigned long now){
+  if(_phase == SCAN_IDLE){
+    return false;
+  }
+
+  //Wait until the interval of the next step has passed.
+  unsigned long interval = _motion.interval() > _stepInterval ? _motion.interval() : _stepInterval;
+  if(now - _lastStep < interval){
+    return true;
+  }
+  _lastStep = now;
+  PROFILE_SCOPE(PROFILE_PHASE + _phase);
+
+  switch(_phase){
+    case SCAN_HOMING:
+      move(_cw);       //Rotate steper motor one step cw.
+      
+      //If the limit switch is activated the start position is found.
+      //A rescan from tracking may start at the far end of the span, 
+      //where the switch is activated until the sensor has moved away.
+      //The start position is the step the switch closed at.
+      if(_switch.closed() && !(_homed && _heading > expectedSweep/2)){
+        _heading = -(int)_switch.overshoot();
+        _homed = true;
+        _releaseCount = 0;
+        _phase = SCAN_HOME_RELEASE;
+        _motion.start(LSSafteyStep);
+
+        //The coarse sweep releases the limit switch on its way. The 
+        //switch trips again at the other end of the span.
+        if(_mode == SCAN_COARSE_FINE){
+          message(F("Start position detected"));
+          message(F("Scanning..."));
+          _phase = SCAN_COARSE;
+          _motion.start(0, _sweepRate);
+          _switch.clear();
+        }
+      }
+    break;
+
+    case SCAN_HOME_RELEASE:
+      move(!_cw);      //Rotate ccw one step to release the limit switch.
+      _releaseCount += 1;
+      if(_releaseCount >= LSSafteyStep){
+        message(F("Start position detected"));
+        message(F("Scanning..."));
+        _phase = SCAN_SWEEP;      //Change state and go to case 1.
+        _motion.start(0, _sweepRate);
+        _switch.clear();
+      }
+    break;
+
+    case SCAN_SWEEP:
+      //When the limit switch is activated the span is scanned. The span
+      //ends at the step the switch closed at.
+      if(_switch.tripped()){
+        _span = _heading - _switch.overshoot();
+        fitProfile();
+        _releaseCount = 0;
+        _phase = SCAN_SWEEP_RELEASE;
+        _motion.start(LSSafteyStep);
+        break;
+      }
+      move(!_cw);                    //Rotate one step ccw.
+      _binSum += _FS5.readRaw(1);    //Read without the lag of the filter.
+      _stepCounter += 1;             //Keep track of steps.
+
+      //Close the bin, its heading is the middle of its steps.
+      if(_stepCounter % profileStride == 0){
+        addProfile(_binSum*(profileScale/profileStride), _heading - (profileStride - 1)/2);
+        _binSum = 0;
+      }
+    break;
+
+    case SCAN_SWEEP_RELEASE:
+      move(_cw);                     //Rotate one step cw to release the limit switch.
+      _releaseCount += 1;
+      if(_releaseCount >= LSSafteyStep){
+        message(F("Scanning complete"));
+        message(F("Aligning sensor..."));
+        _position = 0;                      //Reset Position to zero.
+        _moveSteps = _heading > _alignHeading ? _heading - _alignHeading : _alignHeading - _heading;
+        _phase = SCAN_ALIGN;                //Go to case 2.
+        _motion.start(_moveSteps);
+      }
+    break;
+
+    case SCAN_ALIGN:
+      //Rotates the stepper motor to the correct step to align the FS5 properly.
+      //The peak is cw of the release unless it is close to the far end.
+      if(_heading != _alignHeading){
+        move(_heading > _alignHeading);    //Rotate one step towards the peak.
+        _position = _position + 1;          //Increase Position by one. 
+
+        //If the limit switch is activated, move the stepper motor back to release the limit switch.
+        if(_switch.closed()){
+          _releaseCount = 0;
+          _phase = SCAN_ALIGN_RELEASE;
+          _motion.start(LSSafteyStep);
+        }
+        break;
+      }
+
+      //When the sensor has been aligned to the wind direction, the scan is done. 
+      message(F("Alignment complete"));
+      _phase = SCAN_IDLE;
+    break;
+
+    case SCAN_ALIGN_RELEASE:
+      move(_heading < _alignHeading);    //Rotate one step away from the peak.
+      _releaseCount += 1;
+      if(_releaseCount >= LSSafteyStep){
+        message(F("Alignment complete"));
+        _phase = SCAN_IDLE;
+      }
+    break;
+
+    case SCAN_COARSE:
+      //Sweep until the limit switch trips at the other end of the span.
+      //It was cleared while closed at the start position, and the
+      //bounces as it opens are not taken as a close.
+      if(_switch.tripped()){
+        _span = _heading - _switch.overshoot();
+        finishCoarse();
+        break;
+      }
+
+      move(!_cw);                    //Rotate one step ccw.
+      _stepCounter += 1;
+
+      //Sample every coarseStride steps.
+      if(_stepCounter % coarseStride == 0){
+        unsigned int sample = _FS5.readRaw(coarseReads)*(profileScale/coarseReads);
+        addProfile(sample, _heading);
+
+        //Stop early once the fit window past the highest sample is 
+        //filled, if the signal has clearly risen to it and fallen from
+        //it since. Noise on the floor of the response, with the wind 
+        //from behind, does neither. Else stop when the signal has 
+        //fallen below half of the peak, counted from the zero wind 
+        //level, well past the peak.
+        unsigned int best = _profile[_profileBest];
+        unsigned int low = best;
+        for(uint8_t i = 0; i < _profileBest; i++){
+          low = _profile[i] < low ? _profile[i] : low;
+        }
+        bool fitted = _profileCount - 1 - _profileBest >= fitHalfWidth 
+                      && best - low >= coarseRise*profileScale && best - sample >= coarseDrop*profileScale;
+        double zero = _FS5.zeroCode()*profileScale;
+        double peak = best - zero;
+        bool fallen = _profileCount - 1 - _profileBest >= 2*fitHalfWidth && sample - zero < peak/2;
+        if(peak > 4*profileScale && (fitted || fallen)){
+          finishCoarse();
+        }
+      }
+    break;
+
+    case SCAN_MOVE:
+      //Rotate cw straight to the peak.
+      if(_position < _moveSteps){
+        move(_cw);
+        _position += 1;
+        break;
+      }
+      message(F("Alignment complete"));
+      _phase = SCAN_IDLE;
+    break;
+
+    case SCAN_TRACK:
+      //Move towards the target of the cycle.
+      if(_heading != _trackTarget){
+        move(_heading > _trackTarget);
+
+        //The limit switch is open everywhere inside the span. If it is 
+        //activated the position is lost or the wind is outside the span.
+        if(_switch.closed()){
+          message(F("Tracking lost, rescanning..."));
+          startScan();
+        }
+        break;
+      }
+
+      //Read at the heading, ccw side and cw side, then move to the peak.
+      if(_trackStep < 3){
+        _trackY[_trackStep] = _FS5.readRaw(trackReads);
+        _trackStep += 1;
+        if(_trackStep == 1){
+          _trackTarget = _trackCenter + trackProbe;
+        }
+        else if(_trackStep == 2){
+          _trackTarget = _trackCenter - trackProbe;
+        }
+        else{
+          finishTrack();
+        }
+
+        //A new scan has started its own move.
+        if(_phase == SCAN_TRACK){
+          _motion.start(_trackTarget > _heading ? _trackTarget - _heading : _heading - _trackTarget);
+        }
+        break;
+      }
+      message(F("Alignment complete"));
+      _phase = SCAN_IDLE;
+    break;
+
+    default:
+      _phase = SCAN_IDLE;
+    break;
+  }
+  //The motor holds the sensor by its gear, the coils are turned off 
+  //until the next scan.
+  if(_phase == SCAN_IDLE){
+    _stepper.off();
+    persist();
+  }
+  return _phase != SCAN_IDLE;
+}
+
+/* Function:    void Control::persist()
+ * 
+ * Purpose:     Save the state at the end of a scan or tracking cycle if
+ *              it has changed enough since the last save and the last 
+ *              save is at least saveInterval ms old. The first state
+ *              after the start is always saved.
+ * 
+ * Input:       None
+ * 
+ * Output:      None
+*/
+void Control::persist(){
+  if(!_storage || !_homed){
+    return;
+  }
+  int moved = _heading > _savedHeading ? _heading - _savedHeading : _savedHeading - _heading;
+  bool changed = moved >= saveThreshold || _span != _savedSpan;
+  if(_saved && !(changed && millis() - _lastSave >= saveInterval)){
+    return;
+  }
+
+  StoredState state;
+  state.heading = _heading;
+  state.span = _span;
+  state.flags = STORED_HOMED;
+  _FS5.storeCalibration(state);
+  _storage->save(state);
+  _saved = true;
+  _savedHeading = _heading;
+  _savedSpan = _span;
+  _lastSave = millis();
+}
+
+/* Function:    void Control::finishCoarse()
+ * 
+ * Purpose:     End the coarse sweep. Fit the peak of the profile and
+ *              start the move back to it.
+ * 
+ * Input:       None
+ * 
+ * Output:      None
+*/
+void Control::finishCoarse(){
+  message(F("Scanning complete"));
+  message(F("Aligning sensor..."));
+  fitProfile();
+  _moveSteps = _heading > _alignHeading ? _heading - _alignHeading : 0;
+  _position = 0;
+  _phase = SCAN_MOVE;
+  _motion.start(_moveSteps);
+}
+
+/* Function:    void Control::addProfile(unsigned int value, int heading)
+ * 
+ * Purpose:     Add a value to the profile and keep track of the highest
+ *              one. Values beyond profileSize are dropped.
+ * 
+ * Input:       Mean ADC code times profileScale  (unsigned int value)
+ *              Heading of the value              (int heading)
+ * 
+ * Output:      None
+*/
+void Control::addProfile(unsigned int value, int heading){
+  if(_profileCount >= profileSize){
+    return;
+  }
+  if(_profileCount == 0){
+    _profileFirst = heading;
+  }
+  _profile[_profileCount] = value;
+  if(value > _profile[_profileBest]){
+    _profileBest = _profileCount;
+  }
+  _profileCount += 1;
+}
+
+/* Function:    void Control::fitProfile()
+ * 
+ * Purpose:     Find the peak of the profile. Fit a parabola by least 
+ *              squares to the values within fitHalfWidth of the highest
+ *              one and take its vertex as the peak. If the fit has no 
+ *              maximum inside the values, the highest value is used. 
+ *              Without a profile the peak is the current heading.
+ *              The sensor is aligned headingOffset steps cw of the
+ *              peak, but not beyond the start position or the span.
+ * 
+ * Input:       None
+ * 
+ * Output:      None
+*/
+void Control::fitProfile(){
+  if(_profileCount == 0){
+    _peakHeading = _heading;
+    _alignHeading = _heading;
+    return;
+  }
+  int first = _profileBest > fitHalfWidth ? _profileBest - fitHalfWidth : 0;
+  int last = _profileBest + fitHalfWidth < _profileCount ? _profileBest + fitHalfWidth : _profileCount - 1;
+
+  //Sums for the normal equations of y = a + b*x + c*x^2. The values are
+  //taken relative to the highest one to keep the sums small.
+  double S0 = 0, S1 = 0, S2 = 0, S3 = 0, S4 = 0;
+  double T0 = 0, T1 = 0, T2 = 0;
+  for(int i = first; i <= last; i++){
+    double x = i - _profileBest;
+    double y = (double)_profile[i] - _profile[_profileBest];
+    S0 += 1;
+    S1 += x;
+    S2 += x*x;
+    S3 += x*x*x;
+    S4 += x*x*x*x;
+    T0 += y;
+    T1 += x*y;
+    T2 += x*x*y;
+  }
+
+  //Solve for b and c by Cramer's rule.
+  double peak = 0;
+  double det = S0*(S2*S4 - S3*S3) - S1*(S1*S4 - S3*S2) + S2*(S1*S3 - S2*S2);
+  if(last - first >= 2 && det != 0){
+    double b = (S0*(T1*S4 - S3*T2) - T0*(S1*S4 - S3*S2) + S2*(S1*T2 - T1*S2))/det;
+    double c = (S0*(S2*T2 - T1*S3) - S1*(S1*T2 - T1*S2) + T0*(S1*S3 - S2*S2))/det;
+    if(c < 0){
+      peak = -b/(2*c);
+      if(peak < first - _profileBest || peak > last - _profileBest){
+        peak = 0;
       }
+    }
+  }
+  _peakHeading = _profileFirst + (int)((_profileBest + peak)*_profileStride + 0.5);
+  _alignHeading = _peakHeading - _headingOffset;
+  if(_alignHeading < 0){
+    _alignHeading = 0;
+  }
+  if(_span > 0 && _alignHeading > _span){
+    _alignHeading = _span;
+  }
+}
+
+/* Function:    void Control::finishTrack()
+ * 
+ * Purpose:     End the readings of a tracking cycle. The sensor is moved
+ *              headingOffset steps cw of the vertex of the parabola 
+ *              through the three readings, at most two probe distances
+ *              from the peak of the last cycle. If the readings do not form
+ *              a peak the sensor moves two probe distances towards the
+ *              highest side. In calm wind the heading is kept. A full 
+ *              scan is started if the signal has dropped below half of
+ *              the previous cycle.
+ * 
+ * Input:       None
+ * 
+ * Output:      None
+*/
+void Control::finishTrack(){
+  long zero = (long)(_FS5.zeroCode()*trackReads);
+  long y0 = _trackY[0];
+  long yCcw = _trackY[1];
+  long yCw = _trackY[2];
+  long best = y0 > yCcw ? y0 : yCcw;
+  best = best > yCw ? best : yCw;
+  long level = best - zero;
+
+  //No direction to follow in calm wind.
+  if(level <= 4*trackReads){
+    _trackTarget = _trackCenter - _headingOffset;
+    return;
+  }
+
+  //A sudden drop means the wind has turned away from the heading.
+  if(_trackLevel > 0 && 2*level < _trackLevel){
+    message(F("Signal lost, rescanning..."));
+    startScan();
+    return;
+  }
+  _trackLevel = level;
+
+  long offset;
+  long curvature = 2*y0 - yCcw - yCw;
+  if(curvature > 0){
+    offset = (long)trackProbe*(yCcw - yCw)/(2*curvature);
+  }
+  else{
+    offset = yCcw > yCw ? 2*trackProbe : (yCcw < yCw ? -2*trackProbe : 0);
+  }
+  if(offset > 2*trackProbe){
+    offset = 2*trackProbe;
+  }
+  if(offset < -2*trackProbe){
+    offset = -2*trackProbe;
+  }
+  _trackTarget = _trackCenter + (int)offset - _headingOffset;
+}
+
+/* Function:    void Control::move(bool cw)
+ * 
+ * Purpose:     Rotate the stepper motor one step and keep count of the
+ *              heading.
+ * 
+ * Input:       Direction, true for cw              (bool cw)
+ * 
+ * Output:      None
+*/
+void Control::move(bool cw){
+  _switch.countStep();            //Counted first, the switch may close during the step.
+  _stepper.step(cw);
+  _motion.step();
+  _heading += (cw == _cw) ? -1 : 1;
+}
+
+/* Function:    void Control::message(const __FlashStringHelper* text)
+ * 
+ * Purpose:     Print a status message on the serial port, if enabled.
+ * 
+ * Input:       Message in flash, from F()        (const __FlashStringHelper* text)
+ * 
+ * Output:      None
+*/
+void Control::message(const __FlashStringHelper* text){
+  if(_messages){
+    Serial.println(text);
+  }
+}
+
+/* Function:    void Control::setMessages(bool enabled)
+ * 
+ * Purpose:     Enable or disable the status messages, see Controller.h.
+ * 
+ * Input:       Messages on or off                (bool enabled)
+ * 
+ * Output:      None
+*/
+void Control::setMessages(bool enabled){
+  _messages = enabled;
+}
+
+/* Function:    void Control::setTracking(bool enabled)
+ * 
+ * Purpose:     Enable or disable tracking, see Controller.h.
+ * 
+ * Input:       Tracking on or off                (bool enabled)
+ * 
+ * Output:      None
+*/
+void Control::setTracking(bool enabled){
+  _tracking = enabled;
+}
+
+/* Function:    void Control::setHeadingOffset(int steps)
+ * 
+ * Purpose:     Set how far cw of the peak of the FS5 signal the sensor 
+ *              is held, see Controller.h. With FLAGPOLE_FIXED_CONFIG set
+ *              the offset of the pole is kept.
+ * 
+ * Input:       Steps cw of the signal peak       (int steps)
+ * 
+ * Output:      None
+*/
+void Control::setHeadingOffset(int steps){
+#if FLAGPOLE_FIXED_CONFIG
+  (void)steps;
+#else
+  _headingOffset = steps;
+#endif
+}
+
+/* Function:    void Control::useSampler(ADCSampler* sampler)
+ * 
+ * Purpose:     Let the FS5 used during the scan read from a running
+ *              background sampler.
+ * 
+ * Input:       Sampler of the FS5 pin, 0 to use analogRead()
+ *                                                (ADCSampler* sampler)
+ * 
+ * Output:      None
+*/
+void Control::useSampler(ADCSampler* sampler){
+  _FS5.useSampler(sampler);
+}
+
+/* Function:    void Control::useArray(FS5Array* array)
+ * 
+ * Purpose:     Find the wind direction with a fixed array of FS5 sensors
+ *              instead of rotating, see Controller.h.
+ * 
+ * Input:       Array of FS5 sensors, 0 to probe with the motor
+ *                                                (FS5Array* array)
+ * 
+ * Output:      None
+*/
+void Control::useArray(FS5Array* array){
+  _array = array;
+}
+
+/* Function:    void Control::useStorage(Storage* storage)
+ * 
+ * Purpose:     Save the state when a scan or tracking cycle ends, see
+ *              Controller.h.
+ * 
+ * Input:       Storage, 0 to not save            (Storage* storage)
+ * 
+ * Output:      None
+*/
+void Control::useStorage(Storage* storage){
+  _storage = storage;
+}
+
+/* Function:    bool Control::resume(const StoredState& state)
+ * 
+ * Purpose:     Continue from a state saved before a reset, see 
+ *              Controller.h. The state counts as saved, so it is not
+ *              written again until the heading moves.
+ * 
+ * Input:       Loaded state                      (const StoredState& state)
+ * 
+ * Output:      True if the state was used.
+*/
+bool Control::resume(const StoredState& state){
+  if(!(state.flags & STORED_HOMED) || state.heading < 0 || state.span < 0 
+     || (state.span > 0 && state.heading > state.span)){
+    return false;
+  }
+  _FS5.loadCalibration(state);
+  _heading = state.heading;
+  _span = state.span;
+  _homed = true;
+  _resumed = true;
+  _verify = true;
+  _trackCycles = trackRehome - resumeCycles;
+  _trackLevel = 0;
+  _saved = true;
+  _savedHeading = _heading;
+  _savedSpan = _span;
+  _lastSave = millis();
+  return true;
+}
+
+/* Function:    int Control::span()
+ * 
+ * Purpose:     The heading of the far limit switch.
+ * 
+ * Input:       None
+ * 
+ * Output:      Steps from the start position, 0 if unknown.
+*/
+int Control::span(){
+  return _span;
+}
+
+/* Function:    int Control::heading()
+ * 
+ * Purpose:     The step position counted ccw from the start position.
+ * 
+ * Input:       None
+ * 
+ * Output:      Steps from the start position.
+*/
+int Control::heading(){
+  return _heading;
+}
+
+/* Function:    void Control::setScanMode(ScanMode mode)
+ * 
+ * Purpose:     Select the search strategy of the following scans, see 
+ *              Controller.h.
+ * 
+ * Input:       Search strategy                   (ScanMode mode)
+ * 
+ * Output:      None
+*/
+void Control::setScanMode(ScanMode mode){
+  _mode = mode;
+}
+
+/* Function:    void Control::setStepInterval(unsigned long interval)
+ * 
+ * Purpose:     Set the shortest time between two steps taken by tick().
+ *              The default 0 lets the stepper motor driver pace the steps.
+ * 
+ * Input:       Time between steps [us]           (unsigned long interval)
+ * 
+ * Output:      None
+*/
+void Control::setStepInterval(unsigned long interval){
+  _stepInterval = interval;
+}
+
+/* Function:    void Control::setMotion(unsigned int maxRate, unsigned int acceleration, unsigned int startRate)
+ * 
+ * Purpose:     Set the limits of the stepper motor for the moves that 
+ *              do not read the FS5, see Controller.h. The sweep rate is
+ *              limited to the new start rate.
+ * 
+ * Input:       Highest rate [steps/s]            (unsigned int maxRate)
+ *              Acceleration [steps/s^2]          (unsigned int acceleration)
+ *              Start and stop rate [steps/s]     (unsigned int startRate)
+ * 
+ * Output:      None
+*/
+void Control::setMotion(unsigned int maxRate, unsigned int acceleration, unsigned int startRate){
+  _motion.setLimits(maxRate, acceleration, startRate);
+  setSweepRate(_sweepRate);
+}
+
+/* Function:    void Control::setSweepRate(unsigned int rate)
+ * 
+ * Purpose:     Set the constant rate of the sweeps that read the FS5,
+ *              at most the start rate.
+ * 
+ * Input:       Sweep rate [steps/s]              (unsigned int rate)
+ * 
+ * Output:      None
+*/
+void Control::setSweepRate(unsigned int rate){
+  _sweepRate = rate < _motion.startRate() ? rate : _motion.startRate();
+}
+
+/* Function:    uint8_t Control::profileLength()
+ * 
+ * Purpose:     Number of values in the profile of the last scan.
+ * 
+ * Input:       None
+ * 
+ * Output:      Number of profile values.
+*/
+uint8_t Control::profileLength(){
+  return _profileCount;
+}
+
+/* Function:    unsigned int Control::profileValue(uint8_t i)
+ * 
+ * Purpose:     The FS5 signal of the profile at one heading.
+ * 
+ * Input:       Index, 0 to profileLength() - 1   (uint8_t i)
+ * 
+ * Output:      Mean ADC code times profileScale, 0 outside the profile.
+*/
+unsigned int Control::profileValue(uint8_t i){
+  return i < _profileCount ? _profile[i] : 0;
+}
+
+/* Function:    int Control::profileHeading(uint8_t i)
+ * 
+ * Purpose:     The heading of a profile value.
+ * 
+ * Input:       Index, 0 to profileLength() - 1   (uint8_t i)
+ * 
+ * Output:      Steps from the start position.
+*/
+int Control::profileHeading(uint8_t i){
+  return _profileFirst + (int)i*_profileStride;
+}
+
+/* Function:    int Control::peakHeading()
+ * 
+ * Purpose:     The heading of the peak fitted to the profile.
+ * 
+ * Input:       None
+ * 
+ * Output:      Steps from the start position.
+*/
+int Control::peakHeading(){
+  return _peakHeading;
+}
+
+/* Function:    ScanPhase Control::phase()
+ * 
+ * Purpose:     The current phase of the scan. 
+ * 
+ * Input:       None
+ * 
+ * Output:      The phase, SCAN_IDLE when no scan is in progress.
+*/
+ScanPhase Control::phase(){
+  return _phase;
+}
+
+/* Function:    uint8_t Control::progress()
+ * 
+ * Purpose:     Estimate how far the scan has come. The sweep is assumed
+ *              to cover about 180 degrees.
+ * 
+ * Input:       None
+ * 
+ * Output:      Progress in percent, 100 when done.
+*/
+uint8_t Control::progress(){
+  long done;        //Steps done in the current phase.
+  switch(_phase){
+    case SCAN_HOMING:
+      return 0;
+    case SCAN_HOME_RELEASE:
+      return 10 + 10L*_releaseCount/LSSafteyStep;
+    case SCAN_SWEEP:
+      done = _stepCounter < expectedSweep ? _stepCounter : expectedSweep;
+      return 20 + 50L*done/expectedSweep;
+    case SCAN_SWEEP_RELEASE:
+      return 70 + 10L*_releaseCount/LSSafteyStep;
+    case SCAN_ALIGN:
+      done = _position < _moveSteps ? _position : _moveSteps;
+      return _moveSteps > 0 ? 80 + 19L*done/_moveSteps : 99;
+    case SCAN_ALIGN_RELEASE:
+      return 99;
+    case SCAN_COARSE:
+      done = _stepCounter < expectedSweep ? _stepCounter : expectedSweep;
+      return 10 + 70L*done/expectedSweep;
+    case SCAN_MOVE:
+      done = _position < _moveSteps ? _position : _moveSteps;
+      return _moveSteps > 0 ? 80 + 19L*done/_moveSteps : 99;
+    case SCAN_TRACK:
+      return 25*_trackStep;
+    default:
+      return 100;
   }
 }
+
+/* Function:    bool Control::scanning()
+ * 
+ * Purpose:     Check if a scan is in progress.
+ * 
+ * Input:       None
+ * 
+ * Output:      True while a scan is in progress.
+*/
+bool Control::scanning(){
+  return _phase != SCAN_IDLE;
+}
@@ -14,16 +14,67 @@
  *    Driver:         ULN2003 IC
  *    
  * Notes: 
- *    - In order for this library to work, please install the library
- *      CheapStepper created by tyhenry via: 
- *      https://github.com/tyhenry/CheapStepper
+ *    - The motor is stepped through the port registers, see 
+ *      FastStepper.h. With FLAGPOLE_CHEAPSTEPPER set to 1, below or on
+ *      the compiler command line, it is stepped by the library 
+ *      CheapStepper created by tyhenry instead, which has to be 
+ *      installed via: https://github.com/tyhenry/CheapStepper
+ *    - The limit switch is watched by the pin change interrupt, see 
+ *      LimitSwitch.h, so the steps do not read it.
+ *    - The step counts come from the pole of FLAGPOLE_CONFIG, see 
+ *      FlagpoleConfig.h. With FLAGPOLE_FIXED_CONFIG set to 1 the FS5 
+ *      read during the scan is an FS5Fixed of that pole, and the pin and
+ *      calibration given to the constructor are not used. The heading
+ *      offset is then FLAGPOLE_CONFIG::calibrationSteps as well, see
+ *      setHeadingOffset().
+ *    - The status messages are kept in flash.
  */
 
 #ifndef Controller_h        //Include guard.
 #define Controller_h
 #include "Arduino.h"        
-#include "CheapStepper.h"
 #include "FS5.h"
+#include "FS5Array.h"
+#include "FlagpoleConfig.h"
+#include "LimitSwitch.h"
+#include "Motion.h"
+#include "Storage.h"
+
+#ifndef FLAGPOLE_CHEAPSTEPPER
+#define FLAGPOLE_CHEAPSTEPPER 0
+#endif
+
+#if FLAGPOLE_CHEAPSTEPPER
+#include "CheapStepper.h"
+typedef CheapStepper StepperDriver;
+#else
+#include "FastStepper.h"
+typedef FastStepper StepperDriver;
+#endif
+
+#include "FS5Fixed.h"
+typedef PoleFS5 ScanSensor;
+
+//Phases of the scanning procedure, see Control::phase().
+enum ScanPhase {
+  SCAN_IDLE,            //No scan in progress.
+  SCAN_HOMING,          //Case 0: rotate cw until the limit switch.
+  SCAN_HOME_RELEASE,    //Case 0: release the limit switch.
+  SCAN_SWEEP,           //Case 1: sweep ccw and record the profile.
+  SCAN_SWEEP_RELEASE,   //Case 1: release the limit switch.
+  SCAN_ALIGN,           //Case 2: rotate to the peak of the profile.
+  SCAN_ALIGN_RELEASE,   //Case 2: release the limit switch if hit.
+  SCAN_COARSE,          //Coarse sweep ccw, sampling every coarseStride steps.
+  SCAN_MOVE,            //Rotate cw straight to the fitted peak.
+  SCAN_TRACK            //Probe both sides of the heading and follow the peak,
+                        //or move to the direction of the array.
+};
+
+//Search strategies, see Control::setScanMode().
+enum ScanMode {
+  SCAN_EXHAUSTIVE,      //Read the FS5 at every step of the sweep.
+  SCAN_COARSE_FINE      //Coarse sweep, parabolic peak fit, direct move.
+};
 
 //Class for controlling the stepper motor.
 class Control{
@@ -49,7 +100,7 @@ class Control{
        * 
        * Purpose:     Find the direction of, and align the sensor to, the
        *              wind current by scanning a span of approximately
-       *              180 degrees.  
+       *              180 degrees. Blocks until the scan is complete. 
        * 
        * Input:       None
        * 
@@ -57,16 +108,437 @@ class Control{
       */
       void scan();
 
+      /* Function:    void Control::begin()
+       * 
+       * Purpose:     Start a scan without blocking. The scan is then 
+       *              advanced by calling tick() until it returns false.
+       *              Enables the pin change interrupt of the limit 
+       *              switch.
+       * 
+       * Input:       None
+       * 
+       * Output:      None
+      */
+      void begin();
+
+      /* Function:    bool Control::tick(unsigned long now)
+       * 
+       * Purpose:     Advance the scan started by begin() by at most one
+       *              step of the stepper motor. Steps are not taken closer
+       *              than the step interval, see setStepInterval(). When
+       *              the scan ends the coils of the motor are turned off.
+       * 
+       * Input:       Current time from micros()        (unsigned long now)
+       * 
+       * Output:      True while the scan is in progress.
+      */
+      bool tick(unsigned long now);
+
+      /* Function:    void Control::setStepInterval(unsigned long interval)
+       * 
+       * Purpose:     Set the shortest time between two steps taken by
+       *              tick(). The default 0 lets the speed profile of the
+       *              move pace the steps, see setMotion().
+       * 
+       * Input:       Time between steps [us]           (unsigned long interval)
+       * 
+       * Output:      None
+      */
+      void setStepInterval(unsigned long interval);
+
+      /* Function:    void Control::setMotion(unsigned int maxRate, unsigned int acceleration, unsigned int startRate)
+       * 
+       * Purpose:     Set the limits of the stepper motor. The moves that
+       *              do not read the FS5, homing, the releases of the 
+       *              limit switch, the alignment and the tracking moves,
+       *              speed up from the start rate to the highest rate and
+       *              slow down again before the end, see Motion.h. 
+       * 
+       *              A homing with a known heading is planned up to 
+       *              homeApproach steps before the start position and
+       *              continues at the start rate. Without a known heading
+       *              the whole homing runs at the start rate.
+       * 
+       *              The defaults suit the 28BYJ-48 at 12 V in half steps: 
+       *              1600 steps/s, 4000 steps/s^2 and 1092 steps/s, the 
+       *              16 rpm every move used before. With CheapStepper
+       *              rates above 1600 steps/s are not reached since it
+       *              waits 600 us after each step. setMotion(1092, 0, 
+       *              1092) runs every move at 16 rpm.
+       * 
+       * Input:       Highest rate [steps/s]            (unsigned int maxRate)
+       *              Acceleration [steps/s^2]          (unsigned int acceleration)
+       *              Start and stop rate [steps/s]     (unsigned int startRate)
+       * 
+       * Output:      None
+      */
+      void setMotion(unsigned int maxRate, unsigned int acceleration, unsigned int startRate);
+
+      /* Function:    void Control::setSweepRate(unsigned int rate)
+       * 
+       * Purpose:     Set the constant rate of the sweeps that read the 
+       *              FS5. The sweeps end at the limit switch without
+       *              slowing down, so the rate is limited to the start
+       *              rate of setMotion(). Default 1092 steps/s, 16 rpm.
+       * 
+       * Input:       Sweep rate [steps/s]              (unsigned int rate)
+       * 
+       * Output:      None
+      */
+      void setSweepRate(unsigned int rate);
+
+      /* Function:    void Control::setScanMode(ScanMode mode)
+       * 
+       * Purpose:     Select the search strategy of the following scans.
+       * 
+       *              SCAN_EXHAUSTIVE sweeps the whole span one step at a
+       *              time and reads the FS5 without filtering after every
+       *              step. The readings are summed into a profile bin every
+       *              profileStride steps. After the far limit switch the
+       *              motor returns to the peak fitted to the profile.
+       * 
+       *              SCAN_COARSE_FINE sweeps without filtering and reads
+       *              the FS5 only every coarseStride steps, averaging
+       *              coarseReads readings. The sweep stops early when 
+       *              fitHalfWidth samples past the highest one are taken
+       *              and the signal has risen coarseRise codes to it and
+       *              fallen coarseDrop codes since, or when it has fallen
+       *              below half of the peak. The samples form the profile,
+       *              and the motor moves straight back to the peak fitted
+       *              to it.
+       * 
+       *              In both modes a parabola is fitted by least squares
+       *              to the profile within fitHalfWidth of its highest 
+       *              value, so the peak falls between bins and no single
+       *              reading decides it.
+       * 
+       * Input:       Search strategy                   (ScanMode mode)
+       * 
+       * Output:      None
+      */
+      void setScanMode(ScanMode mode);
+
+      /* Function:    void Control::setTracking(bool enabled)
+       * 
+       * Purpose:     Enable or disable tracking. When tracking, begin() 
+       *              only does a full scan the first time. The following
+       *              calls keep the step position counted from the start
+       *              position and follow the wind with a perturb and 
+       *              observe cycle: the FS5 is read at the heading and 
+       *              trackProbe steps to each side, and the sensor is 
+       *              moved to the vertex of the parabola through the 
+       *              three readings.
+       * 
+       *              A full scan is done instead when the signal drops
+       *              below half of the previous cycle, when the limit 
+       *              switch is activated during a cycle (the position is
+       *              lost or the wind is outside the span) and every 
+       *              trackRehome cycles to bound the drift from lost 
+       *              steps.
+       * 
+       * Input:       Tracking on or off                (bool enabled)
+       * 
+       * Output:      None
+      */
+      void setTracking(bool enabled);
+
+      /* Function:    void Control::setHeadingOffset(int steps)
+       * 
+       * Purpose:     Set how far cw of the peak of the FS5 signal the 
+       *              sensor is held, the calibration of the mount. The
+       *              sweeps align the sensor this many steps cw of the 
+       *              fitted peak, the tracking cycles probe around the
+       *              peak and return by it, and the array moves by it.
+       *              Default FLAGPOLE_CONFIG::calibrationSteps. With
+       *              FLAGPOLE_FIXED_CONFIG set it is fixed at that.
+       * 
+       * Input:       Steps cw of the signal peak       (int steps)
+       * 
+       * Output:      None
+      */
+      void setHeadingOffset(int steps);
+
+      /* Function:    void Control::setMessages(bool enabled)
+       * 
+       * Purpose:     Enable or disable the status messages printed on the
+       *              serial port during a scan, e.g. "Scanning...". On by 
+       *              default. Turn them off when the port carries binary
+       *              telemetry.
+       * 
+       * Input:       Messages on or off                (bool enabled)
+       * 
+       * Output:      None
+      */
+      void setMessages(bool enabled);
+
+      /* Function:    void Control::useSampler(ADCSampler* sampler)
+       * 
+       * Purpose:     Let the FS5 used during the scan read from a running
+       *              background sampler, see FS5sensor::useSampler(). 
+       *              Required when the sampler runs, since analogRead()
+       *              cannot be used meanwhile.
+       * 
+       * Input:       Sampler of the FS5 pin, 0 to use analogRead()
+       *                                                (ADCSampler* sampler)
+       * 
+       * Output:      None
+      */
+      void useSampler(ADCSampler* sampler);
+
+      /* Function:    void Control::useArray(FS5Array* array)
+       * 
+       * Purpose:     Find the wind direction with a fixed array of FS5
+       *              sensors on the shaft instead of rotating, see 
+       *              FS5Array.h. begin() then takes one pass of the 
+       *              array in place of the probes of a tracking cycle, 
+       *              also before the first full scan, and moves the 
+       *              sensor straight to the fitted direction, but only
+       *              if it is more than arrayDeadband steps away and the
+       *              wind is above arrayCalm. Before the first full scan
+       *              the moves are counted from the power up position.
+       *              The full scans every trackRehome cycles, or when the
+       *              limit switch closes during a move, refine the 
+       *              heading and find the start position and the span.
+       * 
+       * Input:       Array of FS5 sensors, 0 to probe with the motor
+       *                                                (FS5Array* array)
+       * 
+       * Output:      None
+      */
+      void useArray(FS5Array* array);
+
+      /* Function:    void Control::useStorage(Storage* storage)
+       * 
+       * Purpose:     Save the heading, the heading of the far limit 
+       *              switch and the FS5 calibration when a scan or a 
+       *              tracking cycle ends, see Storage.h. A save is done
+       *              after the first scan and then when the heading has
+       *              moved saveThreshold steps or the span has changed,
+       *              at most once every saveInterval ms to spare the 
+       *              EEPROM. A save blocks for about 3.3 ms per changed
+       *              byte.
+       * 
+       * Input:       Storage, 0 to not save            (Storage* storage)
+       * 
+       * Output:      None
+      */
+      void useStorage(Storage* storage);
+
+      /* Function:    bool Control::resume(const StoredState& state)
+       * 
+       * Purpose:     Continue from a state saved before a reset. The 
+       *              stored heading is taken as the current one and the 
+       *              FS5 used during the scan takes the stored 
+       *              calibration. The next begin() does not move, so the
+       *              wind is sampled and a decision made at once. The
+       *              following calls track from the stored heading and 
+       *              after resumeCycles cycles a full scan verifies it.
+       *              That scan searches for the start position at the
+       *              start rate, as if the heading was unknown. Without 
+       *              tracking the verification is the next begin().
+       * 
+       * Input:       Loaded state                      (const StoredState& state)
+       * 
+       * Output:      True if the state was used, false if it was not 
+       *              homed or the heading is outside the span.
+      */
+      bool resume(const StoredState& state);
+
+      /* Function:    int Control::span()
+       * 
+       * Purpose:     The heading of the far limit switch, measured by the
+       *              last sweep that reached it.
+       * 
+       * Input:       None
+       * 
+       * Output:      Steps from the start position, 0 if unknown.
+      */
+      int span();
+
+      /* Function:    int Control::heading()
+       * 
+       * Purpose:     The step position counted ccw from the start 
+       *              position, valid once a scan has found the start 
+       *              position.
+       * 
+       * Input:       None
+       * 
+       * Output:      Steps from the start position.
+      */
+      int heading();
+
+      /* Function:    uint8_t Control::profileLength()
+       * 
+       * Purpose:     Number of values in the profile of the last scan, see
+       *              profileValue(). The profile is kept until the next 
+       *              full scan starts.
+       * 
+       * Input:       None
+       * 
+       * Output:      Number of profile values, at most profileSize.
+      */
+      uint8_t profileLength();
+
+      /* Function:    unsigned int Control::profileValue(uint8_t i)
+       * 
+       * Purpose:     The FS5 signal of the profile at one heading, see
+       *              profileHeading(). In the exhaustive mode it is the 
+       *              mean over profileStride steps, in the coarse-to-fine
+       *              mode the mean of coarseReads readings. 
+       * 
+       * Input:       Index, 0 to profileLength() - 1   (uint8_t i)
+       * 
+       * Output:      Mean ADC code times profileScale.
+      */
+      unsigned int profileValue(uint8_t i);
+
+      /* Function:    int Control::profileHeading(uint8_t i)
+       * 
+       * Purpose:     The heading of a profile value, counted like 
+       *              heading(). 
+       * 
+       * Input:       Index, 0 to profileLength() - 1   (uint8_t i)
+       * 
+       * Output:      Steps from the start position.
+      */
+      int profileHeading(uint8_t i);
+
+      /* Function:    int Control::peakHeading()
+       * 
+       * Purpose:     The heading of the peak fitted to the profile of the
+       *              last scan, counted like heading(). 
+       * 
+       * Input:       None
+       * 
+       * Output:      Steps from the start position.
+      */
+      int peakHeading();
+
+      /* Function:    ScanPhase Control::phase()
+       * 
+       * Purpose:     The current phase of the scan. 
+       * 
+       * Input:       None
+       * 
+       * Output:      The phase, SCAN_IDLE when no scan is in progress.
+      */
+      ScanPhase phase();
+
+      /* Function:    uint8_t Control::progress()
+       * 
+       * Purpose:     Estimate how far the scan has come. The sweep is 
+       *              assumed to cover about 180 degrees.
+       * 
+       * Input:       None
+       * 
+       * Output:      Progress in percent, 100 when done.
+      */
+      uint8_t progress();
+
+      /* Function:    bool Control::scanning()
+       * 
+       * Purpose:     Check if a scan is in progress.
+       * 
+       * Input:       None
+       * 
+       * Output:      True while a scan is in progress.
+      */
+      bool scanning();
+
+      static const uint8_t profileSize = 160;   //Capacity of the profile, a 215 degree span.
+
   private:
-      int _limitSwitch;   //Pin for limit switch.
-      int _IN1;           //Pin for Stepper motor.
-      int _IN2;           //Pin for Stepper motor.
-      int _IN3;           //Pin for Stepper motor.
-      int _IN4;           //Pin for Stepper motor.
-      int _pin;           //Pin for FS5.
-      double _U0;         //Voltage U at wind speed 0%.
-      double _U50;        //Voltage U at wind speed 50%.
-      double _v50;        //Wind velocity v at wind speed 50%.
-      double _n;          //Value to setup FS5 for parameter n.
+      StepperDriver _stepper;   //Controller for the stepper motor.
+      Motion _motion;           //Speed profile of the current move.
+      unsigned int _sweepRate;  //Rate of the sweeps [steps/s].
+      ScanSensor _FS5;          //FS5 sensor used during the sweep.
+      LimitSwitch _switch;      //Limit switch, latches the step it closes at.
+
+      //State of the scan.
+      ScanPhase _phase;               //Current phase of the scan.
+      bool _cw;                       //The direction towards the start position.
+      int _stepCounter;               //Counter for steps during the sweep.
+      int _position;                  //Current step position.
+      int _releaseCount;              //Steps taken to release the limit switch.
+      unsigned long _stepInterval;    //Shortest time between steps [us].
+      unsigned long _lastStep;        //Time of the last step [us].
+      bool _messages;                 //Print status messages.
+      void message(const __FlashStringHelper* text);
+
+      //State of the coarse-to-fine search.
+      void finishCoarse();
+      ScanMode _mode;                 //Search strategy.
+      int _moveSteps;                 //Steps of the final move to the peak.
+
+      //Profile of the sweep.
+      void addProfile(unsigned int value, int heading);
+      void fitProfile();
+      uint8_t _profileCount;          //Number of profile values.
+      uint8_t _profileBest;           //Index of the highest profile value.
+      uint8_t _profileStride;         //Steps between profile values.
+      int _profileFirst;              //Heading of the first profile value.
+      int _peakHeading;               //Heading of the fitted peak.
+      int _alignHeading;              //Heading to align to, cw of the peak.
+#if FLAGPOLE_FIXED_CONFIG
+      static const int _headingOffset = FLAGPOLE_CONFIG::calibrationSteps;  //Steps cw of the signal peak to hold.
+#else
+      int _headingOffset;             //Steps cw of the signal peak to hold.
+#endif
+      unsigned int _binSum;           //Sum of the readings of the current bin.
+
+      static const int LSSafteyStep = FLAGPOLE_CONFIG::releaseSteps;  //The number of steps to release limit switch.
+      static const int homeApproach = 64;   //Steps before the start position at the start rate.
+      static const unsigned int switchDebounce = 2000;      //Lockout after a limit switch edge [us].
+      static const unsigned int defaultMaxRate = 1600;      //Highest rate [steps/s].
+      static const unsigned int defaultAcceleration = 4000; //Acceleration [steps/s^2].
+      static const unsigned int defaultStartRate = 1092;    //Start and stop rate, 16 rpm [steps/s].
+      static const int expectedSweep = FLAGPOLE_CONFIG::expectedSweep;  //Steps of a 180 degree sweep.
+      static const uint8_t profileStride = 16;  //Steps per profile bin, exhaustive mode.
+      static const uint8_t profileScale = 16;   //Profile values are ADC codes times this.
+      static const uint8_t coarseStride = 32;   //Steps between coarse samples.
+      static const uint8_t coarseReads = 4;     //ADC readings per coarse sample.
+      static const uint8_t fitHalfWidth = 6;    //Profile values each side in the fit.
+      static const uint8_t coarseRise = 8;      //Rise to the peak to stop early [ADC codes].
+      static const uint8_t coarseDrop = 2;      //Fall past the peak to stop early [ADC codes].
+      unsigned int _profile[profileSize];       //Profile, mean ADC codes times profileScale.
+
+      //State of the tracking.
+      void move(bool cw);
+      void startScan();
+      void finishTrack();
+      bool _tracking;                 //Tracking enabled.
+      bool _homed;                    //The heading is counted from the start position.
+      int _heading;                   //Steps ccw from the start position.
+      int _trackCenter;               //Heading of the signal peak at the start.
+      int _trackTarget;               //Heading to move to.
+      uint8_t _trackStep;             //Reading of the cycle to take next.
+      unsigned int _trackY[3];        //Readings at the heading, ccw and cw side.
+      long _trackLevel;               //Signal above zero wind of the last cycle.
+      unsigned int _trackCycles;      //Cycles since the last full scan.
+
+      //State of the array.
+      void arrayCycle();
+      FS5Array* _array;               //Array of FS5 sensors, 0 if not used.
+      static const int arrayDeadband = 32;      //Smallest move to the fitted direction [steps].
+      static constexpr double arrayCalm = 0.5;  //No move below this wind speed [m/s].
+
+      static const int trackProbe = 128;        //Steps to each side when probing.
+      static const uint8_t trackReads = 16;     //ADC readings per probe.
+      static const unsigned int trackRehome = 60;   //Cycles between full scans.
+
+      //State of the storage.
+      void persist();
+      Storage* _storage;              //Storage of the state, 0 if not used.
+      int _span;                      //Heading of the far limit switch, 0 if unknown.
+      int _savedHeading;              //Heading of the last save.
+      int _savedSpan;                 //Span of the last save.
+      unsigned long _lastSave;        //Time of the last save [ms].
+      bool _saved;                    //Saved or resumed since the start.
+      bool _resumed;                  //Resumed, the next begin() does not move.
+      bool _verify;                   //The next full scan ignores the heading.
+
+      static const int saveThreshold = 32;              //Heading change that is saved [steps].
+      static const unsigned long saveInterval = 60000;  //Shortest time between saves [ms].
+      static const unsigned int resumeCycles = 5;       //Tracking cycles before the verification scan.
 };
 #endif
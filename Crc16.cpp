@@ -0,0 +1,35 @@
+/* Filename:      Crc16.cpp
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Library for the CRC of the telemetry and the stored state, see
+ *    Crc16.h.
+ */
+
+//Include libraries.
+#include "Arduino.h"
+#include "Crc16.h"
+
+/* Function:    uint16_t crc16(const uint8_t* data, uint8_t size)
+ *
+ * Purpose:     CRC-16/CCITT-FALSE, polynomial 0x1021, start 0xFFFF.
+ *
+ * Input:       Data                            (const uint8_t* data)
+ *              Number of bytes                 (uint8_t size)
+ *
+ * Output:      The CRC.
+*/
+uint16_t crc16(const uint8_t* data, uint8_t size){
+  uint16_t crc = 0xFFFF;
+  for(uint8_t i = 0; i < size; i++){
+    crc ^= (uint16_t)data[i] << 8;
+    for(uint8_t bit = 0; bit < 8; bit++){
+      crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+  }
+  return crc;
+}
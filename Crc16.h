@@ -0,0 +1,31 @@
+/* Filename:      Crc16.h
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Header for the Crc16 library.
+ *
+ *    The CRC-16/CCITT-FALSE that guards the telemetry frames of
+ *    Telemetry.h and the stored state of Storage.h.
+ *
+ * Notes:
+ *    - The CRC is computed bit by bit, which needs no table in flash.
+ */
+
+#ifndef Crc16_h           //Include guard.
+#define Crc16_h
+#include "Arduino.h"
+
+/* Function:    uint16_t crc16(const uint8_t* data, uint8_t size)
+ * Purpose:     CRC-16/CCITT-FALSE, polynomial 0x1021, start 0xFFFF.
+ *
+ * Input:       Data                            (const uint8_t* data)
+ *              Number of bytes                 (uint8_t size)
+ *
+ * Output:      The CRC.
+*/
+uint16_t crc16(const uint8_t* data, uint8_t size);
+#endif
@@ -13,9 +13,6 @@
  *    Sensor:     FS5 Thermal Mass Flow Sensor
  *    
  * Notes: 
- *    - In order for this library to work, please install the library
- *      Filters created by hideakitai via:
- *      https://github.com/hideakitai/Filters
  *    - In order to get a signal from the FS5 sensor, the sensor has to be
  *      configured in a constant temperature setup.  
  */
@@ -23,12 +20,8 @@
 //Include libraries.
 #include "Arduino.h"
 #include "FS5.h"
-#include "Filters.h"
-
-float filterFrequency = 0.3; //Set filter frequency.
-
-//Initialize low pass filter.
-FilterOnePole filterOneLowPass(LOWPASS, filterFrequency);      
+#include "FS5Filter.h"
+#include "Profiler.h"
 
 /* Constructor:   FS5sensor::FS5sensor(int pin, double U0, double U50, double v50, double n)
  * 
@@ -45,11 +38,71 @@ FilterOnePole filterOneLowPass(LOWPASS, filterFrequency);
  */
 FS5sensor::FS5sensor(int pin, double U0, double U50, double v50, double n){
   _pin = pin;
+  setCalibration(U0, U50, v50, n);
+  _lastFilterUs = 0;
+  _filter.setup(FS5_FILTER_FREQUENCY, 1000);
+}
+
+/* Function:    void FS5sensor::setCalibration(double U0, double U50, double v50, double n)
+ * Purpose:     Change the calibration and calculate k and the constants
+ *              of velocityFromVoltage(). Refills the velocity table if
+ *              one is in use.
+ * 
+ * Input:       Voltage U at wind speed 0%              (double U0)
+ *              Voltage U at wind speed 50%             (double U50)
+ *              Wind speed v at wind speed 50%          (double v50)
+ *              Value to setup FS5 for parameter n      (double n)
+ *
+ * Output:      None
+*/
+void FS5sensor::setCalibration(double U0, double U50, double v50, double n){
   _U0 = U0; 
   _U50 = U50; 
   _v50 = v50; 
   _n = n; 
   _k = (pow(U50/U0,2)-1)/pow(v50,n);    
+  _invN = 1/n;
+  _velScale = pow(_k,_invN)*pow(U0,2*_invN);
+  if(_table){
+    useTable(_table, _table->interpolate);
+  }
+}
+
+/* Function:    void FS5sensor::storeCalibration(StoredState& state)
+ * Purpose:     Copy the calibration and k to a state to be saved.
+ * 
+ * Input:       State to fill                           (StoredState& state)
+ *
+ * Output:      None
+*/
+void FS5sensor::storeCalibration(StoredState& state){
+  state.U0 = _U0;
+  state.U50 = _U50;
+  state.v50 = _v50;
+  state.n = _n;
+  state.k = _k;
+}
+
+/* Function:    bool FS5sensor::loadCalibration(const StoredState& state)
+ * Purpose:     Use the calibration of a loaded state. The stored k has to
+ *              agree with the k calculated from the other constants, in
+ *              float precision, otherwise the calibration is kept.
+ * 
+ * Input:       Loaded state                            (const StoredState& state)
+ *
+ * Output:      True if the stored calibration is used.
+*/
+bool FS5sensor::loadCalibration(const StoredState& state){
+  if(!(state.U0 > 0 && state.U50 > state.U0 && state.U50 <= _maxInputVoltage &&
+       state.v50 > 0 && state.n > 0 && state.n < 2)){
+    return false;
+  }
+  double k = (pow((double)state.U50/state.U0,2)-1)/pow((double)state.v50,(double)state.n);
+  if(fabs(k - state.k) > 1e-4*k){
+    return false;
+  }
+  setCalibration(state.U0, state.U50, state.v50, state.n);
+  return true;
 }
 
 /* Function:    double FS5sensor::voltage() 
@@ -61,11 +114,53 @@ FS5sensor::FS5sensor(int pin, double U0, double U50, double v50, double n){
  * Output:      The current voltage input from the FS5 sensor. 
 */
 double FS5sensor::voltage(){
-  //Mapping the signal to voltage and filter out noise.
-  double voltage = filterOneLowPass.input(analogRead(_pin)/_c*_maxInputVoltage);  
+  PROFILE_SCOPE(PROFILE_FS5_READ);
+  //Time since the last sample in units of 64 us. The remainder is 
+  //carried to the next sample.
+  unsigned long now = micros();
+  unsigned long dt = (now - _lastFilterUs) >> 6;
+  _lastFilterUs += dt << 6;
+  if(dt > 0xFFFF){
+    dt = 0xFFFF;
+    _lastFilterUs = now;
+  }
+
+  //The decimated value of the sampler keeps its fractional bits in Q5.
+  FilterSample sample;
+  if(_sampler){
+    sample = (FilterSample)(_sampler->code()*32 + 0.5);
+  }
+  else{
+    sample = analogRead(_pin) << 5;
+  }
+
+  //Filter the signal in Q5 and map it to voltage.
+  FilterSample filtered = _filter.input(sample, dt);
+  double voltage = filtered/(_c*32)*_maxInputVoltage;
   return voltage; 
 }
 
+/* Function:    unsigned int FS5sensor::readRaw(uint8_t samples) 
+ * Purpose:     Read the input signal from the FS5 sensor a number of
+ *              times without filtering. 
+ * 
+ * Input:       Number of readings, at most 64     (uint8_t samples)
+ * 
+ * Output:      The sum of the ADC codes of the readings. 
+*/
+unsigned int FS5sensor::readRaw(uint8_t samples){
+  PROFILE_SCOPE(PROFILE_FS5_READ);
+  if(_sampler){
+    return (unsigned int)(_sampler->code()*samples + 0.5);
+  }
+
+  unsigned int sum = 0;
+  for(uint8_t i = 0; i < samples; i++){
+    sum += analogRead(_pin);
+  }
+  return sum;
+}
+
 /* Function:     double FS5sensor::velocity()
  * Purpose:      Calculate the wind velocity.   
  * 
@@ -74,15 +169,142 @@ double FS5sensor::voltage(){
  * Output:       Wind velocity
 */
 double FS5sensor::velocity(){
+  PROFILE_SCOPE(PROFILE_VELOCITY);
   double U = voltage();   //Record the current voltage.
-  
+
+  //Read the table at the fractional ADC code if one is in use.
+  if(_table){
+    return _table->lookup(U*_c/_maxInputVoltage);
+  }
+  return velocityFromVoltage(U);
+}
+
+/* Function:     double FS5sensor::velocityFromCode(double code)
+ * Purpose:      Calculate the wind velocity for a, possibly fractional,
+ *               ADC code, from the velocity table if one is in use and 
+ *               else with the FS5 transfer function.
+ * 
+ * Input:        Mean ADC code of the FS5               (double code)
+ * 
+ * Output:       Wind velocity
+*/
+double FS5sensor::velocityFromCode(double code){
+  if(_table){
+    return _table->lookup(code);
+  }
+  return velocityFromVoltage(code/_c*_maxInputVoltage);
+}
+
+/* Function:     double FS5sensor::velocityFromVoltage(double U)
+ * Purpose:      Calculate the wind velocity for a given voltage with the
+ *               FS5 transfer function.
+ * 
+ * Input:        Voltage from the FS5                   (double U)
+ * 
+ * Output:       Wind velocity
+*/
+double FS5sensor::velocityFromVoltage(double U){
   //If the recorded voltage is lower than the voltage U0 at 0% wind speed, the current voltage is set to U0. This can happen due to error margins in the measurement of U0.
   if(U<_U0){              
     U = _U0; 
   }
   
-  //Calculates the wind velocity from given parameters and the recorded voltage U. 
-  double vel = (pow(((U-_U0)*(U+_U0)),(1/_n)))/(pow(_k,(1/_n))*(pow(_U0,(2/_n))));  
+  //Calculates the wind velocity from given parameters and the recorded voltage U. The denominator (k*U0^2)^(1/n) is constant and computed in the constructor.
+  double vel = pow(((U-_U0)*(U+_U0)),_invN)/_velScale;  
                                                          
   return vel;                                                              
 }
+
+/* Function:     void FS5sensor::useTable(FS5Table* table, bool interpolate)
+ * Purpose:      Fill the table with the velocity at every 
+ *               2^FS5_TABLE_SHIFT:th ADC code from U0 and up, and let 
+ *               velocity() read the table instead of calling pow().
+ * 
+ * Input:        Table to fill, 0 to use the formula    (FS5Table* table)
+ *               Interpolate between knots              (bool interpolate)
+ * 
+ * Output:       None
+*/
+void FS5sensor::useTable(FS5Table* table, bool interpolate){
+  _table = table;
+  if(!table){
+    return;
+  }
+
+  //The first knot is at or just below the code of U0, everything below
+  //it maps to zero wind speed anyway. 
+  int startCode = (int)(_U0*_c/_maxInputVoltage);
+  startCode = (startCode >> FS5_TABLE_SHIFT) << FS5_TABLE_SHIFT;
+  table->startCode = startCode;
+  table->interpolate = interpolate;
+  table->knots = ((1023 - startCode) >> FS5_TABLE_SHIFT) + 2;
+
+  for(int i = 0; i < table->knots; i++){
+    int code = startCode + (i << FS5_TABLE_SHIFT);
+    table->velocity[i] = sqrt(velocityFromVoltage(code/_c*_maxInputVoltage));
+  }
+}
+
+/* Function:     void FS5sensor::setFilter(double frequency, unsigned long periodUs)
+ * Purpose:      Set up the filter chain of the sensor and restart it.
+ * 
+ * Input:        Cutoff frequency [Hz]                  (double frequency)
+ *               Time between calls to voltage() for the stages that 
+ *               assume a fixed rate [us]               (unsigned long periodUs)
+ * 
+ * Output:       None
+*/
+void FS5sensor::setFilter(double frequency, unsigned long periodUs){
+  _filter.setup(frequency, periodUs);
+}
+
+/* Function:     void FS5sensor::useSampler(ADCSampler* sampler)
+ * Purpose:      Read the FS5 from a running background sampler instead of
+ *               calling analogRead().
+ * 
+ * Input:        Sampler of the FS5 pin, 0 to use analogRead()
+ *                                                      (ADCSampler* sampler)
+ * 
+ * Output:       None
+*/
+void FS5sensor::useSampler(ADCSampler* sampler){
+  _sampler = sampler;
+}
+
+/* Function:     double FS5sensor::zeroCode()
+ * Purpose:      The ADC code of U0, the signal at zero wind speed.
+ * 
+ * Input:        None
+ * 
+ * Output:       ADC code, possibly fractional
+*/
+double FS5sensor::zeroCode(){
+  return _U0*_c/_maxInputVoltage;
+}
+
+/* Function:    double FS5Table::lookup(double code)
+ * Purpose:     Look up the wind velocity for a, possibly fractional, ADC
+ *              code. 
+ * 
+ * Input:       ADC code, 0 to 1023           (double code)
+ * 
+ * Output:      Wind velocity
+*/
+double FS5Table::lookup(double code) const {
+  double position = (code - startCode)*(1.0/(1 << FS5_TABLE_SHIFT));
+  double root;                  //Square root of the velocity.
+  int i = (int)position;
+  if(position <= 0){
+    root = velocity[0];
+  }
+  else if(i >= knots - 1){
+    root = velocity[knots - 1];
+  }
+  else if(!interpolate){
+    root = velocity[position - i < 0.5 ? i : i + 1];
+  }
+  else{
+    root = velocity[i] + (position - i)*(velocity[i + 1] - velocity[i]);
+  }
+  return root*root;
+}
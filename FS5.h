@@ -13,17 +13,60 @@
  *    Sensor:    FS5 Thermal Mass Flow Sensor
  *    
  * Notes: 
- *    - In order for this library to work, please install the library
- *      Filters created by hideakitai via:
- *      https://github.com/hideakitai/Filters
  *    - In order to get a signal from the FS5 sensor, the sensor has to be
  *      configured in a constant temperature setup.  
+ *    - With the default FS5_TABLE_SHIFT the velocity table stays within
+ *      0.01 m/s or 0.1 % of the formula, whichever is larger, over the 
+ *      whole ADC range (checked by host/bench/fs5TableBench.cpp).
  */
  
 #ifndef FS5_h     //Include guard.
 #define FS5_h
 #include "Arduino.h"
-#include "Filters.h"
+#include "FS5Filter.h"
+#include "ADCSampler.h"
+#include "Storage.h"
+
+//Filter chain of every FS5sensor, see FS5Filter.h. 
+#ifndef FS5_FILTER
+#define FS5_FILTER FilterChain<OnePoleLowPass>
+#endif
+typedef FS5_FILTER FS5Filter;
+
+//Cutoff frequency [Hz] of the filter chain until setFilter() is called.
+#ifndef FS5_FILTER_FREQUENCY
+#define FS5_FILTER_FREQUENCY 0.3
+#endif
+
+//Knot spacing of the velocity table as a power of two in ADC codes. 
+//4 gives room for 66 knots (264 bytes on the ATmega328), of which only
+//those from U0 and up are used, 37 with U0 = 2.24 V. 0 gives a knot for
+//every code.
+#ifndef FS5_TABLE_SHIFT
+#define FS5_TABLE_SHIFT 4
+#endif
+#define FS5_TABLE_SIZE ((1024 >> FS5_TABLE_SHIFT) + 2)
+
+//Table of wind velocities at evenly spaced ADC codes, filled by 
+//FS5sensor::useTable(). The square root of the velocity is stored, since 
+//v^(1/2) is close to linear in U^2 for n near 0.5, which keeps the linear
+//interpolation error small with few knots. 
+struct FS5Table {
+  float velocity[FS5_TABLE_SIZE];   //Square root of velocity at each knot.
+  int startCode;                    //ADC code of the first knot.
+  int knots;                        //Number of knots in use.
+  bool interpolate;                 //Interpolate between knots.
+
+  /* Function:    double FS5Table::lookup(double code)
+   * Purpose:     Look up the wind velocity for a, possibly fractional,
+   *              ADC code. 
+   * 
+   * Input:       ADC code, 0 to 1023           (double code)
+   * 
+   * Output:      Wind velocity
+  */
+  double lookup(double code) const;
+};
 
 //Class for mapping input signal from the FS5 sensor to voltage and wind velocity.
 class FS5sensor {
@@ -43,9 +86,42 @@ class FS5sensor {
     */
     FS5sensor(int pin, double U0, double U50, double v50, double n); 
     
+    /* Function:    void FS5sensor::setCalibration(double U0, double U50, double v50, double n)
+     * Purpose:     Change the calibration and calculate k. Refills the
+     *              velocity table if one is in use.
+     * 
+     * Input:       Voltage U at wind speed 0%              (double U0)
+     *              Voltage U at wind speed 50%             (double U50)
+     *              Wind speed v at wind speed 50%          (double v50)
+     *              Value to setup FS5 for parameter n      (double n)
+     *
+     * Output:      None
+    */
+    void setCalibration(double U0, double U50, double v50, double n);
+
+    /* Function:    void FS5sensor::storeCalibration(StoredState& state)
+     * Purpose:     Copy the calibration and k to a state to be saved.
+     * 
+     * Input:       State to fill                           (StoredState& state)
+     *
+     * Output:      None
+    */
+    void storeCalibration(StoredState& state);
+
+    /* Function:    bool FS5sensor::loadCalibration(const StoredState& state)
+     * Purpose:     Use the calibration of a loaded state if it is sane
+     *              and its k agrees with the other constants.
+     * 
+     * Input:       Loaded state                            (const StoredState& state)
+     *
+     * Output:      True if the stored calibration is used.
+    */
+    bool loadCalibration(const StoredState& state);
+
     /* Function:    double FS5sensor::voltage() 
      * Purpose:     Mapping the input signal from the FS5 sensor to voltage
-     *              and filter the signal.   
+     *              and filter the signal with the filter chain of this
+     *              sensor.   
      * 
      * Input:       None
      * 
@@ -53,6 +129,18 @@ class FS5sensor {
     */
     double voltage();
 
+    /* Function:    unsigned int FS5sensor::readRaw(uint8_t samples) 
+     * Purpose:     Read the input signal from the FS5 sensor a number of 
+     *              times without filtering. Used where the lag of the 
+     *              low pass filter is unwanted, e.g. while the sensor is
+     *              rotating.
+     * 
+     * Input:       Number of readings, at most 64     (uint8_t samples)
+     * 
+     * Output:      The sum of the ADC codes of the readings. 
+    */
+    unsigned int readRaw(uint8_t samples);
+
     /* Function:     double FS5sensor::velocity()
      * Purpose:      Calculate the wind velocity.   
      * 
@@ -62,6 +150,79 @@ class FS5sensor {
     */
     double velocity();
 
+    /* Function:     double FS5sensor::velocityFromVoltage(double U)
+     * Purpose:      Calculate the wind velocity for a given voltage with
+     *               the FS5 transfer function.
+     * 
+     * Input:        Voltage from the FS5                   (double U)
+     * 
+     * Output:       Wind velocity
+    */
+    double velocityFromVoltage(double U);
+
+    /* Function:     double FS5sensor::velocityFromCode(double code)
+     * Purpose:      Calculate the wind velocity for a, possibly 
+     *               fractional, ADC code, from the velocity table if one
+     *               is in use and else with the FS5 transfer function.
+     * 
+     * Input:        Mean ADC code of the FS5               (double code)
+     * 
+     * Output:       Wind velocity
+    */
+    double velocityFromCode(double code);
+
+    /* Function:     void FS5sensor::useTable(FS5Table* table, bool interpolate)
+     * Purpose:      Fill the table with the velocity at every 
+     *               2^FS5_TABLE_SHIFT:th ADC code from U0 and up, and let 
+     *               velocity() read the table instead of calling pow().
+     *               With interpolation the filtered, fractional voltage is
+     *               interpolated linearly between the knots, otherwise the
+     *               nearest knot is used. 
+     * 
+     * Input:        Table to fill, 0 to use the formula    (FS5Table* table)
+     *               Interpolate between knots              (bool interpolate)
+     * 
+     * Output:       None
+    */
+    void useTable(FS5Table* table, bool interpolate = true);
+
+    /* Function:     void FS5sensor::setFilter(double frequency, unsigned long periodUs)
+     * Purpose:      Set up the filter chain of the sensor and restart it.
+     *               The default is a one pole low pass at
+     *               FS5_FILTER_FREQUENCY.
+     * 
+     * Input:        Cutoff frequency [Hz]                  (double frequency)
+     *               Time between calls to voltage() for the stages that
+     *               assume a fixed rate [us]               (unsigned long periodUs)
+     * 
+     * Output:       None
+    */
+    void setFilter(double frequency, unsigned long periodUs);
+
+    /* Function:     void FS5sensor::useSampler(ADCSampler* sampler)
+     * Purpose:      Read the FS5 from a running background sampler instead
+     *               of calling analogRead(). voltage() then feeds the 
+     *               latest decimated value, with its fractional bits, 
+     *               through the filter chain, and readRaw() scales the 
+     *               latest value to the number of readings. 
+     *               Neither waits for a conversion.
+     * 
+     * Input:        Sampler of the FS5 pin, 0 to use analogRead()
+     *                                                      (ADCSampler* sampler)
+     * 
+     * Output:       None
+    */
+    void useSampler(ADCSampler* sampler);
+
+    /* Function:     double FS5sensor::zeroCode()
+     * Purpose:      The ADC code of U0, the signal at zero wind speed.
+     * 
+     * Input:        None
+     * 
+     * Output:       ADC code, possibly fractional
+    */
+    double zeroCode();
+
  //Private variables. 
   private: 
     int _pin;                       //Pin for input signal for the FS5.    
@@ -70,6 +231,12 @@ class FS5sensor {
     double _v50;                    //Wind velocity v at wind speed 50%.
     double _n;                      //Value to setup FS5. 
     double _k;                      //Fluidic dependent constant. 
+    double _invN;                   //1/n.
+    double _velScale;               //(k*U0^2)^(1/n), denominator of velocity.
+    FS5Table* _table = 0;           //Velocity table, 0 if not used.
+    ADCSampler* _sampler = 0;       //Background sampler, 0 if not used.
+    FS5Filter _filter;              //Filter chain of this sensor.
+    unsigned long _lastFilterUs;    //Time of the last filtered sample.
     double _c = 1023;               //Parameter to map input signal. 
     double _maxInputVoltage = 5;  //Maximum input voltage from FS5. 
 };
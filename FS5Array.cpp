@@ -0,0 +1,203 @@
+/* Filename:      FS5Array.cpp
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Library for a fixed array of FS5 sensors, see FS5Array.h.
+ */
+
+//Include libraries.
+#include "Arduino.h"
+#include "FS5Array.h"
+#include "Profiler.h"
+
+/* Constructor: FS5Array::FS5Array(const uint8_t* pins, const double* angles, uint8_t count, PoleFS5* FS5)
+ *
+ * Purpose:     Setup for the class FS5Array. Declaring private variables
+ *              and the cosine and sine of every angle.
+ *
+ * Input:       Analog pins of the sensors              (const uint8_t* pins)
+ *              Angles ccw from the aligned FS5 [degrees]
+ *                                                      (const double* angles)
+ *              Number of sensors                       (uint8_t count)
+ *              FS5 of the pole, converts the readings  (PoleFS5* FS5)
+ *
+ * Output:      None
+*/
+FS5Array::FS5Array(const uint8_t* pins, const double* angles, uint8_t count, PoleFS5* FS5){
+  _count = count < FS5_ARRAY_MAX ? count : FS5_ARRAY_MAX;
+  for(uint8_t i = 0; i < _count; i++){
+    _pins[i] = pins[i];
+    _cos[i] = cos(angles[i]*M_PI/180);
+    _sin[i] = sin(angles[i]*M_PI/180);
+    _velocity[i] = 0;
+  }
+  _reads = 16;
+  _floor = 0.1;
+  _direction = 0;
+  _speed = 0;
+  _residual = 0;
+  _sampler = 0;
+  _FS5 = FS5;
+}
+
+void FS5Array::setFloor(double floor){
+  _floor = floor < 0 ? 0 : (floor > 0.9 ? 0.9 : floor);
+}
+
+void FS5Array::setReads(uint8_t reads){
+  _reads = reads < 1 ? 1 : (reads > 64 ? 64 : reads);
+}
+
+void FS5Array::useSampler(ADCSampler* sampler){
+  _sampler = sampler;
+}
+
+/* Function:    void FS5Array::pass()
+ *
+ * Purpose:     Read the sensors round-robin, one reading of each in turn,
+ *              convert the mean code of each to a velocity and fit the
+ *              direction and the speed. The sampler, if any, is stopped
+ *              meanwhile, since analogRead() cannot be used while it runs.
+ *
+ * Input:       None
+ *
+ * Output:      None
+*/
+void FS5Array::pass(){
+  PROFILE_SCOPE(PROFILE_FS5_READ);
+  if(_sampler){
+    _sampler->end();
+  }
+  unsigned int sums[FS5_ARRAY_MAX] = {0};
+  for(uint8_t r = 0; r < _reads; r++){
+    for(uint8_t i = 0; i < _count; i++){
+      sums[i] += analogRead(_pins[i]);
+    }
+  }
+  if(_sampler){
+    _sampler->begin();
+  }
+  for(uint8_t i = 0; i < _count; i++){
+    _velocity[i] = _FS5->velocityFromCode((double)sums[i]/_reads);
+  }
+  fit();
+}
+
+/* Function:    void FS5Array::fit()
+ *
+ * Purpose:     Fit the direction and the speed to the velocities of the
+ *              last pass. The first harmonic gives the start, then
+ *              Gauss-Newton steps fit the rectified cosine response.
+ *
+ * Input:       None
+ *
+ * Output:      None
+*/
+void FS5Array::fit(){
+  //Highest velocity, the direction of its sensor is the fallback.
+  uint8_t best = 0;
+  for(uint8_t i = 1; i < _count; i++){
+    best = _velocity[i] > _velocity[best] ? i : best;
+  }
+  if(_count == 0 || _velocity[best] < calmSpeed){
+    _speed = _count ? _velocity[best] : 0;
+    _residual = 0;
+    return;
+  }
+
+  //Least squares of a + b*cos + c*sin by the normal equations, solved
+  //by Cramer's rule.
+  double n = _count, sc = 0, ss = 0, scc = 0, sss = 0, scs = 0;
+  double sv = 0, svc = 0, svs = 0;
+  for(uint8_t i = 0; i < _count; i++){
+    sc += _cos[i];
+    ss += _sin[i];
+    scc += _cos[i]*_cos[i];
+    sss += _sin[i]*_sin[i];
+    scs += _cos[i]*_sin[i];
+    sv += _velocity[i];
+    svc += _velocity[i]*_cos[i];
+    svs += _velocity[i]*_sin[i];
+  }
+  double det = n*(scc*sss - scs*scs) - sc*(sc*sss - scs*ss) + ss*(sc*scs - scc*ss);
+  double phi;
+  if(fabs(det) > 1e-3*n*n*n){
+    double b = (n*(svc*sss - scs*svs) - sv*(sc*sss - scs*ss) + ss*(sc*svs - svc*ss))/det;
+    double c = (n*(scc*svs - svc*scs) - sc*(sc*svs - svc*ss) + sv*(sc*scs - scc*ss))/det;
+    phi = atan2(c, b);
+  }
+  else{
+    phi = atan2(_sin[best], _cos[best]);
+  }
+
+  //Gauss-Newton on the direction of the response. The speed is solved
+  //for exactly at every direction, so the step follows the gradient of
+  //the residual less the part the speed takes up.
+  for(uint8_t k = 0; k < iterations; k++){
+    double cp = cos(phi), sp = sin(phi);
+    double rr = 0, vr = 0, rd = 0, dd = 0, vd = 0;
+    for(uint8_t i = 0; i < _count; i++){
+      //Cosine and sine of the angle of the sensor less the direction.
+      double cx = _cos[i]*cp + _sin[i]*sp;
+      double sx = _sin[i]*cp - _cos[i]*sp;
+      double r = _floor + (cx > 0 ? (1 - _floor)*cx : 0);
+      double d = cx > 0 ? (1 - _floor)*sx : 0;     //dr/dphi
+      rr += r*r;
+      vr += _velocity[i]*r;
+      rd += r*d;
+      dd += d*d;
+      vd += _velocity[i]*d;
+    }
+    double speed = vr/rr;
+    double curvature = speed*(dd - rd*rd/rr);
+    if(curvature <= 0){
+      break;
+    }
+    double step = (vd - speed*rd)/curvature;
+    phi += step > 0.5 ? 0.5 : (step < -0.5 ? -0.5 : step);
+  }
+
+  //Speed and residual at the fitted direction.
+  double cp = cos(phi), sp = sin(phi);
+  double rr = 0, vr = 0;
+  for(uint8_t i = 0; i < _count; i++){
+    double cx = _cos[i]*cp + _sin[i]*sp;
+    double r = _floor + (cx > 0 ? (1 - _floor)*cx : 0);
+    rr += r*r;
+    vr += _velocity[i]*r;
+  }
+  double speed = vr/rr;
+  double squares = 0;
+  for(uint8_t i = 0; i < _count; i++){
+    double cx = _cos[i]*cp + _sin[i]*sp;
+    double e = _velocity[i] - speed*(_floor + (cx > 0 ? (1 - _floor)*cx : 0));
+    squares += e*e;
+  }
+  _residual = sqrt(squares/_count);
+  _direction = atan2(sin(phi), cos(phi));
+  _speed = speed;
+}
+
+double FS5Array::direction(){
+  return _direction*180/M_PI;
+}
+
+double FS5Array::speed(){
+  return _speed;
+}
+
+double FS5Array::residual(){
+  return _residual;
+}
+
+double FS5Array::velocity(uint8_t i){
+  return i < _count ? _velocity[i] : 0;
+}
+
+uint8_t FS5Array::count(){
+  return _count;
+}
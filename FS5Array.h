@@ -0,0 +1,134 @@
+/* Filename:      FS5Array.h
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Header for FS5Array library.
+ *
+ *    Estimates the wind direction and speed from a few FS5 sensors
+ *    mounted at known angles, without rotating them. A pass reads the
+ *    sensors round-robin, one reading of each in turn, so all of them
+ *    see the same gusts, and converts the mean of each to a velocity.
+ *    The FS5 responds to the wind about like the cosine of the angle to
+ *    its sensitive axis, and with a small floor from behind:
+ *
+ *      v_i = speed*(floor + (1 - floor)*max(0, cos(angle_i - direction)))
+ *
+ *    The direction is first taken from the first harmonic of the
+ *    velocities, a least squares fit of a + b*cos(angle) + c*sin(angle),
+ *    and the speed and the direction are then fitted to the response
+ *    above by a few Gauss-Newton iterations. With four or more sensors
+ *    evenly spaced around the axis the first harmonic already points
+ *    at the direction, since the rectified cosine has no odd harmonics
+ *    above the first.
+ *
+ *    The angles count ccw from the FS5 that the Control aligns, like the
+ *    heading of Control, so a direction is the number of degrees the
+ *    heading has to move to face the wind, see Control::useArray().
+ *
+ * Hardware:
+ *    Sensor:       FS5 Thermal Mass Flow Sensors, one analog pin each,
+ *                  with the calibration of the FS5 of the pole.
+ *
+ * Notes:
+ *    - A pass takes count*reads calls of analogRead(), 7 ms with four
+ *      sensors and 16 readings. A running ADCSampler is stopped for the
+ *      pass and started again after it, see useSampler().
+ *    - At most FS5_ARRAY_MAX sensors. With fewer than three distinct
+ *      angles the direction is that of the sensor with the highest
+ *      velocity.
+ *    - In calm air the direction is not fitted and stays where it was.
+ *    - The mean code of each sensor is converted by the FS5 of the pole,
+ *      see FS5sensor::velocityFromCode(), so the array reads its table
+ *      and its stored calibration like the FS5 itself.
+ */
+
+#ifndef FS5Array_h       //Include guard.
+#define FS5Array_h
+#include "Arduino.h"
+#include "ADCSampler.h"
+#include "FS5Fixed.h"
+
+//Most sensors in an array.
+#ifndef FS5_ARRAY_MAX
+#define FS5_ARRAY_MAX 8
+#endif
+
+//Class for a fixed array of FS5 sensors.
+class FS5Array {
+  public:
+    /* Constructor: FS5Array::FS5Array(const uint8_t* pins, const double* angles, uint8_t count, PoleFS5* FS5)
+     *
+     * Purpose:     Setup for the class FS5Array. Declaring private
+     *              variables, with a floor of 0.1 and 16 readings of each
+     *              sensor per pass.
+     *
+     * Input:       Analog pins of the sensors              (const uint8_t* pins)
+     *              Angles ccw from the aligned FS5 [degrees]
+     *                                                      (const double* angles)
+     *              Number of sensors                       (uint8_t count)
+     *              FS5 of the pole, converts the readings  (PoleFS5* FS5)
+     *
+     * Output:      None
+    */
+    FS5Array(const uint8_t* pins, const double* angles, uint8_t count, PoleFS5* FS5);
+
+    //Relative response of a sensor to wind from behind, 0 to 1.
+    void setFloor(double floor);
+
+    //Readings of each sensor per pass, 1 to 64.
+    void setReads(uint8_t reads);
+
+    //Background sampler to stop during a pass, 0 if none.
+    void useSampler(ADCSampler* sampler);
+
+    /* Function:    void FS5Array::pass()
+     *
+     * Purpose:     Read the sensors round-robin and fit the direction and
+     *              the speed of the wind to their velocities.
+     *
+     * Input:       None
+     *
+     * Output:      None
+    */
+    void pass();
+
+    //Direction of the wind ccw from the aligned FS5 [degrees], -180 to
+    //180, of the last pass.
+    double direction();
+
+    //Wind speed [m/s] of the last pass.
+    double speed();
+
+    //Root mean square of the velocities less the fitted response [m/s].
+    double residual();
+
+    //Velocity of one sensor in the last pass [m/s].
+    double velocity(uint8_t i);
+
+    //Number of sensors.
+    uint8_t count();
+
+  private:
+    void fit();
+
+    uint8_t _pins[FS5_ARRAY_MAX];         //Analog pins.
+    float _cos[FS5_ARRAY_MAX];            //Cosine of the angles.
+    float _sin[FS5_ARRAY_MAX];            //Sine of the angles.
+    float _velocity[FS5_ARRAY_MAX];       //Velocities of the last pass [m/s].
+    uint8_t _count;                       //Number of sensors.
+    uint8_t _reads;                       //Readings per sensor and pass.
+    double _floor;                        //Response to wind from behind.
+    double _direction;                    //Fitted direction [rad].
+    double _speed;                        //Fitted speed [m/s].
+    double _residual;                     //RMS of the fit [m/s].
+    ADCSampler* _sampler;                 //Sampler to stop, 0 if none.
+    PoleFS5* _FS5;                        //FS5 whose calibration is used.
+
+    static const uint8_t iterations = 6;  //Gauss-Newton iterations.
+    static constexpr double calmSpeed = 0.3;  //No direction below this [m/s].
+};
+#endif
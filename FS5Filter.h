@@ -0,0 +1,363 @@
+/* Filename:      FS5Filter.h
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Fixed-point filters for the FS5 signal. Each FS5sensor owns one
+ *    filter chain, so sensors do not share filter state.
+ *
+ *    Samples are ADC codes in Q5, code*32, from 0 to 32736, which fits
+ *    an int16_t and leaves room for the fractional codes of ADCSampler.
+ *    Every stage needs one to five 16x16 bit multiplications per sample.
+ *
+ *    The stages are chained at compile time:
+ *
+ *      FilterChain<MovingAverage<4>, OnePoleLowPass> filter;
+ *      filter.setup(0.3, 1000);
+ *      FilterSample y = filter.input(x, dt);
+ *
+ *    OnePoleLowPass follows the time between the samples, like
+ *    FilterOnePole of the Filters library, and can be fed at any rate.
+ *    MovingAverage and BiquadLowPass assume a sample every periodUs.
+ *
+ * Notes:
+ *    - The time between samples, dt, is given in units of 64 us, at
+ *      most 65535 (4.2 s).
+ *    - BiquadLowPass has Q14 coefficients and needs the cutoff above
+ *      about 1/100 of the sample rate. Use OnePoleLowPass for slower
+ *      cutoffs.
+ */
+
+#ifndef FS5Filter_h       //Include guard.
+#define FS5Filter_h
+#include "Arduino.h"
+
+//ADC code in Q5.
+typedef int16_t FilterSample;
+
+//Class for a first order low pass filter with a Q16 coefficient.
+class OnePoleLowPass {
+  public:
+    /* Constructor: OnePoleLowPass::OnePoleLowPass()
+     * Purpose:     Setup for the class OnePoleLowPass. Passes samples
+     *              through until setup() is called.
+     *
+     * Input:       None
+     *
+     * Output:      None
+    */
+    OnePoleLowPass(){
+      _state = 0;
+      _twoTau = 0;
+      reset();
+    }
+
+    /* Function:    void OnePoleLowPass::setup(double frequency, unsigned long periodUs)
+     * Purpose:     Set the cutoff frequency and restart the filter.
+     *
+     * Input:       Cutoff frequency [Hz]            (double frequency)
+     *              Not used, the filter follows dt   (unsigned long periodUs)
+     *
+     * Output:      None
+    */
+    void setup(double frequency, unsigned long periodUs){
+      (void)periodUs;
+      double tau = 1.0/(2*PI*frequency)*1e6/64;   //Time constant in dt units.
+      _twoTau = tau*2 > 0x7FFFFFFFL ? 0x7FFFFFFFL : (uint32_t)(tau*2 + 0.5);
+      reset();
+    }
+
+    /* Function:    void OnePoleLowPass::reset()
+     * Purpose:     Restart the filter. The next sample sets the output.
+     *
+     * Input:       None
+     *
+     * Output:      None
+    */
+    void reset(){
+      _primed = false;
+      _dt = 0;
+      _alpha = 0;
+    }
+
+    /* Function:    FilterSample OnePoleLowPass::input(FilterSample x, uint16_t dt)
+     * Purpose:     Filter one sample. The coefficient 1 - exp(-dt/tau) is
+     *              approximated by 2*dt/(2*tau + dt) and only recomputed
+     *              when dt changes.
+     *
+     * Input:       New sample                        (FilterSample x)
+     *              Time since the last sample        (uint16_t dt)
+     *
+     * Output:      Filtered sample
+    */
+    FilterSample input(FilterSample x, uint16_t dt){
+      if (!_primed){
+        _primed = true;
+        _state = (int32_t)x << 16;
+        return x;
+      }
+      if (dt != _dt){
+        _dt = dt;
+
+        //dt << 17 overflows from dt = 32768 (2.1 s), there the fraction
+        //is halved in the denominator instead.
+        uint32_t alpha = dt < 0x8000 ? ((uint32_t)dt << 17)/(_twoTau + dt) :
+                                       ((uint32_t)dt << 16)/((_twoTau + dt) >> 1);
+        _alpha = alpha > 0xFFFF ? 0xFFFF : alpha;
+      }
+
+      //The state moves a fraction alpha towards the sample.
+      int16_t y = (int16_t)((_state + 0x8000) >> 16);
+      _state += (int32_t)(int16_t)(x - y)*(int32_t)_alpha;
+      return (FilterSample)((_state + 0x8000) >> 16);
+    }
+
+  private:
+    int32_t _state;       //Output in Q21, code*2^21.
+    uint32_t _twoTau;     //Twice the time constant in dt units.
+    uint16_t _dt;         //dt of the current coefficient.
+    uint16_t _alpha;      //Coefficient in Q16.
+    bool _primed;         //A sample has been seen.
+};
+
+//Class for the mean of the last N samples, N a power of two.
+template<uint8_t N>
+class MovingAverage {
+  static_assert(N > 0 && N <= 128 && (N & (N - 1)) == 0, "N must be a power of two, at most 128");
+
+  public:
+    /* Constructor: MovingAverage::MovingAverage()
+     * Purpose:     Setup for the class MovingAverage with an empty window.
+     *
+     * Input:       None
+     *
+     * Output:      None
+    */
+    MovingAverage(){
+      for (uint8_t i = 0; i < N; i++){
+        _window[i] = 0;
+      }
+      _sum = 0;
+      _next = 0;
+      reset();
+    }
+
+    /* Function:    void MovingAverage::setup(double frequency, unsigned long periodUs)
+     * Purpose:     Restart the filter. The window length is fixed by N.
+     *
+     * Input:       Not used                          (double frequency)
+     *              Not used                          (unsigned long periodUs)
+     *
+     * Output:      None
+    */
+    void setup(double frequency, unsigned long periodUs){
+      (void)frequency;
+      (void)periodUs;
+      reset();
+    }
+
+    /* Function:    void MovingAverage::reset()
+     * Purpose:     Restart the filter. The next sample fills the window.
+     *
+     * Input:       None
+     *
+     * Output:      None
+    */
+    void reset(){
+      _primed = false;
+    }
+
+    /* Function:    FilterSample MovingAverage::input(FilterSample x, uint16_t dt)
+     * Purpose:     Filter one sample by a running sum over the window.
+     *
+     * Input:       New sample                        (FilterSample x)
+     *              Not used                          (uint16_t dt)
+     *
+     * Output:      Filtered sample
+    */
+    FilterSample input(FilterSample x, uint16_t dt){
+      (void)dt;
+      if (!_primed){
+        _primed = true;
+        for (uint8_t i = 0; i < N; i++){
+          _window[i] = x;
+        }
+        _sum = (int32_t)x*N;
+        _next = 0;
+      }
+      _sum += x - _window[_next];
+      _window[_next] = x;
+      _next = (_next + 1) & (N - 1);
+      return (FilterSample)((_sum + N/2)/N);
+    }
+
+  private:
+    FilterSample _window[N];    //The last N samples.
+    int32_t _sum;               //Sum of the window.
+    uint8_t _next;              //Slot of the oldest sample.
+    bool _primed;               //A sample has been seen.
+};
+
+//Class for a second order Butterworth low pass filter with Q14 coefficients.
+class BiquadLowPass {
+  public:
+    /* Constructor: BiquadLowPass::BiquadLowPass()
+     * Purpose:     Setup for the class BiquadLowPass. Delays the samples
+     *              by one until setup() is called.
+     *
+     * Input:       None
+     *
+     * Output:      None
+    */
+    BiquadLowPass(){
+      _b0 = 0;
+      _b1 = 16384;
+      _a1 = 0;
+      _a2 = 0;
+      _x1 = _x2 = _y1 = _y2 = 0;
+      _error = 0;
+      reset();
+    }
+
+    /* Function:    void BiquadLowPass::setup(double frequency, unsigned long periodUs)
+     * Purpose:     Design the filter for the cutoff frequency at a sample
+     *              every periodUs and restart it.
+     *
+     * Input:       Cutoff frequency [Hz]            (double frequency)
+     *              Time between samples [us]         (unsigned long periodUs)
+     *
+     * Output:      None
+    */
+    void setup(double frequency, unsigned long periodUs){
+      double w = 2*PI*frequency*periodUs*1e-6;
+      double alpha = sin(w)/(2*0.70710678);
+      double a0 = 1 + alpha;
+      double b = (1 - cos(w))/2/a0;
+      _b0 = (int16_t)lround(b*16384);
+      _a1 = (int16_t)lround(-2*cos(w)/a0*16384);
+      _a2 = (int16_t)lround((1 - alpha)/a0*16384);
+
+      //Round b1 so that the gain at DC stays exactly 1.
+      _b1 = (int16_t)(16384 + _a1 + _a2 - 2*_b0);
+      reset();
+    }
+
+    /* Function:    void BiquadLowPass::reset()
+     * Purpose:     Restart the filter. The next sample sets the output.
+     *
+     * Input:       None
+     *
+     * Output:      None
+    */
+    void reset(){
+      _primed = false;
+    }
+
+    /* Function:    FilterSample BiquadLowPass::input(FilterSample x, uint16_t dt)
+     * Purpose:     Filter one sample, direct form I. The part of the sum
+     *              shifted out is fed back into the next sample, which
+     *              keeps the rounding from building up at low cutoffs.
+     *
+     * Input:       New sample                        (FilterSample x)
+     *              Not used                          (uint16_t dt)
+     *
+     * Output:      Filtered sample
+    */
+    FilterSample input(FilterSample x, uint16_t dt){
+      (void)dt;
+      if (!_primed){
+        _primed = true;
+        _x1 = _x2 = _y1 = _y2 = x;
+        _error = 0;
+      }
+
+      //b2 equals b0 for the low pass.
+      int32_t acc = (int32_t)_b0*((int32_t)x + _x2) + (int32_t)_b1*_x1 + _error;
+      acc -= (int32_t)_a1*_y1;
+      acc -= (int32_t)_a2*_y2;
+      FilterSample y = (FilterSample)(acc >> 14);
+      _error = (int16_t)(acc & 0x3FFF);
+
+      _x2 = _x1;
+      _x1 = x;
+      _y2 = _y1;
+      _y1 = y;
+      return y;
+    }
+
+  private:
+    int16_t _b0, _b1, _a1, _a2;       //Coefficients in Q14.
+    FilterSample _x1, _x2;            //Previous inputs.
+    FilterSample _y1, _y2;            //Previous outputs.
+    int16_t _error;                   //Remainder of the last sum.
+    bool _primed;                     //A sample has been seen.
+};
+
+//Chain of filter stages, applied from left to right.
+template<typename... Stages>
+class FilterChain;
+
+template<>
+class FilterChain<> {
+  public:
+    void setup(double frequency, unsigned long periodUs){
+      (void)frequency;
+      (void)periodUs;
+    }
+    void reset(){
+    }
+    FilterSample input(FilterSample x, uint16_t dt){
+      (void)dt;
+      return x;
+    }
+};
+
+template<typename First, typename... Rest>
+class FilterChain<First, Rest...> {
+  public:
+    /* Function:    void FilterChain::setup(double frequency, unsigned long periodUs)
+     * Purpose:     Set up every stage for the cutoff frequency and the
+     *              time between samples.
+     *
+     * Input:       Cutoff frequency [Hz]            (double frequency)
+     *              Time between samples [us]         (unsigned long periodUs)
+     *
+     * Output:      None
+    */
+    void setup(double frequency, unsigned long periodUs){
+      _first.setup(frequency, periodUs);
+      _rest.setup(frequency, periodUs);
+    }
+
+    /* Function:    void FilterChain::reset()
+     * Purpose:     Restart every stage.
+     *
+     * Input:       None
+     *
+     * Output:      None
+    */
+    void reset(){
+      _first.reset();
+      _rest.reset();
+    }
+
+    /* Function:    FilterSample FilterChain::input(FilterSample x, uint16_t dt)
+     * Purpose:     Filter one sample through all stages.
+     *
+     * Input:       New sample                        (FilterSample x)
+     *              Time since the last sample        (uint16_t dt)
+     *
+     * Output:      Filtered sample
+    */
+    FilterSample input(FilterSample x, uint16_t dt){
+      return _rest.input(_first.input(x, dt), dt);
+    }
+
+  private:
+    First _first;
+    FilterChain<Rest...> _rest;
+};
+#endif
@@ -0,0 +1,316 @@
+/* Filename:      FS5Fixed.h
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    The FS5 sensor with the pin and calibration of a pole known at
+ *    compile time, see FlagpoleConfig.h. Reads like FS5sensor, with the
+ *    same filter chain and background sampler, but k, 1/n and the
+ *    denominator of the velocity are folded by the compiler and the
+ *    velocity table of FS5sensor::useTable() is built by the compiler
+ *    and kept in flash. That spares the calibration, the table and the
+ *    filling of it in setup() in RAM.
+ *
+ * Hardware:
+ *    Sensor:    FS5 Thermal Mass Flow Sensor
+ *
+ * Notes:
+ *    - The table has the knots of FS5_TABLE_SHIFT and is interpolated
+ *      like an FS5Table, 37 knots or 148 bytes of flash for the
+ *      prototype.
+ *    - The calibration cannot be loaded from a stored state,
+ *      loadCalibration() keeps the compile time one.
+ */
+
+#ifndef FS5Fixed_h      //Include guard.
+#define FS5Fixed_h
+#include "Arduino.h"
+#include "FS5.h"
+#include "FS5Filter.h"
+#include "ADCSampler.h"
+#include "Storage.h"
+#include "Profiler.h"
+#include "FlagpoleConfig.h"
+
+//FS5 constants of a pole, the same as FS5sensor::setCalibration() and
+//FS5sensor::useTable() calculate.
+template <class Config>
+struct FS5Constants {
+  static_assert(Config::U0 > 0 && Config::U50 > Config::U0 && Config::U50 <= 5, "FS5 voltages out of range");
+  static_assert(Config::v50 > 0 && Config::n > 0 && Config::n < 2, "FS5 calibration out of range");
+
+  static constexpr double c = 1023;                 //Highest ADC code.
+  static constexpr double maxInputVoltage = 5;      //Voltage at the highest code.
+  static constexpr double k = (constSquare(Config::U50/Config::U0) - 1)/constPow(Config::v50, Config::n);
+  static constexpr double invN = 1/Config::n;
+  static constexpr double velScale = constPow(k, invN)*constPow(Config::U0, 2*invN);
+  static constexpr double zeroCode = Config::U0*c/maxInputVoltage;
+
+  //First knot at or just below the code of U0, and the number of knots.
+  static const int startCode = ((int)zeroCode >> FS5_TABLE_SHIFT) << FS5_TABLE_SHIFT;
+  static const int knots = ((1023 - startCode) >> FS5_TABLE_SHIFT) + 2;
+
+  //Square root of the velocity at a knot.
+  static constexpr float root(int knot){
+    return constPow(constVelocity((startCode + (knot << FS5_TABLE_SHIFT))/c*maxInputVoltage,
+                                  Config::U0, invN, velScale), 0.5);
+  }
+};
+
+template <class Config> constexpr double FS5Constants<Config>::c;
+template <class Config> constexpr double FS5Constants<Config>::maxInputVoltage;
+template <class Config> constexpr double FS5Constants<Config>::k;
+template <class Config> constexpr double FS5Constants<Config>::invN;
+template <class Config> constexpr double FS5Constants<Config>::velScale;
+template <class Config> constexpr double FS5Constants<Config>::zeroCode;
+template <class Config> const int FS5Constants<Config>::startCode;
+template <class Config> const int FS5Constants<Config>::knots;
+
+//The knots 0 to N - 1 as a parameter pack, split in halves so the
+//templates nest log2(N) deep.
+template <int... I> struct FS5Knots {};
+
+template <class Low, class High> struct FS5KnotsJoin;
+template <int... I, int... J>
+struct FS5KnotsJoin<FS5Knots<I...>, FS5Knots<J...> > {
+  typedef FS5Knots<I..., (int)sizeof...(I) + J...> type;
+};
+
+template <int N>
+struct FS5KnotsUpTo {
+  typedef typename FS5KnotsJoin<typename FS5KnotsUpTo<N/2>::type,
+                                typename FS5KnotsUpTo<N - N/2>::type>::type type;
+};
+template <> struct FS5KnotsUpTo<0> { typedef FS5Knots<> type; };
+template <> struct FS5KnotsUpTo<1> { typedef FS5Knots<0> type; };
+
+//Velocity table of a pole in flash, square roots like FS5Table.
+template <class Config, class Knots = typename FS5KnotsUpTo<FS5Constants<Config>::knots>::type>
+struct FS5FixedTable;
+
+template <class Config, int... I>
+struct FS5FixedTable<Config, FS5Knots<I...> > {
+  static const float velocity[sizeof...(I)];
+};
+
+template <class Config, int... I>
+const float FS5FixedTable<Config, FS5Knots<I...> >::velocity[sizeof...(I)] PROGMEM = {
+  FS5Constants<Config>::root(I)...
+};
+
+//Class for the FS5 sensor of a pole known at compile time.
+template <class Config>
+class FS5Fixed {
+  public:
+    typedef FS5Constants<Config> Constants;
+
+    /* Constructor: FS5Fixed::FS5Fixed()
+     *
+     * Purpose:     Setup for the class FS5Fixed, with the default filter
+     *              chain of FS5sensor.
+     *
+     * Input:       None
+     *
+     * Output:      None
+    */
+    FS5Fixed(){
+      _sampler = 0;
+      _lastFilterUs = 0;
+      _filter.setup(FS5_FILTER_FREQUENCY, 1000);
+    }
+
+    /* Function:    void FS5Fixed::storeCalibration(StoredState& state)
+     * Purpose:     Copy the calibration and k to a state to be saved.
+     *
+     * Input:       State to fill                           (StoredState& state)
+     *
+     * Output:      None
+    */
+    void storeCalibration(StoredState& state){
+      state.U0 = Config::U0;
+      state.U50 = Config::U50;
+      state.v50 = Config::v50;
+      state.n = Config::n;
+      state.k = Constants::k;
+    }
+
+    /* Function:    bool FS5Fixed::loadCalibration(const StoredState& state)
+     * Purpose:     Keep the calibration of the pole, like 
+     *              FS5sensor::loadCalibration() with a state it rejects.
+     *              The calibration is fixed at compile time, a stored 
+     *              one is never used.
+     *
+     * Input:       Loaded state, not used                  (const StoredState& state)
+     *
+     * Output:      False, the stored calibration is not used.
+    */
+    bool loadCalibration(const StoredState&){
+      return false;
+    }
+
+    /* Function:    double FS5Fixed::voltage()
+     * Purpose:     Map the input signal from the FS5 sensor to voltage
+     *              and filter it, like FS5sensor::voltage().
+     *
+     * Input:       None
+     *
+     * Output:      The current voltage input from the FS5 sensor.
+    */
+    double voltage(){
+      PROFILE_SCOPE(PROFILE_FS5_READ);
+
+      //Time since the last sample in units of 64 us, the remainder is
+      //carried to the next sample.
+      unsigned long now = micros();
+      unsigned long dt = (now - _lastFilterUs) >> 6;
+      _lastFilterUs += dt << 6;
+      if(dt > 0xFFFF){
+        dt = 0xFFFF;
+        _lastFilterUs = now;
+      }
+
+      //The decimated value of the sampler keeps its fractional bits in Q5.
+      FilterSample sample;
+      if(_sampler){
+        sample = (FilterSample)(_sampler->code()*32 + 0.5);
+      }
+      else{
+        sample = analogRead(Config::pinFS5) << 5;
+      }
+      FilterSample filtered = _filter.input(sample, dt);
+      return filtered*(Constants::maxInputVoltage/(Constants::c*32));
+    }
+
+    /* Function:    unsigned int FS5Fixed::readRaw(uint8_t samples)
+     * Purpose:     Read the input signal a number of times without
+     *              filtering, like FS5sensor::readRaw().
+     *
+     * Input:       Number of readings, at most 64     (uint8_t samples)
+     *
+     * Output:      The sum of the ADC codes of the readings.
+    */
+    unsigned int readRaw(uint8_t samples){
+      PROFILE_SCOPE(PROFILE_FS5_READ);
+      if(_sampler){
+        return (unsigned int)(_sampler->code()*samples + 0.5);
+      }
+      unsigned int sum = 0;
+      for(uint8_t i = 0; i < samples; i++){
+        sum += analogRead(Config::pinFS5);
+      }
+      return sum;
+    }
+
+    /* Function:     double FS5Fixed::velocity()
+     * Purpose:      The wind velocity, interpolated in the table at the
+     *               filtered, fractional ADC code.
+     *
+     * Input:        None
+     *
+     * Output:       Wind velocity
+    */
+    double velocity(){
+      PROFILE_SCOPE(PROFILE_VELOCITY);
+      return velocityFromCode(voltage()*(Constants::c/Constants::maxInputVoltage));
+    }
+
+    /* Function:     double FS5Fixed::velocityFromCode(double code)
+     * Purpose:      The wind velocity, interpolated in the table at a,
+     *               possibly fractional, ADC code.
+     *
+     * Input:        Mean ADC code of the FS5               (double code)
+     *
+     * Output:       Wind velocity
+    */
+    static double velocityFromCode(double code){
+      double position = (code - Constants::startCode)*(1.0/(1 << FS5_TABLE_SHIFT));
+      const float* table = FS5FixedTable<Config>::velocity;
+      double root;            //Square root of the velocity.
+      int i = (int)position;
+      if(position <= 0){
+        root = pgm_read_float(&table[0]);
+      }
+      else if(i >= Constants::knots - 1){
+        root = pgm_read_float(&table[Constants::knots - 1]);
+      }
+      else{
+        double low = pgm_read_float(&table[i]);
+        root = low + (position - i)*(pgm_read_float(&table[i + 1]) - low);
+      }
+      return root*root;
+    }
+
+    /* Function:     double FS5Fixed::velocityFromVoltage(double U)
+     * Purpose:      The wind velocity for a given voltage with the FS5
+     *               transfer function and the folded constants.
+     *
+     * Input:        Voltage from the FS5                   (double U)
+     *
+     * Output:       Wind velocity
+    */
+    static double velocityFromVoltage(double U){
+      U = U < Config::U0 ? Config::U0 : U;
+      return pow((U - Config::U0)*(U + Config::U0), Constants::invN)*(1/Constants::velScale);
+    }
+
+    /* Function:     double FS5Fixed::zeroCode()
+     * Purpose:      The ADC code of U0, the signal at zero wind speed,
+     *               folded by the compiler.
+     *
+     * Input:        None
+     *
+     * Output:       ADC code, possibly fractional
+    */
+    double zeroCode(){
+      return Constants::zeroCode;
+    }
+
+    /* Function:     void FS5Fixed::setFilter(double frequency, unsigned long periodUs)
+     * Purpose:      Set up the filter chain of the sensor and restart it,
+     *               like FS5sensor::setFilter(). The default is a one
+     *               pole low pass at FS5_FILTER_FREQUENCY.
+     *
+     * Input:        Cutoff frequency [Hz]                  (double frequency)
+     *               Time between calls to voltage() for the stages that
+     *               assume a fixed rate [us]               (unsigned long periodUs)
+     *
+     * Output:       None
+    */
+    void setFilter(double frequency, unsigned long periodUs){
+      _filter.setup(frequency, periodUs);
+    }
+
+    /* Function:     void FS5Fixed::useSampler(ADCSampler* sampler)
+     * Purpose:      Read the FS5 from a running background sampler instead
+     *               of calling analogRead(), like FS5sensor::useSampler().
+     *               voltage() then feeds the latest decimated value, with
+     *               its fractional bits, through the filter chain, and 
+     *               readRaw() scales the latest value to the number of 
+     *               readings. Neither waits for a conversion.
+     *
+     * Input:        Sampler of the FS5 pin, 0 to use analogRead()
+     *                                                      (ADCSampler* sampler)
+     *
+     * Output:       None
+    */
+    void useSampler(ADCSampler* sampler){
+      _sampler = sampler;
+    }
+
+  private:
+    ADCSampler* _sampler;           //Background sampler, 0 if not used.
+    FS5Filter _filter;              //Filter chain of this sensor.
+    unsigned long _lastFilterUs;    //Time of the last filtered sample.
+};
+
+//FS5 of the pole in FlagpoleConfig.h, with the calibration and table in
+//flash when FLAGPOLE_FIXED_CONFIG is set and set up at run time else.
+#if FLAGPOLE_FIXED_CONFIG
+typedef FS5Fixed<FLAGPOLE_CONFIG> PoleFS5;
+#else
+typedef FS5sensor PoleFS5;
+#endif
+#endif
@@ -0,0 +1,327 @@
+/* Filename:      FastStepper.cpp
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Library for stepping the 28byj-48 through the port registers of the
+ *    coil pins, see FastStepper.h.
+ *
+ * Hardware:
+ *    MCU:          ATmega328
+ *
+ * Notes:
+ *    - On the ATmega328 the output registers are written directly and
+ *      TIMER1_COMPA_vect steps the running motor. The host build writes
+ *      the ports and starts the emulated timer of the simulated board
+ *      instead.
+ *    - The sequence is the one of CheapStepper, so both turn the motor
+ *      the same way for the same direction.
+ */
+
+//Include libraries.
+#include "Arduino.h"
+#include "FastStepper.h"
+
+//Half-step coil sequence, bit 0 = IN1 ... bit 3 = IN4. The odd phases
+//have two coils on and are the full steps.
+static const uint8_t coilSequence[8] = {0x1, 0x3, 0x2, 0x6, 0x4, 0xC, 0x8, 0x9};
+
+//Timer 1 counts at 16 MHz/8.
+static const unsigned long timerHz = 2000000;
+
+#ifdef __AVR__
+FastStepper* volatile FastStepper::_active = 0;
+
+ISR(TIMER1_COMPA_vect){
+  FastStepper::isr();
+}
+#else
+thread_local FastStepper* FastStepper::_active = 0;
+#endif
+
+/* Constructor: FastStepper::FastStepper(uint8_t in1, uint8_t in2, uint8_t in3, uint8_t in4, bool halfStep)
+ *
+ * Purpose:     Setup for the class FastStepper. Builds the port patterns
+ *              of the coil sequence and sets the pins as outputs.
+ *
+ * Input:       Pins for IN1 - IN4 of the ULN2003  (uint8_t in1 - uint8_t in4)
+ *              Half-steps, else full steps with
+ *              two coils on                       (bool halfStep)
+ *
+ * Output:      None
+*/
+FastStepper::FastStepper(uint8_t in1, uint8_t in2, uint8_t in3, uint8_t in4, bool halfStep){
+  const uint8_t pins[4] = {in1, in2, in3, in4};
+  uint8_t portOf[4];
+  _ports = 0;
+  memset(_mask, 0, sizeof(_mask));
+  memset(_pattern, 0, sizeof(_pattern));
+
+  //Group the pins by port.
+  for(uint8_t c = 0; c < 4; c++){
+    uint8_t port = digitalPinToPort(pins[c]);
+    uint8_t p = 0;
+#ifdef __AVR__
+    while(p < _ports && _out[p] != portOutputRegister(port)){
+      p++;
+    }
+    _out[p] = portOutputRegister(port);
+#else
+    while(p < _ports && _port[p] != port){
+      p++;
+    }
+    _port[p] = port;
+#endif
+    if(p == _ports){
+      _ports += 1;
+    }
+    portOf[c] = p;
+    _mask[p] |= digitalPinToBitMask(pins[c]);
+    pinMode(pins[c], OUTPUT);
+  }
+
+  //The bits of every phase on every port.
+  for(uint8_t phase = 0; phase < 8; phase++){
+    for(uint8_t c = 0; c < 4; c++){
+      if(coilSequence[phase] & (1 << c)){
+        _pattern[phase][portOf[c]] |= digitalPinToBitMask(pins[c]);
+      }
+    }
+  }
+  _stride = halfStep ? 1 : 2;
+  _phase = halfStep ? 0 : 1;
+  _on = false;
+  _position = 0;
+  _remaining = 0;
+}
+
+FastStepper::~FastStepper(){
+  stop();
+}
+
+/* Function:    void FastStepper::step(bool cw)
+ *
+ * Purpose:     Take one step at once.
+ *
+ * Input:       Direction, true for cw            (bool cw)
+ *
+ * Output:      None
+*/
+void FastStepper::step(bool cw){
+  advance(cw);
+}
+
+/* Function:    void FastStepper::off()
+ *
+ * Purpose:     Turn all coils off. The position is kept.
+ *
+ * Input:       None
+ *
+ * Output:      None
+*/
+void FastStepper::off(){
+  for(uint8_t p = 0; p < _ports; p++){
+#ifdef __AVR__
+    *_out[p] &= ~_mask[p];
+#else
+    simPortWrite(_port[p], _mask[p], 0);
+#endif
+  }
+  _on = false;
+}
+
+/* Function:    void FastStepper::run(long steps, unsigned int rate)
+ *
+ * Purpose:     Take steps in the timer 1 interrupt at a fixed rate, the
+ *              first one a step period from now. The period is rounded
+ *              to the 0.5 us of the timer. Returns at once.
+ *
+ * Input:       Steps, positive cw                (long steps)
+ *              Step rate [steps/s]               (unsigned int rate)
+ *
+ * Output:      None
+*/
+void FastStepper::run(long steps, unsigned int rate){
+  stop();
+  if(steps == 0 || rate == 0){
+    return;
+  }
+  unsigned long ticks = (timerHz + rate/2)/rate;
+  uint16_t compare = ticks > 65536 ? 65535 : (uint16_t)(ticks - 1);
+  _remaining = steps;
+  _active = this;
+
+#ifdef __AVR__
+  //CTC mode on OCR1A, 16 MHz/8.
+  TCCR1A = 0;
+  TCCR1B = 0;
+  TCNT1 = 0;
+  OCR1A = compare;
+  TIFR1 = 1 << OCF1A;
+  TIMSK1 |= 1 << OCIE1A;
+  TCCR1B = (1 << WGM12) | (1 << CS11);
+#else
+  simTimerStart(compare, &FastStepper::isr);
+#endif
+}
+
+/* Function:    void FastStepper::stop()
+ *
+ * Purpose:     Stop the steps of run(). The position is kept.
+ *
+ * Input:       None
+ *
+ * Output:      None
+*/
+void FastStepper::stop(){
+  if(_active != this){
+    return;
+  }
+  stopTimer();
+  _remaining = 0;
+}
+
+/* Function:    bool FastStepper::running()
+ *
+ * Purpose:     Check if run() still moves the motor.
+ *
+ * Input:       None
+ *
+ * Output:      True while steps are left.
+*/
+bool FastStepper::running(){
+  return _active == this;
+}
+
+/* Function:    long FastStepper::position()
+ *
+ * Purpose:     The position, read with the timer interrupt held off
+ *              since it is four bytes.
+ *
+ * Input:       None
+ *
+ * Output:      Steps from the start, positive cw.
+*/
+long FastStepper::position(){
+#ifdef __AVR__
+  uint8_t sreg = SREG;
+  cli();
+  long position = _position;
+  SREG = sreg;
+  return position;
+#else
+  return _position;
+#endif
+}
+
+/* Function:    void FastStepper::setPosition(long position)
+ *
+ * Purpose:     Set the count of the position, written with the timer
+ *              interrupt held off since it is four bytes.
+ *
+ * Input:       Steps from the start, positive cw (long position)
+ *
+ * Output:      None
+*/
+void FastStepper::setPosition(long position){
+#ifdef __AVR__
+  uint8_t sreg = SREG;
+  cli();
+  _position = position;
+  SREG = sreg;
+#else
+  _position = position;
+#endif
+}
+
+/* Function:    void FastStepper::isr()
+ *
+ * Purpose:     Take the next step of the running motor and stop the
+ *              timer after the last one. Called from the compare
+ *              interrupt of timer 1.
+ *
+ * Input:       None
+ *
+ * Output:      None
+*/
+void FastStepper::isr(){
+  FastStepper* motor = _active;
+  if(!motor){
+    return;
+  }
+  bool cw = motor->_remaining > 0;
+  motor->advance(cw);
+  motor->_remaining += cw ? -1 : 1;
+  if(motor->_remaining == 0){
+    motor->stopTimer();
+  }
+}
+
+/* Function:    void FastStepper::advance(bool cw)
+ *
+ * Purpose:     Move to the next phase of the sequence, write it to the
+ *              ports and count the step.
+ *
+ * Input:       Direction, true for cw            (bool cw)
+ *
+ * Output:      None
+*/
+void FastStepper::advance(bool cw){
+  uint8_t from = _phase;
+  _phase = (_phase + (cw ? _stride : 8 - _stride)) & 7;
+  output(from);
+  _position += cw ? 1 : -1;
+}
+
+/* Function:    void FastStepper::output(uint8_t from)
+ *
+ * Purpose:     Write the current phase, one read-modify-write per port.
+ *              Ports that do not change are skipped while the coils are
+ *              on, and ports that only turn coils on are written first,
+ *              so that between the writes of a full step the coils never
+ *              show another phase of the sequence.
+ *
+ * Input:       Phase written before                (uint8_t from)
+ *
+ * Output:      None
+*/
+void FastStepper::output(uint8_t from){
+  const uint8_t* pattern = _pattern[_phase];
+  const uint8_t* before = _pattern[from];
+  for(uint8_t pass = 0; pass < 2; pass++){
+    for(uint8_t p = 0; p < _ports; p++){
+      bool turnsOff = (before[p] & ~pattern[p]) != 0;
+      if(turnsOff != (pass == 1) || (_on && before[p] == pattern[p])){
+        continue;
+      }
+#ifdef __AVR__
+      volatile uint8_t* out = _out[p];
+      *out = (*out & ~_mask[p]) | pattern[p];
+#else
+      simPortWrite(_port[p], _mask[p], pattern[p]);
+#endif
+    }
+  }
+  _on = true;
+}
+
+/* Function:    void FastStepper::stopTimer()
+ *
+ * Purpose:     Stop the compare interrupt of timer 1 and release it.
+ *
+ * Input:       None
+ *
+ * Output:      None
+*/
+void FastStepper::stopTimer(){
+#ifdef __AVR__
+  TIMSK1 &= ~(1 << OCIE1A);
+  TCCR1B = 0;
+#else
+  simTimerStop();
+#endif
+  _active = 0;
+}
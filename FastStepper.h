@@ -0,0 +1,176 @@
+/* Filename:      FastStepper.h
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Header for FastStepper library.
+ *
+ *    Drives the 28byj-48 through the ULN2003 by writing the port
+ *    registers of the coil pins directly. The coil sequence is turned
+ *    into one mask and one pattern per port when constructed, so a step
+ *    is one read-modify-write of each port whose coils change: one or
+ *    two for IN1 - IN4 on pins 10, 9, 8 (PORTB) and 7 (PORTD).
+ *    CheapStepper instead calls digitalWrite() four times and then waits
+ *    600 us.
+ *
+ *    Steps are taken either by step(), paced by the caller, or by the
+ *    compare interrupt of timer 1 at a fixed rate, see run(), which
+ *    keeps the time between steps free of the jitter of loop(). The
+ *    position is a signed count of the steps, positive clockwise.
+ *
+ * Hardware:
+ *    Stepper Motor:  28byj-48 12V
+ *    Driver:         ULN2003 IC
+ *    MCU:            ATmega328, timer 1 at 2 MHz (prescaler 8).
+ *
+ * Notes:
+ *    - run() takes timer 1. Only one motor can run on the timer.
+ *    - step() must not be called while run() moves the motor.
+ *    - Rates from 31 to 65535 steps per second can be run on the timer.
+ *    - The host build writes the ports of the simulated board and
+ *      emulates timer 1.
+ */
+
+#ifndef FastStepper_h     //Include guard.
+#define FastStepper_h
+#include "Arduino.h"
+
+//Class for stepping a 4 coil unipolar motor through the port registers.
+class FastStepper {
+  public:
+    /* Constructor: FastStepper::FastStepper(uint8_t in1, uint8_t in2, uint8_t in3, uint8_t in4, bool halfStep)
+     *
+     * Purpose:     Setup for the class FastStepper. Builds the port
+     *              patterns of the coil sequence and sets the pins as
+     *              outputs.
+     *
+     * Input:       Pins for IN1 - IN4 of the ULN2003  (uint8_t in1 - uint8_t in4)
+     *              Half-steps, else full steps with
+     *              two coils on                       (bool halfStep)
+     *
+     * Output:      None
+    */
+    FastStepper(uint8_t in1, uint8_t in2, uint8_t in3, uint8_t in4, bool halfStep = true);
+    ~FastStepper();
+
+    /* Function:    void FastStepper::step(bool cw)
+     *
+     * Purpose:     Take one step at once.
+     *
+     * Input:       Direction, true for cw            (bool cw)
+     *
+     * Output:      None
+    */
+    void step(bool cw);
+
+    /* Function:    void FastStepper::off()
+     *
+     * Purpose:     Turn all coils off to spare their current while the
+     *              motor stands still. The position is kept and the
+     *              next step turns the coils of its phase on.
+     *
+     * Input:       None
+     *
+     * Output:      None
+    */
+    void off();
+
+    /* Function:    void FastStepper::run(long steps, unsigned int rate)
+     *
+     * Purpose:     Take steps in the timer 1 interrupt at a fixed rate,
+     *              the first one a step period from now. Returns at
+     *              once, see running().
+     *
+     * Input:       Steps, positive cw                (long steps)
+     *              Step rate [steps/s]               (unsigned int rate)
+     *
+     * Output:      None
+    */
+    void run(long steps, unsigned int rate);
+
+    /* Function:    void FastStepper::stop()
+     *
+     * Purpose:     Stop the steps of run() before they are all taken.
+     *              The position is kept and the coils stay on.
+     *
+     * Input:       None
+     *
+     * Output:      None
+    */
+    void stop();
+
+    /* Function:    bool FastStepper::running()
+     *
+     * Purpose:     Check if run() still moves the motor.
+     *
+     * Input:       None
+     *
+     * Output:      True while steps of run() are left.
+    */
+    bool running();
+
+    /* Function:    long FastStepper::position()
+     *
+     * Purpose:     The position, also while run() moves the motor.
+     *
+     * Input:       None
+     *
+     * Output:      Steps from the start, positive cw.
+    */
+    long position();
+
+    /* Function:    void FastStepper::setPosition(long position)
+     *
+     * Purpose:     Set the count of the position, e.g. to 0 at a known
+     *              heading. The motor does not move.
+     *
+     * Input:       Steps from the start, positive cw (long position)
+     *
+     * Output:      None
+    */
+    void setPosition(long position);
+
+    /* Function:    void FastStepper::isr()
+     *
+     * Purpose:     Take the next step of the running motor. Called from
+     *              the compare interrupt of timer 1.
+     *
+     * Input:       None
+     *
+     * Output:      None
+    */
+    static void isr();
+
+  private:
+    void output(uint8_t from);
+    void advance(bool cw);
+    void stopTimer();
+
+#ifdef __AVR__
+    static FastStepper* volatile _active;   //Motor run by the timer.
+#else
+    static thread_local FastStepper* _active; //One per simulated board.
+#endif
+
+    static const uint8_t maxPorts = 4;
+
+    uint8_t _ports;                   //Ports with coil pins.
+#ifdef __AVR__
+    volatile uint8_t* _out[maxPorts]; //Output register of each port.
+#else
+    uint8_t _port[maxPorts];          //Number of each port.
+#endif
+    uint8_t _mask[maxPorts];          //Coil bits of each port.
+    uint8_t _pattern[8][maxPorts];    //Coil bits of each phase and port.
+    uint8_t _stride;                  //Phases per step, 1 or 2.
+    uint8_t _phase;                   //Current phase of the sequence.
+    bool _on;                         //The ports hold the current phase.
+
+    //Written by the interrupt while running.
+    volatile long _position;          //Steps from the start, positive cw.
+    volatile long _remaining;         //Steps left of run(), positive cw.
+};
+#endif
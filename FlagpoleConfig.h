@@ -0,0 +1,95 @@
+/* Filename:      FlagpoleConfig.h
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    The pins, step counts and FS5 calibration of a pole as compile time
+ *    values, and constexpr functions to derive constants from them.
+ *
+ *    A pole is a struct with the members of HotswapPole below. main.ino
+ *    and Controller.h use the one named by FLAGPOLE_CONFIG. With
+ *    FLAGPOLE_FIXED_CONFIG set to 1, on the compiler command line, the
+ *    FS5 is an FS5Fixed of that pole, see FS5Fixed.h, whose constants
+ *    and velocity table are computed by the compiler and kept in flash.
+ *
+ * Notes:
+ *    - pow() and log() are not constexpr in C++11, so the constants are
+ *      folded with the constexpr functions below instead. They agree
+ *      with pow() to about 1e-12.
+ *    - A compile time calibration cannot be changed, the one stored in
+ *      the EEPROM is then not used, see Storage.h.
+ */
+
+#ifndef FlagpoleConfig_h    //Include guard.
+#define FlagpoleConfig_h
+#include "Arduino.h"
+
+//The pole of Hotswap, the prototype.
+struct HotswapPole {
+  static const uint8_t pinFS5 = A0;         //Input pin of the FS5.
+  static const uint8_t IN1 = 10;            //Pins of the stepper motor.
+  static const uint8_t IN2 = 9;
+  static const uint8_t IN3 = 8;
+  static const uint8_t IN4 = 7;
+  static const uint8_t limitSwitch = 12;    //Pin of the limit switch.
+
+  static constexpr double U0 = 2.24;        //FS5 voltage at wind speed 0% [V].
+  static constexpr double U50 = 3.33;       //FS5 voltage at wind speed 50% [V].
+  static constexpr double v50 = 8;          //Wind speed at 50% [m/s].
+  static constexpr double n = 0.51;         //Constant of the FS5 calibration.
+
+  static const int releaseSteps = 400;      //Steps to release the limit switch.
+  static const int expectedSweep = 2048;    //Steps of a 180 degree sweep.
+  static const int calibrationSteps = 300;  //Heading cw of the FS5 signal peak [steps].
+};
+
+//Pole used by main.ino and Controller.h.
+#ifndef FLAGPOLE_CONFIG
+#define FLAGPOLE_CONFIG HotswapPole
+#endif
+
+//Use the pole at compile time, see FS5Fixed.h.
+#ifndef FLAGPOLE_FIXED_CONFIG
+#define FLAGPOLE_FIXED_CONFIG 0
+#endif
+
+//Square of x.
+constexpr double constSquare(double x){
+  return x*x;
+}
+
+//e^x by its series, halving x until it is small.
+constexpr double constExpSeries(double x, double term, int i){
+  return i > 24 ? term : term + constExpSeries(x, term*x/i, i + 1);
+}
+
+constexpr double constExp(double x){
+  return (x > 0.125 || x < -0.125) ? constSquare(constExp(x/2)) : constExpSeries(x, 1, 1);
+}
+
+//ln(x) for x > 0, which constPow() checks. Scaled by 2 until x is
+//between 1 and 2, then 2*atanh((x - 1)/(x + 1)) by its series.
+constexpr double constAtanhSeries(double y, double power, int i){
+  return i > 61 ? power/i : power/i + constAtanhSeries(y, power*y*y, i + 2);
+}
+
+constexpr double constLog(double x){
+  return x > 2 ? constLog(x/2) + 0.69314718055994530942 :
+         x < 1 ? constLog(x*2) - 0.69314718055994530942 :
+         2*constAtanhSeries((x - 1)/(x + 1), (x - 1)/(x + 1), 1);
+}
+
+//x^y for x >= 0.
+constexpr double constPow(double x, double y){
+  return x > 0 ? constExp(y*constLog(x)) : 0;
+}
+
+//Wind velocity of the FS5 transfer function, see
+//FS5sensor::velocityFromVoltage().
+constexpr double constVelocity(double U, double U0, double invN, double velScale){
+  return U > U0 ? constPow((U - U0)*(U + U0), invN)/velScale : 0;
+}
+#endif
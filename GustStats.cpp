@@ -0,0 +1,283 @@
+/* Filename:      GustStats.cpp
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Library for the gust statistics, see GustStats.h.
+ *
+ * Source:
+ *    R. Jain and I. Chlamtac, "The P² algorithm for dynamic calculation
+ *    of quantiles and histograms without storing observations",
+ *    Communications of the ACM, vol. 28, no. 10, 1985.
+ */
+
+//Include libraries.
+#include "Arduino.h"
+#include "GustStats.h"
+
+/* Function:    void GustAccumulator::clear()
+ *
+ * Purpose:     Restart the accumulator without samples.
+ *
+ * Input:       None
+ *
+ * Output:      None
+*/
+void GustAccumulator::clear(){
+  count = 0;
+  mean = 0;
+  m2 = 0;
+  peak = 0;
+}
+
+/* Function:    void GustAccumulator::add(double sample, double p)
+ *
+ * Purpose:     Add a sample to the mean and the squared deviations by
+ *              Welford's method, to the peak and to the P² markers of
+ *              the percentile p. The markers sit at the minimum, p/2,
+ *              p, (1 + p)/2 and the maximum. A middle marker that is
+ *              a position or more from where it should be moves one
+ *              position, and its height is adjusted by the parabola
+ *              through it and its neighbours, or linearly if that would
+ *              pass a neighbour.
+ *
+ * Input:       Wind speed [m/s]                        (double sample)
+ *              Percentile                              (double p)
+ *
+ * Output:      None
+*/
+void GustAccumulator::add(double sample, double p){
+  count += count < 0xFFFF ? 1 : 0;
+  double delta = sample - mean;
+  mean += delta/count;
+  m2 += delta*(sample - mean);
+  peak = (count == 1 || sample > peak) ? sample : peak;
+
+  //The first five samples are the markers, sorted.
+  if(count <= 5){
+    uint8_t i = count - 1;
+    for(; i > 0 && q[i - 1] > sample; i--){
+      q[i] = q[i - 1];
+    }
+    q[i] = sample;
+    n[0] = 1;
+    n[1] = 2;
+    n[2] = 3;
+    return;
+  }
+
+  //Cell of the sample, the outer markers follow the extremes.
+  uint8_t k;
+  if(sample < q[0]){
+    q[0] = sample;
+    k = 0;
+  }
+  else if(sample >= q[4]){
+    q[4] = sample;
+    k = 3;
+  }
+  else{
+    k = 0;
+    while(sample >= q[k + 1]){
+      k++;
+    }
+  }
+  for(uint8_t i = k; i < 3; i++){
+    n[i] += 1;
+  }
+
+  //Move the middle markers towards their desired positions.
+  const double fraction[3] = {p/2, p, (1 + p)/2};
+  for(uint8_t i = 1; i <= 3; i++){
+    double position = n[i - 1];
+    double below = i == 1 ? 0 : n[i - 2];
+    double above = i == 3 ? count - 1 : n[i];
+    double d = (count - 1)*fraction[i - 1] - position;
+    if((d >= 1 && above - position > 1) || (d <= -1 && below - position < -1)){
+      int s = d > 0 ? 1 : -1;
+      double parabolic = q[i] + s/(above - below)*((position - below + s)*(q[i + 1] - q[i])/(above - position)
+                                                   + (above - position - s)*(q[i] - q[i - 1])/(position - below));
+      if(q[i - 1] < parabolic && parabolic < q[i + 1]){
+        q[i] = parabolic;
+      }
+      else{
+        q[i] += s*(q[i + s] - q[i])/((s > 0 ? above : below) - position);
+      }
+      n[i - 1] += s;
+    }
+  }
+}
+
+/* Function:    double GustAccumulator::percentile(double p) const
+ *
+ * Purpose:     The estimate of the percentile p, the middle marker, or
+ *              the nearest rank while there are fewer than five samples.
+ *
+ * Input:       Percentile                              (double p)
+ *
+ * Output:      The percentile [m/s], 0 without samples.
+*/
+double GustAccumulator::percentile(double p) const {
+  if(count == 0){
+    return 0;
+  }
+  if(count < 5){
+    int rank = (int)ceil(p*count) - 1;
+    return q[rank < 0 ? 0 : rank];
+  }
+  return q[2];
+}
+
+/* Constructor: GustStats::GustStats(double percentile)
+ *
+ * Purpose:     Setup for the class GustStats. Declaring private
+ *              variables, with windows of 3 s, 1 min and 10 min.
+ *
+ * Input:       Percentile to estimate, e.g. 0.9      (double percentile)
+ *
+ * Output:      None
+*/
+GustStats::GustStats(double percentile){
+  _p = percentile;
+  _length[GUST_SHORT] = 3000;
+  _length[GUST_MINUTE] = 60000;
+  _length[GUST_LONG] = 600000;
+  clear();
+}
+
+/* Function:    void GustStats::setWindow(uint8_t window, unsigned long lengthMs)
+ *
+ * Purpose:     Set the length of a window and empty it.
+ *
+ * Input:       Window, GustWindow                      (uint8_t window)
+ *              Length, at least 2 ms [ms]              (unsigned long lengthMs)
+ *
+ * Output:      None
+*/
+void GustStats::setWindow(uint8_t window, unsigned long lengthMs){
+  if(window >= GUST_WINDOWS){
+    return;
+  }
+  _length[window] = lengthMs < 2 ? 2 : lengthMs;
+  _acc[window][0].clear();
+  _acc[window][1].clear();
+  _full[window] = false;
+}
+
+/* Function:    void GustStats::clear()
+ *
+ * Purpose:     Empty all windows, keeping their lengths.
+ *
+ * Input:       None
+ *
+ * Output:      None
+*/
+void GustStats::clear(){
+  for(uint8_t w = 0; w < GUST_WINDOWS; w++){
+    setWindow(w, _length[w]);
+  }
+}
+
+/* Function:    void GustStats::add(double sample, unsigned long timeMs)
+ *
+ * Purpose:     Add a wind speed sample to every window. The first
+ *              accumulator of a window restarts every window length of
+ *              time, the second half a window later, each with the
+ *              first sample from its restart on. The restarts keep to
+ *              a grid from the first sample, so the two stay half a 
+ *              window apart however the samples are spaced.
+ *
+ * Input:       Wind speed [m/s]                        (double sample)
+ *              Time of the sample, millis()            (unsigned long timeMs)
+ *
+ * Output:      None
+*/
+void GustStats::add(double sample, unsigned long timeMs){
+  for(uint8_t w = 0; w < GUST_WINDOWS; w++){
+    if(_acc[w][0].count == 0 && _acc[w][1].count == 0){
+      _restart[w][0] = timeMs;
+      _restart[w][1] = timeMs - _length[w]/2;
+    }
+    for(uint8_t a = 0; a < 2; a++){
+      unsigned long age = timeMs - _restart[w][a];
+      if(age >= _length[w]){
+        _restart[w][a] = timeMs - age % _length[w];
+        _full[w] = _full[w] || a == 0;
+        _acc[w][a].clear();
+      }
+      _acc[w][a].add(sample, _p);
+    }
+  }
+}
+
+/* Function:    double GustStats::statistic(uint8_t window, uint8_t which)
+ *
+ * Purpose:     One statistic of a window, from the accumulator with the
+ *              most samples.
+ *
+ * Input:       Window, GustWindow                      (uint8_t window)
+ *              Statistic, GustStatistic                (uint8_t which)
+ *
+ * Output:      The statistic [m/s], 0 without samples.
+*/
+double GustStats::statistic(uint8_t window, uint8_t which){
+  if(window >= GUST_WINDOWS){
+    return 0;
+  }
+  const GustAccumulator& acc = older(window);
+  switch(which){
+    case GUST_MEAN:
+      return acc.mean;
+    case GUST_DEVIATION:
+      return acc.count > 1 ? sqrt(acc.m2/(acc.count - 1)) : 0;
+    case GUST_PEAK:
+      return acc.peak;
+    case GUST_PERCENTILE:
+      return acc.percentile(_p);
+    default:
+      return 0;
+  }
+}
+
+/* Function:    uint16_t GustStats::count(uint8_t window)
+ *
+ * Purpose:     The number of samples the statistics of a window are
+ *              taken over, those of the older accumulator.
+ *
+ * Input:       Window, GustWindow                      (uint8_t window)
+ *
+ * Output:      Samples of the window, 0 for no window.
+*/
+uint16_t GustStats::count(uint8_t window){
+  return window < GUST_WINDOWS ? older(window).count : 0;
+}
+
+/* Function:    bool GustStats::full(uint8_t window)
+ *
+ * Purpose:     Check if a window has seen a whole window length of
+ *              time, so its statistics cover at least half of it.
+ *
+ * Input:       Window, GustWindow                      (uint8_t window)
+ *
+ * Output:      True once the window is full, false for no window.
+*/
+bool GustStats::full(uint8_t window){
+  return window < GUST_WINDOWS && _full[window];
+}
+
+/* Function:    const GustAccumulator& GustStats::older(uint8_t window)
+ *
+ * Purpose:     The accumulator of a window with the most samples,
+ *              the one the statistics are taken from.
+ *
+ * Input:       Window, GustWindow, checked
+ *              by the caller                           (uint8_t window)
+ *
+ * Output:      The older accumulator.
+*/
+const GustAccumulator& GustStats::older(uint8_t window){
+  return _acc[window][0].count >= _acc[window][1].count ? _acc[window][0] : _acc[window][1];
+}
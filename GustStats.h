@@ -0,0 +1,170 @@
+/* Filename:      GustStats.h
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Header for GustStats library.
+ *
+ *    Statistics of the wind samples over a short, a one minute and a
+ *    ten minute window, next to the median of the last N samples: the
+ *    mean and the standard deviation (Welford), the peak gust and a
+ *    high percentile (P², Jain and Chlamtac 1985). A gust inside a
+ *    windy period shows in the peak and the percentile of the short
+ *    window long before it moves the median.
+ *
+ *    Every window has two accumulators that restart every window length
+ *    of time, half a window apart. The statistics are those of the
+ *    older one, so they cover the last half to whole window, and a
+ *    sample costs the same whatever the window length. The P²
+ *    estimator keeps five markers instead of the samples.
+ *
+ * Notes:
+ *    - The windows are in time, from the time given with each sample,
+ *      so they cover 3 s, 1 min and 10 min whatever the time between
+ *      the samples. Every sample counts the same, so a dense stretch
+ *      of samples weighs more than a sparse one.
+ *    - After a pause longer than a window the statistics start over
+ *      with the next sample, so a 3 s window with samples 4 s apart
+ *      holds only the last sample.
+ *    - An accumulator takes 40 bytes and a window 93 bytes on the
+ *      ATmega328, 283 bytes in all.
+ *    - Until five samples are in an accumulator the percentile is the
+ *      nearest rank of those samples.
+ */
+
+#ifndef GustStats_h     //Include guard.
+#define GustStats_h
+#include "Arduino.h"
+
+//Windows of the statistics.
+enum GustWindow {
+  GUST_SHORT,           //3 s, gusts.
+  GUST_MINUTE,          //1 min.
+  GUST_LONG,            //10 min, the mean wind of the weather report.
+  GUST_WINDOWS
+};
+
+//Statistics of a window.
+enum GustStatistic {
+  GUST_MEAN,            //Mean wind speed [m/s].
+  GUST_DEVIATION,       //Standard deviation [m/s].
+  GUST_PEAK,            //Highest sample [m/s].
+  GUST_PERCENTILE       //High percentile [m/s].
+};
+
+//Statistics of the samples since a restart.
+struct GustAccumulator {
+  uint16_t count;       //Samples since the restart.
+  double mean;          //Mean of the samples.
+  double m2;            //Sum of squared deviations from the mean.
+  double peak;          //Highest sample.
+  double q[5];          //P² marker heights, the samples until there are five.
+  uint16_t n[3];        //Positions of the three middle markers.
+
+  void clear();
+  void add(double sample, double p);
+  double percentile(double p) const;
+};
+
+//Class for the gust statistics.
+class GustStats {
+  public:
+    /* Constructor: GustStats::GustStats(double percentile)
+     *
+     * Purpose:     Setup for the class GustStats with empty windows of
+     *              3 s, 1 min and 10 min.
+     *
+     * Input:       Percentile to estimate, e.g. 0.9      (double percentile)
+     *
+     * Output:      None
+    */
+    GustStats(double percentile);
+
+    /* Function:    void GustStats::setWindow(uint8_t window, unsigned long lengthMs)
+     *
+     * Purpose:     Set the length of a window and empty it.
+     *
+     * Input:       Window, GustWindow                      (uint8_t window)
+     *              Length, at least 2 ms [ms]              (unsigned long lengthMs)
+     *
+     * Output:      None
+    */
+    void setWindow(uint8_t window, unsigned long lengthMs);
+
+    /* Function:    void GustStats::add(double sample, unsigned long timeMs)
+     *
+     * Purpose:     Add a wind speed sample to every window.
+     *
+     * Input:       Wind speed [m/s]                        (double sample)
+     *              Time of the sample, millis()            (unsigned long timeMs)
+     *
+     * Output:      None
+    */
+    void add(double sample, unsigned long timeMs);
+
+    /* Function:    double GustStats::statistic(uint8_t window, uint8_t which)
+     *
+     * Purpose:     One statistic of a window.
+     *
+     * Input:       Window, GustWindow                      (uint8_t window)
+     *              Statistic, GustStatistic                (uint8_t which)
+     *
+     * Output:      The statistic [m/s], 0 without samples.
+    */
+    double statistic(uint8_t window, uint8_t which);
+
+    /* Function:    uint16_t GustStats::count(uint8_t window)
+     *
+     * Purpose:     The number of samples the statistics of a window are
+     *              taken over, those of the older accumulator.
+     *
+     * Input:       Window, GustWindow                      (uint8_t window)
+     *
+     * Output:      Samples of the window, 0 for no window.
+    */
+    uint16_t count(uint8_t window);
+
+    /* Function:    bool GustStats::full(uint8_t window)
+     *
+     * Purpose:     Check if a window has seen a whole window length of
+     *              time, so its statistics cover at least half of it.
+     *
+     * Input:       Window, GustWindow                      (uint8_t window)
+     *
+     * Output:      True once the window is full, false for no window.
+    */
+    bool full(uint8_t window);
+
+    /* Function:    void GustStats::clear()
+     *
+     * Purpose:     Empty all windows, keeping their lengths.
+     *
+     * Input:       None
+     *
+     * Output:      None
+    */
+    void clear();
+
+  private:
+    /* Function:    const GustAccumulator& GustStats::older(uint8_t window)
+     *
+     * Purpose:     The accumulator of a window with the most samples,
+     *              the one the statistics are taken from.
+     *
+     * Input:       Window, GustWindow, checked
+     *              by the caller                           (uint8_t window)
+     *
+     * Output:      The older accumulator.
+    */
+    const GustAccumulator& older(uint8_t window);
+
+    double _p;                                  //Percentile to estimate.
+    GustAccumulator _acc[GUST_WINDOWS][2];      //Accumulators, half a window apart.
+    unsigned long _length[GUST_WINDOWS];        //Window lengths [ms].
+    unsigned long _restart[GUST_WINDOWS][2];    //Times the accumulators restarted [ms].
+    bool _full[GUST_WINDOWS];                   //A whole window has been seen.
+};
+#endif
@@ -0,0 +1,280 @@
+/* Filename:      LimitSwitch.cpp
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Library for watching the limit switch with the pin change
+ *    interrupt, see LimitSwitch.h.
+ *
+ * Hardware:
+ *    MCU:          ATmega328
+ *
+ * Notes:
+ *    - On the ATmega328 the pin change mask of the pin is set directly
+ *      and the interrupt reads the input register of the port. Only the
+ *      vector of the port of LIMIT_SWITCH_PIN is defined. The host
+ *      build starts the emulated pin change interrupt of the simulated
+ *      board instead and reads the pin with digitalRead().
+ */
+
+//Include libraries.
+#include "Arduino.h"
+#include "LimitSwitch.h"
+
+#ifdef __AVR__
+LimitSwitch* volatile LimitSwitch::_active = 0;
+
+//Pin change interrupt of the port of LIMIT_SWITCH_PIN.
+#if LIMIT_SWITCH_PIN >= 8 && LIMIT_SWITCH_PIN <= 13
+#define LIMIT_SWITCH_VECT PCINT0_vect
+#elif LIMIT_SWITCH_PIN >= 14 && LIMIT_SWITCH_PIN <= 19
+#define LIMIT_SWITCH_VECT PCINT1_vect
+#elif LIMIT_SWITCH_PIN >= 0 && LIMIT_SWITCH_PIN <= 7
+#define LIMIT_SWITCH_VECT PCINT2_vect
+#else
+#error "LIMIT_SWITCH_PIN has no pin change interrupt on the ATmega328"
+#endif
+
+//Any edge on the port goes to the watched switch, which checks its
+//own pin.
+ISR(LIMIT_SWITCH_VECT){
+  LimitSwitch::isr();
+}
+#else
+thread_local LimitSwitch* LimitSwitch::_active = 0;
+#endif
+
+/* Constructor: LimitSwitch::LimitSwitch(uint8_t pin, unsigned int debounceUs)
+ *
+ * Purpose:     Setup for the class LimitSwitch. Declaring private
+ *              variables and setting the pin as input.
+ *
+ * Input:       Pin of the limit switch                (uint8_t pin)
+ *              Time an edge locks out the next [us]   (unsigned int debounceUs)
+ *
+ * Output:      None
+*/
+LimitSwitch::LimitSwitch(uint8_t pin, unsigned int debounceUs){
+  _pin = pin;
+  _debounceUs = debounceUs;
+#ifdef __AVR__
+  _input = portInputRegister(digitalPinToPort(pin));
+  _mask = digitalPinToBitMask(pin);
+#endif
+  _closed = false;
+  _dirty = false;
+  _tripped = false;
+  _trippedAt = 0;
+  _quiet = true;
+  _lastEdge = 0;
+  _bounces = 0;
+  _steps = 0;
+  pinMode(pin, INPUT);
+}
+
+LimitSwitch::~LimitSwitch(){
+  end();
+}
+
+/* Function:    void LimitSwitch::begin()
+ *
+ * Purpose:     Read the switch and enable the pin change interrupt for
+ *              it. Can be called again, e.g. before every scan; the 
+ *              trip and the bounces are kept while it is watched.
+ *
+ * Input:       None
+ *
+ * Output:      None
+*/
+void LimitSwitch::begin(){
+  if(_active != this){
+    _tripped = false;
+    _bounces = 0;
+    _active = this;
+  }
+  _closed = readPin();
+  _dirty = false;
+  _quiet = true;
+
+#ifdef __AVR__
+  uint8_t port = digitalPinToPCICRbit(_pin);
+  PCIFR = 1 << port;                            //Drop an old edge.
+  *digitalPinToPCMSK(_pin) |= 1 << digitalPinToPCMSKbit(_pin);
+  *digitalPinToPCICR(_pin) |= 1 << port;
+#else
+  simPinChangeStart(_pin, &LimitSwitch::isr);
+#endif
+}
+
+/* Function:    void LimitSwitch::end()
+ *
+ * Purpose:     Disable the pin change interrupt of the switch.
+ *
+ * Input:       None
+ *
+ * Output:      None
+*/
+void LimitSwitch::end(){
+  if(_active != this){
+    return;
+  }
+#ifdef __AVR__
+  *digitalPinToPCMSK(_pin) &= ~(1 << digitalPinToPCMSKbit(_pin));
+#else
+  simPinChangeStop();
+#endif
+  _active = 0;
+}
+
+/* Function:    bool LimitSwitch::closed()
+ *
+ * Purpose:     The debounced level of the switch. When a bounce left
+ *              the pin at another level than the accepted one, the edge
+ *              is handled again with the interrupt disabled. It is
+ *              accepted once the lockout has passed.
+ *
+ * Input:       None
+ *
+ * Output:      True if the switch is closed.
+*/
+bool LimitSwitch::closed(){
+  if(_dirty){
+#ifdef __AVR__
+    uint8_t sreg = SREG;
+    cli();
+    edge();
+    SREG = sreg;
+#else
+    edge();
+#endif
+  }
+  return _closed;
+}
+
+/* Function:    bool LimitSwitch::tripped()
+ *
+ * Purpose:     Check if the switch has closed since clear().
+ *
+ * Input:       None
+ *
+ * Output:      True if the switch has closed.
+*/
+bool LimitSwitch::tripped(){
+  closed();
+  return _tripped;
+}
+
+/* Function:    uint8_t LimitSwitch::overshoot()
+ *
+ * Purpose:     Steps counted by countStep() since the switch closed.
+ *              The step latched by the interrupt is the last one
+ *              counted before the switch closed.
+ *
+ * Input:       None
+ *
+ * Output:      Steps past the switch, 0 if it has not tripped.
+*/
+uint8_t LimitSwitch::overshoot(){
+  if(!tripped()){
+    return 0;
+  }
+  return (uint8_t)(_steps - _trippedAt);
+}
+
+/* Function:    void LimitSwitch::clear()
+ *
+ * Purpose:     Forget the trip, the next close of the switch trips it
+ *              again.
+ *
+ * Input:       None
+ *
+ * Output:      None
+*/
+void LimitSwitch::clear(){
+  _tripped = false;
+}
+
+/* Function:    unsigned int LimitSwitch::bounces()
+ *
+ * Purpose:     Number of edges ignored as bounces, read with the 
+ *              interrupt held off since it is two bytes.
+ *
+ * Input:       None
+ *
+ * Output:      Bounces since the switch is watched.
+*/
+unsigned int LimitSwitch::bounces(){
+#ifdef __AVR__
+  uint8_t sreg = SREG;
+  cli();
+  uint16_t bounces = _bounces;
+  SREG = sreg;
+  return bounces;
+#else
+  return _bounces;
+#endif
+}
+
+/* Function:    void LimitSwitch::isr()
+ *
+ * Purpose:     Handle an edge on the pin of the watched switch. Called
+ *              from the pin change interrupt.
+ *
+ * Input:       None
+ *
+ * Output:      None
+*/
+void LimitSwitch::isr(){
+  LimitSwitch* watched = _active;
+  if(watched){
+    watched->edge();
+  }
+}
+
+/* Function:    void LimitSwitch::edge()
+ *
+ * Purpose:     Debounce an edge. A new level is accepted when no edge
+ *              was accepted within the last debounceUs; a close then
+ *              latches the step count. Edges within the lockout are
+ *              counted as bounces. If the pin is left at another level
+ *              than the accepted one, the switch is marked unsettled.
+ *
+ * Input:       None
+ *
+ * Output:      None
+*/
+void LimitSwitch::edge(){
+  bool level = readPin();
+  unsigned long now = micros();
+  bool locked = !_quiet && now - _lastEdge < _debounceUs;
+  if(locked){
+    _bounces = _bounces + 1;
+  }
+  if(level == _closed){
+    _dirty = false;           //Bounced back, or another pin of the port.
+    return;
+  }
+  if(locked){
+    _dirty = true;
+    return;
+  }
+  _closed = level;
+  _dirty = false;
+  _quiet = false;
+  _lastEdge = now;
+  if(level && !_tripped){
+    _trippedAt = _steps;
+    _tripped = true;
+  }
+}
+
+bool LimitSwitch::readPin(){
+#ifdef __AVR__
+  return (*_input & _mask) != 0;
+#else
+  return digitalRead(_pin) == HIGH;
+#endif
+}
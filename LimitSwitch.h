@@ -0,0 +1,176 @@
+/* Filename:      LimitSwitch.h
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Header for LimitSwitch library.
+ *
+ *    Watches the limit switch with the pin change interrupt instead of
+ *    reading the pin after every step. The interrupt debounces the
+ *    switch and latches the step count when it closes, so the position
+ *    of the switch is known to the step even when loop() looks at it
+ *    some steps later, see overshoot().
+ *
+ *    Debouncing: the first edge after a quiet debounceUs is taken at
+ *    once, so the trip is not delayed. Edges within debounceUs of it
+ *    are bounces and ignored. If the pin has not settled back at the
+ *    accepted level, the level is read again once debounceUs has
+ *    passed, the next time closed() or tripped() is called.
+ *
+ * Hardware:
+ *    MCU:          ATmega328
+ *    Switch:       Active high, closes at either end of the span.
+ *
+ * Notes:
+ *    - There is one pin change interrupt handler per port, so only one
+ *      switch can be watched at a time. LimitSwitch.cpp defines only
+ *      the handler of the port of LIMIT_SWITCH_PIN, chosen at compile
+ *      time, so the other two are left to e.g. SoftwareSerial. The
+ *      switch must be on that pin.
+ *    - The step count is one byte, which the interrupt reads atomically.
+ *      The trip is known exactly for up to 255 steps after it.
+ *    - The host build emulates the pin change interrupt, with contact
+ *      bounce, on the simulated board.
+ */
+
+#ifndef LimitSwitch_h     //Include guard.
+#define LimitSwitch_h
+#include "Arduino.h"
+
+//Pin of the limit switch, the one of HotswapPole in FlagpoleConfig.h.
+//Selects the pin change interrupt LimitSwitch.cpp defines: pins 8 - 13
+//are on port B, A0 - A5 (14 - 19) on port C and 0 - 7 on port D.
+#ifndef LIMIT_SWITCH_PIN
+#define LIMIT_SWITCH_PIN 12
+#endif
+
+//Class for a limit switch watched by the pin change interrupt.
+class LimitSwitch {
+  public:
+    /* Constructor: LimitSwitch::LimitSwitch(uint8_t pin, unsigned int debounceUs)
+     *
+     * Purpose:     Setup for the class LimitSwitch. Declaring private
+     *              variables and setting the pin as input.
+     *
+     * Input:       Pin of the limit switch                (uint8_t pin)
+     *              Time an edge locks out the next [us]   (unsigned int debounceUs)
+     *
+     * Output:      None
+    */
+    LimitSwitch(uint8_t pin, unsigned int debounceUs);
+    ~LimitSwitch();
+
+    /* Function:    void LimitSwitch::begin()
+     *
+     * Purpose:     Read the switch and enable the pin change interrupt
+     *              for it. Can be called again, the trip and the bounces
+     *              are kept while it is watched.
+     *
+     * Input:       None
+     *
+     * Output:      None
+    */
+    void begin();
+
+    /* Function:    void LimitSwitch::end()
+     *
+     * Purpose:     Disable the pin change interrupt of the switch.
+     *
+     * Input:       None
+     *
+     * Output:      None
+    */
+    void end();
+
+    /* Function:    bool LimitSwitch::closed()
+     *
+     * Purpose:     The debounced level of the switch. Reads the pin only
+     *              when bounces left it unsettled.
+     *
+     * Input:       None
+     *
+     * Output:      True if the switch is closed.
+    */
+    bool closed();
+
+    /* Function:    bool LimitSwitch::tripped()
+     *
+     * Purpose:     Check if the switch has closed since clear().
+     *
+     * Input:       None
+     *
+     * Output:      True if the switch has closed.
+    */
+    bool tripped();
+
+    /* Function:    uint8_t LimitSwitch::overshoot()
+     *
+     * Purpose:     Steps counted by countStep() since the switch closed.
+     *
+     * Input:       None
+     *
+     * Output:      Steps past the switch, 0 if it has not tripped.
+    */
+    uint8_t overshoot();
+
+    /* Function:    void LimitSwitch::clear()
+     *
+     * Purpose:     Forget the trip, the next close of the switch trips
+     *              it again.
+     *
+     * Input:       None
+     *
+     * Output:      None
+    */
+    void clear();
+
+    //Count one step of the motor. Call before the step is taken.
+    void countStep() { _steps = (uint8_t)(_steps + 1); }
+
+    //Edges ignored as bounces while watched.
+    unsigned int bounces();
+
+    /* Function:    void LimitSwitch::isr()
+     *
+     * Purpose:     Handle an edge on the pin of the watched switch.
+     *              Called from the pin change interrupt.
+     *
+     * Input:       None
+     *
+     * Output:      None
+    */
+    static void isr();
+
+  private:
+    void edge();
+    bool readPin();
+
+#ifdef __AVR__
+    static LimitSwitch* volatile _active;   //Switch served by the interrupt.
+#else
+    static thread_local LimitSwitch* _active; //One per simulated board.
+#endif
+
+    uint8_t _pin;                     //Pin of the limit switch.
+    unsigned int _debounceUs;         //Lockout after an accepted edge [us].
+#ifdef __AVR__
+    volatile uint8_t* _input;         //Input register of the port.
+    uint8_t _mask;                    //Bit of the pin in the register.
+#endif
+
+    //Written by the interrupt, or by loop() with it disabled.
+    volatile bool _closed;            //Debounced level.
+    volatile bool _dirty;             //A bounce left the pin unsettled.
+    volatile bool _tripped;           //Closed since clear().
+    volatile uint8_t _trippedAt;      //Step count when closed.
+    volatile bool _quiet;             //No edge accepted yet.
+    unsigned long _lastEdge;          //Time of the accepted edge [us].
+    volatile uint16_t _bounces;       //Edges ignored as bounces.
+
+    //Written by loop() only.
+    volatile uint8_t _steps;          //Steps counted by countStep().
+};
+#endif
@@ -0,0 +1,136 @@
+/* Filename:      Motion.cpp
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Library for trapezoidal speed profiles of stepper motor moves,
+ *    see Motion.h.
+ */
+
+//Include libraries.
+#include "Arduino.h"
+#include "Motion.h"
+
+/* Constructor: Motion::Motion(unsigned int maxRate, unsigned int acceleration, unsigned int startRate)
+ *
+ * Purpose:     Setup for the class Motion. Declaring private variables.
+ *
+ * Input:       Highest rate [steps/s]              (unsigned int maxRate)
+ *              Acceleration [steps/s^2]            (unsigned int acceleration)
+ *              Start and stop rate [steps/s]       (unsigned int startRate)
+ *
+ * Output:      None
+*/
+Motion::Motion(unsigned int maxRate, unsigned int acceleration, unsigned int startRate){
+  setLimits(maxRate, acceleration, startRate);
+  start(0);
+}
+
+/* Function:    void Motion::setLimits(unsigned int maxRate, unsigned int acceleration, unsigned int startRate)
+ *
+ * Purpose:     Set the limits of the motor for the following moves.
+ *
+ * Input:       Highest rate [steps/s]              (unsigned int maxRate)
+ *              Acceleration [steps/s^2]            (unsigned int acceleration)
+ *              Start and stop rate [steps/s]       (unsigned int startRate)
+ *
+ * Output:      None
+*/
+void Motion::setLimits(unsigned int maxRate, unsigned int acceleration, unsigned int startRate){
+  _startRate = startRate > 0 ? startRate : 1;
+  _maxRate = maxRate > _startRate ? maxRate : _startRate;
+  _acceleration = acceleration;
+}
+
+/* Function:    void Motion::start(unsigned int steps, unsigned int rate)
+ *
+ * Purpose:     Start a move of the given length and cruise rate. The
+ *              cruise rate is limited to the highest rate.
+ *
+ * Input:       Length of the move [steps]          (unsigned int steps)
+ *              Cruise rate [steps/s], 0 for the highest rate
+ *                                                  (unsigned int rate)
+ *
+ * Output:      None
+*/
+void Motion::start(unsigned int steps, unsigned int rate){
+  _cruise = (rate == 0 || rate > _maxRate) ? _maxRate : rate;
+  _steps = steps;
+  _done = 0;
+  update();
+}
+
+/* Function:    void Motion::step()
+ *
+ * Purpose:     Count a step taken and compute the interval before the
+ *              next one.
+ *
+ * Input:       None
+ *
+ * Output:      None
+*/
+void Motion::step(){
+  _done += _done < 0xFFFF ? 1 : 0;
+  update();
+}
+
+/* Function:    void Motion::update()
+ *
+ * Purpose:     Compute the interval before the next step from the rate
+ *              of the profile at that step. The ramps are only needed
+ *              when the cruise rate is above the start rate.
+ *
+ * Input:       None
+ *
+ * Output:      None
+*/
+void Motion::update(){
+  double rate = _cruise < _startRate ? _cruise : _startRate;
+  if(_done < _steps && _cruise > _startRate){
+    double start2 = (double)_startRate*_startRate;
+    double up = sqrt(start2 + 2.0*_acceleration*_done);
+    double down = sqrt(start2 + 2.0*_acceleration*(_steps - 1 - _done));
+    rate = up < down ? up : down;
+    rate = rate < _cruise ? rate : _cruise;
+  }
+  _interval = (unsigned long)(1000000.0/rate);
+}
+
+/* Function:    unsigned long Motion::interval()
+ *
+ * Purpose:     The time between the last step and the next one.
+ *
+ * Input:       None
+ *
+ * Output:      Interval [us].
+*/
+unsigned long Motion::interval(){
+  return _interval;
+}
+
+/* Function:    unsigned int Motion::remaining()
+ *
+ * Purpose:     Steps left of the length of the move.
+ *
+ * Input:       None
+ *
+ * Output:      Steps left, 0 when the planned part is done.
+*/
+unsigned int Motion::remaining(){
+  return _done < _steps ? _steps - _done : 0;
+}
+
+/* Function:    unsigned int Motion::startRate()
+ *
+ * Purpose:     The rate moves start and end at.
+ *
+ * Input:       None
+ *
+ * Output:      Start and stop rate [steps/s].
+*/
+unsigned int Motion::startRate(){
+  return _startRate;
+}
@@ -0,0 +1,126 @@
+/* Filename:      Motion.h
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Header for Motion library.
+ *
+ *    Trapezoidal speed profiles for the moves of the stepper motor. A
+ *    move of a known number of steps starts at the start rate, speeds
+ *    up with constant acceleration to its cruise rate and slows down
+ *    again so that the last step is taken at the start rate:
+ *
+ *      rate = min(cruise, sqrt(start^2 + 2*a*done), sqrt(start^2 + 2*a*left))
+ *
+ *    Steps beyond the length of the move are taken at the start rate,
+ *    or the cruise rate if lower, so a move towards a limit switch can
+ *    be planned up to shortly before the switch and then continue
+ *    slowly until it is activated. The caller takes the steps and waits
+ *    interval() between them.
+ *
+ * Notes:
+ *    - The start rate is the rate the motor can start, stop and reverse
+ *      at without losing steps. Moves slower than it need no ramps.
+ *    - The interval is computed once per step, two sqrt() of about
+ *      40 us each on the ATmega328.
+ */
+
+#ifndef Motion_h          //Include guard.
+#define Motion_h
+#include "Arduino.h"
+
+//Class for the speed profile of stepper motor moves.
+class Motion {
+  public:
+    /* Constructor: Motion::Motion(unsigned int maxRate, unsigned int acceleration, unsigned int startRate)
+     *
+     * Purpose:     Setup for the class Motion, see setLimits().
+     *
+     * Input:       Highest rate [steps/s]              (unsigned int maxRate)
+     *              Acceleration [steps/s^2]            (unsigned int acceleration)
+     *              Start and stop rate [steps/s]       (unsigned int startRate)
+     *
+     * Output:      None
+    */
+    Motion(unsigned int maxRate, unsigned int acceleration, unsigned int startRate);
+
+    /* Function:    void Motion::setLimits(unsigned int maxRate, unsigned int acceleration, unsigned int startRate)
+     *
+     * Purpose:     Set the limits of the motor for the following moves.
+     *              With acceleration 0 all moves run at the start rate.
+     *
+     * Input:       Highest rate [steps/s]              (unsigned int maxRate)
+     *              Acceleration [steps/s^2]            (unsigned int acceleration)
+     *              Start and stop rate [steps/s]       (unsigned int startRate)
+     *
+     * Output:      None
+    */
+    void setLimits(unsigned int maxRate, unsigned int acceleration, unsigned int startRate);
+
+    /* Function:    void Motion::start(unsigned int steps, unsigned int rate)
+     *
+     * Purpose:     Start a move.
+     *
+     * Input:       Length of the move [steps]          (unsigned int steps)
+     *              Cruise rate [steps/s], 0 for the highest rate
+     *                                                  (unsigned int rate)
+     *
+     * Output:      None
+    */
+    void start(unsigned int steps, unsigned int rate = 0);
+
+    /* Function:    void Motion::step()
+     *
+     * Purpose:     Count a step taken and compute the interval before
+     *              the next one.
+     *
+     * Input:       None
+     *
+     * Output:      None
+    */
+    void step();
+
+    /* Function:    unsigned long Motion::interval()
+     *
+     * Purpose:     The time between the last step and the next one.
+     *
+     * Input:       None
+     *
+     * Output:      Interval [us].
+    */
+    unsigned long interval();
+
+    /* Function:    unsigned int Motion::remaining()
+     *
+     * Purpose:     Steps left of the length of the move.
+     *
+     * Input:       None
+     *
+     * Output:      Steps left, 0 when the planned part is done.
+    */
+    unsigned int remaining();
+
+    /* Function:    unsigned int Motion::startRate()
+     *
+     * Purpose:     The rate moves start and end at.
+     *
+     * Input:       None
+     *
+     * Output:      Start and stop rate [steps/s].
+    */
+    unsigned int startRate();
+
+  private:
+    void update();
+    unsigned int _maxRate;          //Highest rate [steps/s].
+    unsigned int _acceleration;     //Acceleration [steps/s^2].
+    unsigned int _startRate;        //Start and stop rate [steps/s].
+    unsigned int _cruise;           //Cruise rate of the move [steps/s].
+    unsigned int _steps;            //Length of the move.
+    unsigned int _done;             //Steps taken of the move.
+    unsigned long _interval;        //Time before the next step [us].
+};
+#endif
@@ -0,0 +1,114 @@
+/* Filename:      PowerSave.cpp
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Library for waiting with the MCU asleep, see PowerSave.h.
+ */
+
+//Include libraries.
+#include "Arduino.h"
+#include "PowerSave.h"
+
+#ifdef __AVR__
+#include <avr/sleep.h>
+#include <avr/wdt.h>
+
+//Counters of timer 0 in wiring.c of the Arduino core.
+extern volatile unsigned long timer0_millis;
+extern volatile unsigned long timer0_overflow_count;
+
+//The watchdog only wakes the CPU.
+ISR(WDT_vect){
+}
+
+//Steps of the watchdog [ms], longest first. The prescaler setting of a
+//step is 9 less its index, WDTO_8S to WDTO_15MS.
+static const uint16_t watchdogMs[10] = {8000, 4000, 2000, 1000, 500, 250, 120, 60, 30, 15};
+
+/* Function:    static void watchdogSleep(uint8_t step)
+ *
+ * Purpose:     Power down for one step of the watchdog and move the
+ *              counters of timer 0 on by it, 1024 us per overflow.
+ *
+ * Input:       Index of the step in watchdogMs    (uint8_t step)
+ *
+ * Output:      None
+*/
+static void watchdogSleep(uint8_t step){
+  uint8_t prescaler = 9 - step;
+  noInterrupts();
+  MCUSR &= ~(1 << WDRF);
+  WDTCSR = (1 << WDCE) | (1 << WDE);
+  WDTCSR = (1 << WDIE) | ((prescaler & 0x08) ? (1 << WDP3) : 0) | (prescaler & 0x07);
+  set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+  sleep_enable();
+#if defined(BODS) && defined(BODSE)
+  //The brown-out detector is off while asleep, on the ATmega328P.
+  sleep_bod_disable();
+#endif
+  interrupts();
+  sleep_cpu();
+  sleep_disable();
+  wdt_disable();
+
+  noInterrupts();
+  timer0_millis += watchdogMs[step];
+  timer0_overflow_count += ((unsigned long)watchdogMs[step]*1000) >> 10;
+  interrupts();
+}
+#endif
+
+/* Function:    void PowerSave::idle(unsigned long ms)
+ *
+ * Purpose:     Wait like delay() with the CPU in idle mode. Timer 0
+ *              wakes it every 1024 us to count millis().
+ *
+ * Input:       Time to wait [ms]                   (unsigned long ms)
+ *
+ * Output:      None
+*/
+void PowerSave::idle(unsigned long ms){
+#ifdef __AVR__
+  unsigned long start = millis();
+  set_sleep_mode(SLEEP_MODE_IDLE);
+  while(millis() - start < ms){
+    sleep_enable();
+    sleep_cpu();
+    sleep_disable();
+  }
+#else
+  simSleep(ms*1000, false);
+#endif
+}
+
+/* Function:    void PowerSave::powerDown(unsigned long ms)
+ *
+ * Purpose:     Send the serial output and wait in power down, in the
+ *              longest steps of the watchdog that fit, with the ADC
+ *              turned off. The rest is waited in idle mode.
+ *
+ * Input:       Time to wait [ms]                   (unsigned long ms)
+ *
+ * Output:      None
+*/
+void PowerSave::powerDown(unsigned long ms){
+  Serial.flush();
+#ifdef __AVR__
+  uint8_t adc = ADCSRA;
+  ADCSRA = adc & ~(1 << ADEN);
+  for(uint8_t step = 0; step < 10; step++){
+    while(ms >= watchdogMs[step]){
+      watchdogSleep(step);
+      ms -= watchdogMs[step];
+    }
+  }
+  ADCSRA = adc;
+  idle(ms);
+#else
+  simSleep(ms*1000, true);
+#endif
+}
@@ -0,0 +1,65 @@
+/* Filename:      PowerSave.h
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Header for PowerSave library.
+ *
+ *    Waits with the MCU asleep instead of in delay(). idle() sleeps in
+ *    idle mode, where the interrupts, e.g. the ADC of ADCSampler, go on
+ *    and timer 0 keeps millis(). powerDown() sleeps in power down with
+ *    the watchdog interrupt as the alarm clock, in steps of 8 s down to
+ *    15 ms, with the ADC turned off. Timer 0 stands still meanwhile, so
+ *    millis() and micros() are moved on by the time slept.
+ *
+ * Hardware:
+ *    MCU:          ATmega328, about 9 mA active, 2.5 mA idle and a few
+ *                  uA in power down with the watchdog at 5 V and 16 MHz.
+ *
+ * Notes:
+ *    - The coils of the stepper motor draw about 90 mA each while on,
+ *      far more than the MCU. Control turns them off after a scan.
+ *    - Stop the ADCSampler before powerDown() and start it again after,
+ *      the ADC does not convert in power down. Serial output is sent
+ *      before the MCU powers down.
+ *    - The watchdog oscillator is off by up to 10 %, and so is the time
+ *      of a power down. Another interrupt, e.g. a pin change, ends a
+ *      step of the watchdog early, but it is counted in full.
+ *    - The host build emulates both sleep modes on the simulated board,
+ *      which counts the time asleep.
+ */
+
+#ifndef PowerSave_h       //Include guard.
+#define PowerSave_h
+#include "Arduino.h"
+
+//Class for waiting with the MCU asleep.
+class PowerSave {
+  public:
+    /* Function:    void PowerSave::idle(unsigned long ms)
+     *
+     * Purpose:     Wait like delay() with the CPU in idle mode, woken by
+     *              every interrupt.
+     *
+     * Input:       Time to wait [ms]                   (unsigned long ms)
+     *
+     * Output:      None
+    */
+    static void idle(unsigned long ms);
+
+    /* Function:    void PowerSave::powerDown(unsigned long ms)
+     *
+     * Purpose:     Wait in power down, woken by the watchdog. What is
+     *              left below the shortest watchdog step is waited in
+     *              idle mode.
+     *
+     * Input:       Time to wait [ms]                   (unsigned long ms)
+     *
+     * Output:      None
+    */
+    static void powerDown(unsigned long ms);
+};
+#endif
@@ -0,0 +1,194 @@
+/* Filename:      Profiler.cpp
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Library for the timing instrumentation, see Profiler.h.
+ *
+ * Notes:
+ *    - Empty unless FLAGPOLE_PROFILE is 1.
+ */
+
+//Include libraries.
+#include "Arduino.h"
+#include "Profiler.h"
+
+#if FLAGPOLE_PROFILE
+
+ProfileStats Profiler::_sections[PROFILE_SECTIONS];
+ProfileStats Profiler::_intervals;
+uint16_t Profiler::_jitter[profileBuckets];
+unsigned long Profiler::_lastSample;
+
+//Names of the sections in the report.
+static const char* const sectionNames[PROFILE_SECTIONS] = {
+  "idle", "homing", "home release", "sweep", "sweep release", "align",
+  "align release", "coarse", "move", "track",
+  "FS5 read", "velocity", "median", "report", "sequence"
+};
+
+//Count one time in the statistics.
+static void addStats(ProfileStats& stats, uint32_t us){
+  if(stats.count == 0 || us < stats.minUs){
+    stats.minUs = us;
+  }
+  if(us > stats.maxUs){
+    stats.maxUs = us;
+  }
+  stats.count += 1;
+  stats.totalUs += us;
+}
+
+//Print a value right aligned in a field of the given width.
+static void printField(unsigned long value, uint8_t width){
+  unsigned long digits = 1;
+  for(unsigned long v = value; v >= 10; v /= 10){
+    digits += 1;
+  }
+  for(; digits < width; digits++){
+    Serial.print(' ');
+  }
+  Serial.print(value);
+}
+
+//Print a name left aligned in a field of the given width.
+static void printName(const char* name, uint8_t width){
+  Serial.print(name);
+  for(uint8_t n = strlen(name); n < width; n++){
+    Serial.print(' ');
+  }
+}
+
+//Print one row of statistics.
+static void printStats(const char* name, const ProfileStats& stats){
+  printName(name, 16);
+  printField(stats.count, 10);
+  printField(stats.count > 0 ? (unsigned long)(stats.totalUs/stats.count) : 0, 10);
+  printField(stats.minUs, 10);
+  printField(stats.maxUs, 10);
+  printField((unsigned long)(stats.totalUs/1000), 11);
+  Serial.println();
+}
+
+/* Function:    void Profiler::add(uint8_t section, uint32_t us)
+ *
+ * Purpose:     Count one call of a section.
+ *
+ * Input:       Section, ProfileSection         (uint8_t section)
+ *              Time of the call [us]           (uint32_t us)
+ *
+ * Output:      None
+*/
+void Profiler::add(uint8_t section, uint32_t us){
+  if(section < PROFILE_SECTIONS){
+    addStats(_sections[section], us);
+  }
+}
+
+/* Function:    void Profiler::interval(unsigned long now, unsigned long periodUs)
+ *
+ * Purpose:     Count a wind sample taken now. The first sample after a
+ *              reset only starts the first interval.
+ *
+ * Input:       Time of the sample, micros()    (unsigned long now)
+ *              Intended sample period [us]     (unsigned long periodUs)
+ *
+ * Output:      None
+*/
+void Profiler::interval(unsigned long now, unsigned long periodUs){
+  if(_lastSample != 0){
+    unsigned long length = now - _lastSample;
+    unsigned long deviation = length > periodUs ? length - periodUs : periodUs - length;
+    uint8_t bucket = 0;
+    for(deviation >>= 6; deviation > 0 && bucket < profileBuckets - 1; deviation >>= 1){
+      bucket += 1;
+    }
+    addStats(_intervals, length);
+    _jitter[bucket] += _jitter[bucket] < 0xFFFF ? 1 : 0;
+  }
+  _lastSample = now == 0 ? 1 : now;
+}
+
+/* Function:    void Profiler::reset()
+ *
+ * Purpose:     Clear all statistics.
+ *
+ * Input:       None
+ *
+ * Output:      None
+*/
+void Profiler::reset(){
+  memset(_sections, 0, sizeof(_sections));
+  memset(&_intervals, 0, sizeof(_intervals));
+  memset(_jitter, 0, sizeof(_jitter));
+  _lastSample = 0;
+}
+
+/* Function:    void Profiler::report()
+ *
+ * Purpose:     Print the statistics as a table on the serial port.
+ *              Sections that were never entered are left out.
+ *
+ * Input:       None
+ *
+ * Output:      None
+*/
+void Profiler::report(){
+  Serial.println(F("section              calls  mean[us]   min[us]   max[us]  total[ms]"));
+  for(uint8_t i = 0; i < PROFILE_SECTIONS; i++){
+    if(_sections[i].count > 0){
+      printStats(sectionNames[i], _sections[i]);
+    }
+  }
+  printStats("sample interval", _intervals);
+  Serial.println(F("jitter |interval - period| [us], intervals per bucket"));
+  unsigned long limit = 64;
+  for(uint8_t b = 0; b < profileBuckets; b++){
+    Serial.print(b < profileBuckets - 1 ? "  <" : "  >=");
+    Serial.print(b < profileBuckets - 1 ? limit : limit/2);
+    Serial.print(": ");
+    Serial.println((unsigned int)_jitter[b]);
+    limit *= 2;
+  }
+}
+
+/* Function:    const ProfileStats& Profiler::stats(uint8_t section)
+ *
+ * Purpose:     The statistics of one section.
+ *
+ * Input:       Section, ProfileSection         (uint8_t section)
+ *
+ * Output:      Calls and times of the section.
+*/
+const ProfileStats& Profiler::stats(uint8_t section){
+  return _sections[section < PROFILE_SECTIONS ? section : 0];
+}
+
+/* Function:    const ProfileStats& Profiler::intervals()
+ *
+ * Purpose:     The statistics of the intervals between samples.
+ *
+ * Input:       None
+ *
+ * Output:      Number and length of the intervals.
+*/
+const ProfileStats& Profiler::intervals(){
+  return _intervals;
+}
+
+/* Function:    uint16_t Profiler::jitter(uint8_t bucket)
+ *
+ * Purpose:     One bucket of the jitter histogram.
+ *
+ * Input:       Bucket, 0 to profileBuckets - 1 (uint8_t bucket)
+ *
+ * Output:      Number of intervals in the bucket.
+*/
+uint16_t Profiler::jitter(uint8_t bucket){
+  return bucket < profileBuckets ? _jitter[bucket] : 0;
+}
+
+#endif
@@ -0,0 +1,165 @@
+/* Filename:      Profiler.h
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Timing instrumentation that can be compiled out. Scoped timers
+ *    built on micros() count the calls and the time of every section:
+ *    the phases of a scan, the FS5 reads, the velocity conversion and
+ *    the parts of loop(). The intervals between wind samples are
+ *    collected with their min, max and mean and a histogram of the
+ *    deviation from the sample period.
+ *
+ *      PROFILE_SCOPE(PROFILE_VELOCITY);            //Times the enclosing block.
+ *      PROFILE_INTERVAL(micros(), 100000);         //One sample taken.
+ *      Profiler::report();                          //Table on the serial port.
+ *
+ *    The host build runs the same code on the simulated clock, so a
+ *    profile from the target and from the simulation can be compared,
+ *    see host/bench/profileBench.cpp.
+ *
+ * Notes:
+ *    - Set FLAGPOLE_PROFILE to 1 below, or on the compiler command line,
+ *      to enable. With 0 the macros are empty and Profiler.cpp compiles
+ *      to nothing.
+ *    - Enabled, the statistics use 348 bytes of RAM on the ATmega328 and
+ *      a scope costs two calls to micros() and an update, under 10 us.
+ *    - Times include nested sections, e.g. PROFILE_VELOCITY includes
+ *      the PROFILE_FS5_READ inside it.
+ */
+
+#ifndef Profiler_h        //Include guard.
+#define Profiler_h
+#include "Arduino.h"
+
+#ifndef FLAGPOLE_PROFILE
+#define FLAGPOLE_PROFILE 0
+#endif
+
+//Timed sections. The scan phases come first, in the order of ScanPhase.
+enum ProfileSection {
+  PROFILE_PHASE = 0,          //Control::tick() in phase PROFILE_PHASE + ScanPhase.
+  PROFILE_FS5_READ = 10,      //FS5sensor::voltage() and readRaw().
+  PROFILE_VELOCITY,           //FS5sensor::velocity().
+  PROFILE_MEDIAN,             //Window update and median in loop().
+  PROFILE_REPORT,             //Report of a decision in loop().
+  PROFILE_SEQUENCE,           //Measuring sequence of loop().
+  PROFILE_SECTIONS
+};
+
+//Calls and time of one section.
+struct ProfileStats {
+  uint32_t count;             //Number of calls.
+  uint64_t totalUs;           //Sum of the times [us].
+  uint32_t minUs;             //Shortest time [us].
+  uint32_t maxUs;             //Longest time [us].
+};
+
+//Buckets of the jitter histogram. Bucket 0 holds deviations below 64 us,
+//bucket b those below 64*2^b us, the last one the rest.
+const uint8_t profileBuckets = 12;
+
+//Class for collecting and reporting the timing statistics.
+class Profiler {
+  public:
+    /* Function:    void Profiler::add(uint8_t section, uint32_t us)
+     * Purpose:     Count one call of a section.
+     *
+     * Input:       Section, ProfileSection         (uint8_t section)
+     *              Time of the call [us]           (uint32_t us)
+     *
+     * Output:      None
+    */
+    static void add(uint8_t section, uint32_t us);
+
+    /* Function:    void Profiler::interval(unsigned long now, unsigned long periodUs)
+     * Purpose:     Count a wind sample taken now. The time since the
+     *              previous sample goes into the interval statistics and
+     *              its deviation from the period into the histogram.
+     *
+     * Input:       Time of the sample, micros()    (unsigned long now)
+     *              Intended sample period [us]     (unsigned long periodUs)
+     *
+     * Output:      None
+    */
+    static void interval(unsigned long now, unsigned long periodUs);
+
+    /* Function:    void Profiler::reset()
+     * Purpose:     Clear all statistics.
+     *
+     * Input:       None
+     *
+     * Output:      None
+    */
+    static void reset();
+
+    /* Function:    void Profiler::report()
+     * Purpose:     Print the statistics as a table on the serial port.
+     *
+     * Input:       None
+     *
+     * Output:      None
+    */
+    static void report();
+
+    /* Function:    const ProfileStats& Profiler::stats(uint8_t section)
+     * Purpose:     The statistics of one section.
+     *
+     * Input:       Section, ProfileSection         (uint8_t section)
+     *
+     * Output:      Calls and times of the section.
+    */
+    static const ProfileStats& stats(uint8_t section);
+
+    /* Function:    const ProfileStats& Profiler::intervals()
+     * Purpose:     The statistics of the intervals between samples.
+     *
+     * Input:       None
+     *
+     * Output:      Number and length of the intervals.
+    */
+    static const ProfileStats& intervals();
+
+    /* Function:    uint16_t Profiler::jitter(uint8_t bucket)
+     * Purpose:     One bucket of the jitter histogram.
+     *
+     * Input:       Bucket, 0 to profileBuckets - 1 (uint8_t bucket)
+     *
+     * Output:      Number of intervals in the bucket.
+    */
+    static uint16_t jitter(uint8_t bucket);
+
+  private:
+    static ProfileStats _sections[PROFILE_SECTIONS];
+    static ProfileStats _intervals;
+    static uint16_t _jitter[profileBuckets];
+    static unsigned long _lastSample;
+};
+
+//Class timing the block it is declared in.
+class ProfileScope {
+  public:
+    ProfileScope(uint8_t section){
+      _section = section;
+      _start = micros();
+    }
+    ~ProfileScope(){
+      Profiler::add(_section, micros() - _start);
+    }
+
+  private:
+    uint8_t _section;
+    unsigned long _start;
+};
+
+#if FLAGPOLE_PROFILE
+#define PROFILE_SCOPE(section) ProfileScope profileScope(section)
+#define PROFILE_INTERVAL(now, periodUs) Profiler::interval(now, periodUs)
+#else
+#define PROFILE_SCOPE(section) do {} while (0)
+#define PROFILE_INTERVAL(now, periodUs) do {} while (0)
+#endif
+#endif
@@ -0,0 +1,110 @@
+/* Filename:      RingBuffer.h
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Lock-free ring buffer for one producer and one consumer, e.g. an
+ *    interrupt service routine filling it and loop() emptying it.
+ *
+ *    The producer only writes the head index and the consumer only
+ *    writes the tail index. An element is written before the head is
+ *    advanced past it and read before the tail is advanced past it, so
+ *    neither side has to disable interrupts.
+ *
+ * Notes:
+ *    - N must be a power of two and at most 128. The indices run freely
+ *      and are masked on access, so all N slots are used.
+ *    - The indices are single bytes, which the ATmega328 loads and stores
+ *      atomically. The __atomic builtins only add the ordering needed
+ *      when producer and consumer run on different cores, as in the
+ *      host build.
+ */
+
+#ifndef RingBuffer_h      //Include guard.
+#define RingBuffer_h
+#include "Arduino.h"
+
+//Class for a single producer, single consumer queue of N elements of type T.
+template<typename T, uint8_t N>
+class RingBuffer {
+  static_assert(N > 0 && N <= 128 && (N & (N - 1)) == 0, "N must be a power of two, at most 128");
+
+  public:
+    /* Constructor: RingBuffer()
+     * Purpose:     Setup for the class RingBuffer with an empty queue.
+     *
+     * Input:       None
+     *
+     * Output:      None
+    */
+    RingBuffer(){
+      _head = 0;
+      _tail = 0;
+    }
+
+    /* Function:    bool RingBuffer::push(T value)
+     * Purpose:     Add an element. Producer side only.
+     *
+     * Input:       New element                   (T value)
+     *
+     * Output:      False if the queue was full and the element dropped.
+    */
+    bool push(T value){
+      uint8_t head = _head;
+      if ((uint8_t)(head - __atomic_load_n(&_tail, __ATOMIC_ACQUIRE)) == N){
+        return false;
+      }
+      _data[head & (N - 1)] = value;
+      __atomic_store_n(&_head, (uint8_t)(head + 1), __ATOMIC_RELEASE);
+      return true;
+    }
+
+    /* Function:    bool RingBuffer::pop(T& value)
+     * Purpose:     Take the oldest element. Consumer side only.
+     *
+     * Input:       Where to store the element    (T& value)
+     *
+     * Output:      False if the queue was empty.
+    */
+    bool pop(T& value){
+      uint8_t tail = _tail;
+      if (__atomic_load_n(&_head, __ATOMIC_ACQUIRE) == tail){
+        return false;
+      }
+      value = _data[tail & (N - 1)];
+      __atomic_store_n(&_tail, (uint8_t)(tail + 1), __ATOMIC_RELEASE);
+      return true;
+    }
+
+    /* Function:    uint8_t RingBuffer::count()
+     * Purpose:     Number of elements waiting. Exact on the consumer side,
+     *              a lower bound on the producer side.
+     *
+     * Input:       None
+     *
+     * Output:      Number of elements in the queue.
+    */
+    uint8_t count() const {
+      return (uint8_t)(__atomic_load_n(&_head, __ATOMIC_ACQUIRE) - __atomic_load_n(&_tail, __ATOMIC_ACQUIRE));
+    }
+
+    /* Function:    void RingBuffer::clear()
+     * Purpose:     Drop all elements. Consumer side only.
+     *
+     * Input:       None
+     *
+     * Output:      None
+    */
+    void clear(){
+      __atomic_store_n(&_tail, __atomic_load_n(&_head, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+    }
+
+  private:
+    T _data[N];           //Elements, indexed by the masked indices.
+    uint8_t _head;        //Next slot to write, written by the producer.
+    uint8_t _tail;        //Next slot to read, written by the consumer.
+};
+#endif
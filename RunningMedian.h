@@ -0,0 +1,227 @@
+/* Filename:      RunningMedian.h
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Sliding window median. Keeps the last N samples and updates the
+ *    median in place for every new sample, so a new wind decision is
+ *    available after each measurement instead of after sorting a full
+ *    array.
+ *
+ *    The samples are split over two heaps: a max-heap with the lower
+ *    half and a min-heap with the upper half of the window. The median
+ *    is found at the top of the heaps. When the window is full the
+ *    oldest sample is overwritten by the new one inside its heap and
+ *    the heaps are repaired, which costs O(log N) per sample.
+ *
+ * Notes:
+ *    - All storage is fixed at compile time, no heap allocation. A window
+ *      of 11 doubles uses 71 bytes of RAM on the ATmega328.
+ *    - N can be at most 255.
+ */
+
+#ifndef RunningMedian_h   //Include guard.
+#define RunningMedian_h
+#include "Arduino.h"
+
+//Class for the median of the last N samples of type T.
+template<typename T, uint8_t N>
+class RunningMedian {
+  public:
+    /* Constructor: RunningMedian()
+     * Purpose:     Setup for the class RunningMedian with an empty window.
+     *
+     * Input:       None
+     *
+     * Output:      None
+    */
+    RunningMedian(){
+      clear();
+    }
+
+    /* Function:    void RunningMedian::clear()
+     * Purpose:     Empty the window.
+     *
+     * Input:       None
+     *
+     * Output:      None
+    */
+    void clear(){
+      _count = 0;
+      _next = 0;
+      _loCount = 0;
+      _hiCount = 0;
+    }
+
+    /* Function:    void RunningMedian::add(T value)
+     * Purpose:     Add a sample to the window. When the window is full the
+     *              oldest sample is dropped.
+     *
+     * Input:       New sample                    (T value)
+     *
+     * Output:      None
+    */
+    void add(T value){
+      uint8_t slot = _next;
+      _next = (_next + 1 == N) ? 0 : _next + 1;
+
+      //Window full: overwrite the oldest sample inside its own heap.
+      if (_count == N){
+        _data[slot] = value;
+        uint8_t p = _pos[slot];
+        if (p & hiFlag){
+          p = siftUp(_hi, p & ~hiFlag, false);
+          siftDown(_hi, _hiCount, p, false);
+        }
+        else {
+          p = siftUp(_lo, p, true);
+          siftDown(_lo, _loCount, p, true);
+        }
+
+        //At most one sample is on the wrong side, swap the two tops.
+        if (_hiCount > 0 && _data[_hi[0]] < _data[_lo[0]]){
+          uint8_t loTop = _lo[0];
+          _lo[0] = _hi[0];
+          _hi[0] = loTop;
+          _pos[_lo[0]] = 0;
+          _pos[_hi[0]] = hiFlag;
+          siftDown(_lo, _loCount, 0, true);
+          siftDown(_hi, _hiCount, 0, false);
+        }
+        return;
+      }
+
+      //Window filling up: push into the matching half, then rebalance so
+      //the lower half holds the extra sample.
+      _data[slot] = value;
+      _count++;
+      if (_loCount == 0 || !(_data[_lo[0]] < value)){
+        push(_lo, _loCount, slot, true);
+      }
+      else {
+        push(_hi, _hiCount, slot, false);
+      }
+      if (_loCount > _hiCount + 1){
+        push(_hi, _hiCount, pop(_lo, _loCount, true), false);
+      }
+      else if (_hiCount > _loCount){
+        push(_lo, _loCount, pop(_hi, _hiCount, false), true);
+      }
+    }
+
+    /* Function:    T RunningMedian::median()
+     * Purpose:     The median of the samples in the window. For an even
+     *              number of samples, the mean of the two middle samples.
+     *
+     * Input:       None
+     *
+     * Output:      Median of the window, 0 if empty.
+    */
+    T median() const {
+      if (_count == 0){
+        return 0;
+      }
+      if (_loCount > _hiCount){
+        return _data[_lo[0]];
+      }
+      return (_data[_lo[0]] + _data[_hi[0]])/2;
+    }
+
+    /* Function:    uint8_t RunningMedian::count()
+     * Purpose:     Number of samples in the window.
+     *
+     * Input:       None
+     *
+     * Output:      Number of samples, at most N.
+    */
+    uint8_t count() const {
+      return _count;
+    }
+
+    /* Function:    bool RunningMedian::full()
+     * Purpose:     Check if the window holds N samples.
+     *
+     * Input:       None
+     *
+     * Output:      True if the window is full.
+    */
+    bool full() const {
+      return _count == N;
+    }
+
+  private:
+    static const uint8_t hiFlag = 0x80;   //Marks a position in _hi.
+
+    //Orders slot a before slot b in the lower (max) or upper (min) heap.
+    bool before(uint8_t a, uint8_t b, bool lo) const {
+      return lo ? _data[b] < _data[a] : _data[a] < _data[b];
+    }
+
+    void place(uint8_t heap[], uint8_t i, uint8_t slot, bool lo){
+      heap[i] = slot;
+      _pos[slot] = lo ? i : (i | hiFlag);
+    }
+
+    uint8_t siftUp(uint8_t heap[], uint8_t i, bool lo){
+      uint8_t slot = heap[i];
+      while (i > 0){
+        uint8_t parent = (i - 1)/2;
+        if (!before(slot, heap[parent], lo)){
+          break;
+        }
+        place(heap, i, heap[parent], lo);
+        i = parent;
+      }
+      place(heap, i, slot, lo);
+      return i;
+    }
+
+    void siftDown(uint8_t heap[], uint8_t size, uint8_t i, bool lo){
+      uint8_t slot = heap[i];
+      while (true){
+        uint16_t child = 2*(uint16_t)i + 1;
+        if (child >= size){
+          break;
+        }
+        if (child + 1 < size && before(heap[child + 1], heap[child], lo)){
+          child++;
+        }
+        if (!before(heap[child], slot, lo)){
+          break;
+        }
+        place(heap, i, heap[child], lo);
+        i = child;
+      }
+      place(heap, i, slot, lo);
+    }
+
+    void push(uint8_t heap[], uint8_t& size, uint8_t slot, bool lo){
+      place(heap, size, slot, lo);
+      siftUp(heap, size, lo);
+      size++;
+    }
+
+    uint8_t pop(uint8_t heap[], uint8_t& size, bool lo){
+      uint8_t top = heap[0];
+      size--;
+      if (size > 0){
+        place(heap, 0, heap[size], lo);
+        siftDown(heap, size, 0, lo);
+      }
+      return top;
+    }
+
+    T _data[N];                   //Samples, in arrival order (ring).
+    uint8_t _pos[N];              //Heap position of each sample.
+    uint8_t _lo[N/2 + 1];         //Max-heap with the lower half.
+    uint8_t _hi[N/2 + 1];         //Min-heap with the upper half.
+    uint8_t _count;               //Number of samples in the window.
+    uint8_t _next;                //Slot for the next sample.
+    uint8_t _loCount;             //Number of samples in _lo.
+    uint8_t _hiCount;             //Number of samples in _hi.
+};
+
+#endif
@@ -0,0 +1,175 @@
+/* Filename:      Storage.cpp
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Library for keeping the state in EEPROM over a reset, see
+ *    Storage.h.
+ */
+
+//Include libraries.
+#include "Arduino.h"
+#include "Storage.h"
+#include "Crc16.h"
+#include <EEPROM.h>
+
+//Store a 16 or 32 bit value, low byte first.
+static void put16(uint8_t* p, uint16_t value){
+  p[0] = (uint8_t)value;
+  p[1] = (uint8_t)(value >> 8);
+}
+
+static void putFloat(uint8_t* p, float value){
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  put16(p, (uint16_t)bits);
+  put16(p + 2, (uint16_t)(bits >> 16));
+}
+
+//Load a 16 or 32 bit value, low byte first.
+static uint16_t get16(const uint8_t* p){
+  return (uint16_t)(p[0] | ((uint16_t)p[1] << 8));
+}
+
+static float getFloat(const uint8_t* p){
+  uint32_t bits = get16(p) | ((uint32_t)get16(p + 2) << 16);
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+/* Constructor: Storage::Storage(int address, uint8_t slots)
+ *
+ * Purpose:     Setup for the class Storage. Declaring private variables.
+ *              Until load() has run, the first save goes to slot 0.
+ *
+ * Input:       EEPROM address of the first slot    (int address)
+ *              Number of slots of storageSlotSize bytes
+ *                                                  (uint8_t slots)
+ *
+ * Output:      None
+*/
+Storage::Storage(int address, uint8_t slots){
+  _address = address;
+  _slots = slots > 0 ? slots : 1;
+  _slot = _slots - 1;
+  _sequence = 0xFFFF;
+}
+
+/* Function:    bool Storage::load(StoredState& state)
+ *
+ * Purpose:     Read every slot and keep the valid record with the
+ *              highest sequence number. The sequence numbers wrap, a
+ *              record is newer if it is less than 32768 ahead.
+ *
+ * Input:       State to fill                       (StoredState& state)
+ *
+ * Output:      True if a valid record was found.
+*/
+bool Storage::load(StoredState& state){
+  bool found = false;
+  uint8_t record[storageRecordSize];
+  for(uint8_t s = 0; s < _slots; s++){
+    for(uint8_t i = 0; i < storageRecordSize; i++){
+      record[i] = EEPROM.read(_address + s*storageSlotSize + i);
+    }
+    StoredState candidate;
+    uint16_t sequence;
+    if(decode(record, candidate, sequence) && (!found || (int16_t)(sequence - _sequence) > 0)){
+      found = true;
+      state = candidate;
+      _sequence = sequence;
+      _slot = s;
+    }
+  }
+  return found;
+}
+
+/* Function:    void Storage::save(const StoredState& state)
+ *
+ * Purpose:     Write the state as a new record to the slot after the
+ *              newest one. Unchanged bytes are not written again.
+ *
+ * Input:       State to save                       (const StoredState& state)
+ *
+ * Output:      None
+*/
+void Storage::save(const StoredState& state){
+  uint8_t record[storageRecordSize];
+  _sequence += 1;
+  _slot = _slot + 1 < _slots ? _slot + 1 : 0;
+  encode(state, _sequence, record);
+  for(uint8_t i = 0; i < storageRecordSize; i++){
+    EEPROM.update(_address + _slot*storageSlotSize + i, record[i]);
+  }
+}
+
+/* Function:    void Storage::erase()
+ *
+ * Purpose:     Invalidate all records by clearing their version byte.
+ *
+ * Input:       None
+ *
+ * Output:      None
+*/
+void Storage::erase(){
+  for(uint8_t s = 0; s < _slots; s++){
+    EEPROM.update(_address + s*storageSlotSize, 0xFF);
+  }
+  _slot = _slots - 1;
+  _sequence = 0xFFFF;
+}
+
+/* Function:    void Storage::encode(const StoredState& state, uint16_t sequence, uint8_t* record)
+ *
+ * Purpose:     Pack a state into a record with version and CRC, see the
+ *              layout in Storage.h.
+ *
+ * Input:       State                               (const StoredState& state)
+ *              Sequence number                     (uint16_t sequence)
+ *              Buffer of storageRecordSize bytes   (uint8_t* record)
+ *
+ * Output:      None
+*/
+void Storage::encode(const StoredState& state, uint16_t sequence, uint8_t* record){
+  record[0] = storageVersion;
+  put16(record + 1, sequence);
+  put16(record + 3, (uint16_t)state.heading);
+  put16(record + 5, (uint16_t)state.span);
+  record[7] = state.flags;
+  putFloat(record + 8, state.U0);
+  putFloat(record + 12, state.U50);
+  putFloat(record + 16, state.v50);
+  putFloat(record + 20, state.n);
+  putFloat(record + 24, state.k);
+  put16(record + 28, crc16(record, 28));
+}
+
+/* Function:    bool Storage::decode(const uint8_t* record, StoredState& state, uint16_t& sequence)
+ *
+ * Purpose:     Check the version and CRC of a record and unpack it.
+ *
+ * Input:       Record of storageRecordSize bytes   (const uint8_t* record)
+ *              State to fill                       (StoredState& state)
+ *              Sequence number of the record       (uint16_t& sequence)
+ *
+ * Output:      True if the record is valid.
+*/
+bool Storage::decode(const uint8_t* record, StoredState& state, uint16_t& sequence){
+  if(record[0] != storageVersion || get16(record + 28) != crc16(record, 28)){
+    return false;
+  }
+  sequence = get16(record + 1);
+  state.heading = (int16_t)get16(record + 3);
+  state.span = (int16_t)get16(record + 5);
+  state.flags = record[7];
+  state.U0 = getFloat(record + 8);
+  state.U50 = getFloat(record + 12);
+  state.v50 = getFloat(record + 16);
+  state.n = getFloat(record + 20);
+  state.k = getFloat(record + 24);
+  return true;
+}
@@ -0,0 +1,146 @@
+/* Filename:      Storage.h
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Header for Storage library.
+ *
+ *    Keeps the state needed for a fast start after a reset in EEPROM:
+ *    the heading of the sensor, the heading of the far limit switch and
+ *    the FS5 calibration. Every save writes a whole record to the next
+ *    of a ring of slots, so the writes are spread over the slots, and
+ *    load() takes the valid record with the highest sequence number.
+ *    A record is 30 bytes, little endian, in a slot of 32 bytes:
+ *
+ *      0      version, storageVersion
+ *      1-2    sequence number
+ *      3-4    heading [steps from the start position]
+ *      5-6    heading of the far limit switch [steps]
+ *      7      flags, STORED_HOMED
+ *      8-27   U0, U50, v50, n, k as 32 bit floats
+ *      28-29  CRC-16/CCITT-FALSE of bytes 0-27, see Crc16.h
+ *
+ *    A record with another version or a bad CRC is skipped. A reset
+ *    during a save leaves the torn slot invalid and the previous record
+ *    is loaded.
+ *
+ * Notes:
+ *    - The default 32 slots fill the 1 KB EEPROM of the ATmega328.
+ *    - A byte takes 3.3 ms to write and only changed bytes are written,
+ *      usually the sequence number, the heading and the CRC.
+ *    - The EEPROM endures about 100 000 writes per byte. Control saves
+ *      at most once a minute, see Control::useStorage(), which with 32
+ *      slots lasts more than 6 years.
+ *    - Change storageVersion when the layout changes.
+ */
+
+#ifndef Storage_h         //Include guard.
+#define Storage_h
+#include "Arduino.h"
+
+//Version of the record layout.
+const uint8_t storageVersion = 1;
+
+//Size of a record and of a slot [bytes].
+const uint8_t storageRecordSize = 30;
+const uint8_t storageSlotSize = 32;
+
+//Flags of a stored state.
+enum StoredFlags {
+  STORED_HOMED = 1            //The heading is counted from the start position.
+};
+
+//State kept over a reset.
+struct StoredState {
+  int16_t heading;            //Steps ccw from the start position.
+  int16_t span;               //Heading of the far limit switch, 0 if unknown.
+  uint8_t flags;              //StoredFlags.
+  float U0;                   //FS5 voltage at wind speed 0% [V].
+  float U50;                  //FS5 voltage at wind speed 50% [V].
+  float v50;                  //Wind velocity at wind speed 50% [m/s].
+  float n;                    //FS5 exponent n.
+  float k;                    //FS5 fluidic dependent constant k.
+};
+
+//Class for saving and loading the state in a ring of EEPROM slots.
+class Storage {
+  public:
+    /* Constructor: Storage::Storage(int address, uint8_t slots)
+     *
+     * Purpose:     Setup for the class Storage. Declaring private
+     *              variables.
+     *
+     * Input:       EEPROM address of the first slot    (int address)
+     *              Number of slots of storageSlotSize bytes
+     *                                                  (uint8_t slots)
+     *
+     * Output:      None
+    */
+    Storage(int address = 0, uint8_t slots = 32);
+
+    /* Function:    bool Storage::load(StoredState& state)
+     *
+     * Purpose:     Find the newest valid record. The following save()
+     *              writes to the slot after it.
+     *
+     * Input:       State to fill                       (StoredState& state)
+     *
+     * Output:      True if a valid record was found.
+    */
+    bool load(StoredState& state);
+
+    /* Function:    void Storage::save(const StoredState& state)
+     *
+     * Purpose:     Write the state as a new record to the next slot.
+     *              Blocks while the changed bytes are written.
+     *
+     * Input:       State to save                       (const StoredState& state)
+     *
+     * Output:      None
+    */
+    void save(const StoredState& state);
+
+    /* Function:    void Storage::erase()
+     *
+     * Purpose:     Invalidate all records.
+     *
+     * Input:       None
+     *
+     * Output:      None
+    */
+    void erase();
+
+    /* Function:    static void Storage::encode(const StoredState& state, uint16_t sequence, uint8_t* record)
+     *
+     * Purpose:     Pack a state into a record with version and CRC.
+     *
+     * Input:       State                               (const StoredState& state)
+     *              Sequence number                     (uint16_t sequence)
+     *              Buffer of storageRecordSize bytes   (uint8_t* record)
+     *
+     * Output:      None
+    */
+    static void encode(const StoredState& state, uint16_t sequence, uint8_t* record);
+
+    /* Function:    static bool Storage::decode(const uint8_t* record, StoredState& state, uint16_t& sequence)
+     *
+     * Purpose:     Check the version and CRC of a record and unpack it.
+     *
+     * Input:       Record of storageRecordSize bytes   (const uint8_t* record)
+     *              State to fill                       (StoredState& state)
+     *              Sequence number of the record       (uint16_t& sequence)
+     *
+     * Output:      True if the record is valid.
+    */
+    static bool decode(const uint8_t* record, StoredState& state, uint16_t& sequence);
+
+  private:
+    int _address;               //Address of the first slot.
+    uint8_t _slots;             //Number of slots.
+    uint8_t _slot;              //Slot of the newest record.
+    uint16_t _sequence;         //Sequence number of the newest record.
+};
+#endif
@@ -0,0 +1,206 @@
+/* Filename:      Telemetry.cpp
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Library for the binary telemetry records, see Telemetry.h.
+ *
+ * Notes:
+ *    - A frame takes 2 ms to send at 115200 baud.
+ */
+
+//Include libraries.
+#include "Arduino.h"
+#include "Telemetry.h"
+#include "Crc16.h"
+
+//Store a 16 or 32 bit value, low byte first.
+static void put16(uint8_t* p, uint16_t value){
+  p[0] = (uint8_t)value;
+  p[1] = (uint8_t)(value >> 8);
+}
+
+static void put32(uint8_t* p, uint32_t value){
+  put16(p, (uint16_t)value);
+  put16(p + 2, (uint16_t)(value >> 16));
+}
+
+//Load a 16 or 32 bit value, low byte first.
+static uint16_t get16(const uint8_t* p){
+  return (uint16_t)(p[0] | ((uint16_t)p[1] << 8));
+}
+
+static uint32_t get32(const uint8_t* p){
+  return get16(p) | ((uint32_t)get16(p + 2) << 16);
+}
+
+/* Constructor: Telemetry::Telemetry()
+ *
+ * Purpose:     Setup for the class Telemetry. The sequence starts at 0.
+ *
+ * Input:       None
+ *
+ * Output:      None
+*/
+Telemetry::Telemetry(){
+  _sequence = 0;
+}
+
+/* Function:    void Telemetry::begin(unsigned long baud)
+ *
+ * Purpose:     Start the serial port and send the HELLO record with the
+ *              version of the record layout.
+ *
+ * Input:       Baud rate                       (unsigned long baud)
+ *
+ * Output:      None
+*/
+void Telemetry::begin(unsigned long baud){
+  Serial.begin(baud);
+  TelemetryRecord hello = {};
+  hello.type = TELEMETRY_HELLO;
+  hello.timeMs = millis();
+  hello.count = telemetryVersion;
+  send(hello);
+}
+
+/* Function:    void Telemetry::send(TelemetryRecord& record)
+ *
+ * Purpose:     Number the record and write it as a frame. The frame is
+ *              written in one call, so the UART buffer takes it at once
+ *              when there is room.
+ *
+ * Input:       Record to send, the sequence number is set
+ *                                              (TelemetryRecord& record)
+ *
+ * Output:      None
+*/
+void Telemetry::send(TelemetryRecord& record){
+  record.sequence = _sequence;
+  _sequence += 1;
+  uint8_t frame[telemetryFrameSize];
+  uint8_t size = encode(record, frame);
+  Serial.write(frame, size);
+}
+
+/* Function:    uint8_t Telemetry::encode(const TelemetryRecord& record, uint8_t* frame)
+ *
+ * Purpose:     Encode a record as a frame. The record and its CRC are
+ *              COBS encoded: every zero byte is replaced by the distance
+ *              to the next one, and a leading byte holds the distance to
+ *              the first. A zero byte closes the frame.
+ *
+ * Input:       Record to encode                (const TelemetryRecord& record)
+ *              Buffer of telemetryFrameSize bytes (uint8_t* frame)
+ *
+ * Output:      Length of the frame.
+*/
+uint8_t Telemetry::encode(const TelemetryRecord& record, uint8_t* frame){
+  uint8_t raw[telemetryRecordSize + 2];
+  raw[0] = record.type;
+  put16(raw + 1, record.sequence);
+  put32(raw + 3, record.timeMs);
+  put16(raw + 7, record.windSpeed);
+  raw[9] = record.status;
+  put16(raw + 10, (uint16_t)record.heading);
+  raw[12] = record.count;
+  put16(raw + 13, record.minSpeed);
+  put16(raw + 15, record.maxSpeed);
+  put16(raw + 17, record.durationMs);
+  put16(raw + telemetryRecordSize, crc16(raw, telemetryRecordSize));
+
+  //The record is shorter than 254 bytes, so every code fits one byte.
+  uint8_t codeAt = 0;       //Where the code of the current block goes.
+  uint8_t code = 1;         //Distance to the next zero byte.
+  uint8_t size = 1;
+  for(uint8_t i = 0; i < sizeof(raw); i++){
+    if(raw[i] == 0){
+      frame[codeAt] = code;
+      codeAt = size;
+      code = 1;
+    }
+    else{
+      frame[size] = raw[i];
+      code += 1;
+    }
+    size += 1;
+  }
+  frame[codeAt] = code;
+  frame[size] = 0;
+  return size + 1;
+}
+
+/* Function:    bool Telemetry::decode(const uint8_t* frame, uint8_t size, TelemetryRecord& record)
+ *
+ * Purpose:     Decode a frame received up to, not including, its
+ *              closing zero byte. Undo the COBS encoding, check the
+ *              length and the CRC and unpack the record.
+ *
+ * Input:       Received bytes                  (const uint8_t* frame)
+ *              Number of bytes                 (uint8_t size)
+ *              Where to store the record       (TelemetryRecord& record)
+ *
+ * Output:      False if the frame has the wrong length, broken COBS
+ *              encoding or a bad CRC.
+*/
+bool Telemetry::decode(const uint8_t* frame, uint8_t size, TelemetryRecord& record){
+  uint8_t raw[telemetryRecordSize + 2];
+  if(size != sizeof(raw) + 1){
+    return false;
+  }
+
+  uint8_t length = 0;
+  uint8_t i = 0;
+  while(i < size){
+    uint8_t code = frame[i];
+    if(code == 0 || i + code > size){
+      return false;
+    }
+    for(uint8_t k = 1; k < code; k++){
+      raw[length] = frame[i + k];
+      length += 1;
+    }
+    i += code;
+
+    //A code below 0xFF stands for a zero byte, except at the end.
+    if(i < size && code < 0xFF){
+      if(length >= sizeof(raw)){
+        return false;
+      }
+      raw[length] = 0;
+      length += 1;
+    }
+  }
+  if(length != sizeof(raw) || get16(raw + telemetryRecordSize) != crc16(raw, telemetryRecordSize)){
+    return false;
+  }
+
+  record.type = raw[0];
+  record.sequence = get16(raw + 1);
+  record.timeMs = get32(raw + 3);
+  record.windSpeed = get16(raw + 7);
+  record.status = raw[9];
+  record.heading = (int16_t)get16(raw + 10);
+  record.count = raw[12];
+  record.minSpeed = get16(raw + 13);
+  record.maxSpeed = get16(raw + 15);
+  record.durationMs = get16(raw + 17);
+  return true;
+}
+
+/* Function:    uint16_t Telemetry::speed(double velocity)
+ *
+ * Purpose:     Convert a wind velocity to the record unit, limited to
+ *              the range of the field.
+ *
+ * Input:       Wind velocity [m/s]             (double velocity)
+ *
+ * Output:      Wind velocity [cm/s].
+*/
+uint16_t Telemetry::speed(double velocity){
+  double cm = velocity*100 + 0.5;
+  return cm <= 0 ? 0 : (cm >= 65535 ? 65535 : (uint16_t)cm);
+}
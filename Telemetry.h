@@ -0,0 +1,157 @@
+/* Filename:      Telemetry.h
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Compact binary telemetry over the serial port, replacing the JSON
+ *    and text output when the link is the bottleneck.
+ *
+ *    Every record has the same layout of 19 bytes, little endian:
+ *
+ *      offset  size  field
+ *       0      1     type, see TelemetryType
+ *       1      2     sequence number, counts every record sent
+ *       3      4     time [ms], millis()
+ *       7      2     wind speed [cm/s], sample, median or test mean
+ *       9      1     status flags, see TelemetryStatus
+ *      10      2     heading [steps from the start position]
+ *      12      1     number of samples (protocol version for HELLO)
+ *      13      2     lowest sample since the last decision [cm/s]
+ *      15      2     highest sample since the last decision [cm/s]
+ *      17      2     duration [ms], of the scan for SCAN records
+ *
+ *    A CRC-16/CCITT-FALSE of the 19 bytes follows, low byte first, see
+ *    Crc16.h. The 21 bytes are COBS encoded, which removes all zero
+ *    bytes, and a zero byte ends the frame. A frame is 23 bytes, against
+ *    about 100 for one JSON report. A receiver resynchronises at the
+ *    next zero byte and finds lost records from gaps in the sequence
+ *    number.
+ *
+ *    A GUST record follows every DECISION record for each window of
+ *    GustStats.h, with the fields reused: the wind speed is the mean,
+ *    the number of samples the window, GustWindow, the lowest and the
+ *    highest sample the standard deviation and the peak, and the
+ *    duration the percentile [cm/s]. TELEMETRY_FULL is set once the
+ *    window has seen a whole window length.
+ *
+ * Notes:
+ *    - host/tools/telemetryDecode.cpp decodes a recorded stream to JSON
+ *      or CSV.
+ *    - Text printed on the same port between frames, e.g. by Control
+ *      with messages enabled, is dropped by the receiver as bad frames.
+ */
+
+#ifndef Telemetry_h       //Include guard.
+#define Telemetry_h
+#include "Arduino.h"
+
+//Version of the record layout, sent in the HELLO record.
+const uint8_t telemetryVersion = 2;
+
+//Record types.
+enum TelemetryType {
+  TELEMETRY_HELLO = 0,      //Sent once by begin().
+  TELEMETRY_SAMPLE = 1,     //One wind speed sample.
+  TELEMETRY_DECISION = 2,   //Median or test mean and the lower flag status.
+  TELEMETRY_SCAN = 3,       //A scan or tracking cycle has ended.
+  TELEMETRY_GUST = 4        //Statistics of one gust window, see below.
+};
+
+//Status flags.
+enum TelemetryStatus {
+  TELEMETRY_LOWER = 0x01,       //The flag should be lowered.
+  TELEMETRY_FULL = 0x02,        //The window of samples is full.
+  TELEMETRY_TRACKING = 0x04,    //The scan was a tracking cycle.
+  TELEMETRY_SCANNING = 0x08     //The sample was taken during a scan.
+};
+
+//Fields of one record, see the layout above.
+struct TelemetryRecord {
+  uint8_t type;             //Record type, TelemetryType.
+  uint16_t sequence;        //Sequence number, set by Telemetry::send().
+  uint32_t timeMs;          //Time [ms].
+  uint16_t windSpeed;       //Wind speed [cm/s].
+  uint8_t status;           //Status flags, TelemetryStatus.
+  int16_t heading;          //Heading [steps].
+  uint8_t count;            //Number of samples.
+  uint16_t minSpeed;        //Lowest sample [cm/s].
+  uint16_t maxSpeed;        //Highest sample [cm/s].
+  uint16_t durationMs;      //Duration [ms].
+};
+
+//Sizes of a record, with the CRC, and of a whole frame.
+const uint8_t telemetryRecordSize = 19;
+const uint8_t telemetryFrameSize = telemetryRecordSize + 2 + 2;
+
+//Class for sending telemetry records on the serial port.
+class Telemetry {
+  public:
+    /* Constructor: Telemetry::Telemetry()
+     * Purpose:     Setup for the class Telemetry. The sequence starts at 0.
+     *
+     * Input:       None
+     *
+     * Output:      None
+    */
+    Telemetry();
+
+    /* Function:    void Telemetry::begin(unsigned long baud)
+     * Purpose:     Start the serial port and send the HELLO record.
+     *
+     * Input:       Baud rate                       (unsigned long baud)
+     *
+     * Output:      None
+    */
+    void begin(unsigned long baud);
+
+    /* Function:    void Telemetry::send(TelemetryRecord& record)
+     * Purpose:     Number the record and write it as a frame.
+     *
+     * Input:       Record to send, the sequence number is set
+     *                                              (TelemetryRecord& record)
+     *
+     * Output:      None
+    */
+    void send(TelemetryRecord& record);
+
+    /* Function:    uint8_t Telemetry::encode(const TelemetryRecord& record, uint8_t* frame)
+     * Purpose:     Encode a record as a frame, with the CRC, the COBS
+     *              encoding and the closing zero byte.
+     *
+     * Input:       Record to encode                (const TelemetryRecord& record)
+     *              Buffer of telemetryFrameSize bytes (uint8_t* frame)
+     *
+     * Output:      Length of the frame.
+    */
+    static uint8_t encode(const TelemetryRecord& record, uint8_t* frame);
+
+    /* Function:    bool Telemetry::decode(const uint8_t* frame, uint8_t size, TelemetryRecord& record)
+     * Purpose:     Decode a frame received up to, not including, its
+     *              closing zero byte.
+     *
+     * Input:       Received bytes                  (const uint8_t* frame)
+     *              Number of bytes                 (uint8_t size)
+     *              Where to store the record       (TelemetryRecord& record)
+     *
+     * Output:      False if the frame has the wrong length, broken COBS
+     *              encoding or a bad CRC.
+    */
+    static bool decode(const uint8_t* frame, uint8_t size, TelemetryRecord& record);
+
+    /* Function:    uint16_t Telemetry::speed(double velocity)
+     * Purpose:     Convert a wind velocity to the record unit, limited to
+     *              the range of the field.
+     *
+     * Input:       Wind velocity [m/s]             (double velocity)
+     *
+     * Output:      Wind velocity [cm/s].
+    */
+    static uint16_t speed(double velocity);
+
+  private:
+    uint16_t _sequence;     //Sequence number of the next record.
+};
+#endif
@@ -0,0 +1,195 @@
+/* Filename:      WindDecision.cpp
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Library for the sequential lower flag decision, see WindDecision.h.
+ */
+
+//Include libraries.
+#include "Arduino.h"
+#include "WindDecision.h"
+
+/* Constructor: WindDecision::WindDecision(double allowed, double margin, double sigma, double* window, uint16_t* gaps, uint8_t maxSamples)
+ *
+ * Purpose:     Setup for the class WindDecision. Declaring private
+ *              variables, with false lower and missed lower rates of
+ *              1 % and 5 % and no hysteresis.
+ *
+ * Input:       Allowed wind speed [m/s]                (double allowed)
+ *              Half width of the indifference zone
+ *              around the limit [m/s]                  (double margin)
+ *              Spread of the samples [m/s]             (double sigma)
+ *              Window of maxSamples samples            (double* window)
+ *              Time before each sample of the window   (uint16_t* gaps)
+ *              Samples before the test must decide     (uint8_t maxSamples)
+ *
+ * Output:      None
+*/
+WindDecision::WindDecision(double allowed, double margin, double sigma, double* window, uint16_t* gaps, uint8_t maxSamples){
+  _allowed = allowed;
+  _margin = margin;
+  _sigma = sigma;
+  _hysteresis = 0;
+  _window = window;
+  _gaps = gaps;
+  _maxSamples = maxSamples > 0 ? maxSamples : 1;
+  _spanMs = 0;
+  _lastMs = 0;
+  _lowered = false;
+  _lowerSum = 0;
+  _keepSum = 0;
+  _filled = 0;
+  _next = 0;
+  setBounds(0.01, 0.05);
+  restart();
+}
+
+/* Function:    void WindDecision::setBounds(double falseLower, double missedLower)
+ *
+ * Purpose:     Set the bounds of the log-likelihood ratio from the error
+ *              rates the test aims at, Wald's approximation.
+ *
+ * Input:       Probability to lower in a wind margin
+ *              below the limit                         (double falseLower)
+ *              Probability to keep in a wind margin
+ *              above the limit                         (double missedLower)
+ *
+ * Output:      None
+*/
+void WindDecision::setBounds(double falseLower, double missedLower){
+  _lowerBound = log((1 - missedLower)/falseLower);
+  _keepBound = log(missedLower/(1 - falseLower));
+}
+
+/* Function:    void WindDecision::setHysteresis(double hysteresis)
+ *
+ * Purpose:     Set how much lower the limit is after a lower decision.
+ *
+ * Input:       Lowering of the limit [m/s]             (double hysteresis)
+ *
+ * Output:      None
+*/
+void WindDecision::setHysteresis(double hysteresis){
+  _hysteresis = hysteresis;
+}
+
+/* Function:    void WindDecision::setAllowed(double allowed)
+ *
+ * Purpose:     Change the allowed wind speed.
+ *
+ * Input:       Allowed wind speed [m/s]                (double allowed)
+ *
+ * Output:      None
+*/
+void WindDecision::setAllowed(double allowed){
+  _allowed = allowed;
+}
+
+/* Function:    void WindDecision::setSpan(unsigned long spanMs)
+ *
+ * Purpose:     Set the longest time the window covers.
+ *
+ * Input:       Longest time of the window, 0 for
+ *              maxSamples samples at any cadence [ms]  (unsigned long spanMs)
+ *
+ * Output:      None
+*/
+void WindDecision::setSpan(unsigned long spanMs){
+  _spanMs = spanMs;
+}
+
+/* Function:    void WindDecision::restart()
+ *
+ * Purpose:     Start a new test. The last decision is kept for the
+ *              hysteresis, and the evidence towards each decision is
+ *              kept until that decision is made.
+ *
+ * Input:       None
+ *
+ * Output:      None
+*/
+void WindDecision::restart(){
+  _llr = 0;
+  _sum = 0;
+  _count = 0;
+  _verdict = WIND_UNDECIDED;
+}
+
+/* Function:    WindVerdict WindDecision::add(double sample, unsigned long timeMs)
+ *
+ * Purpose:     Add a sample to the log-likelihood ratio and commit when
+ *              the evidence for a decision crosses its bound, or by the
+ *              sign of the ratio after maxSamples. The evidence for
+ *              lower does not drop below 0 and the one for keep not
+ *              above 0, so calm samples before a gust do not delay the
+ *              decision to lower. After a keep it also lowers when the
+ *              mean of the last maxSamples, or of the last span if that
+ *              is shorter, is above the limit, so it is never later than
+ *              a window of that many samples. After a decision the test
+ *              starts over with the sample.
+ *
+ * Input:       Wind speed [m/s]                        (double sample)
+ *              Time of the sample, millis()            (unsigned long timeMs)
+ *
+ * Output:      The decision, WIND_UNDECIDED while more samples are
+ *              needed.
+*/
+WindVerdict WindDecision::add(double sample, unsigned long timeMs){
+  if(_verdict != WIND_UNDECIDED){
+    restart();
+  }
+  double limit = _lowered ? _allowed - _hysteresis : _allowed;
+
+  //Clip spikes to 3 sigma.
+  double deviation = sample - limit;
+  double clip = 3*_sigma;
+  deviation = deviation > clip ? clip : (deviation < -clip ? -clip : deviation);
+  double increment = 2*_margin/(_sigma*_sigma)*deviation;
+  _llr += increment;
+
+  //Clipped samples of the last maxSamples and the time before each, the
+  //first one taken as an even share of the span.
+  unsigned long gap = _filled > 0 ? timeMs - _lastMs : _spanMs/_maxSamples;
+  _lastMs = timeMs;
+  _window[_next] = limit + deviation;
+  _gaps[_next] = gap < 0xFFFF ? gap : 0xFFFF;
+  uint8_t newest = _next;
+  _next = _next + 1 < _maxSamples ? _next + 1 : 0;
+  _filled += _filled < _maxSamples ? 1 : 0;
+
+  //Mean of the samples back to maxSamples or the span, newest first.
+  //The window is full at either one, so after a sparse cadence the old
+  //samples do not hold the mean down once the samples are dense again.
+  double windowSum = 0;
+  unsigned long covered = 0;
+  uint8_t k = 0;
+  for(uint8_t i = newest; k < _filled && (_spanMs == 0 || covered < _spanMs); i = i > 0 ? i - 1 : _maxSamples - 1){
+    windowSum += _window[i];
+    covered += _gaps[i];
+    k++;
+  }
+  bool full = k == _maxSamples || (_spanMs > 0 && covered >= _spanMs);
+  bool above = full && windowSum > limit*k;
+
+  _lowerSum = _lowerSum + increment > 0 ? _lowerSum + increment : 0;
+  _keepSum = _keepSum + increment < 0 ? _keepSum + increment : 0;
+  _sum += sample;
+  _count++;
+
+  if(_lowerSum >= _lowerBound || (above && !_lowered) || (_count >= _maxSamples && _llr > 0)){
+    _verdict = WIND_LOWER;
+    _lowerSum = 0;
+  }
+  else if(_keepSum <= _keepBound || _count >= _maxSamples){
+    _verdict = WIND_KEEP;
+    _keepSum = 0;
+  }
+  if(_verdict != WIND_UNDECIDED){
+    _lowered = _verdict == WIND_LOWER;
+  }
+  return _verdict;
+}
@@ -0,0 +1,243 @@
+/* Filename:      WindDecision.h
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Header for WindDecision library.
+ *
+ *    Decides whether to lower the flag one wind sample at a time with a
+ *    sequential probability ratio test (SPRT), instead of always waiting
+ *    for a full window of samples. The test weighs a mean wind speed
+ *    margin above the limit against margin below it. Every sample adds
+ *
+ *      llr += 2*margin/sigma^2*(sample - limit)
+ *
+ *    to the log-likelihood ratio. The evidence for lower is summed like
+ *    llr but not below 0, and the one for keep not above 0, so calm
+ *    samples before a gust do not delay the decision to lower (CUSUM).
+ *    The test commits to lower when its evidence reaches
+ *    log((1 - missed)/falseLower) and to keep when its evidence reaches
+ *    log(missed/(1 - falseLower)). A wind far above or below the limit
+ *    is thus decided after two or three samples, a wind close to it
+ *    after up to maxSamples, where the test decides by the sign of llr.
+ *    After a keep it also lowers as soon as the mean of the last
+ *    maxSamples is above the limit, so it is never later than a window
+ *    of that many samples. With a span set, the window ends at that
+ *    much time before the latest sample if that comes first, so it
+ *    covers the same time whatever the cadence of the samples.
+ *
+ *    Hysteresis: after a lower decision the limit of the next test is
+ *    the allowed speed less the hysteresis, so the flag is only raised
+ *    again when the wind has clearly dropped.
+ *
+ * Notes:
+ *    - Samples are clipped to 3 sigma from the limit, so a single spike
+ *      of the FS5 cannot decide the test.
+ *    - The bounds assume independent samples. The gusts make following
+ *      samples alike, so the real error rates are higher than the
+ *      configured ones; tune them with fleet_sim in host/.
+ *    - A decided test starts over with the next sample.
+ *    - The window of the last maxSamples is kept by WindDecisionN,
+ *      sized at compile time, 6 bytes per sample on the ATmega328 with
+ *      the time before each.
+ */
+
+#ifndef WindDecision_h    //Include guard.
+#define WindDecision_h
+#include "Arduino.h"
+
+//State of the test.
+enum WindVerdict {
+  WIND_UNDECIDED,       //More samples are needed.
+  WIND_KEEP,            //The wind is in the allowed span.
+  WIND_LOWER            //The wind is too strong, lower the flag.
+};
+
+//Class for the sequential lower flag decision.
+class WindDecision {
+  public:
+    /* Constructor: WindDecision::WindDecision(double allowed, double margin, double sigma, double* window, uint16_t* gaps, uint8_t maxSamples)
+     *
+     * Purpose:     Setup for the class WindDecision, with false lower and
+     *              missed lower rates of 1 % and 5 % and no hysteresis.
+     *              See WindDecisionN for one that keeps its own window.
+     *
+     * Input:       Allowed wind speed [m/s]                (double allowed)
+     *              Half width of the indifference zone
+     *              around the limit [m/s]                  (double margin)
+     *              Spread of the samples [m/s]             (double sigma)
+     *              Window of maxSamples samples            (double* window)
+     *              Time before each sample of the window   (uint16_t* gaps)
+     *              Samples before the test must decide     (uint8_t maxSamples)
+     *
+     * Output:      None
+    */
+    WindDecision(double allowed, double margin, double sigma, double* window, uint16_t* gaps, uint8_t maxSamples);
+
+    /* Function:    void WindDecision::setBounds(double falseLower, double missedLower)
+     *
+     * Purpose:     Set the error rates the test aims at.
+     *
+     * Input:       Probability to lower in a wind margin
+     *              below the limit                         (double falseLower)
+     *              Probability to keep in a wind margin
+     *              above the limit                         (double missedLower)
+     *
+     * Output:      None
+    */
+    void setBounds(double falseLower, double missedLower);
+
+    /* Function:    void WindDecision::setHysteresis(double hysteresis)
+     *
+     * Purpose:     Set how much lower the limit of the test is after a
+     *              lower decision, so the flag is only raised again
+     *              when the wind has clearly dropped.
+     *
+     * Input:       Lowering of the limit [m/s]             (double hysteresis)
+     *
+     * Output:      None
+    */
+    void setHysteresis(double hysteresis);
+
+    /* Function:    void WindDecision::setAllowed(double allowed)
+     *
+     * Purpose:     Change the allowed wind speed. A running test goes on
+     *              against the new limit.
+     *
+     * Input:       Allowed wind speed [m/s]                (double allowed)
+     *
+     * Output:      None
+    */
+    void setAllowed(double allowed);
+
+    /* Function:    void WindDecision::setSpan(unsigned long spanMs)
+     *
+     * Purpose:     Set the longest time the window of the last
+     *              maxSamples covers, so it covers the same time
+     *              whatever the cadence of the samples.
+     *
+     * Input:       Longest time of the window, 0 for
+     *              maxSamples samples at any cadence [ms]  (unsigned long spanMs)
+     *
+     * Output:      None
+    */
+    void setSpan(unsigned long spanMs);
+
+    /* Function:    void WindDecision::restart()
+     *
+     * Purpose:     Start a new test. The last decision is kept for the
+     *              hysteresis.
+     *
+     * Input:       None
+     *
+     * Output:      None
+    */
+    void restart();
+
+    /* Function:    WindVerdict WindDecision::add(double sample, unsigned long timeMs)
+     *
+     * Purpose:     Add a sample to the test. After a decision the test
+     *              starts over with the sample.
+     *
+     * Input:       Wind speed [m/s]                        (double sample)
+     *              Time of the sample, millis()            (unsigned long timeMs)
+     *
+     * Output:      The decision, WIND_UNDECIDED while more samples are
+     *              needed.
+    */
+    WindVerdict add(double sample, unsigned long timeMs);
+
+    /* Function:    WindVerdict WindDecision::verdict()
+     *
+     * Purpose:     The decision of the test.
+     *
+     * Input:       None
+     *
+     * Output:      The decision, WIND_UNDECIDED while the test runs.
+    */
+    WindVerdict verdict() { return _verdict; }
+
+    /* Function:    bool WindDecision::lowered()
+     *
+     * Purpose:     Whether the last decision was to lower, which sets
+     *              the limit less the hysteresis.
+     *
+     * Input:       None
+     *
+     * Output:      True if the last decision was to lower.
+    */
+    bool lowered() { return _lowered; }
+
+    /* Function:    double WindDecision::mean()
+     *
+     * Purpose:     The mean wind speed of the samples of the test, to
+     *              report with a decision.
+     *
+     * Input:       None
+     *
+     * Output:      Mean of the samples [m/s], 0 before the first one.
+    */
+    double mean() { return _count > 0 ? _sum/_count : 0; }
+
+    /* Function:    uint8_t WindDecision::count()
+     *
+     * Purpose:     The number of samples in the test.
+     *
+     * Input:       None
+     *
+     * Output:      Samples since the test started.
+    */
+    uint8_t count() { return _count; }
+
+    /* Function:    double WindDecision::evidence()
+     *
+     * Purpose:     The log-likelihood ratio of lower against keep.
+     *
+     * Input:       None
+     *
+     * Output:      The ratio, positive towards lower and negative
+     *              towards keep.
+    */
+    double evidence() { return _llr; }
+
+  private:
+    double _allowed;                //Allowed wind speed [m/s].
+    double _margin;                 //Half width of the indifference zone [m/s].
+    double _sigma;                  //Spread of the samples [m/s].
+    double _hysteresis;             //Limit less this after a lower [m/s].
+    double _lowerBound;             //llr to commit to lower.
+    double _keepBound;              //llr to commit to keep, negative.
+    uint8_t _maxSamples;            //Samples before a forced decision.
+    unsigned long _spanMs;          //Longest time of the window [ms], 0 for none.
+
+    double _llr;                    //Log-likelihood ratio of the test.
+    double _lowerSum;               //Evidence for lower, at least 0.
+    double _keepSum;                //Evidence for keep, at most 0.
+    double* _window;                //Clipped samples of the last maxSamples.
+    uint16_t* _gaps;                //Time before each sample of the window [ms].
+    unsigned long _lastMs;          //Time of the last sample [ms].
+    uint8_t _filled;                //Samples in the window.
+    uint8_t _next;                  //Next slot of the window.
+    double _sum;                    //Sum of the samples.
+    uint8_t _count;                 //Samples in the test.
+    WindVerdict _verdict;           //Decision of the test.
+    bool _lowered;                  //Last decision was to lower.
+};
+
+//The sequential decision with a window of W samples, at most W samples
+//before the test must decide.
+template <uint8_t W>
+class WindDecisionN : public WindDecision {
+  public:
+    WindDecisionN(double allowed, double margin, double sigma)
+      : WindDecision(allowed, margin, sigma, _samples, _sampleGaps, W){
+    }
+
+  private:
+    double _samples[W];             //Window of the test.
+    uint16_t _sampleGaps[W];        //Time before each sample [ms].
+};
+#endif
@@ -0,0 +1,225 @@
+/* Filename:      FS5Batch.cpp
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Batch conversion of FS5 voltages and ADC codes, see FS5Batch.h.
+ */
+
+#include "FS5Batch.h"
+#include <math.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FS5_BATCH_X86 1
+#else
+#define FS5_BATCH_X86 0
+#endif
+
+//Same mapping from ADC code to voltage as FS5sensor.
+static const double codeScale = 1023;
+static const double maxInputVoltage = 5;
+
+//log2(m) = t*(c1 + c3 t^2 + c5 t^4 + ...) with t = (m - 1)/(m + 1), the
+//series of 2 atanh(t)/ln 2. For m in [sqrt(1/2), sqrt(2)) |t| < 0.172,
+//and the next term is below 1e-9.
+static const float log2C1 = 2.885390082f;     //2/ln 2
+static const float log2C3 = 0.961796694f;     //2/(3 ln 2)
+static const float log2C5 = 0.577078016f;     //2/(5 ln 2)
+static const float log2C7 = 0.412198583f;     //2/(7 ln 2)
+static const float log2C9 = 0.320598898f;     //2/(9 ln 2)
+static const float sqrt2 = 1.414213562f;
+
+//2^f = sum of (f ln 2)^k/k! for f in [-1/2, 1/2], to k = 7.
+static const float exp2C1 = 0.693147181f;
+static const float exp2C2 = 0.240226507f;
+static const float exp2C3 = 0.0555041087f;
+static const float exp2C4 = 0.00961812911f;
+static const float exp2C5 = 0.00133335581f;
+static const float exp2C6 = 0.000154035304f;
+static const float exp2C7 = 0.0000152527338f;
+
+static const float minExponent = -126;
+
+static inline float log2Poly(float x){
+  uint32_t bits;
+  memcpy(&bits, &x, sizeof(bits));
+  int e = (int)((bits >> 23) & 0xFF) - 127;
+  bits = (bits & 0x7FFFFF) | 0x3F800000;
+  float m;
+  memcpy(&m, &bits, sizeof(m));
+  if (m > sqrt2){
+    m *= 0.5f;
+    e++;
+  }
+  float t = (m - 1)/(m + 1);
+  float t2 = t*t;
+  return e + t*(log2C1 + t2*(log2C3 + t2*(log2C5 + t2*(log2C7 + t2*log2C9))));
+}
+
+static inline float exp2Poly(float y){
+  y = y < minExponent ? minExponent : y;
+  float n = nearbyintf(y);
+  float f = y - n;
+  float p = 1 + f*(exp2C1 + f*(exp2C2 + f*(exp2C3 + f*(exp2C4 + f*(exp2C5 + f*(exp2C6 + f*exp2C7))))));
+  uint32_t bits = (uint32_t)((int)n + 127) << 23;
+  float scale;
+  memcpy(&scale, &bits, sizeof(scale));
+  return p*scale;
+}
+
+FS5Batch::FS5Batch(double U0, double U50, double v50, double n){
+  double k = (pow(U50/U0, 2) - 1)/pow(v50, n);
+  _U0 = U0;
+  _invN = 1/n;
+  _velScale = pow(k, _invN)*pow(U0, 2*_invN);
+  _U0f = (float)U0;
+  _invNf = (float)_invN;
+  _log2Scale = (float)log2(_velScale);
+  for (int code = 0; code < 1024; code++){
+    _codeTable[code] = (float)velocity(code/codeScale*maxInputVoltage);
+  }
+  _kernel = avx2Supported() ? BATCH_AVX2 : BATCH_SCALAR;
+}
+
+bool FS5Batch::avx2Supported(){
+#if FS5_BATCH_X86
+  return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+  return false;
+#endif
+}
+
+void FS5Batch::setKernel(BatchKernel kernel){
+  _kernel = kernel == BATCH_AVX2 && avx2Supported() ? BATCH_AVX2 : BATCH_SCALAR;
+}
+
+double FS5Batch::velocity(double U) const {
+  if (U < _U0){
+    U = _U0;
+  }
+  return pow((U - _U0)*(U + _U0), _invN)/_velScale;
+}
+
+void FS5Batch::fromVoltages(const float* U, float* v, size_t count) const {
+  if (_kernel == BATCH_AVX2){
+    voltagesAvx2(U, v, count);
+  }
+  else {
+    voltagesScalar(U, v, count);
+  }
+}
+
+void FS5Batch::fromCodes(const uint16_t* codes, float* v, size_t count) const {
+  if (_kernel == BATCH_AVX2){
+    codesAvx2(codes, v, count);
+  }
+  else {
+    codesScalar(codes, v, count);
+  }
+}
+
+void FS5Batch::voltagesScalar(const float* U, float* v, size_t count) const {
+  for (size_t i = 0; i < count; i++){
+    float u = U[i] > _U0f ? U[i] : _U0f;        //Also takes NaN to U0.
+    float x = (u - _U0f)*(u + _U0f);
+    v[i] = x > 0 ? exp2Poly(log2Poly(x)*_invNf - _log2Scale) : 0;
+  }
+}
+
+void FS5Batch::codesScalar(const uint16_t* codes, float* v, size_t count) const {
+  for (size_t i = 0; i < count; i++){
+    v[i] = _codeTable[codes[i] & 1023];
+  }
+}
+
+#if FS5_BATCH_X86
+
+/* Function:    void FS5Batch::voltagesAvx2(const float* U, float* v, size_t count)
+ * Purpose:     The scalar kernel on eight samples at a time. The rest
+ *              of the batch is done by the scalar kernel.
+ *
+ * Input:       Voltages [V]                (const float* U)
+ *              Velocities [m/s]            (float* v)
+ *              Number of samples           (size_t count)
+ *
+ * Output:      None
+*/
+__attribute__((target("avx2,fma")))
+void FS5Batch::voltagesAvx2(const float* U, float* v, size_t count) const {
+  const __m256 u0 = _mm256_set1_ps(_U0f);
+  const __m256 invN = _mm256_set1_ps(_invNf);
+  const __m256 log2Scale = _mm256_set1_ps(_log2Scale);
+  const __m256 one = _mm256_set1_ps(1);
+  const __m256 half = _mm256_set1_ps(0.5f);
+  const __m256 root2 = _mm256_set1_ps(sqrt2);
+  const __m256 lowest = _mm256_set1_ps(minExponent);
+  const __m256i mantissa = _mm256_set1_epi32(0x7FFFFF);
+  const __m256i exponentOne = _mm256_set1_epi32(0x3F800000);
+  const __m256i bias = _mm256_set1_epi32(127);
+
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8){
+    __m256 u = _mm256_max_ps(_mm256_loadu_ps(U + i), u0);
+    __m256 x = _mm256_mul_ps(_mm256_sub_ps(u, u0), _mm256_add_ps(u, u0));
+    __m256 still = _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_LE_OQ);
+
+    //log2(x), split into exponent and mantissa.
+    __m256i bits = _mm256_castps_si256(x);
+    __m256i e = _mm256_sub_epi32(_mm256_srli_epi32(bits, 23), bias);
+    __m256 m = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, mantissa), exponentOne));
+    __m256 big = _mm256_cmp_ps(m, root2, _CMP_GT_OQ);
+    m = _mm256_blendv_ps(m, _mm256_mul_ps(m, half), big);
+    e = _mm256_sub_epi32(e, _mm256_castps_si256(big));
+    __m256 t = _mm256_div_ps(_mm256_sub_ps(m, one), _mm256_add_ps(m, one));
+    __m256 t2 = _mm256_mul_ps(t, t);
+    __m256 p = _mm256_fmadd_ps(t2, _mm256_set1_ps(log2C9), _mm256_set1_ps(log2C7));
+    p = _mm256_fmadd_ps(t2, p, _mm256_set1_ps(log2C5));
+    p = _mm256_fmadd_ps(t2, p, _mm256_set1_ps(log2C3));
+    p = _mm256_fmadd_ps(t2, p, _mm256_set1_ps(log2C1));
+    __m256 l = _mm256_fmadd_ps(t, p, _mm256_cvtepi32_ps(e));
+
+    //2^y with y = log2(x)/n - log2(scale).
+    __m256 y = _mm256_max_ps(_mm256_fmsub_ps(l, invN, log2Scale), lowest);
+    __m256 n = _mm256_round_ps(y, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256 f = _mm256_sub_ps(y, n);
+    __m256 q = _mm256_fmadd_ps(f, _mm256_set1_ps(exp2C7), _mm256_set1_ps(exp2C6));
+    q = _mm256_fmadd_ps(f, q, _mm256_set1_ps(exp2C5));
+    q = _mm256_fmadd_ps(f, q, _mm256_set1_ps(exp2C4));
+    q = _mm256_fmadd_ps(f, q, _mm256_set1_ps(exp2C3));
+    q = _mm256_fmadd_ps(f, q, _mm256_set1_ps(exp2C2));
+    q = _mm256_fmadd_ps(f, q, _mm256_set1_ps(exp2C1));
+    q = _mm256_fmadd_ps(f, q, one);
+    __m256 scale = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), bias), 23));
+    _mm256_storeu_ps(v + i, _mm256_andnot_ps(still, _mm256_mul_ps(q, scale)));
+  }
+  voltagesScalar(U + i, v + i, count - i);
+}
+
+__attribute__((target("avx2,fma")))
+void FS5Batch::codesAvx2(const uint16_t* codes, float* v, size_t count) const {
+  const __m256i mask = _mm256_set1_epi32(1023);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8){
+    __m128i packed = _mm_loadu_si128((const __m128i*)(codes + i));
+    __m256i index = _mm256_and_si256(_mm256_cvtepu16_epi32(packed), mask);
+    _mm256_storeu_ps(v + i, _mm256_i32gather_ps(_codeTable, index, 4));
+  }
+  codesScalar(codes + i, v + i, count - i);
+}
+
+#else
+
+void FS5Batch::voltagesAvx2(const float* U, float* v, size_t count) const {
+  voltagesScalar(U, v, count);
+}
+
+void FS5Batch::codesAvx2(const uint16_t* codes, float* v, size_t count) const {
+  codesScalar(codes, v, count);
+}
+
+#endif
@@ -0,0 +1,108 @@
+/* Filename:      FS5Batch.h
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Conversion of logged FS5 voltages or ADC codes to wind velocity in
+ *    batches, for processing archived logs on a PC. The transfer
+ *    function is that of FS5sensor::velocityFromVoltage():
+ *
+ *      v = ((U - U0)(U + U0))^(1/n) / (k U0^2)^(1/n),  U below U0 as U0
+ *
+ *    Voltages are converted as 2^(log2(U^2 - U0^2)/n - log2 scale) with
+ *    polynomial log2() and exp2(), eight samples at a time with AVX2 and
+ *    FMA when the CPU has them, otherwise one at a time with the same
+ *    polynomials. ADC codes are looked up in a table of the velocity at
+ *    each of the 1024 codes, computed with pow() in double.
+ *
+ *    Maximum error against velocityFromVoltage() in double, for float
+ *    voltages from 0 to 5 V and the calibration of main.ino, checked by
+ *    host/bench/batchBench.cpp:
+ *      voltages   1e-6 m/s + 2e-6 of the velocity
+ *      ADC codes  rounding to float, 6e-8 of the velocity
+ *
+ * Notes:
+ *    - Host only. The AVX2 kernels are compiled with target attributes
+ *      and chosen at run time, so the library runs on any x86-64 CPU.
+ */
+
+#ifndef FS5Batch_h        //Include guard.
+#define FS5Batch_h
+#include <stddef.h>
+#include <stdint.h>
+
+//Kernels of FS5Batch.
+enum BatchKernel {
+  BATCH_SCALAR,         //One sample at a time, any CPU.
+  BATCH_AVX2            //Eight samples at a time, x86-64 with AVX2 and FMA.
+};
+
+//Class converting FS5 voltages or ADC codes to wind velocity in batches.
+class FS5Batch {
+  public:
+    /* Constructor:   FS5Batch::FS5Batch(double U0, double U50, double v50, double n)
+     *
+     * Purpose:     Calculate the constants of the transfer function and
+     *              the table of the ADC codes, and choose the fastest
+     *              kernel the CPU runs.
+     *
+     * Input:       Voltage U at wind speed 0%              (double U0)
+     *              Voltage U at wind speed 50%             (double U50)
+     *              Wind speed v at wind speed 50%          (double v50)
+     *              Value to setup FS5 for parameter n      (double n)
+     *
+     * Output:      None
+    */
+    FS5Batch(double U0, double U50, double v50, double n);
+
+    //Use a kernel, the scalar one if the CPU cannot run it.
+    void setKernel(BatchKernel kernel);
+    BatchKernel kernel() const { return _kernel; }
+    static bool avx2Supported();
+
+    /* Function:    void FS5Batch::fromVoltages(const float* U, float* v, size_t count)
+     * Purpose:     Convert voltages to wind velocities.
+     *
+     * Input:       Voltages [V]                (const float* U)
+     *              Velocities [m/s], may be U  (float* v)
+     *              Number of samples           (size_t count)
+     *
+     * Output:      None
+    */
+    void fromVoltages(const float* U, float* v, size_t count) const;
+
+    /* Function:    void FS5Batch::fromCodes(const uint16_t* codes, float* v, size_t count)
+     * Purpose:     Convert ADC codes to wind velocities. Only the low 10
+     *              bits of a code are used.
+     *
+     * Input:       ADC codes, 0 to 1023        (const uint16_t* codes)
+     *              Velocities [m/s]            (float* v)
+     *              Number of samples           (size_t count)
+     *
+     * Output:      None
+    */
+    void fromCodes(const uint16_t* codes, float* v, size_t count) const;
+
+    //The transfer function in double, as the firmware computes it.
+    double velocity(double U) const;
+
+  private:
+    void voltagesScalar(const float* U, float* v, size_t count) const;
+    void voltagesAvx2(const float* U, float* v, size_t count) const;
+    void codesScalar(const uint16_t* codes, float* v, size_t count) const;
+    void codesAvx2(const uint16_t* codes, float* v, size_t count) const;
+
+    double _U0;
+    double _invN;                   //1/n.
+    double _velScale;               //(k*U0^2)^(1/n).
+    float _U0f;                     //U0 for the float kernels.
+    float _invNf;                   //1/n for the float kernels.
+    float _log2Scale;               //log2 of _velScale.
+    BatchKernel _kernel;
+    float _codeTable[1024];         //Velocity at every ADC code.
+};
+
+#endif
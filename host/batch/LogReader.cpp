@@ -0,0 +1,175 @@
+/* Filename:      LogReader.cpp
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Streaming reader of FS5 logs, see LogReader.h.
+ */
+
+#include "LogReader.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+//Size of the CSV text buffer, lines longer than this are skipped.
+static const size_t textBuffer = 1 << 16;
+
+LogReader::LogReader() : _file(0), _format(LOG_CSV), _column(0), _buffer(0), _size(0),
+                         _begin(0), _end(0), _eof(true), _bytes(0), _skipped(0) {
+}
+
+LogReader::~LogReader(){
+  close();
+  free(_buffer);
+}
+
+bool LogReader::open(const char* path, LogFormat format, int column){
+  close();
+  _file = fopen(path, "rb");
+  if (!_file){
+    return false;
+  }
+  setvbuf(_file, 0, _IOFBF, 1 << 16);
+  _format = format;
+  _column = column;
+  _begin = _end = 0;
+  _eof = false;
+  _bytes = 0;
+  _skipped = 0;
+  if (format == LOG_CSV && !_buffer){
+    _size = textBuffer;
+    _buffer = (char*)malloc(_size + 1);
+  }
+  return true;
+}
+
+void LogReader::close(){
+  if (_file){
+    fclose(_file);
+    _file = 0;
+  }
+  _eof = true;
+}
+
+//Move the unparsed text to the front and read more after it.
+bool LogReader::refill(){
+  if (_eof){
+    return false;
+  }
+  memmove(_buffer, _buffer + _begin, _end - _begin);
+  _end -= _begin;
+  _begin = 0;
+  size_t got = fread(_buffer + _end, 1, _size - _end, _file);
+  _bytes += got;
+  _end += got;
+  _buffer[_end] = 0;
+  if (got == 0){
+    _eof = true;
+  }
+  return got > 0;
+}
+
+/* Function:    bool LogReader::nextLine(float& value)
+ * Purpose:     Parse CSV lines until one has a number in the column.
+ *
+ * Input:       The number                  (float& value)
+ *
+ * Output:      False at the end of the log.
+*/
+bool LogReader::nextLine(float& value){
+  while (true){
+    char* line = _buffer + _begin;
+    char* newline = (char*)memchr(line, '\n', _end - _begin);
+    if (!newline){
+      if (_end - _begin == _size){
+        _begin = _end;          //Too long, drop it.
+        _skipped++;
+        continue;
+      }
+      if (refill()){
+        continue;
+      }
+      if (_begin == _end){
+        return false;
+      }
+      newline = _buffer + _end;   //Last line without a newline.
+    }
+    *newline = 0;
+    _begin = newline - _buffer + (newline < _buffer + _end ? 1 : 0);
+
+    char* field = line;
+    for (int c = 0; c < _column && field; c++){
+      field = strchr(field, ',');
+      field = field ? field + 1 : 0;
+    }
+    char* parsed;
+    if (field){
+      value = strtof(field, &parsed);
+      if (parsed != field){
+        return true;
+      }
+    }
+    if (*line != 0 && *line != '\r'){
+      _skipped++;
+    }
+  }
+}
+
+size_t LogReader::read(float* values, size_t max){
+  if (!_file || _format == LOG_U16){
+    return 0;
+  }
+  if (_format == LOG_F32){
+    size_t got = fread(values, sizeof(float), max, _file);
+    _bytes += got*sizeof(float);
+    return got;
+  }
+  size_t n = 0;
+  while (n < max && nextLine(values[n])){
+    n++;
+  }
+  return n;
+}
+
+size_t LogReader::readCodes(uint16_t* codes, size_t max){
+  if (!_file || _format == LOG_F32){
+    return 0;
+  }
+  if (_format == LOG_U16){
+    size_t got = fread(codes, sizeof(uint16_t), max, _file);
+    _bytes += got*sizeof(uint16_t);
+    return got;
+  }
+  size_t n = 0;
+  float value;
+  while (n < max && nextLine(value)){
+    codes[n++] = (uint16_t)lrintf(value < 0 ? 0 : (value > 1023 ? 1023 : value));
+  }
+  return n;
+}
+
+uint64_t convertLog(LogReader& reader, const FS5Batch& batch, bool codes,
+                    const std::function<void(const float*, size_t)>& sink){
+  float values[logChunk];
+  uint16_t raw[logChunk];
+  uint64_t total = 0;
+  while (true){
+    size_t n;
+    if (codes){
+      n = reader.readCodes(raw, logChunk);
+      batch.fromCodes(raw, values, n);
+    }
+    else {
+      n = reader.read(values, logChunk);
+      batch.fromVoltages(values, values, n);
+    }
+    if (n == 0){
+      return total;
+    }
+    sink(values, n);
+    total += n;
+  }
+}
@@ -0,0 +1,97 @@
+/* Filename:      LogReader.h
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Streaming reader of FS5 logs, for converting them with FS5Batch in
+ *    chunks that stay in the cache. Formats:
+ *      LOG_CSV  text, one sample per line, the value in a given column.
+ *               Lines without a number there, e.g. headers, are skipped.
+ *      LOG_F32  binary little endian float voltages.
+ *      LOG_U16  binary little endian uint16 ADC codes.
+ *
+ *    convertLog() reads a log chunk by chunk, converts each chunk and
+ *    hands the velocities to a sink, so logs of any size run in fixed
+ *    memory.
+ */
+
+#ifndef LogReader_h       //Include guard.
+#define LogReader_h
+#include "FS5Batch.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <functional>
+
+//Formats of LogReader.
+enum LogFormat {
+  LOG_CSV,
+  LOG_F32,
+  LOG_U16
+};
+
+//Samples per chunk, 16 kB of floats in and 16 kB out.
+static const size_t logChunk = 4096;
+
+//Class reading the samples of a log in chunks.
+class LogReader {
+  public:
+    LogReader();
+    ~LogReader();
+
+    //Open a log. False if it cannot be opened.
+    bool open(const char* path, LogFormat format, int column = 0);
+    void close();
+
+    /* Function:    size_t LogReader::read(float* values, size_t max)
+     * Purpose:     Read the next samples as numbers, voltages in LOG_F32
+     *              and whatever the column holds in LOG_CSV. Not for
+     *              LOG_U16.
+     *
+     * Input:       Samples read                (float* values)
+     *              Most samples to read        (size_t max)
+     *
+     * Output:      Number of samples read, 0 at the end of the log.
+    */
+    size_t read(float* values, size_t max);
+
+    //The same for ADC codes, in LOG_U16 or a LOG_CSV column of codes.
+    size_t readCodes(uint16_t* codes, size_t max);
+
+    LogFormat format() const { return _format; }
+    uint64_t bytes() const { return _bytes; }         //Bytes read from the file.
+    uint64_t skipped() const { return _skipped; }     //CSV lines without a sample.
+
+  private:
+    bool nextLine(float& value);
+    bool refill();
+
+    FILE* _file;
+    LogFormat _format;
+    int _column;
+    char* _buffer;              //CSV text, _size bytes and a terminating 0.
+    size_t _size;
+    size_t _begin;              //Start of the unparsed text.
+    size_t _end;                //End of the text read.
+    bool _eof;
+    uint64_t _bytes;
+    uint64_t _skipped;
+};
+
+/* Function:    uint64_t convertLog(LogReader& reader, const FS5Batch& batch, bool codes, const std::function<void(const float*, size_t)>& sink)
+ * Purpose:     Convert a whole log to velocities, a chunk at a time.
+ *
+ * Input:       Open log                    (LogReader& reader)
+ *              Conversion                  (const FS5Batch& batch)
+ *              The samples are ADC codes   (bool codes)
+ *              Called with each chunk of velocities
+ *                                          (const std::function<void(const float*, size_t)>& sink)
+ *
+ * Output:      Number of samples converted.
+*/
+uint64_t convertLog(LogReader& reader, const FS5Batch& batch, bool codes,
+                    const std::function<void(const float*, size_t)>& sink);
+
+#endif
@@ -0,0 +1,108 @@
+/* Filename:      BenchStats.h
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Small helpers shared by the host benchmarks: a sample summary with
+ *    mean and percentiles, wall clock timing and argument parsing.
+ */
+
+#ifndef BenchStats_h      //Include guard.
+#define BenchStats_h
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+//Collects samples of one metric and summarises them.
+class Summary {
+  public:
+    void add(double x) { _samples.push_back(x); _sorted = false; }
+    size_t count() const { return _samples.size(); }
+
+    double mean() const {
+      if (_samples.empty()){
+        return 0;
+      }
+      double sum = 0;
+      for (size_t i = 0; i < _samples.size(); i++){
+        sum += _samples[i];
+      }
+      return sum/_samples.size();
+    }
+
+    //Percentile p in [0, 100], nearest rank.
+    double percentile(double p) {
+      if (_samples.empty()){
+        return 0;
+      }
+      if (!_sorted){
+        std::sort(_samples.begin(), _samples.end());
+        _sorted = true;
+      }
+      size_t rank = (size_t)(p/100.0*(_samples.size() - 1) + 0.5);
+      return _samples[rank];
+    }
+
+    double max() { return percentile(100); }
+
+    //Print one row: name, mean, p50, p95, p99 and max.
+    void printRow(const char* name) {
+      printf("  %-24s %12.3f %12.3f %12.3f %12.3f %12.3f\n", name, mean(),
+             percentile(50), percentile(95), percentile(99), max());
+    }
+
+    static void printHeader() {
+      printf("  %-24s %12s %12s %12s %12s %12s\n", "metric", "mean", "p50",
+             "p95", "p99", "max");
+    }
+
+  private:
+    std::vector<double> _samples;
+    bool _sorted = false;
+};
+
+//Wall clock stopwatch in seconds.
+class WallTimer {
+  public:
+    WallTimer() : _start(std::chrono::steady_clock::now()) {}
+    double seconds() const {
+      return std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+    }
+
+  private:
+    std::chrono::steady_clock::time_point _start;
+};
+
+//Value of "--name value" on the command line, or fallback.
+inline double argValue(int argc, char** argv, const char* name, double fallback){
+  for (int i = 1; i + 1 < argc; i++){
+    if (strcmp(argv[i], name) == 0){
+      return atof(argv[i + 1]);
+    }
+  }
+  return fallback;
+}
+
+//True if "--name" is given on the command line.
+inline bool argFlag(int argc, char** argv, const char* name){
+  for (int i = 1; i < argc; i++){
+    if (strcmp(argv[i], name) == 0){
+      return true;
+    }
+  }
+  return false;
+}
+
+//Keeps the optimiser from removing a computed value.
+template<typename T>
+inline void keep(const T& value){
+  asm volatile("" : : "g"(&value) : "memory");
+}
+
+#endif
@@ -0,0 +1,402 @@
+/* Filename:      LoopModel.h
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    The loop() of main.ino as a class, for the benchmarks that run the
+ *    whole firmware on the simulated board. Output is JSON and text or
+ *    binary telemetry, and the time spent blocked on the UART is counted.
+ *    The profiling sections of main.ino are kept, see Profiler.h. With
+ *    a Storage the state is resumed and saved like in setup(). The
+ *    window size, the allowed wind speed and the scan strategy can be
+ *    varied, and every decision can be passed to a hook. The decision
+ *    is the median of a full window like in main.ino, or sequential,
+ *    see WindDecision.h and setSequential(). The gust statistics of GustStats.h
+ *    are kept and sent like in main.ino, and the samples and scans 
+ *    follow the adaptive cadence of Cadence.h unless it is turned off.
+ */
+
+#ifndef LoopModel_h       //Include guard.
+#define LoopModel_h
+#include "Arduino.h"
+#include "Controller.h"
+#include "FS5.h"
+#include "Profiler.h"
+#include "RunningMedian.h"
+#include "Telemetry.h"
+#include "Storage.h"
+#include "WindDecision.h"
+#include "GustStats.h"
+#include "Cadence.h"
+#include "PowerSave.h"
+#include "SimBoard.h"
+#include <functional>
+#include <stdio.h>
+
+//Same setup as main.ino.
+static const int pinFS5 = A0;
+static const double U0 = 2.24;
+static const double U50 = 3.33;
+static const double v50 = 8;
+static const double nFS5 = 0.51;
+static const int IN1 = 10;
+static const int IN2 = 9;
+static const int IN3 = 8;
+static const int IN4 = 7;
+static const int pinLS = 12;
+static const double allowedWindSpeed = 2;
+static const unsigned long samplePeriod = 100;    //[ms]
+static const uint8_t N = 11;
+static const double windMargin = 0.3;             //[m/s]
+static const double windSigma = 0.5;              //[m/s]
+static const double falseLowerRate = 0.005;
+static const double missedLowerRate = 0.05;
+static const double windHysteresis = 0.2;         //[m/s]
+static const double gustPercentile = 0.9;
+static const unsigned int sparsePeriod = 4000;    //[ms]
+static const double windRise = 0.5;               //[m/s per s]
+static const unsigned long maxRescanPeriod = 60000;   //[ms]
+static const unsigned int powerDownPeriod = 500;  //[ms]
+
+//Called with the wind speed and the decision each time one is reported.
+typedef std::function<void(double windSpeed, bool lower)> DecisionHook;
+
+//The loop() of main.ino with both kinds of output and a window of W
+//samples. The JSON document is printed in the format of serializeJson().
+template <uint8_t W>
+class LoopModelN {
+  public:
+    LoopModelN(bool binary, unsigned long baud, Storage* storage = 0)
+      : _controller(pinLS, IN1, IN2, IN3, IN4, pinFS5, U0, U50, v50, nFS5),
+        _FS5(pinFS5, U0, U50, v50, nFS5),
+        _decision(allowedWindSpeed, windMargin, windSigma),
+        _gusts(gustPercentile),
+        _cadence(allowedWindSpeed, windSigma){
+      _binary = binary;
+      _allowed = allowedWindSpeed;
+      _sequential = false;
+      _sequenceUs = 0;
+      _sequenceSamples = 0;
+      _sequencePausedUs = 0;
+      _adaptive = true;
+      _cadence.setPeriods(samplePeriod, sparsePeriod);
+      _cadence.setRise(windRise);
+      _cadence.setRescan(maxRescanPeriod);
+      _decision.setBounds(falseLowerRate, missedLowerRate);
+      _decision.setHysteresis(windHysteresis);
+      _decision.setSpan(W*samplePeriod);
+      _gusts.setWindow(GUST_SHORT, 3000);
+      _gusts.setWindow(GUST_MINUTE, 60000);
+      _gusts.setWindow(GUST_LONG, 600000);
+      _allowedGust = 0;
+      _resumed = false;
+      if (storage){
+        StoredState state;
+        if (storage->load(state)){
+          _FS5.loadCalibration(state);
+          _resumed = _controller.resume(state);
+        }
+        _controller.useStorage(storage);
+      }
+      _controller.setTracking(true);
+      _sampleCount = 0;
+      if (binary){
+        _telemetry.begin(baud);
+        _controller.setMessages(false);
+      }
+      else {
+        Serial.begin(baud);
+      }
+    }
+
+    //Runs one loop() and returns the time from the decision of the
+    //measuring sequence until its report had left the UART [s], blocked
+    //time in blockedUs.
+    double loop(SimBoard& board, double& blockedUs){
+      _board = &board;
+      _blockedUs = 0;
+      message("//////////////////////////////////////////////////////////");
+      _lowerReported = false;
+      if (!_adaptive || _cadence.rescanDue(millis())){
+        _controller.begin();
+        bool tracking = _controller.phase() == SCAN_TRACK;
+        unsigned long scanStart = millis();
+        unsigned long lastSample = scanStart;
+        while (_controller.tick(micros())){
+          if (millis() - lastSample >= samplePeriod){
+            lastSample = millis();
+            if (sampleWind() == WIND_LOWER && _sequential && !_lowerReported){
+              report(_decision.mean(), true);
+              _lowerReported = true;
+            }
+          }
+        }
+        if (_binary){
+          unsigned long scanTime = millis() - scanStart;
+          sendRecord(TELEMETRY_SCAN, 0, tracking ? TELEMETRY_TRACKING : 0,
+                     scanTime > 65535 ? 65535 : scanTime);
+        }
+        _cadence.scanned(millis());
+      }
+      message("Start wind measuring sequence...");
+      double sequenceStart = board.now();
+      double decided = 0, latency = 0;
+      bool reported = false;
+      _decision.restart();
+      {
+        PROFILE_SCOPE(PROFILE_SEQUENCE);
+        for (int k = 0; k < W; k++){
+          WindVerdict verdict = sampleWind();
+          _sequenceSamples++;
+          if (_sequential && verdict == WIND_LOWER){
+            decided = reported ? decided : board.now();
+            report(_decision.mean(), true);
+            latency = (board.serialIdleUs() - board.now())*1e-6;
+            break;
+          }
+          if (_sequential && verdict == WIND_KEEP && !reported){
+            decided = board.now();
+            report(_decision.mean(), false);
+            latency = (board.serialIdleUs() - decided)*1e-6;
+            reported = true;
+          }
+          uint64_t pauseStart = board.now();
+          pause();
+          _sequencePausedUs += board.now() - pauseStart;
+        }
+      }
+      message("Measuring sequence complete");
+      if (!_sequential){
+        message("Create and print JSON array...");
+        message("");
+        decided = board.now();
+        report(_window.median(), _window.median() > _allowed);
+        latency = (board.serialIdleUs() - decided)*1e-6;
+      }
+      _sequenceUs = decided - sequenceStart;
+      message(" ");
+      message("Program complete");
+      blockedUs = _blockedUs;
+      return latency;
+    }
+
+    Control& controller(){
+      return _controller;
+    }
+
+    void setAllowedWindSpeed(double speed){
+      _allowed = speed;
+      _decision.setAllowed(speed);
+      _cadence.setAllowed(speed);
+    }
+
+    //Follow the adaptive cadence like main.ino, else sample every
+    //samplePeriod with delay() and scan every loop.
+    void setAdaptive(bool adaptive){
+      _adaptive = adaptive;
+    }
+
+    Cadence& cadence(){
+      return _cadence;
+    }
+
+    //Lower when the percentile of the short gust window exceeds the
+    //speed, 0 to only report the gusts.
+    void setAllowedGust(double speed){
+      _allowedGust = speed;
+    }
+
+    GustStats& gusts(){
+      return _gusts;
+    }
+
+    //Decide sequentially like main.ino with sequentialDecision set,
+    //else by the median of a full window when the sequence ends.
+    void setSequential(bool sequential){
+      _sequential = sequential;
+    }
+
+    //Time of the last measuring sequence until its decision [us].
+    double sequenceUs(){
+      return _sequenceUs;
+    }
+
+    //Samples and time paused between them in all measuring sequences.
+    unsigned long sequenceSamples(){
+      return _sequenceSamples;
+    }
+
+    double sequencePausedUs(){
+      return _sequencePausedUs;
+    }
+
+    void onDecision(const DecisionHook& hook){
+      _hook = hook;
+    }
+
+    //True if the constructor resumed from a stored state.
+    bool resumed(){
+      return _resumed;
+    }
+
+  private:
+    void message(const char* text){
+      if (!_binary){
+        uint64_t start = _board->now();
+        Serial.println(text);
+        _blockedUs += _board->now() - start;
+      }
+    }
+
+    void pause(){
+      if (!_adaptive){
+        delay(samplePeriod);
+        return;
+      }
+      unsigned int period = _cadence.period();
+      if (period >= powerDownPeriod){
+        PowerSave::powerDown(period);
+      }
+      else {
+        PowerSave::idle(period);
+      }
+    }
+
+    void sendRecord(uint8_t type, double windSpeed, uint8_t status, unsigned int durationMs){
+      TelemetryRecord record;
+      record.type = type;
+      record.timeMs = millis();
+      record.windSpeed = Telemetry::speed(windSpeed);
+      record.status = status | (_window.full() ? TELEMETRY_FULL : 0);
+      record.heading = _controller.heading();
+      record.count = _window.count();
+      record.minSpeed = Telemetry::speed(_sampleCount > 0 ? _sampleMin : 0);
+      record.maxSpeed = Telemetry::speed(_sampleCount > 0 ? _sampleMax : 0);
+      record.durationMs = durationMs;
+      uint64_t start = _board->now();
+      _telemetry.send(record);
+      _blockedUs += _board->now() - start;
+    }
+
+    void sendGusts(){
+      for (uint8_t w = 0; w < GUST_WINDOWS; w++){
+        TelemetryRecord record;
+        record.type = TELEMETRY_GUST;
+        record.timeMs = millis();
+        record.windSpeed = Telemetry::speed(_gusts.statistic(w, GUST_MEAN));
+        record.status = _gusts.full(w) ? TELEMETRY_FULL : 0;
+        record.heading = _controller.heading();
+        record.count = w;
+        record.minSpeed = Telemetry::speed(_gusts.statistic(w, GUST_DEVIATION));
+        record.maxSpeed = Telemetry::speed(_gusts.statistic(w, GUST_PEAK));
+        record.durationMs = Telemetry::speed(_gusts.statistic(w, GUST_PERCENTILE));
+        uint64_t start = _board->now();
+        _telemetry.send(record);
+        _blockedUs += _board->now() - start;
+      }
+    }
+
+    void report(double windSpeed, bool lower){
+      PROFILE_SCOPE(PROFILE_REPORT);
+      if (_hook){
+        _hook(windSpeed, lower);
+      }
+      if (_binary){
+        sendRecord(TELEMETRY_DECISION, windSpeed, lower ? TELEMETRY_LOWER : 0, 0);
+        sendGusts();
+        _sampleCount = 0;
+        return;
+      }
+      char json[200];
+      if (lower){
+        snprintf(json, sizeof(json), "{\"Sensor\":\"FS5\",\"Wind Speed\":%.9g,\"Status\":\"True\","
+                 "\"Info\":\"Wind speed is NOT in the allowed span. Lower the flag.\"}", windSpeed);
+      }
+      else {
+        snprintf(json, sizeof(json), "{\"Sensor\":\"FS5\",\"Wind Speed\":%.9g,\"Status\":\"False\","
+                 "\"Info\":\"Wind speed is in the allowed span. \"}", windSpeed);
+      }
+      uint64_t start = _board->now();
+      Serial.print(json);
+      Serial.println(" ");
+      _blockedUs += _board->now() - start;
+      _sampleCount = 0;
+    }
+
+    WindVerdict sampleWind(){
+      PROFILE_INTERVAL(micros(), samplePeriod*1000);
+      double sample = _FS5.velocity();
+      bool scanning = _controller.scanning();
+      double median;
+      {
+        PROFILE_SCOPE(PROFILE_MEDIAN);
+        if (!scanning){
+          _window.add(sample);
+          _gusts.add(sample, millis());
+        }
+        median = _window.median();
+      }
+      if (!scanning){
+        _cadence.add(sample, millis());
+      }
+      _sampleMin = (_sampleCount == 0 || sample < _sampleMin) ? sample : _sampleMin;
+      _sampleMax = (_sampleCount == 0 || sample > _sampleMax) ? sample : _sampleMax;
+      _sampleCount += _sampleCount < 255 ? 1 : 0;
+      if (_binary){
+        sendRecord(TELEMETRY_SAMPLE, sample, scanning ? TELEMETRY_SCANNING : 0, 0);
+      }
+      else {
+        uint64_t start = _board->now();
+        Serial.println(sample);
+        _blockedUs += _board->now() - start;
+      }
+      WindVerdict verdict = WIND_UNDECIDED;
+      if (scanning){
+        //No decision on the headings of a scan, as in main.ino.
+      }
+      else if (_sequential){
+        verdict = _decision.add(sample, millis());
+      }
+      else if (_window.full() && median > _allowed){
+        verdict = WIND_LOWER;
+      }
+      if (!scanning && _allowedGust > 0 && _gusts.statistic(GUST_SHORT, GUST_PERCENTILE) > _allowedGust){
+        verdict = WIND_LOWER;
+      }
+      if (!_sequential && verdict == WIND_LOWER && !_lowerReported){
+        report(median, true);
+        _lowerReported = true;
+      }
+      return verdict;
+    }
+
+    Control _controller;
+    FS5sensor _FS5;
+    Telemetry _telemetry;
+    RunningMedian<double, W> _window;
+    WindDecisionN<W> _decision;
+    GustStats _gusts;
+    Cadence _cadence;
+    bool _adaptive;
+    double _allowedGust;
+    SimBoard* _board;
+    DecisionHook _hook;
+    bool _binary;
+    double _allowed;
+    bool _sequential;
+    double _sequenceUs;
+    unsigned long _sequenceSamples;
+    double _sequencePausedUs;
+    bool _resumed;
+    bool _lowerReported;
+    double _sampleMin, _sampleMax;
+    uint8_t _sampleCount;
+    double _blockedUs;
+};
+
+//The loop() of main.ino as it is.
+typedef LoopModelN<N> LoopModel;
+#endif
@@ -0,0 +1,240 @@
+/* Filename:      arrayBench.cpp
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Benchmark of the fixed array of FS5 sensors, see FS5Array.h, on the
+ *    simulated board, against the single FS5 that is rotated.
+ *
+ *    The first part takes single passes of arrays of four sensors 90
+ *    degrees apart and three sensors 120 degrees apart, with the shaft
+ *    at rest and the wind from a random direction all around. The error
+ *    of the fitted direction and speed is reported per wind speed, with
+ *    the simulated time of a pass. With three sensors the direction is
+ *    poorly determined when the wind is close to one of them, since the
+ *    other two see only the floor of their response.
+ *
+ *    The second part aligns the FS5 from power up with a wind from a
+ *    random direction inside the span: by the exhaustive sweep, by the
+ *    coarse-to-fine search, and by one cycle with the array of four, see
+ *    Control::useArray(). The time to align, the half-steps and the
+ *    alignment error are compared.
+ *
+ *    The third part runs loop() cycles in the veering wind of
+ *    scan_bench, with a sudden 70 degree turn halfway, tracking by
+ *    probing with the motor against tracking with the array.
+ *
+ * Usage:
+ *    array_bench [--trials N] [--seed S] [--speed m/s] [--track-seconds T]
+ */
+
+#include "Arduino.h"
+#include "Controller.h"
+#include "FS5Array.h"
+#include "SimBoard.h"
+#include "BenchStats.h"
+
+//Same setup as main.ino.
+static const int pinFS5 = A0;
+static const double U0 = 2.24;
+static const double U50 = 3.33;
+static const double v50 = 8;
+static const double nFS5 = 0.51;
+static const int IN1 = 10;
+static const int IN2 = 9;
+static const int IN3 = 8;
+static const int IN4 = 7;
+static const int pinLS = 12;
+static const uint8_t arrayPins[4] = {A1, A2, A3, A6};
+static const double squareDeg[4] = {0, 90, 180, 270};
+static const double triangleDeg[3] = {0, 120, 240};
+
+static const unsigned long samplePeriod = 100;    //[ms]
+
+//Angle wrapped to -180 to 180 degrees.
+static double wrap(double deg){
+  deg = fmod(deg + 180, 360);
+  return (deg < 0 ? deg + 360 : deg) - 180;
+}
+
+//Simulated board with an array of the given angles on the pins of main.ino.
+static SimConfig arrayConfig(const double* angles, uint8_t count){
+  SimConfig config;
+  config.arraySensors = count;
+  for (uint8_t i = 0; i < count; i++){
+    config.arrayPins[i] = arrayPins[i];
+    config.arrayDeg[i] = angles[i];
+  }
+  return config;
+}
+
+//Runs loop() cycles for the given time and collects the time and steps
+//spent per scan or tracking cycle and the error after each one.
+static void runCycles(SimBoard& board, FS5Array* array, double seconds, Summary& cycleTime, Summary& steps,
+                      Summary& absError, int& scans){
+  Control controller(pinLS, IN1, IN2, IN3, IN4, pinFS5, U0, U50, v50, nFS5);
+  controller.setScanMode(SCAN_COARSE_FINE);
+  controller.setTracking(true);
+  controller.setMessages(false);
+  controller.useArray(array);
+  uint64_t start = board.now();
+  scans = 0;
+  while ((board.now() - start)*1e-6 < seconds){
+    uint64_t cycleStart = board.now();
+    board.clearCounters();
+    controller.begin();
+    scans += controller.phase() == SCAN_TRACK ? 0 : 1;
+    while (controller.tick(micros())){
+    }
+    cycleTime.add((board.now() - cycleStart)*1e-6);
+    steps.add(board.counters().steps);
+    absError.add(fabs(board.headingError()));
+    delay(11*samplePeriod);     //Measuring sequence.
+  }
+}
+
+int main(int argc, char** argv){
+  int trials = (int)argValue(argc, argv, "--trials", 500);
+  uint32_t seed = (uint32_t)argValue(argc, argv, "--seed", 1);
+  double speed = argValue(argc, argv, "--speed", 6);
+  bool ok = true;
+
+  SimConfig config = arrayConfig(squareDeg, 4);
+  SimBoard board(config, seed);
+  board.makeCurrent();
+  WallTimer wall;
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> anyDeg(0, 360);
+
+  //The array converts its readings with the FS5 of main.ino.
+  FS5sensor FS5(pinFS5, U0, U50, v50, nFS5);
+  FS5Table table;
+  FS5.useTable(&table);
+
+  //Single passes at rest.
+  printf("array benchmark: %d trials, noise %.3f V, floor %.2f, seed %u\n\n", trials,
+         config.noiseVolts, config.directionalFloor, seed);
+  const double speeds[4] = {1, 2, 4, 8};
+  const char* geometryNames[2] = {"four sensors, 90 deg apart", "three sensors, 120 deg apart"};
+  Summary squareError;
+  double passMs = 0;
+  for (int geometry = 0; geometry < 2; geometry++){
+    const double* angles = geometry ? triangleDeg : squareDeg;
+    uint8_t count = geometry ? 3 : 4;
+    SimConfig fixed = arrayConfig(angles, count);
+    printf("%s, one pass of 16 readings each\n", geometryNames[geometry]);
+    printf("  %-24s %12s %12s %12s %12s\n", "wind", "|dir| p50", "|dir| p95", "speed p50", "speed p95");
+    for (int s = 0; s < 4; s++){
+      Summary directionError, speedError;
+      for (int t = 0; t < trials; t++){
+        board.reset(fixed, seed + t);
+        board.setWind(speeds[s], anyDeg(rng));
+        FS5Array array(arrayPins, angles, count, &FS5);
+        uint64_t start = board.now();
+        array.pass();
+        passMs = (board.now() - start)*1e-3;
+
+        //The wind is at the heading plus the error of the FS5 axis.
+        double error = fabs(wrap(array.direction() - board.axisError()));
+        directionError.add(error);
+        speedError.add(fabs(array.speed()/speeds[s] - 1)*100);
+        if (geometry == 0 && speeds[s] >= 2){
+          squareError.add(error);
+        }
+      }
+      char name[40];
+      snprintf(name, sizeof(name), "%.0f m/s [deg], [%%]", speeds[s]);
+      printf("  %-24s %12.2f %12.2f %12.2f %12.2f\n", name, directionError.percentile(50),
+             directionError.percentile(95), speedError.percentile(50), speedError.percentile(95));
+    }
+  }
+  printf("  %.1f ms per pass of four sensors\n\n", passMs);
+
+  //From power up to aligned, wind inside the span of the sweep.
+  const double sweepStart = config.cwStopDeg - 400*360.0/config.stepsPerRev;
+  std::uniform_real_distribution<double> startDeg(config.ccwStopDeg + 1, config.cwStopDeg - 1);
+  std::uniform_real_distribution<double> windDeg(config.ccwStopDeg + 10, sweepStart - 10);
+  const char* alignNames[3] = {"exhaustive sweep", "coarse-to-fine", "array of four"};
+  Summary alignTime[3], alignSteps[3], alignError[3];
+  for (int t = 0; t < trials/5; t++){
+    config.startDeg = startDeg(rng);
+    double direction = windDeg(rng);
+    for (int variant = 0; variant < 3; variant++){
+      board.reset(config, seed + t);
+      board.setWind(speed, direction);
+      Serial.begin(9600);
+      Control controller(pinLS, IN1, IN2, IN3, IN4, pinFS5, U0, U50, v50, nFS5);
+      controller.setScanMode(variant == 0 ? SCAN_EXHAUSTIVE : SCAN_COARSE_FINE);
+      controller.setMessages(false);
+      FS5Array array(arrayPins, squareDeg, 4, &FS5);
+      if (variant == 2){
+        controller.useArray(&array);
+      }
+      board.clearCounters();
+      uint64_t start = board.now();
+      controller.scan();
+      alignTime[variant].add((board.now() - start)*1e-6);
+      alignSteps[variant].add(board.counters().steps);
+      alignError[variant].add(fabs(board.headingError()));
+    }
+  }
+  printf("power up to aligned, %d trials, wind %.1f m/s\n", trials/5, speed);
+  Summary::printHeader();
+  for (int variant = 0; variant < 3; variant++){
+    printf("%s\n", alignNames[variant]);
+    alignTime[variant].printRow("  time to align [s]");
+    alignSteps[variant].printRow("  half-steps");
+    alignError[variant].printRow("  |error| [deg]");
+  }
+
+  //Repeated loop() cycles in a veering wind.
+  const double runSeconds = argValue(argc, argv, "--track-seconds", 600);
+  const double center = (config.ccwStopDeg + sweepStart)/2;
+  WindField veering = [=](double t){
+    WindSample w;
+    w.speed = speed;
+    w.direction = center + 25*sin(2*M_PI*t/300) + (t > runSeconds/2 ? -35 : 35);
+    return w;
+  };
+  printf("\nloop() cycles for %.0f s, wind veering +-25 deg, 70 deg turn at %.0f s\n",
+         runSeconds, runSeconds/2);
+  const char* cycleNames[2] = {"tracking by probing", "tracking with the array"};
+  Summary cycleSteps[2], cycleError[2];
+  for (int variant = 0; variant < 2; variant++){
+    config.startDeg = 100;
+    board.reset(config, seed);
+    board.setWind(veering);
+    board.advance(10e6);
+    Serial.begin(9600);
+    FS5Array array(arrayPins, squareDeg, 4, &FS5);
+    Summary cycleTime;
+    int scans;
+    runCycles(board, variant ? &array : 0, runSeconds, cycleTime, cycleSteps[variant], cycleError[variant],
+              scans);
+    printf("%s: %d cycles, %d full scans\n", cycleNames[variant], (int)cycleTime.count(), scans);
+    Summary::printHeader();
+    cycleTime.printRow("time per cycle [s]");
+    cycleSteps[variant].printRow("half-steps per cycle");
+    cycleError[variant].printRow("|error| [deg]");
+  }
+
+  //The array of four finds the direction within a few degrees in one
+  //pass, aligns from power up many times faster than a sweep and at
+  //least as closely, and tracks with fewer steps. While tracking the
+  //heading is left within the dead band of the array.
+  bool passOk = squareError.percentile(95) < 5;
+  bool faster = alignTime[2].mean() < alignTime[1].mean()/5;
+  bool closer = alignError[2].percentile(95) <= alignError[1].percentile(95) + 1;
+  bool tracks = cycleSteps[1].mean() < cycleSteps[0].mean()/2 &&
+                cycleError[1].percentile(95) <= cycleError[0].percentile(95) + 1;
+  printf("\nDirection of one pass within 5 deg from 2 m/s:  %s\n", passOk ? "ok" : "FAIL");
+  printf("Align from power up 5 times faster than a sweep: %s\n", faster ? "ok" : "FAIL");
+  printf("Aligned as closely as the sweep:                %s\n", closer ? "ok" : "FAIL");
+  printf("Tracks with half the steps, as closely:         %s\n", tracks ? "ok" : "FAIL");
+  printf("  host wall time %.2f s\n", wall.seconds());
+  ok = passOk && faster && closer && tracks;
+  return ok ? 0 : 1;
+}
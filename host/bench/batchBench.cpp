@@ -0,0 +1,229 @@
+/* Filename:      batchBench.cpp
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Verifies and benchmarks the batch conversion of FS5Batch and the
+ *    log reader.
+ *
+ *    Every float voltage from 2.2 to 5 V is converted by both kernels
+ *    and compared with FS5sensor::velocityFromVoltage() in double. The
+ *    run fails above 1e-6 m/s + 2e-6 of the velocity. Every ADC code is
+ *    compared too, within the rounding to float.
+ *
+ *    Throughput is measured on random voltages and codes against the
+ *    firmware function, one sample at a time, and through the log reader
+ *    on CSV and binary logs, which must give the same velocities as the
+ *    conversion in memory.
+ *
+ * Usage:
+ *    batch_bench [--samples N] [--log-samples N] [--reps R] [--seed S]
+ */
+
+#include "Arduino.h"
+#include "FS5.h"
+#include "FS5Batch.h"
+#include "LogReader.h"
+#include "BenchStats.h"
+#include <random>
+#include <unistd.h>
+#include <vector>
+
+static const double U0 = 2.24;
+static const double U50 = 3.33;
+static const double v50 = 8;
+static const double nFS5 = 0.51;
+static const double absoluteBound = 1e-6;   //Allowed voltage kernel error [m/s].
+static const double relativeBound = 2e-6;   //Allowed relative voltage kernel error.
+static const double codeBound = 6e-8;       //Allowed relative code table error.
+
+static const char* kernelName(BatchKernel kernel){
+  return kernel == BATCH_AVX2 ? "avx2" : "scalar";
+}
+
+//Largest errors of a kernel over every float voltage in [from, to].
+static bool voltageError(FS5Batch& batch, FS5sensor& FS5, float from, float to){
+  std::vector<float> U, v;
+  for (float u = from; u <= to; u = nextafterf(u, 10)){
+    U.push_back(u);
+  }
+  v.resize(U.size());
+  batch.fromVoltages(U.data(), v.data(), U.size());
+  double worstAbsolute = 0, worstRelative = 0, worstU = 0;
+  bool within = true;
+  for (size_t i = 0; i < U.size(); i++){
+    double reference = FS5.velocityFromVoltage(U[i]);
+    double error = fabs(v[i] - reference);
+    within &= error <= absoluteBound + relativeBound*reference;
+    if (error > worstAbsolute){
+      worstAbsolute = error;
+      worstU = U[i];
+    }
+    if (reference > 0.01){
+      worstRelative = fmax(worstRelative, error/reference);
+    }
+  }
+  printf("  %-8s %9zu voltages: max error %.2e m/s at %.6f V, %.2e of the velocity above 0.01 m/s  %s\n",
+         kernelName(batch.kernel()), U.size(), worstAbsolute, worstU, worstRelative,
+         within ? "ok" : "FAIL");
+  return within;
+}
+
+static bool codeError(FS5Batch& batch, FS5sensor& FS5){
+  uint16_t codes[1024];
+  float v[1024];
+  for (int i = 0; i < 1024; i++){
+    codes[i] = (uint16_t)i;
+  }
+  batch.fromCodes(codes, v, 1024);
+  double worst = 0;
+  bool within = true;
+  for (int i = 0; i < 1024; i++){
+    double reference = FS5.velocityFromVoltage(i/1023.0*5);
+    double error = fabs(v[i] - reference);
+    within &= error <= codeBound*reference;
+    worst = reference > 0 ? fmax(worst, error/reference) : worst;
+  }
+  printf("  %-8s      1024 codes:    max error %.2e of the velocity  %s\n",
+         kernelName(batch.kernel()), worst, within ? "ok" : "FAIL");
+  return within;
+}
+
+//Best time of reps runs of a conversion, printed as a row.
+template<typename F>
+static void measure(const char* name, size_t samples, size_t inBytes, int reps, double baseline,
+                    double& best, F convert){
+  best = 1e9;
+  for (int r = 0; r < reps; r++){
+    WallTimer timer;
+    convert();
+    best = fmin(best, timer.seconds());
+  }
+  printf("  %-28s %9.1f %9.2f %9.1fx\n", name, samples/best*1e-6, inBytes*samples/best*1e-9,
+         baseline > 0 ? baseline/best : 1.0);
+}
+
+int main(int argc, char** argv){
+  size_t samples = (size_t)argValue(argc, argv, "--samples", 1 << 24);
+  size_t logSamples = (size_t)argValue(argc, argv, "--log-samples", 1 << 21);
+  int reps = (int)argValue(argc, argv, "--reps", 3);
+  std::mt19937 rng((uint32_t)argValue(argc, argv, "--seed", 1));
+  bool ok = true;
+
+  FS5sensor FS5(A0, U0, U50, v50, nFS5);
+  FS5Batch batch(U0, U50, v50, nFS5);
+  std::vector<BatchKernel> kernels(1, BATCH_SCALAR);
+  if (FS5Batch::avx2Supported()){
+    kernels.push_back(BATCH_AVX2);
+  }
+  else {
+    printf("no AVX2 and FMA on this CPU, only the scalar kernel\n");
+  }
+
+  printf("Accuracy against FS5sensor::velocityFromVoltage():\n");
+  for (size_t k = 0; k < kernels.size(); k++){
+    batch.setKernel(kernels[k]);
+    ok &= voltageError(batch, FS5, 2.2f, 5.0f);
+    ok &= codeError(batch, FS5);
+  }
+
+  //Random voltages over the range of the ADC and the codes of them.
+  std::vector<float> U(samples), v(samples);
+  std::vector<uint16_t> codes(samples);
+  std::uniform_real_distribution<float> voltage(2.0f, 5.0f);
+  for (size_t i = 0; i < samples; i++){
+    U[i] = voltage(rng);
+    codes[i] = (uint16_t)lrint(U[i]/5*1023);
+  }
+
+  printf("\nThroughput, %zu samples, best of %d:\n", samples, reps);
+  printf("  %-28s %9s %9s %10s\n", "path", "Msample/s", "GB/s in", "speedup");
+  double firmware, seconds;
+  measure("firmware, one at a time", samples, sizeof(float), reps, 0, firmware, [&](){
+    for (size_t i = 0; i < samples; i++){
+      v[i] = (float)FS5.velocityFromVoltage(U[i]);
+    }
+    keep(v[samples - 1]);
+  });
+  for (size_t k = 0; k < kernels.size(); k++){
+    batch.setKernel(kernels[k]);
+    char name[40];
+    snprintf(name, sizeof(name), "voltages, %s", kernelName(kernels[k]));
+    measure(name, samples, sizeof(float), reps, firmware, seconds, [&](){
+      batch.fromVoltages(U.data(), v.data(), samples);
+      keep(v[samples - 1]);
+    });
+    snprintf(name, sizeof(name), "voltages in chunks, %s", kernelName(kernels[k]));
+    measure(name, samples, sizeof(float), reps, firmware, seconds, [&](){
+      for (size_t i = 0; i < samples; i += logChunk){
+        size_t n = samples - i < logChunk ? samples - i : logChunk;
+        batch.fromVoltages(U.data() + i, v.data() + i, n);
+      }
+      keep(v[samples - 1]);
+    });
+    snprintf(name, sizeof(name), "codes, %s", kernelName(kernels[k]));
+    measure(name, samples, sizeof(uint16_t), reps, firmware, seconds, [&](){
+      batch.fromCodes(codes.data(), v.data(), samples);
+      keep(v[samples - 1]);
+    });
+  }
+
+  //Logs on disk, read back in chunks with the fastest kernel.
+  batch.setKernel(kernels.back());
+  logSamples = logSamples < samples ? logSamples : samples;
+  std::vector<float> expected(logSamples), expectedCodes(logSamples);
+  batch.fromVoltages(U.data(), expected.data(), logSamples);
+  batch.fromCodes(codes.data(), expectedCodes.data(), logSamples);
+  char csvPath[] = "batch_bench_csv_XXXXXX";
+  char f32Path[] = "batch_bench_f32_XXXXXX";
+  char u16Path[] = "batch_bench_u16_XXXXXX";
+  int csvFd = mkstemp(csvPath), f32Fd = mkstemp(f32Path), u16Fd = mkstemp(u16Path);
+  FILE* csv = fdopen(csvFd, "w");
+  FILE* f32 = fdopen(f32Fd, "wb");
+  FILE* u16 = fdopen(u16Fd, "wb");
+  fprintf(csv, "time,voltage\n");
+  for (size_t i = 0; i < logSamples; i++){
+    fprintf(csv, "%zu,%.9g\n", i*100, U[i]);
+  }
+  fwrite(U.data(), sizeof(float), logSamples, f32);
+  fwrite(codes.data(), sizeof(uint16_t), logSamples, u16);
+  fclose(csv);
+  fclose(f32);
+  fclose(u16);
+
+  printf("\nLogs of %zu samples, %s kernel:\n", logSamples, kernelName(batch.kernel()));
+  printf("  %-28s %9s %9s %10s\n", "log", "Msample/s", "MB/s", "same");
+  struct {
+    const char* name;
+    const char* path;
+    LogFormat format;
+    int column;
+    bool codes;
+    const std::vector<float>* expected;
+  } logs[3] = {{"CSV, column 1", csvPath, LOG_CSV, 1, false, &expected},
+               {"binary float voltages", f32Path, LOG_F32, 0, false, &expected},
+               {"binary uint16 codes", u16Path, LOG_U16, 0, true, &expectedCodes}};
+  for (int l = 0; l < 3; l++){
+    LogReader reader;
+    reader.open(logs[l].path, logs[l].format, logs[l].column);
+    size_t at = 0;
+    bool same = true;
+    WallTimer timer;
+    uint64_t converted = convertLog(reader, batch, logs[l].codes, [&](const float* velocity, size_t n){
+      same &= at + n <= logSamples && memcmp(velocity, logs[l].expected->data() + at, n*sizeof(float)) == 0;
+      at += n;
+    });
+    seconds = timer.seconds();
+    same &= converted == logSamples && reader.skipped() == (logs[l].format == LOG_CSV ? 1u : 0u);
+    printf("  %-28s %9.1f %9.1f %10s\n", logs[l].name, converted/seconds*1e-6,
+           reader.bytes()/seconds*1e-6, same ? "ok" : "FAIL");
+    ok &= same;
+  }
+  unlink(csvPath);
+  unlink(f32Path);
+  unlink(u16Path);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,179 @@
+/* Filename:      cadenceBench.cpp
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Benchmark of the adaptive cadence of Cadence.h against the fixed
+ *    one, sampling every 100 ms with delay() and scanning every loop.
+ *    The loop() of main.ino runs on the simulated board in calm air,
+ *    near the allowed wind speed and in a gusty wind. The duty cycle is
+ *    the part of the time the MCU is awake, and the current is estimated
+ *    from it with 9 mA active, 2.5 mA idle and 6 uA in power down. The
+ *    current of the motor, from its own 12 V supply, is estimated from
+ *    the time its coils are on, about 90 mA each through the ULN2003.
+ *    The wake-ups and the motor steps are counted per hour, and the mean
+ *    time between the samples of the measuring sequences is printed.
+ *
+ *    Last, the wind steps from calm air to well above the limit at a
+ *    random time, and the time until the first decision to lower is
+ *    compared between the two cadences.
+ *
+ * Usage:
+ *    cadence_bench [--seconds S] [--trials N] [--seed S]
+ */
+
+#include "Arduino.h"
+#include "LoopModel.h"
+#include "GustField.h"
+#include "BenchStats.h"
+#include <random>
+
+//Current of the MCU in each state [mA].
+static const double activeMa = 9;
+static const double idleMa = 2.5;
+static const double powerDownMa = 0.006;
+
+//Current of one coil of the 28byj-48 12V, 130 ohm, through the ULN2003 [mA].
+static const double coilMa = 90;
+
+//Time the MCU spends in each state and what it did meanwhile.
+struct CadenceRun {
+  double duty;                  //Part of the time awake.
+  double currentMa;             //Mean current of the MCU.
+  double motorMa;               //Mean current of the motor.
+  double wakeupsPerHour;
+  double stepsPerHour;
+  double periodMs;              //Mean time between samples of a sequence.
+};
+
+//Runs loop() for a time in a wind, with the adaptive or the fixed
+//cadence.
+static CadenceRun run(SimBoard& board, const SimConfig& config, uint32_t seed, const WindField& wind,
+                      bool adaptive, double seconds){
+  board.reset(config, seed);
+  board.setWind(wind);
+  LoopModel model(true, 115200);
+  model.setAdaptive(adaptive);
+  board.clearCounters();
+  uint64_t start = board.now();
+  double blockedUs;
+  while ((board.now() - start)*1e-6 < seconds){
+    model.loop(board, blockedUs);
+  }
+  double elapsed = board.now() - start;
+  const SimBoard::Counters& counters = board.counters();
+  double idle = counters.idleUs/elapsed;
+  double powerDown = counters.powerDownUs/elapsed;
+  CadenceRun result;
+  result.duty = 1 - idle - powerDown;
+  result.currentMa = result.duty*activeMa + idle*idleMa + powerDown*powerDownMa;
+  result.motorMa = board.coilUs()/elapsed*coilMa;
+  result.wakeupsPerHour = counters.wakeups*3.6e9/elapsed;
+  result.stepsPerHour = counters.steps*3.6e9/elapsed;
+  result.periodMs = model.sequenceSamples() > 0 ?
+                    model.sequencePausedUs()*1e-3/model.sequenceSamples() : 0;
+  return result;
+}
+
+//Time from a step of the wind to the first decision to lower [s],
+//negative if none came.
+static double reaction(SimBoard& board, const SimConfig& config, uint32_t seed, double stepTime,
+                       bool adaptive){
+  board.reset(config, seed);
+  double start = board.now()*1e-6;
+  board.setWind([start, stepTime](double t){
+    return WindSample{t - start < stepTime ? 0.5 : 4.0, 100};
+  });
+  LoopModel model(true, 115200);
+  model.setAdaptive(adaptive);
+  double lowered = -1;
+  model.onDecision([&](double, bool lower){
+    double t = board.now()*1e-6 - start;
+    if (lower && t >= stepTime && lowered < 0){
+      lowered = t - stepTime;
+    }
+  });
+  double blockedUs;
+  while (lowered < 0 && board.now()*1e-6 - start < stepTime + 30){
+    model.loop(board, blockedUs);
+  }
+  return lowered;
+}
+
+int main(int argc, char** argv){
+  double seconds = argValue(argc, argv, "--seconds", 300);
+  int trials = (int)argValue(argc, argv, "--trials", 10);
+  uint32_t seed = (uint32_t)argValue(argc, argv, "--seed", 1);
+  bool ok = true;
+
+  SimConfig config;
+  SimBoard board(config, seed);
+  board.makeCurrent();
+
+  GustParams params;
+  params.meanSpeed = 1.2;
+  params.direction = 100;
+  GustField field(params, seed);
+
+  const char* names[3] = {"calm, 0.5 m/s", "near the limit, 1.8 m/s", "gusty, 1.2 m/s mean"};
+  const WindField winds[3] = {
+    [](double t){ return WindSample{0.5, 100 + 0.1*t}; },
+    [](double t){ return WindSample{1.8, 100 + 0.1*t}; },
+    [&field](double t){ return field.at(t); }
+  };
+
+  printf("Cadence, fixed every %lu ms against adaptive %lu to %u ms, %.0f s per wind\n\n",
+         samplePeriod, samplePeriod, sparsePeriod, seconds);
+  printf("  %-26s %-9s %8s %10s %10s %12s %12s %12s\n", "wind", "cadence", "duty", "MCU", "motor",
+         "wakeups/h", "steps/h", "period");
+  CadenceRun fixed[3], adaptive[3];
+  for (int w = 0; w < 3; w++){
+    fixed[w] = run(board, config, seed + w, winds[w], false, seconds);
+    adaptive[w] = run(board, config, seed + w, winds[w], true, seconds);
+    const CadenceRun* runs[2] = {&fixed[w], &adaptive[w]};
+    for (int a = 0; a < 2; a++){
+      printf("  %-26s %-9s %7.1f%% %7.2f mA %7.2f mA %12.0f %12.0f %9.0f ms\n", a ? "" : names[w],
+             a ? "adaptive" : "fixed", runs[a]->duty*100, runs[a]->currentMa, runs[a]->motorMa,
+             runs[a]->wakeupsPerHour, runs[a]->stepsPerHour, runs[a]->periodMs);
+    }
+  }
+
+  //From calm air to 4 m/s at a random time.
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> stepTime(20, 80);
+  Summary fixedReaction, adaptiveReaction;
+  int missed = 0;
+  for (int t = 0; t < trials; t++){
+    double at = stepTime(rng);
+    double a = reaction(board, config, seed + 10 + t, at, false);
+    double b = reaction(board, config, seed + 10 + t, at, true);
+    missed += (a < 0 ? 1 : 0) + (b < 0 ? 1 : 0);
+    if (a >= 0 && b >= 0){
+      fixedReaction.add(a);
+      adaptiveReaction.add(b);
+    }
+  }
+  printf("\nTime from a step to 4 m/s to the decision to lower, %d trials\n", trials);
+  Summary::printHeader();
+  fixedReaction.printRow("fixed [s]");
+  adaptiveReaction.printRow("adaptive [s]");
+
+  //In calm air the MCU should sleep most of the time, near the limit
+  //sample as densely as the fixed cadence, and a step of the wind be
+  //seen at most one sparse period later. In calm air the coils are on
+  //only while scanning, well below the current of holding the motor.
+  bool saves = adaptive[0].duty < fixed[0].duty/2;
+  bool dense = adaptive[1].periodMs <= samplePeriod*1.5;
+  bool reacts = missed == 0 && fixedReaction.count() > 0 &&
+                adaptiveReaction.max() <= fixedReaction.max() + sparsePeriod*1e-3 + 1;
+  bool released = adaptive[0].motorMa < coilMa/5;
+  printf("\nDuty in calm air below half the fixed:     %s\n", saves ? "ok" : "FAIL");
+  printf("Dense near the limit:                      %s\n", dense ? "ok" : "FAIL");
+  printf("Reaction within a sparse period of fixed:  %s\n", reacts ? "ok" : "FAIL");
+  printf("Coils off between scans in calm air:       %s\n", released ? "ok" : "FAIL");
+  ok = saves && dense && reacts && released;
+  return ok ? 0 : 1;
+}
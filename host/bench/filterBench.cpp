@@ -0,0 +1,243 @@
+/* Filename:      filterBench.cpp
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Checks and benchmarks the fixed-point filters in FS5Filter.h.
+ *
+ *    Step responses: OnePoleLowPass against the float FilterOnePole
+ *    that FS5sensor used before, at a sample every 1 ms, every 100 ms
+ *    and at a jittering rate, and with samples 2.1 to 4.2 s apart, where
+ *    dt is 32768 and more. MovingAverage and BiquadLowPass against
+ *    the same filters in double precision.
+ *
+ *    Isolation: one FS5sensor read every 100 ms, alone and with a second
+ *    sensor on another pin read every 1 ms in between. The outputs must
+ *    be identical. The same sequence through
+ *    one shared FilterOnePole shows the interference of the former
+ *    global filter.
+ *
+ *    Cost: host time per sample of each filter chain.
+ *
+ *    The run fails if a response is off by more than 1 % of the step.
+ *
+ * Usage:
+ *    filter_bench [--samples N] [--seed S]
+ */
+
+#include "Arduino.h"
+#include "FS5.h"
+#include "FS5Filter.h"
+#include "Filters.h"
+#include "SimBoard.h"
+#include "BenchStats.h"
+
+static const double errorBound = 0.01;      //Allowed error relative to the step.
+static const double stepFrom = 460;         //ADC code before the step.
+static const double stepTo = 700;           //ADC code after the step.
+
+//Largest error of OnePoleLowPass against FilterOnePole over a step, with
+//samples spaced by the given generator, relative to the step.
+template<typename Spacing>
+static double onePoleError(SimBoard& board, double frequency, double seconds, Spacing spacing){
+  FilterOnePole reference(LOWPASS, frequency, stepFrom);
+  OnePoleLowPass filter;
+  filter.setup(frequency, 0);
+  filter.input((FilterSample)(stepFrom*32), 0);
+
+  double worst = 0;
+  uint64_t start = board.now();
+  unsigned long last = micros();
+  while ((board.now() - start)*1e-6 < seconds){
+    board.advance(spacing());
+    unsigned long now = micros();
+    uint16_t dt = (now - last) >> 6;
+    last += (unsigned long)dt << 6;       //Keep the rounding of dt.
+    double expected = reference.input(stepTo);
+    double actual = filter.input((FilterSample)(stepTo*32), dt)/32.0;
+    worst = fmax(worst, fabs(actual - expected));
+  }
+  return worst/(stepTo - stepFrom);
+}
+
+//Double precision moving average of the last n samples.
+static double movingAverageError(int samples){
+  MovingAverage<8> filter;
+  filter.setup(0, 0);
+  double history[8];
+  double worst = 0;
+  for (int i = 0; i < samples; i++){
+    double x = i < 4 ? stepFrom : stepTo;
+    history[i % 8] = x;
+    if (i == 0){
+      for (int k = 0; k < 8; k++){
+        history[k] = x;
+      }
+    }
+    double expected = 0;
+    for (int k = 0; k < 8; k++){
+      expected += history[k]/8;
+    }
+    double actual = filter.input((FilterSample)(x*32), 0)/32.0;
+    worst = fmax(worst, fabs(actual - expected));
+  }
+  return worst/(stepTo - stepFrom);
+}
+
+//Double precision Butterworth biquad with the same design.
+static double biquadError(double frequency, unsigned long periodUs, int samples){
+  BiquadLowPass filter;
+  filter.setup(frequency, periodUs);
+  double w = 2*PI*frequency*periodUs*1e-6;
+  double alpha = sin(w)/(2*0.70710678);
+  double a0 = 1 + alpha;
+  double b0 = (1 - cos(w))/2/a0, b1 = 2*b0, b2 = b0;
+  double a1 = -2*cos(w)/a0, a2 = (1 - alpha)/a0;
+
+  double x1 = stepFrom, x2 = stepFrom, y1 = stepFrom, y2 = stepFrom;
+  filter.input((FilterSample)(stepFrom*32), 0);
+  double worst = 0;
+  for (int i = 0; i < samples; i++){
+    double x = stepTo;
+    double y = b0*x + b1*x1 + b2*x2 - a1*y1 - a2*y2;
+    x2 = x1;
+    x1 = x;
+    y2 = y1;
+    y1 = y;
+    double actual = filter.input((FilterSample)(x*32), 0)/32.0;
+    worst = fmax(worst, fabs(actual - y));
+  }
+  return worst/(stepTo - stepFrom);
+}
+
+//Reads sensor A every 100 ms for 5 s on a fresh board, in a wind that
+//picks up after 1 s. With pair, sensor B is read every 1 ms in between.
+//Returns the readings of sensor A.
+template<typename ReadA, typename ReadB>
+static std::vector<double> readPattern(const SimConfig& config, bool pair, ReadA readA, ReadB readB){
+  SimBoard board(config, 1);
+  board.makeCurrent();
+  board.setWind([](double t){ WindSample w = {t > 1 ? 8.0 : 1.0, 100}; return w; });
+  std::vector<double> readings;
+
+  //The reads start at fixed times, whatever the reads before them cost.
+  double start = board.now();
+  for (int i = 0; i < 50; i++){
+    for (int k = 1; k < 100 && pair; k++){
+      board.advance(start + 100000.0*i + 1000.0*k - config.analogReadUs - board.now());
+      readB();
+    }
+    board.advance(start + 100000.0*(i + 1) - config.analogReadUs - board.now());
+    readings.push_back(readA());
+  }
+  return readings;
+}
+
+//Host time per sample of a filter chain.
+template<typename Chain>
+static double chainNs(const char* name, long samples, const std::vector<FilterSample>& input){
+  Chain chain;
+  chain.setup(5, 1000);
+  long sum = 0;
+  WallTimer timer;
+  for (long i = 0; i < samples; i++){
+    sum += chain.input(input[i & 4095], 16);
+  }
+  double ns = timer.seconds()/samples*1e9;
+  keep(sum);
+  printf("  %-34s %8.2f ns\n", name, ns);
+  return ns;
+}
+
+int main(int argc, char** argv){
+  long samples = (long)argValue(argc, argv, "--samples", 2e7);
+  uint32_t seed = (uint32_t)argValue(argc, argv, "--seed", 1);
+  bool ok = true;
+
+  SimConfig config;
+  config.noiseVolts = 0;
+  SimBoard board(config, seed);
+  board.makeCurrent();
+  std::mt19937 rng(seed);
+
+  //Step responses.
+  printf("step response %.0f -> %.0f, max error relative to the step\n", stepFrom, stepTo);
+  std::uniform_real_distribution<double> jitter(500, 1500);
+  std::uniform_real_distribution<double> sparse(2.1e6, 4.19e6);
+  double errors[7];
+  errors[0] = onePoleError(board, 0.3, 3, [](){ return 1000.0; });
+  errors[1] = onePoleError(board, 0.3, 3, [](){ return 100000.0; });
+  errors[2] = onePoleError(board, 0.3, 3, [&](){ return jitter(rng); });
+  errors[3] = movingAverageError(64);
+  errors[4] = biquadError(5, 1000, 2000);
+  errors[5] = onePoleError(board, 0.3, 20, [](){ return 4e6; });
+  errors[6] = onePoleError(board, 0.01, 120, [&](){ return sparse(rng); });
+  const char* names[7] = {
+    "one pole 0.3 Hz, every 1 ms", "one pole 0.3 Hz, every 100 ms",
+    "one pole 0.3 Hz, every 0.5-1.5 ms", "moving average of 8", "biquad 5 Hz, every 1 ms",
+    "one pole 0.3 Hz, every 4 s", "one pole 0.01 Hz, every 2.1-4.2 s"
+  };
+  for (int i = 0; i < 7; i++){
+    bool within = errors[i] <= errorBound;
+    printf("  %-34s %8.4f %%  %s\n", names[i], 100*errors[i], within ? "ok" : "OUT OF BOUND");
+    ok &= within;
+  }
+
+  //Two sensors, one read every 100 ms and one on another pin, at 0 V, 
+  //read every 1 ms in between. The wind picks up after 1 s. The filters are
+  //made at time 0, like the boards of the runs.
+  SimBoard origin(config, seed);
+  origin.makeCurrent();
+  FS5sensor alone(A0, 2.24, 3.33, 8, 0.51);
+  FS5sensor sensorA(A0, 2.24, 3.33, 8, 0.51);
+  FS5sensor sensorB(A1, 2.24, 3.33, 8, 0.51);
+  FilterOnePole globalAlone(LOWPASS, 0.3);
+  FilterOnePole globalPair(LOWPASS, 0.3);
+  std::vector<double> aloneOut = readPattern(config, false,
+      [&](){ return alone.voltage(); }, [](){ return 0.0; });
+  std::vector<double> pairOut = readPattern(config, true,
+      [&](){ return sensorA.voltage(); }, [&](){ return sensorB.voltage(); });
+  std::vector<double> globalAloneOut = readPattern(config, false,
+      [&](){ return (double)globalAlone.input(analogRead(A0)/1023.0*5); }, [](){ return 0.0; });
+  std::vector<double> globalPairOut = readPattern(config, true,
+      [&](){ return (double)globalPair.input(analogRead(A0)/1023.0*5); },
+      [&](){ return (double)globalPair.input(analogRead(A1)/1023.0*5); });
+
+  double isolation = 0;
+  double interference = 0;
+  for (size_t i = 0; i < aloneOut.size(); i++){
+    isolation = fmax(isolation, fabs(pairOut[i] - aloneOut[i]));
+    interference = fmax(interference, fabs(globalPairOut[i] - globalAloneOut[i]));
+  }
+  printf("sensor read every 100 ms with a second sensor read every 1 ms\n");
+  printf("  %-34s max difference %.4f V  %s\n", "per-sensor fixed-point filters", isolation,
+         isolation == 0 ? "ok" : "FAIL");
+  printf("  %-34s max difference %.4f V\n", "one shared FilterOnePole", interference);
+  ok &= isolation == 0;
+
+  //Cost per sample.
+  board.makeCurrent();
+  std::uniform_int_distribution<int> code(460*32, 700*32);
+  std::vector<FilterSample> input(4096);
+  for (size_t i = 0; i < input.size(); i++){
+    input[i] = (FilterSample)code(rng);
+  }
+  printf("host time per sample, %ld samples\n", samples);
+  FilterOnePole floatFilter(LOWPASS, 0.3);
+  WallTimer timer;
+  double sum = 0;
+  for (long i = 0; i < samples; i++){
+    sum += floatFilter.input(input[i & 4095]/32.0);
+  }
+  keep(sum);
+  printf("  %-34s %8.2f ns\n", "FilterOnePole (float, exp)", timer.seconds()/samples*1e9);
+  chainNs<FilterChain<OnePoleLowPass> >("OnePoleLowPass", samples, input);
+  chainNs<FilterChain<MovingAverage<8> > >("MovingAverage<8>", samples, input);
+  chainNs<FilterChain<BiquadLowPass> >("BiquadLowPass", samples, input);
+  chainNs<FilterChain<MovingAverage<4>, OnePoleLowPass> >("MovingAverage<4>, OnePoleLowPass", samples, input);
+  chainNs<FilterChain<MovingAverage<4>, BiquadLowPass> >("MovingAverage<4>, BiquadLowPass", samples, input);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,154 @@
+/* Filename:      fs5TableBench.cpp
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Verifies and benchmarks the velocity table of FS5sensor. The table
+ *    is compared with the original velocity formula (four pow() calls per
+ *    sample) at every 1/16 ADC code, the way a filtered voltage arrives.
+ *    The run fails if the interpolated table is off by more than
+ *    0.01 m/s or 0.1 % of the velocity, whichever is larger, anywhere in
+ *    the ADC range.
+ *
+ *    The table and constants that the compiler builds for FS5Fixed, see
+ *    FS5Fixed.h, have to agree with those of FS5sensor to float and
+ *    1e-9 precision.
+ *
+ * Usage:
+ *    fs5_table_bench [--conversions N] [--seed S]
+ */
+
+#include "Arduino.h"
+#include "FS5.h"
+#include "FS5Fixed.h"
+#include "BenchStats.h"
+#include <random>
+
+//Volatile so the compiler cannot fold the reference formula.
+static volatile double U0 = 2.24;
+static volatile double U50 = 3.33;
+static volatile double v50 = 8;
+static volatile double nFS5 = 0.51;
+static const double errorBound = 0.01;    //Allowed table error [m/s].
+static const double relativeBound = 0.001;  //Allowed relative table error.
+
+//The velocity formula as it was in FS5sensor::velocity().
+static double originalVelocity(double U){
+  double k = (pow(U50/U0, 2) - 1)/pow(v50, nFS5);
+  if (U < U0){
+    U = U0;
+  }
+  return (pow(((U - U0)*(U + U0)), (1/nFS5)))/(pow(k, (1/nFS5))*(pow(U0, (2/nFS5))));
+}
+
+//Largest error of the table against the original formula. Sets within
+//to false if the error bound is exceeded anywhere.
+static double tableError(FS5sensor& FS5, FS5Table& table, bool interpolate,
+                         double& worstCode, bool& within){
+  FS5.useTable(&table, interpolate);
+  double worst = 0;
+  within = true;
+  for (int i = 0; i <= 1023*16; i++){
+    double code = i/16.0;
+    double reference = originalVelocity(code/1023.0*5);
+    double error = fabs(table.lookup(code) - reference);
+    within &= error <= fmax(errorBound, relativeBound*reference);
+    if (error > worst){
+      worst = error;
+      worstCode = code;
+    }
+  }
+  return worst;
+}
+
+int main(int argc, char** argv){
+  long conversions = (long)argValue(argc, argv, "--conversions", 5e6);
+  uint32_t seed = (uint32_t)argValue(argc, argv, "--seed", 1);
+
+  FS5sensor FS5(A0, U0, U50, v50, nFS5);
+  FS5Table table;
+
+  double worstCode = 0;
+  double formulaError = 0;
+  for (int i = 0; i <= 1023*16; i++){
+    double U = i/16.0/1023.0*5;
+    formulaError = fmax(formulaError, fabs(FS5.velocityFromVoltage(U) - originalVelocity(U)));
+  }
+  bool within;
+  double nearestError = tableError(FS5, table, false, worstCode, within);
+  double nearestCode = worstCode;
+  double interpError = tableError(FS5, table, true, worstCode, within);
+
+  //Error where the flag decisions are made, below 20 m/s.
+  double lowError = 0;
+  for (int i = 0; i <= 1023*16; i++){
+    double code = i/16.0;
+    double reference = originalVelocity(code/1023.0*5);
+    if (reference < 20){
+      lowError = fmax(lowError, fabs(table.lookup(code) - reference));
+    }
+  }
+
+  printf("FS5 velocity table: shift %d, %d knots from code %d, %u bytes\n",
+         FS5_TABLE_SHIFT, table.knots, table.startCode, (unsigned)sizeof(table.velocity));
+  printf("  max error, precomputed formula   %.2e m/s\n", formulaError);
+  printf("  max error, nearest knot          %.4f m/s at code %.2f\n", nearestError, nearestCode);
+  printf("  max error, interpolated          %.4f m/s at code %.2f (%s)\n",
+         interpError, worstCode, within ? "within bound" : "OUT OF BOUND");
+  printf("  max error, interpolated < 20 m/s %.4f m/s\n", lowError);
+
+  //The table of the compiler against the one of FS5sensor.
+  typedef FS5Constants<HotswapPole> Fixed;
+  const float* fixedTable = FS5FixedTable<HotswapPole>::velocity;
+  bool sameKnots = Fixed::knots == table.knots && Fixed::startCode == table.startCode;
+  double rootError = 0;
+  for (int i = 0; sameKnots && i < table.knots; i++){
+    rootError = fmax(rootError, fabs(pgm_read_float(&fixedTable[i]) - table.velocity[i])/fmax(table.velocity[i], 1e-3));
+  }
+  double constantError = 0;
+  for (int i = 0; i <= 1023*16; i++){
+    double U = i/16.0/1023.0*5;
+    double reference = FS5.velocityFromVoltage(U);
+    constantError = fmax(constantError, fabs(FS5Fixed<HotswapPole>::velocityFromVoltage(U) - reference)/fmax(reference, 1e-3));
+  }
+  bool fixedWithin = sameKnots && rootError <= 1e-6 && constantError <= 1e-9;
+  printf("  compile time table, %d knots      %.1e relative, constants %.1e (%s)\n", Fixed::knots,
+         rootError, constantError, fixedWithin ? "ok" : "FAIL");
+
+  //Fractional codes in the range a filtered FS5 signal covers.
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> codeDist(400, 1023);
+  std::vector<double> codes(4096);
+  for (size_t i = 0; i < codes.size(); i++){
+    codes[i] = codeDist(rng);
+  }
+
+  double sum = 0;
+  WallTimer original;
+  for (long i = 0; i < conversions; i++){
+    sum += originalVelocity(codes[i & 4095]/1023.0*5);
+  }
+  double originalNs = original.seconds()/conversions*1e9;
+
+  WallTimer formula;
+  for (long i = 0; i < conversions; i++){
+    sum += FS5.velocityFromVoltage(codes[i & 4095]/1023.0*5);
+  }
+  double formulaNs = formula.seconds()/conversions*1e9;
+
+  WallTimer lookup;
+  for (long i = 0; i < conversions; i++){
+    sum += table.lookup(codes[i & 4095]);
+  }
+  double lookupNs = lookup.seconds()/conversions*1e9;
+  keep(sum);
+
+  printf("  original formula (4 x pow)       %8.2f ns\n", originalNs);
+  printf("  precomputed formula (1 x pow)    %8.2f ns  %5.1fx\n", formulaNs, originalNs/formulaNs);
+  printf("  interpolated table               %8.2f ns  %5.1fx\n", lookupNs, originalNs/lookupNs);
+
+  return within && fixedWithin ? 0 : 1;
+}
@@ -0,0 +1,283 @@
+/* Filename:      gustBench.cpp
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Benchmark of the gust statistics in GustStats.h on the wind of a
+ *    GustField sampled every 100 ms. Every few samples the statistics
+ *    of each window are checked against the exact ones of the samples
+ *    the window covers: the mean, the standard deviation and the peak
+ *    to rounding. The error of the P² percentile relative to the
+ *    standard deviation is printed for the wind and checked against a
+ *    bound on stationary samples, where the estimator converges. The
+ *    time per sample is measured with short and with ten times longer
+ *    windows, which should cost the same. The windows are checked to
+ *    cover their length of time, not of samples, with the samples 0.1
+ *    to 4 s apart like with the adaptive cadence.
+ *
+ *    Last, for every episode of the field with the 3 s mean above the
+ *    limit, the first sample at which the median of N samples and the
+ *    short window percentile are above the limit are compared.
+ *
+ * Usage:
+ *    gust_bench [--minutes M] [--seed S] [--limit L]
+ */
+
+#include "Arduino.h"
+#include "GustStats.h"
+#include "RunningMedian.h"
+#include "GustField.h"
+#include "BenchStats.h"
+#include <random>
+
+static const double samplePeriod = 0.1;       //[s]
+static const double percentile = 0.9;
+static const char* windowNames[GUST_WINDOWS] = {"3 s", "1 min", "10 min"};
+
+//Exact percentile p of samples, interpolated between the ranks like
+//the P² markers.
+static double exactPercentile(std::vector<double> samples, double p){
+  double position = (samples.size() - 1)*p;
+  size_t low = (size_t)position;
+  std::nth_element(samples.begin(), samples.begin() + low, samples.end());
+  double below = samples[low];
+  if (low + 1 >= samples.size()){
+    return below;
+  }
+  double above = *std::min_element(samples.begin() + low + 1, samples.end());
+  return below + (position - low)*(above - below);
+}
+
+//Time of sample i every samplePeriod [ms].
+static unsigned long sampleMs(size_t i){
+  return (unsigned long)(i*samplePeriod*1000 + 0.5);
+}
+
+//Wind speed samples of the field with sensor noise.
+static std::vector<double> makeWind(GustField& field, size_t count, uint32_t seed){
+  std::mt19937 rng(seed);
+  std::normal_distribution<double> noise(0, 0.05);
+  std::vector<double> samples(count);
+  for (size_t i = 0; i < count; i++){
+    double speed = field.at(i*samplePeriod).speed + noise(rng);
+    samples[i] = speed > 0 ? speed : 0;
+  }
+  return samples;
+}
+
+//Errors of the percentile relative to the standard deviation, checked
+//every 10 samples of full windows.
+static void checkPercentile(const std::vector<double>& samples, GustStats& gusts, Summary* errors,
+                            Summary* covered){
+  for (size_t i = 0; i < samples.size(); i++){
+    gusts.add(samples[i], sampleMs(i));
+    if (i % 10 != 9){
+      continue;
+    }
+    for (uint8_t w = 0; w < GUST_WINDOWS; w++){
+      size_t n = gusts.count(w);
+      double deviation = gusts.statistic(w, GUST_DEVIATION);
+      if (gusts.full(w) && deviation > 0){
+        std::vector<double> window(samples.begin() + (i + 1 - n), samples.begin() + (i + 1));
+        double error = gusts.statistic(w, GUST_PERCENTILE) - exactPercentile(window, percentile);
+        errors[w].add(fabs(error)/deviation);
+        covered[w].add(n);
+      }
+    }
+  }
+}
+
+//Prints the percentile errors of each window and returns true if the
+//mean and the 95th percentile are within the bounds of the window, if
+//given.
+static bool printPercentile(const char* title, Summary* errors, Summary* covered, const double* meanBound,
+                            const double* p95Bound){
+  printf("%s\n", title);
+  printf("  %-24s %12s %12s %12s %12s %12s\n", "window", "mean", "p50", "p95", "p99", "max");
+  bool ok = true;
+  for (uint8_t w = 0; w < GUST_WINDOWS; w++){
+    char name[40];
+    snprintf(name, sizeof(name), "%s (%.0f samples)", windowNames[w], covered[w].mean());
+    errors[w].printRow(name);
+    ok &= !meanBound || (errors[w].mean() < meanBound[w] && errors[w].percentile(95) < p95Bound[w]);
+  }
+  return ok;
+}
+
+//Nanoseconds per sample with the windows of the given lengths, best of
+//a few runs.
+static double timeAdd(const std::vector<double>& samples, unsigned long shortWindow){
+  double best = 1e30;
+  for (int run = 0; run < 5; run++){
+    GustStats gusts(percentile);
+    gusts.setWindow(GUST_SHORT, shortWindow);
+    gusts.setWindow(GUST_MINUTE, shortWindow*20);
+    gusts.setWindow(GUST_LONG, shortWindow*200);
+    WallTimer timer;
+    for (size_t i = 0; i < samples.size(); i++){
+      gusts.add(samples[i], sampleMs(i));
+    }
+    double seconds = timer.seconds();
+    keep(gusts.statistic(GUST_LONG, GUST_PERCENTILE));
+    best = seconds < best ? seconds : best;
+  }
+  return best/samples.size()*1e9;
+}
+
+int main(int argc, char** argv){
+  double minutes = argValue(argc, argv, "--minutes", 120);
+  uint64_t seed = (uint64_t)argValue(argc, argv, "--seed", 1);
+  double limit = argValue(argc, argv, "--limit", 3);
+  size_t count = (size_t)(minutes*60/samplePeriod);
+
+  GustParams params;
+  params.meanSpeed = 2.5;
+  GustField field(params, seed);
+  field.setThreshold(limit, 3);
+  std::vector<double> samples = makeWind(field, count, (uint32_t)seed);
+
+  printf("Gust statistics, %.0f min of wind sampled every %.0f ms, percentile %.0f\n\n",
+         minutes, samplePeriod*1000, percentile*100);
+
+  //Mean, deviation and peak against the exact ones of the covered
+  //samples.
+  GustStats gusts(percentile);
+  double worstMean = 0, worstDeviation = 0, worstPeak = 0;
+  for (size_t i = 0; i < count; i++){
+    gusts.add(samples[i], sampleMs(i));
+    if (i % 10 != 9){
+      continue;
+    }
+    for (uint8_t w = 0; w < GUST_WINDOWS; w++){
+      size_t n = gusts.count(w);
+      std::vector<double> window(samples.begin() + (i + 1 - n), samples.begin() + (i + 1));
+      double mean = 0, peak = window[0];
+      for (double x : window){
+        mean += x;
+        peak = x > peak ? x : peak;
+      }
+      mean /= n;
+      double squares = 0;
+      for (double x : window){
+        squares += (x - mean)*(x - mean);
+      }
+      double deviation = n > 1 ? sqrt(squares/(n - 1)) : 0;
+      worstMean = std::max(worstMean, fabs(gusts.statistic(w, GUST_MEAN) - mean));
+      worstDeviation = std::max(worstDeviation, fabs(gusts.statistic(w, GUST_DEVIATION) - deviation));
+      worstPeak = std::max(worstPeak, fabs(gusts.statistic(w, GUST_PEAK) - peak));
+    }
+  }
+  printf("Largest error of the mean %.2e, deviation %.2e, peak %.2e m/s\n\n",
+         worstMean, worstDeviation, worstPeak);
+
+  //P² against the exact percentile, on the wind and on stationary
+  //samples. On the wind the drift and the gusts within a window move
+  //the percentile faster than the markers follow, so the error depends
+  //on the seed and is only printed. In the short window five markers
+  //are a good part of the 15 to 30 samples.
+  const double flatMean[GUST_WINDOWS] = {0.25, 0.05, 0.05};
+  const double flatP95[GUST_WINDOWS] = {0.75, 0.15, 0.15};
+  Summary windError[GUST_WINDOWS], windCovered[GUST_WINDOWS];
+  GustStats windGusts(percentile);
+  checkPercentile(samples, windGusts, windError, windCovered);
+  printPercentile("P2 percentile error on the wind, relative to the standard deviation",
+                  windError, windCovered, 0, 0);
+
+  std::mt19937 rng((uint32_t)seed);
+  std::normal_distribution<double> stationary(params.meanSpeed, 0.5);
+  std::vector<double> flat(std::min(count, (size_t)24000));
+  for (size_t i = 0; i < flat.size(); i++){
+    flat[i] = stationary(rng);
+  }
+  Summary flatError[GUST_WINDOWS], flatCovered[GUST_WINDOWS];
+  GustStats flatGusts(percentile);
+  checkPercentile(flat, flatGusts, flatError, flatCovered);
+  printf("\n");
+  bool percentileOk = printPercentile("P2 percentile error on stationary samples", flatError, flatCovered,
+                                      flatMean, flatP95);
+
+  //The same cost with ten times longer windows.
+  double shortNs = timeAdd(samples, 3000);
+  double longNs = timeAdd(samples, 30000);
+  printf("\nTime per sample, windows 3 s/1 min/10 min: %.1f ns, 30 s/10 min/100 min: %.1f ns\n",
+         shortNs, longNs);
+
+  //Samples 0.1 to 4 s apart, in stretches like those of the adaptive
+  //cadence. The covered samples of a full window span less than the
+  //window and at least half of it less the time before the first.
+  std::uniform_int_distribution<int> stretch(5, 50);
+  std::uniform_real_distribution<double> periodMs(100, 4000);
+  std::vector<unsigned long> times;
+  unsigned long now = 0;
+  while (times.size() < count){
+    unsigned long period = (unsigned long)periodMs(rng);
+    for (int k = stretch(rng); k > 0; k--){
+      times.push_back(now);
+      now += period;
+    }
+  }
+  GustStats sparse(percentile);
+  const unsigned long lengthMs[GUST_WINDOWS] = {3000, 60000, 600000};
+  bool spans = true;
+  for (size_t i = 0; i < count; i++){
+    sparse.add(samples[i], times[i]);
+    for (uint8_t w = 0; w < GUST_WINDOWS; w++){
+      size_t n = sparse.count(w);
+      size_t first = i + 1 - n;
+      unsigned long span = times[i] - times[first];
+      unsigned long before = first > 0 ? times[first] - times[first - 1] : 0;
+      spans &= span < lengthMs[w] && (!sparse.full(w) || span + before >= lengthMs[w]/2);
+    }
+  }
+  printf("Windows of time with samples 0.1 to 4 s apart, 10 min over %zu samples, %.1f h\n",
+         (size_t)sparse.count(GUST_LONG), now/3.6e6);
+
+  //First sample above the limit in every episode, by the median of N
+  //samples and by the short window percentile.
+  const uint8_t N = 11;
+  RunningMedian<double, N> median;
+  GustStats detector(percentile);
+  std::vector<double> medianFirst(count, -1), gustFirst(count, -1);
+  std::vector<bool> medianAbove(count), gustAbove(count);
+  for (size_t i = 0; i < count; i++){
+    median.add(samples[i]);
+    detector.add(samples[i], sampleMs(i));
+    medianAbove[i] = median.full() && median.median() > limit;
+    gustAbove[i] = detector.statistic(GUST_SHORT, GUST_PERCENTILE) > limit;
+  }
+  size_t episodes = 0, medianCaught = 0, gustCaught = 0;
+  Summary lead;
+  for (const GustEpisode& episode : field.episodes()){
+    double end = episode.end < 0 ? count*samplePeriod : episode.end;
+    size_t first = (size_t)((episode.start - 3)/samplePeriod > 0 ? (episode.start - 3)/samplePeriod : 0);
+    size_t last = std::min(count, (size_t)(end/samplePeriod) + 1);
+    long medianAt = -1, gustAt = -1;
+    for (size_t i = first; i < last; i++){
+      medianAt = (medianAt < 0 && medianAbove[i]) ? (long)i : medianAt;
+      gustAt = (gustAt < 0 && gustAbove[i]) ? (long)i : gustAt;
+    }
+    episodes++;
+    medianCaught += medianAt >= 0 ? 1 : 0;
+    gustCaught += gustAt >= 0 ? 1 : 0;
+    if (medianAt >= 0 && gustAt >= 0){
+      lead.add((medianAt - gustAt)*samplePeriod);
+    }
+  }
+  printf("\nEpisodes with the 3 s mean above %.1f m/s: %zu\n", limit, episodes);
+  printf("  caught by the median of %u samples:   %zu\n", N, medianCaught);
+  printf("  caught by the 3 s percentile:         %zu\n", gustCaught);
+  if (lead.count() > 0){
+    printf("  percentile ahead of the median by %.2f s on average, %.2f s at most\n", lead.mean(), lead.max());
+  }
+
+  bool exact = worstMean < 1e-9 && worstDeviation < 1e-9 && worstPeak == 0;
+  bool constant = longNs < shortNs*1.5;
+  printf("\nMean, deviation and peak exact: %s\n", exact ? "ok" : "FAIL");
+  printf("Percentile within bound:        %s\n", percentileOk ? "ok" : "FAIL");
+  printf("Cost independent of the window: %s\n", constant ? "ok" : "FAIL");
+  printf("Windows cover their time:       %s\n", spans ? "ok" : "FAIL");
+  return exact && percentileOk && constant && spans ? 0 : 1;
+}
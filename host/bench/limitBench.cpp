@@ -0,0 +1,159 @@
+/* Filename:      limitBench.cpp
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Verifies the limit switch watched by the pin change interrupt, see
+ *    LimitSwitch.h, on the simulated board with a bouncing switch.
+ *
+ *    The first part steps the motor cw into the switch at several rates
+ *    and looks at the switch only every few steps. The step the switch
+ *    closed at, the steps taken less overshoot(), has to be the first
+ *    step at which the contact closes, however late it is looked at.
+ *
+ *    The second part runs full scans of both search modes from random
+ *    start angles, with the wind close to the ccw stop so that the
+ *    coarse sweep reaches it too. The start position and the span have
+ *    to be exactly the steps where the switch closes, and the scan may
+ *    read the pin only in the interrupt and just after bounces, not at
+ *    every step.
+ *
+ * Usage:
+ *    limit_bench [--trials N] [--bounces B] [--bounce-us T] [--seed S]
+ */
+
+#include "Arduino.h"
+#include "CheapStepper.h"
+#include "Controller.h"
+#include "LimitSwitch.h"
+#include "SimBoard.h"
+#include "BenchStats.h"
+
+//Same setup as main.ino.
+static const int pinFS5 = A0;
+static const double U0 = 2.24;
+static const double U50 = 3.33;
+static const double v50 = 8;
+static const double nFS5 = 0.51;
+static const int IN1 = 10;
+static const int IN2 = 9;
+static const int IN3 = 8;
+static const int IN4 = 7;
+static const int pinLS = 12;
+
+static const unsigned int debounceUs = 2000;
+static const unsigned long extraReads = 8;    //Pin reads allowed per scan besides the interrupts.
+
+//Shaft position of the first step with the switch closed at the cw and
+//the ccw stop.
+static long cwStopStep(const SimConfig& config){
+  return (long)ceil((config.cwStopDeg - config.startDeg)*config.stepsPerRev/360 - 1e-9);
+}
+
+static long ccwStopStep(const SimConfig& config){
+  return (long)floor((config.ccwStopDeg - config.startDeg)*config.stepsPerRev/360 + 1e-9);
+}
+
+int main(int argc, char** argv){
+  int trials = (int)argValue(argc, argv, "--trials", 200);
+  uint32_t seed = (uint32_t)argValue(argc, argv, "--seed", 1);
+  SimConfig config;
+  config.switchBounces = (int)argValue(argc, argv, "--bounces", 5);
+  config.switchBounceUs = argValue(argc, argv, "--bounce-us", 1500);
+  bool ok = true;
+
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> startDeg(config.ccwStopDeg + 1, config.cwStopDeg - 1);
+  SimBoard board(config, seed);
+  board.makeCurrent();
+
+  printf("limit switch, %d bounces within %.0f us, lockout %u us\n",
+         config.switchBounces, config.switchBounceUs, debounceUs);
+
+  //Steps into the switch, looked at every few steps.
+  const unsigned int rates[3] = {300, 1092, 1600};
+  const int looks[3] = {1, 16, 128};
+  printf("\nSwitch position latched by the interrupt, %d runs each:\n", trials/10);
+  printf("  %-12s %-10s %10s %10s %10s\n", "rate [1/s]", "look every", "exact", "overshoot", "pin reads");
+  for (int r = 0; r < 3; r++){
+    for (int l = 0; l < 3; l++){
+      int exact = 0;
+      Summary overshoot, reads;
+      for (int t = 0; t < trials/10; t++){
+        config.startDeg = config.cwStopDeg - 10 - startDeg(rng)/20;
+        board.reset(config, seed + t);
+        CheapStepper stepper(IN1, IN2, IN3, IN4);
+        LimitSwitch limit(pinLS, debounceUs);
+        limit.begin();
+        board.clearCounters();
+        long steps = 0;
+        while (steps < 2*config.stepsPerRev){
+          limit.countStep();
+          stepper.step(true);
+          steps++;
+          delayMicroseconds(1000000/rates[r]);
+          if (steps % looks[l] == 0 && limit.tripped()){
+            break;
+          }
+        }
+        uint8_t past = limit.overshoot();
+        exact += board.shaftSteps() - past == cwStopStep(config) ? 1 : 0;
+        overshoot.add(past);
+        reads.add(board.counters().digitalReads);
+      }
+      bool pass = exact == trials/10;
+      printf("  %-12u %-10d %6d/%-3d %10.1f %10.1f  %s\n", rates[r], looks[l], exact, trials/10,
+             overshoot.mean(), reads.mean(), pass ? "ok" : "FAIL");
+      ok &= pass;
+    }
+  }
+
+  //Full scans.
+  const char* modeNames[2] = {"exhaustive sweep", "coarse-to-fine"};
+  printf("\nScans, %d trials each:\n", trials);
+  for (int mode = 0; mode < 2; mode++){
+    int home = 0, span = 0, valid = 0, reached = 0;
+    Summary steps, reads, interrupts;
+    for (int t = 0; t < trials; t++){
+      config.startDeg = startDeg(rng);
+      board.reset(config, seed + t);
+      board.setWind(6, config.ccwStopDeg + 15);
+      Control controller(pinLS, IN1, IN2, IN3, IN4, pinFS5, U0, U50, v50, nFS5);
+      controller.setScanMode(mode ? SCAN_COARSE_FINE : SCAN_EXHAUSTIVE);
+      controller.setMessages(false);
+      board.clearCounters();
+      controller.scan();
+      if (board.counters().lostSteps > 0){
+        continue;                 //The count of the heading is off.
+      }
+      valid++;
+
+      //The heading counts ccw and the shaft cw, so their sum is the shaft
+      //position of heading 0.
+      home += controller.heading() + board.shaftSteps() == cwStopStep(config) ? 1 : 0;
+
+      //The coarse sweep may stop before the far end.
+      if (controller.span() != 0){
+        reached++;
+        span += controller.span() == cwStopStep(config) - ccwStopStep(config) ? 1 : 0;
+      }
+      steps.add(board.counters().steps);
+      reads.add(board.counters().digitalReads);
+      interrupts.add(board.counters().pinChanges);
+      ok &= board.counters().digitalReads <= board.counters().pinChanges + extraReads;
+    }
+    bool pass = valid > 0 && home == valid && span == reached;
+    printf("%s: %d scans without lost steps, start position exact %d, span exact %d of %d  %s\n",
+           modeNames[mode], valid, home, span, reached, pass ? "ok" : "FAIL");
+    Summary::printHeader();
+    steps.printRow("half-steps");
+    interrupts.printRow("pin change interrupts");
+    reads.printRow("limit switch reads");
+    ok &= pass;
+  }
+  printf("\nlimit switch latched exactly, read only by the interrupt  %s\n", ok ? "ok" : "FAIL");
+  return ok ? 0 : 1;
+}
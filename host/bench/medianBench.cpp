@@ -0,0 +1,93 @@
+/* Filename:      medianBench.cpp
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Microbenchmark of the sliding window median in RunningMedian.h
+ *    against the previous path in loop(): copy the window, sort it with
+ *    Sorting::quickSorting and pick the middle element. Both produce a
+ *    median for every new sample. The running median is checked against
+ *    the sorted window on every sample.
+ *
+ * Usage:
+ *    median_bench [--samples N] [--seed S]
+ */
+
+#include "Arduino.h"
+#include "quickSort.h"
+#include "RunningMedian.h"
+#include "BenchStats.h"
+#include <random>
+
+//Sample stream shapes. A calm day gives a nearly constant stream, which
+//is the worst case for the last-element pivot of quickSorting.
+enum Stream { GUSTY, CALM };
+
+static std::vector<double> makeStream(Stream shape, size_t count, uint32_t seed){
+  std::mt19937 rng(seed);
+  std::normal_distribution<double> gust(4.0, 1.5);
+  std::vector<double> samples(count);
+  for (size_t i = 0; i < count; i++){
+    samples[i] = (shape == GUSTY) ? fabs(gust(rng)) : 0.0;
+  }
+  return samples;
+}
+
+//Runs one window size. Returns false if the medians differ.
+template<uint8_t N>
+static bool run(Stream shape, const std::vector<double>& samples){
+  //Previous path: ring buffer, copy, quicksort, pick.
+  Sorting qs;
+  double ring[N] = {0};
+  double sorted[N];
+  std::vector<double> sortMedian(samples.size());
+  WallTimer sortTimer;
+  for (size_t i = 0; i < samples.size(); i++){
+    ring[i % N] = samples[i];
+    size_t n = i + 1 < N ? i + 1 : N;
+    memcpy(sorted, ring, n*sizeof(double));
+    qs.quickSorting(sorted, 0, (int)n - 1);
+    sortMedian[i] = (n % 2) ? sorted[n/2] : (sorted[n/2 - 1] + sorted[n/2])/2;
+  }
+  double sortSeconds = sortTimer.seconds();
+
+  //Running median.
+  RunningMedian<double, N> window;
+  std::vector<double> runMedian(samples.size());
+  WallTimer runTimer;
+  for (size_t i = 0; i < samples.size(); i++){
+    window.add(samples[i]);
+    runMedian[i] = window.median();
+  }
+  double runSeconds = runTimer.seconds();
+
+  bool match = (sortMedian == runMedian);
+  printf("  %-6s %5u %14.1f %14.1f %9.1fx %8s\n", shape == GUSTY ? "gusty" : "calm",
+         N, sortSeconds/samples.size()*1e9, runSeconds/samples.size()*1e9,
+         sortSeconds/runSeconds, match ? "ok" : "MISMATCH");
+  return match;
+}
+
+int main(int argc, char** argv){
+  size_t count = (size_t)argValue(argc, argv, "--samples", 200000);
+  uint32_t seed = (uint32_t)argValue(argc, argv, "--seed", 1);
+
+  printf("median benchmark: %zu samples per run, seed %u\n", count, seed);
+  printf("  %-6s %5s %14s %14s %10s %8s\n", "stream", "N", "quicksort[ns]",
+         "running[ns]", "speedup", "check");
+
+  bool ok = true;
+  for (int s = 0; s < 2; s++){
+    Stream shape = (Stream)s;
+    std::vector<double> samples = makeStream(shape, count, seed);
+    ok &= run<11>(shape, samples);
+    ok &= run<31>(shape, samples);
+    ok &= run<63>(shape, samples);
+    ok &= run<127>(shape, samples);
+    ok &= run<255>(shape, samples);
+  }
+  return ok ? 0 : 1;
+}
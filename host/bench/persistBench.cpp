@@ -0,0 +1,211 @@
+/* Filename:      persistBench.cpp
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Checks the EEPROM storage of Storage.h and the resume of Control.
+ *
+ *    The first part encodes and decodes random states and checks that
+ *    records with a flipped bit or another version are rejected. A save
+ *    torn by a power loss after each number of written bytes must leave
+ *    the previous record loadable. Many saves with a moving heading give
+ *    the writes of the most worn byte per save, and from that the
+ *    lifetime at one save per minute.
+ *
+ *    The second part runs the loop() of main.ino on the simulated board
+ *    in a veering wind and cuts the power at a number of times. The board
+ *    restarts with the shaft where it stopped and the EEPROM kept. The
+ *    time to the first decision and the heading error are compared with
+ *    a cold start from an empty EEPROM. The first decision after a
+ *    resume must come within one sampling window, and the verification
+ *    scan must bring the heading back to within a few steps.
+ *
+ * Usage:
+ *    persist_bench [--states N] [--saves N] [--trials N] [--seed S]
+ */
+
+#include "LoopModel.h"
+#include "BenchStats.h"
+
+//True if two states have the same fields.
+static bool sameState(const StoredState& a, const StoredState& b){
+  return a.heading == b.heading && a.span == b.span && a.flags == b.flags
+      && a.U0 == b.U0 && a.U50 == b.U50 && a.v50 == b.v50 && a.n == b.n && a.k == b.k;
+}
+
+//A state with the calibration of main.ino.
+static StoredState makeState(int heading, int span){
+  StoredState state;
+  FS5sensor sensor(pinFS5, U0, U50, v50, nFS5);
+  sensor.storeCalibration(state);
+  state.heading = heading;
+  state.span = span;
+  state.flags = STORED_HOMED;
+  return state;
+}
+
+//Heading plus the shaft position in steps. Constant while no steps are
+//lost, since the heading counts ccw and the shaft angle grows cw.
+static double headingOffset(SimBoard& board, Control& controller, const SimConfig& config){
+  return controller.heading() + board.shaftDeg()*config.stepsPerRev/360.0;
+}
+
+//Runs loop() for a number of simulated seconds.
+static void runFor(SimBoard& board, LoopModel& model, double seconds){
+  double blockedUs;
+  uint64_t start = board.now();
+  while ((board.now() - start)*1e-6 < seconds){
+    model.loop(board, blockedUs);
+  }
+}
+
+int main(int argc, char** argv){
+  long states = (long)argValue(argc, argv, "--states", 1e5);
+  long saves = (long)argValue(argc, argv, "--saves", 10000);
+  int trials = (int)argValue(argc, argv, "--trials", 6);
+  uint32_t seed = (uint32_t)argValue(argc, argv, "--seed", 1);
+  bool ok = true;
+
+  //Codec round trip and corrupted records.
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<uint32_t> bits32;
+  std::uniform_real_distribution<float> unit(0, 1);
+  long mismatches = 0, undetected = 0;
+  uint8_t record[storageRecordSize];
+  for (long i = 0; i < states; i++){
+    StoredState in, out;
+    uint32_t a = bits32(rng);
+    in.heading = (int16_t)a;
+    in.span = (int16_t)(a >> 16);
+    in.flags = (uint8_t)bits32(rng);
+    in.U0 = 1 + unit(rng);
+    in.U50 = 3 + unit(rng);
+    in.v50 = 5 + 5*unit(rng);
+    in.n = 0.3f + 0.4f*unit(rng);
+    in.k = unit(rng);
+    uint16_t sequence = (uint16_t)bits32(rng), loaded = 0;
+    Storage::encode(in, sequence, record);
+    if (!Storage::decode(record, out, loaded) || !sameState(in, out) || loaded != sequence){
+      mismatches++;
+    }
+    uint32_t bit = bits32(rng) % (8*storageRecordSize);
+    record[bit/8] ^= (uint8_t)(1 << (bit % 8));
+    undetected += Storage::decode(record, out, loaded) ? 1 : 0;
+  }
+  StoredState sample = makeState(900, 2300), out;
+  uint16_t loaded;
+  Storage::encode(sample, 1, record);
+  record[0] = storageVersion + 1;
+  bool versionRejected = !Storage::decode(record, out, loaded);
+  printf("codec: %ld states, %ld mismatches, %ld flipped bits accepted, other version %s\n",
+         states, mismatches, undetected, versionRejected ? "rejected" : "ACCEPTED");
+  ok &= mismatches == 0 && undetected == 0 && versionRejected;
+
+  //A power loss after every possible number of bytes of a save.
+  SimConfig config;
+  SimBoard board(config, seed);
+  board.makeCurrent();
+  long tornFailures = 0;
+  for (int bytes = 0; bytes < storageRecordSize; bytes++){
+    board.eraseEeprom();
+    Storage storage;
+    storage.save(makeState(100, 2300));
+    storage.save(makeState(200, 2300));
+    board.failEepromAfter(bytes);
+    storage.save(makeState(300 + 1000*bytes, 2300));
+    board.failEepromAfter(-1);
+    StoredState state;
+    Storage restarted;
+    if (!restarted.load(state) || state.heading != 200){
+      tornFailures++;
+    }
+  }
+  printf("torn saves: %d cut points, %ld did not load the previous record\n",
+         (int)storageRecordSize, tornFailures);
+  ok &= tornFailures == 0;
+
+  //Wear of the most written byte.
+  board.reset(config, seed);
+  board.eraseEeprom();
+  std::vector<unsigned long> before(board.eepromSize());
+  for (size_t i = 0; i < before.size(); i++){
+    before[i] = board.eepromWear((int)i);
+  }
+  Storage storage;
+  uint64_t saveStart = board.now();
+  unsigned long writesBefore = board.counters().eepromWrites;
+  for (long i = 0; i < saves; i++){
+    storage.save(makeState(500 + (int)(bits32(rng) % 1500), 2300));
+  }
+  double saveMs = (board.now() - saveStart)*1e-3/saves;
+  unsigned long maxWear = 0;
+  for (size_t i = 0; i < before.size(); i++){
+    unsigned long wear = board.eepromWear((int)i) - before[i];
+    maxWear = wear > maxWear ? wear : maxWear;
+  }
+  double wearPerSave = (double)maxWear/saves;
+  double years = 100000/wearPerSave/(60.0*24*365);
+  printf("wear: %ld saves, %.1f bytes and %.1f ms per save, most worn byte %.4f writes per save,"
+         " %.1f years at one save a minute\n", saves,
+         (double)(board.counters().eepromWrites - writesBefore)/saves, saveMs, wearPerSave, years);
+  ok &= years > 6;
+
+  //Power loss while running. The wind veers, so the heading moves and is
+  //saved now and then. It stays inside the span, the clock of the board
+  //runs on from trial to trial.
+  auto wind = [](double t){ return WindSample{6, 100 + 40*sin(2*M_PI*t/1200)}; };
+  std::uniform_real_distribution<double> cutTime(70, 240);
+  Summary coldFirst, warmFirst, storedError, verifiedError;
+  for (int trial = 0; trial < trials; trial++){
+    double cut = cutTime(rng);
+    SimConfig running = config;
+    board.reset(running, seed + trial);
+    board.eraseEeprom();
+    board.setWind(wind);
+    Storage coldStorage;
+    LoopModel first(true, 115200, &coldStorage);
+    uint64_t startedUs = board.now();
+    double blockedUs;
+    first.loop(board, blockedUs);
+    coldFirst.add((board.now() - startedUs)*1e-6);
+    runFor(board, first, cut);
+    double offset = headingOffset(board, first.controller(), running);
+
+    //Restart where the shaft stopped. The clock of the board runs on.
+    SimConfig restart = running;
+    restart.startDeg = board.shaftDeg();
+    board.reset(restart, seed + 100 + trial);
+    board.setWind(wind);
+    Storage warmStorage;
+    LoopModel second(true, 115200, &warmStorage);
+    if (!second.resumed()){
+      printf("trial %d: no state resumed\n", trial);
+      ok = false;
+      continue;
+    }
+    storedError.add(fabs(headingOffset(board, second.controller(), restart) - offset));
+    startedUs = board.now();
+    second.loop(board, blockedUs);
+    warmFirst.add((board.now() - startedUs)*1e-6);
+
+    //The verification scan follows after a few tracking cycles.
+    runFor(board, second, 60);
+    verifiedError.add(fabs(headingOffset(board, second.controller(), restart) - offset));
+  }
+  Summary::printHeader();
+  coldFirst.printRow("first decision, cold [s]");
+  warmFirst.printRow("first decision, resumed [s]");
+  storedError.printRow("stored heading error [steps]");
+  verifiedError.printRow("after verification [steps]");
+
+  double window = N*samplePeriod*1e-3;
+  bool fast = warmFirst.count() == (size_t)trials && warmFirst.max() <= window*1.1;
+  bool verified = verifiedError.count() == (size_t)trials && verifiedError.max() <= 4;
+  printf("first decision within one window (%.1f s)  %s\n", window, fast ? "ok" : "FAIL");
+  printf("heading verified                          %s\n", verified ? "ok" : "FAIL");
+  ok &= fast && verified;
+  return ok ? 0 : 1;
+}
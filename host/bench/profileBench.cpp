@@ -0,0 +1,90 @@
+/* Filename:      profileBench.cpp
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Runs the loop() of main.ino on the simulated board with the timing
+ *    instrumentation of Profiler.h enabled and prints the same report
+ *    as the firmware does on 'p', here in simulated time. The first loop
+ *    scans, the following ones track, in a wind that veers slowly.
+ *
+ *    Checks that every section of the loop was entered and that the
+ *    sampling in the measuring sequence takes a small part of the
+ *    sample period. Reports the host time of an empty PROFILE_SCOPE.
+ *
+ * Usage:
+ *    profile_bench [--seconds T] [--seed S] [--wind V] [--text]
+ */
+
+#include "LoopModel.h"
+#include "BenchStats.h"
+
+int main(int argc, char** argv){
+  double seconds = argValue(argc, argv, "--seconds", 120);
+  uint32_t seed = (uint32_t)argValue(argc, argv, "--seed", 1);
+  double wind = argValue(argc, argv, "--wind", 6);
+  bool text = argFlag(argc, argv, "--text");
+  bool ok = true;
+
+  SimConfig config;
+  SimBoard board(config, seed);
+  board.makeCurrent();
+  board.setWind([wind](double t){ return WindSample{wind, 100 + 0.2*t}; });
+  board.advance(1e6);
+
+  LoopModel model(!text, text ? 9600 : 115200);
+  Profiler::reset();
+  int loops = 0;
+  uint64_t start = board.now();
+  while ((board.now() - start)*1e-6 < seconds){
+    double blockedUs;
+    model.loop(board, blockedUs);
+    loops++;
+  }
+  printf("loop() for %.0f s, %d loops, wind %.1f m/s, %s\n\n", seconds, loops, wind,
+         text ? "JSON and text at 9600 baud" : "binary at 115200 baud");
+
+  //The report goes through the serial port like on the target.
+  board.setSerialCapture(false);
+  board.setSerialEcho(true);
+  Profiler::report();
+  board.setSerialEcho(false);
+  printf("\n");
+
+  const uint8_t required[] = {PROFILE_FS5_READ, PROFILE_VELOCITY, PROFILE_MEDIAN,
+                              PROFILE_REPORT, PROFILE_SEQUENCE};
+  for (size_t i = 0; i < sizeof(required); i++){
+    ok &= Profiler::stats(required[i]).count > 0;
+  }
+  bool entered = ok;
+  printf("sections entered  %s\n", entered ? "ok" : "FAIL");
+
+  //With the sequential decision a sequence ends early when the decision
+  //is to lower, see WindDecision.h. Besides the pauses between the samples, the sampling
+  //must take a small part of the dense period. The intervals around a scan 
+  //vary more: the first sample of a sequence follows the last sample of
+  //the scan directly.
+  unsigned long periodUs = samplePeriod*1000;
+  const ProfileStats& sequence = Profiler::stats(PROFILE_SEQUENCE);
+  double sampling = model.sequenceSamples() > 0 ?
+                    ((double)sequence.totalUs - model.sequencePausedUs())/model.sequenceSamples() : -1;
+  bool onPeriod = sampling >= 0 && sampling < periodUs/20;
+  printf("sequence %.1f samples, %.0f us per sample besides the pauses, intervals %lu to %lu us  %s\n",
+         sequence.count > 0 ? (double)model.sequenceSamples()/sequence.count : 0.0, sampling,
+         (unsigned long)Profiler::intervals().minUs, (unsigned long)Profiler::intervals().maxUs,
+         onPeriod ? "ok" : "FAIL");
+  ok &= onPeriod;
+
+  //Host cost of a scope, for comparison with the estimate in Profiler.h.
+  const long scopes = 10000000;
+  WallTimer timer;
+  for (long i = 0; i < scopes; i++){
+    PROFILE_SCOPE(PROFILE_SECTIONS - 1);
+    keep(i);
+  }
+  printf("PROFILE_SCOPE on the host: %.1f ns\n", timer.seconds()*1e9/scopes);
+  return ok ? 0 : 1;
+}
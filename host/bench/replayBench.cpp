@@ -0,0 +1,167 @@
+/* Filename:      replayBench.cpp
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Records the loop() of main.ino on the simulated board to a trace,
+ *    see Trace.h, in a gusty wind that crosses the allowed speed and
+ *    veers, with a sudden turn that forces a rescan. The trace is then
+ *    replayed through the same firmware on a fresh board.
+ *
+ *    Checks that the replay follows the trace to its end, so every ADC
+ *    code, step, switch level and serial byte happens at the recorded
+ *    time, and that the decisions are the recorded ones, bit for bit.
+ *    A replay with the coarse-to-fine scan instead must diverge.
+ *    Reports the size of the trace and the replay throughput in ADC
+ *    samples per second.
+ *
+ * Usage:
+ *    replay_bench [--seconds T] [--seed S] [--trace FILE] [--keep]
+ */
+
+#include "LoopModel.h"
+#include "BenchStats.h"
+#include "Trace.h"
+#include <unistd.h>
+
+//The decisions in a captured telemetry stream.
+static std::vector<TelemetryRecord> decisions(const std::string& stream){
+  std::vector<TelemetryRecord> found;
+  size_t begin = 0;
+  for (size_t k = 0; k < stream.size(); k++){
+    if (stream[k] != 0){
+      continue;
+    }
+    TelemetryRecord record;
+    if (k > begin && k - begin < 256
+        && Telemetry::decode((const uint8_t*)stream.data() + begin, (uint8_t)(k - begin), record)
+        && record.type == TELEMETRY_DECISION){
+      found.push_back(record);
+    }
+    begin = k + 1;
+  }
+  return found;
+}
+
+//Replays the trace until it ends or diverges.
+static void replay(TraceReader& reader, SimBoard& board, bool coarse){
+  board.replay(reader);
+  board.setSerialCapture(true);
+  LoopModel model(true, 115200);
+  if (coarse){
+    model.controller().setScanMode(SCAN_COARSE_FINE);
+  }
+  double blockedUs;
+  while (!board.replayStatus().ended && !board.replayStatus().diverged){
+    model.loop(board, blockedUs);
+  }
+}
+
+int main(int argc, char** argv){
+  double seconds = argValue(argc, argv, "--seconds", 1800);
+  uint32_t seed = (uint32_t)argValue(argc, argv, "--seed", 1);
+  bool keep = argFlag(argc, argv, "--keep");
+  const char* path = "replay_bench.trace";
+  for (int i = 1; i + 1 < argc; i++){
+    if (strcmp(argv[i], "--trace") == 0){
+      path = argv[i + 1];
+    }
+  }
+  bool ok = true;
+
+  //Gusts around the allowed speed, a slow veer and a turn of 60 degrees
+  //halfway.
+  double turnAt = seconds/2;
+  auto wind = [turnAt](double t){
+    double gust = 0.8*sin(t/3.1) + 0.5*sin(t/1.3 + 1);
+    return WindSample{2.2 + 1.2*sin(t/40) + gust, 100 + 0.05*t + (t > turnAt ? 60 : 0)};
+  };
+
+  //Record.
+  SimConfig config;
+  SimBoard board(config, seed);
+  board.makeCurrent();
+  board.setWind(wind);
+  TraceWriter writer;
+  if (!board.record(path, writer)){
+    printf("cannot create %s\n", path);
+    return 1;
+  }
+  board.setSerialCapture(true);
+  WallTimer recordTimer;
+  int loops = 0;
+  {
+    LoopModel model(true, 115200);
+    uint64_t start = board.now();
+    double blockedUs;
+    while ((board.now() - start)*1e-6 < seconds){
+      model.loop(board, blockedUs);
+      loops++;
+    }
+  }
+  double recordSeconds = recordTimer.seconds();
+  uint64_t events = writer.events();
+  uint64_t bytes = writer.bytes();
+  board.stopRecording();
+  std::vector<TelemetryRecord> recorded = decisions(board.serialOutput());
+  unsigned long adcRecorded = board.counters().analogReads + board.counters().adcConversions;
+  printf("recorded %.0f s, %d loops, %zu decisions: %llu events, %.2f MB, %.2f bytes per event,"
+         " %.2f s on the host\n", seconds, loops, recorded.size(), (unsigned long long)events,
+         bytes/1e6, (double)bytes/events, recordSeconds);
+
+  //Replay on a fresh board.
+  TraceReader reader;
+  if (!reader.open(path)){
+    printf("cannot read %s\n", path);
+    return 1;
+  }
+  SimBoard replayBoard;
+  replayBoard.makeCurrent();
+  WallTimer replayTimer;
+  replay(reader, replayBoard, false);
+  double replaySeconds = replayTimer.seconds();
+  const SimBoard::ReplayStatus& status = replayBoard.replayStatus();
+  std::vector<TelemetryRecord> replayed = decisions(replayBoard.serialOutput());
+  bool complete = status.ended && !status.diverged && status.events == events;
+  printf("replayed %llu of %llu events, %llu ADC samples of %lu  %s\n",
+         (unsigned long long)status.events, (unsigned long long)events,
+         (unsigned long long)status.adcSamples, adcRecorded, complete ? "ok" : "FAIL");
+  if (status.diverged){
+    printf("  diverged at %.0f us: %s\n", status.divergedUs, status.reason);
+  }
+  ok &= complete;
+
+  size_t same = 0;
+  for (size_t i = 0; i < recorded.size() && i < replayed.size(); i++){
+    const TelemetryRecord& a = recorded[i];
+    const TelemetryRecord& b = replayed[i];
+    same += a.timeMs == b.timeMs && a.windSpeed == b.windSpeed && a.status == b.status
+         && a.heading == b.heading && a.sequence == b.sequence ? 1 : 0;
+  }
+  bool exact = recorded.size() > 0 && same == recorded.size();
+  printf("decisions identical: %zu of %zu  %s\n", same, recorded.size(), exact ? "ok" : "FAIL");
+  ok &= exact;
+  printf("replay %.2f s on the host: %.2f M ADC samples/s, %.2f M events/s, %.0f MB/s,"
+         " %.0fx real time\n", replaySeconds, status.adcSamples/replaySeconds*1e-6,
+         status.events/replaySeconds*1e-6, bytes/replaySeconds*1e-6, seconds/replaySeconds);
+
+  //Other firmware behaviour must be caught.
+  TraceReader again;
+  again.open(path);
+  SimBoard otherBoard;
+  otherBoard.makeCurrent();
+  replay(again, otherBoard, true);
+  const SimBoard::ReplayStatus& other = otherBoard.replayStatus();
+  printf("coarse-to-fine scan instead: %s after %llu events%s%s\n",
+         other.diverged ? "diverged" : "DID NOT DIVERGE", (unsigned long long)other.events,
+         other.diverged ? ", " : "", other.reason);
+  ok &= other.diverged;
+
+  if (!keep){
+    unlink(path);
+  }
+  return ok ? 0 : 1;
+}
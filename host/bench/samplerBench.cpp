@@ -0,0 +1,259 @@
+/* Filename:      samplerBench.cpp
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Checks and benchmarks the background ADC sampler.
+ *
+ *    The first part runs RingBuffer with the producer and the consumer
+ *    on two threads. The blocking run retries full pushes and checks
+ *    that every element arrives once and in order. The lossy run drops
+ *    on a full buffer like the ADC interrupt and checks that the
+ *    elements still arrive in order and that received plus dropped adds
+ *    up. Reports the transfer rate.
+ *
+ *    The second part runs ADCSampler on the simulated board with the
+ *    emulated ADC interrupt. At many wind speeds it compares a single
+ *    analogRead() and the decimated values for 0 to 3 extra bits with
+ *    the exact code of the simulated sensor voltage, and reports the
+ *    time a reading costs the caller and the time taken by the
+ *    interrupt.
+ *
+ *    The third part runs coarse-to-fine scans reading the FS5 by
+ *    analogRead() and through the sampler.
+ *
+ *    The last part reads the sampler through the filter chain of an
+ *    FS5sensor and of an FS5Fixed of the prototype pole, across a step
+ *    of the wind. Both have to filter it the same.
+ *
+ *    The run fails on any ring buffer error, on analogRead() called while
+ *    the sampler runs, if the sampler is not more exact than a single
+ *    reading, or if FS5Fixed does not filter the sampler like FS5sensor.
+ *
+ * Usage:
+ *    sampler_bench [--elements N] [--speeds N] [--trials N] [--seed S]
+ */
+
+#include "Arduino.h"
+#include "ADCSampler.h"
+#include "Controller.h"
+#include "FS5Fixed.h"
+#include "RingBuffer.h"
+#include "SimBoard.h"
+#include "BenchStats.h"
+#include <atomic>
+#include <thread>
+
+//Same setup as main.ino.
+static const int pinFS5 = A0;
+static const double U0 = 2.24;
+static const double U50 = 3.33;
+static const double v50 = 8;
+static const double nFS5 = 0.51;
+static const int IN1 = 10;
+static const int IN2 = 9;
+static const int IN3 = 8;
+static const int IN4 = 7;
+static const int pinLS = 12;
+
+//Moves count elements from a producer thread to the calling thread. The
+//waiting side yields, so the run also progresses on a single core.
+//Returns false if an element is lost, duplicated or out of order.
+static bool transfer(uint32_t count, bool lossy, double& seconds, uint32_t& dropped){
+  RingBuffer<uint32_t, 64> buffer;
+  std::atomic<bool> done(false);
+  std::atomic<uint32_t> drops(0);
+
+  WallTimer timer;
+  std::thread producer([&](){
+    uint32_t lost = 0;
+    for (uint32_t i = 0; i < count; i++){
+      if (lossy){
+        lost += buffer.push(i) ? 0 : 1;
+      }
+      else {
+        while (!buffer.push(i)){
+          std::this_thread::yield();
+        }
+      }
+    }
+    drops = lost;
+    done = true;
+  });
+
+  bool ok = true;
+  uint32_t received = 0;
+  int64_t last = -1;
+  uint32_t value;
+  for (;;){
+    bool finished = done;
+    while (buffer.pop(value)){
+      ok &= lossy ? (int64_t)value > last : value == (uint32_t)(last + 1);
+      last = value;
+      received++;
+    }
+    if (finished){
+      break;
+    }
+    std::this_thread::yield();
+  }
+  producer.join();
+  seconds = timer.seconds();
+  dropped = drops;
+  return ok && received + dropped == count;
+}
+
+int main(int argc, char** argv){
+  uint32_t elements = (uint32_t)argValue(argc, argv, "--elements", 2e7);
+  int speeds = (int)argValue(argc, argv, "--speeds", 200);
+  int trials = (int)argValue(argc, argv, "--trials", 200);
+  uint32_t seed = (uint32_t)argValue(argc, argv, "--seed", 1);
+  bool ok = true;
+
+  //Ring buffer across threads.
+  printf("ring buffer, 64 slots, %u elements between two threads\n", elements);
+  for (int lossy = 0; lossy < 2; lossy++){
+    double seconds;
+    uint32_t dropped;
+    bool match = transfer(elements, lossy, seconds, dropped);
+    printf("  %-9s %8.1f M elements/s  dropped %10u  %s\n", lossy ? "lossy" : "blocking",
+           elements/seconds*1e-6, dropped, match ? "ok" : "FAIL");
+    ok &= match;
+  }
+
+  //Accuracy and cost on the simulated board.
+  SimConfig config;
+  SimBoard board(config, seed);
+  board.makeCurrent();
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> speedDist(0, 15);
+  std::vector<double> windSpeeds(speeds);
+  for (int i = 0; i < speeds; i++){
+    windSpeeds[i] = speedDist(rng);
+  }
+
+  printf("reading the FS5 at %d wind speeds, noise %.3f V\n", speeds, config.noiseVolts);
+  printf("  %-15s %14s %14s %14s %10s\n", "source", "rms error[LSB]", "max error[LSB]",
+         "caller[us]", "isr load");
+  double rawRms = 0;
+  for (int bits = -1; bits <= 3; bits++){
+    double sumSquares = 0;
+    double worst = 0;
+    double callerUs = 0;
+    double isrLoad = 0;
+    for (int i = 0; i < speeds; i++){
+      board.reset(config, seed + i);
+      board.setWind(windSpeeds[i], config.startDeg);
+      double exact = board.sensorVoltage()/5.0*1023.0;
+      double code;
+      if (bits < 0){
+        uint64_t start = board.now();
+        code = analogRead(pinFS5);
+        callerUs += board.now() - start;
+      }
+      else {
+        ADCSampler sampler(pinFS5, bits);
+        sampler.begin();
+        board.clearCounters();
+        uint64_t idle = board.now();
+        delayMicroseconds((unsigned int)(16*(1 << 2*bits)*config.adcConversionUs));   //Half a buffer.
+        uint64_t start = board.now();
+        code = sampler.code();
+        callerUs += board.now() - start;
+        isrLoad += board.counters().adcConversions*config.adcIsrUs/(start - idle);
+        ok &= sampler.overruns() == 0;
+        sampler.end();
+      }
+      double error = code - exact;
+      sumSquares += error*error;
+      worst = fmax(worst, fabs(error));
+    }
+    double rms = sqrt(sumSquares/speeds);
+    if (bits < 0){
+      rawRms = rms;
+      printf("  %-15s %14.3f %14.3f %14.1f %10s\n", "analogRead()", rms, worst, callerUs/speeds, "-");
+    }
+    else {
+      char name[32];
+      snprintf(name, sizeof(name), "sampler +%d bits", bits);
+      printf("  %-15s %14.3f %14.3f %14.1f %9.1f%%\n", name, rms, worst, callerUs/speeds,
+             100*isrLoad/speeds);
+      if (bits == 3){
+        ok &= rms < rawRms/2;
+      }
+    }
+  }
+
+  //Coarse-to-fine scans with and without the sampler.
+  printf("coarse-to-fine scans, %d trials, wind 6.0 m/s\n", trials);
+  Summary::printHeader();
+  std::uniform_real_distribution<double> startDeg(config.ccwStopDeg + 1, config.cwStopDeg - 1);
+  std::uniform_real_distribution<double> windDeg(config.ccwStopDeg + 10, config.cwStopDeg - 45);
+  std::vector<double> starts(trials), directions(trials);
+  for (int t = 0; t < trials; t++){
+    starts[t] = startDeg(rng);
+    directions[t] = windDeg(rng);
+  }
+  for (int sampled = 0; sampled < 2; sampled++){
+    Summary time, error;
+    unsigned long conflicts = 0;
+    for (int t = 0; t < trials; t++){
+      config.startDeg = starts[t];
+      board.reset(config, seed + t);
+      board.setWind(6, directions[t]);
+      Serial.begin(9600);
+
+      ADCSampler sampler(pinFS5, 3);
+      Control controller(pinLS, IN1, IN2, IN3, IN4, pinFS5, U0, U50, v50, nFS5);
+      controller.setScanMode(SCAN_COARSE_FINE);
+      if (sampled){
+        sampler.begin();
+        controller.useSampler(&sampler);
+      }
+      board.clearCounters();
+      uint64_t start = board.now();
+      controller.scan();
+      time.add((board.now() - start)*1e-6);
+      error.add(fabs(board.headingError()));
+      conflicts += board.counters().adcConflicts;
+      sampler.end();
+    }
+    printf("%s\n", sampled ? "sampler +3 bits" : "analogRead()");
+    time.printRow("time to align [s]");
+    error.printRow("|error| [deg]");
+    if (sampled){
+      printf("  analogRead() while sampling: %lu\n", conflicts);
+      ok &= conflicts == 0;
+    }
+  }
+
+  //The filter chains of FS5sensor and FS5Fixed on the same sampler, the
+  //wind stepping from 1 to 8 m/s after 2 s.
+  config.startDeg = 100;
+  board.reset(config, seed);
+  double stepAt = board.now()*1e-6 + 2;
+  board.setWind([stepAt](double t){ WindSample w = {t > stepAt ? 8.0 : 1.0, 100}; return w; });
+  ADCSampler sampler(pinFS5, 3);
+  sampler.begin();
+  FS5sensor sensor(pinFS5, U0, U50, v50, nFS5);
+  FS5Fixed<HotswapPole> fixed;
+  sensor.useSampler(&sampler);
+  fixed.useSampler(&sampler);
+  double apart = 0, lag = 0;
+  for (int i = 0; i < 400; i++){
+    delay(10);
+    double U = sensor.voltage();
+    apart = fmax(apart, fabs(fixed.voltage() - U));
+    lag = fmax(lag, sampler.code()*(5.0/1023) - U);
+  }
+  sampler.end();
+  bool filtered = apart < 1e-3 && lag > 0.1;
+  printf("FS5sensor and FS5Fixed on the sampler, step 1 to 8 m/s\n");
+  printf("  largest difference %.5f V, lag behind the sampler %.3f V  %s\n", apart, lag,
+         filtered ? "ok" : "FAIL");
+  ok &= filtered;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,293 @@
+/* Filename:      scanBench.cpp
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Benchmark of Control::scan() on the simulated board. Every trial
+ *    starts the shaft at a random angle, lets the wind blow from a random
+ *    direction inside the scanned span and runs one scan. Reports the
+ *    simulated time to align, the number of half-steps and ADC reads and
+ *    the alignment error between the FS5 axis and the wind. Both search
+ *    modes of Control run on the same start angles and wind directions:
+ *    the exhaustive sweep and the coarse-to-fine search. Each mode runs
+ *    with every move at a fixed 16 rpm, as before the speed profiles,
+ *    and with the trapezoidal profiles of Motion.h, and the time spent
+ *    in each phase is reported. With --profile the profile recorded by
+ *    the first trial of each mode is printed. The half-steps and ADC
+ *    reads of the coarse-to-fine search are then given as a part of
+ *    those of the exhaustive sweep. Both home to the limit switch first,
+ *    and the coarse sweep still has to reach the peak, so it cuts the 
+ *    ADC reads ten times but the half-steps only by about a third.
+ *
+ *    The second part compares the time until the first lower flag
+ *    decision, with the window median of loop() sampling every 100 ms,
+ *    when the scan blocks (scan()) and when loop() keeps sampling between
+ *    the steps (begin()/tick()). The wind speed should be above the
+ *    allowed 2 m/s for this part.
+ *
+ *    The third part runs loop() cycles, a scan followed by a measuring
+ *    sequence of about 1.1 s, in a wind that veers slowly and turns
+ *    suddenly by 70 degrees halfway. A full scan every cycle is compared
+ *    with tracking, which follows the wind by probing around the heading
+ *    and falls back to a full scan when the signal drops.
+ *
+ * Usage:
+ *    scan_bench [--trials N] [--seed S] [--speed m/s] [--noise V]
+ *               [--track-seconds T] [--profile]
+ */
+
+#include "Arduino.h"
+#include "Controller.h"
+#include "FS5.h"
+#include "RunningMedian.h"
+#include "SimBoard.h"
+#include "BenchStats.h"
+
+//Same setup as main.ino.
+static const int pinFS5 = A0;
+static const double U0 = 2.24;
+static const double U50 = 3.33;
+static const double v50 = 8;
+static const double nFS5 = 0.51;
+static const int IN1 = 10;
+static const int IN2 = 9;
+static const int IN3 = 8;
+static const int IN4 = 7;
+static const int pinLS = 12;
+
+static const double allowedWindSpeed = 2;
+static const unsigned long samplePeriod = 100;    //[ms]
+
+//Time from the start of loop() until the window median first exceeds the
+//allowed wind speed, or -1 if it does not within the deadline.
+static double timeToLower(SimBoard& board, bool ticked, double deadline){
+  Control controller(pinLS, IN1, IN2, IN3, IN4, pinFS5, U0, U50, v50, nFS5);
+  FS5sensor FS5(pinFS5, U0, U50, v50, nFS5);
+  RunningMedian<double, 11> window;
+  uint64_t start = board.now();
+
+  if (ticked){
+    controller.begin();
+    unsigned long lastSample = millis();
+    while (controller.tick(micros())){
+      if (millis() - lastSample >= samplePeriod){
+        lastSample = millis();
+        window.add(FS5.velocity());
+        if (window.full() && window.median() > allowedWindSpeed){
+          return (board.now() - start)*1e-6;
+        }
+      }
+    }
+  }
+  else {
+    controller.scan();
+  }
+
+  while ((board.now() - start)*1e-6 < deadline){
+    window.add(FS5.velocity());
+    if (window.full() && window.median() > allowedWindSpeed){
+      return (board.now() - start)*1e-6;
+    }
+    delay(samplePeriod);
+  }
+  return -1;
+}
+
+//Runs loop() cycles for the given time and collects the time and steps
+//spent per scan or tracking cycle and the error after each one.
+static void runCycles(SimBoard& board, ScanMode mode, bool tracking, double seconds,
+                      Summary& cycleTime, Summary& steps, Summary& absError, int& scans){
+  Control controller(pinLS, IN1, IN2, IN3, IN4, pinFS5, U0, U50, v50, nFS5);
+  controller.setScanMode(mode);
+  controller.setTracking(tracking);
+  uint64_t start = board.now();
+  scans = 0;
+  while ((board.now() - start)*1e-6 < seconds){
+    uint64_t cycleStart = board.now();
+    board.clearCounters();
+    controller.begin();
+    scans += controller.phase() == SCAN_TRACK ? 0 : 1;
+    while (controller.tick(micros())){
+    }
+    cycleTime.add((board.now() - cycleStart)*1e-6);
+    steps.add(board.counters().steps);
+    absError.add(fabs(board.headingError()));
+    delay(11*samplePeriod);     //Measuring sequence.
+  }
+}
+
+//Prints the profile of the last scan, heading in degrees from the start
+//position and the mean ADC code, with the fitted peak.
+static void printProfile(Control& controller, const SimConfig& config){
+  double degPerStep = 360.0/config.stepsPerRev;
+  printf("  %d values, peak at %.2f deg\n", controller.profileLength(),
+         controller.peakHeading()*degPerStep);
+  for (uint8_t i = 0; i < controller.profileLength(); i++){
+    printf("  %8.2f %9.3f\n", controller.profileHeading(i)*degPerStep,
+           controller.profileValue(i)/16.0);
+  }
+}
+
+int main(int argc, char** argv){
+  int trials = (int)argValue(argc, argv, "--trials", 2000);
+  uint32_t seed = (uint32_t)argValue(argc, argv, "--seed", 1);
+  double speed = argValue(argc, argv, "--speed", 6);
+  bool showProfile = argFlag(argc, argv, "--profile");
+
+  SimConfig config;
+  config.noiseVolts = argValue(argc, argv, "--noise", config.noiseVolts);
+
+  //The sweep starts 400 steps after the cw stop was found and ends at the
+  //ccw stop. Keep the wind a few degrees inside that span.
+  const double sweepStart = config.cwStopDeg - 400*360.0/config.stepsPerRev;
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> startDeg(config.ccwStopDeg + 1, config.cwStopDeg - 1);
+  std::uniform_real_distribution<double> windDeg(config.ccwStopDeg + 10, sweepStart - 10);
+
+  SimBoard board(config, seed);
+  board.makeCurrent();
+  WallTimer wall;
+
+  std::vector<double> starts(trials), directions(trials);
+  for (int t = 0; t < trials; t++){
+    starts[t] = startDeg(rng);
+    directions[t] = windDeg(rng);
+  }
+
+  printf("scan benchmark: %d trials, wind %.1f m/s, noise %.3f V, seed %u\n",
+         trials, speed, config.noiseVolts, seed);
+  const char* modeNames[4] = {"exhaustive sweep, fixed 16 rpm", "exhaustive sweep, trapezoidal",
+                              "coarse-to-fine, fixed 16 rpm", "coarse-to-fine, trapezoidal"};
+  const char* phaseNames[SCAN_TRACK + 1] = {"", "  homing [s]", "  home release [s]", "  sweep [s]",
+                                            "  sweep release [s]", "  align [s]", "  align release [s]",
+                                            "  coarse sweep [s]", "  move [s]", "  track [s]"};
+  double meanSteps[4], meanReads[4];
+  for (int variant = 0; variant < 4; variant++){
+    int mode = variant/2;
+    bool fixed = variant % 2 == 0;
+    Summary timeToAlign, steps, lostSteps, adcReads, absError, signedError;
+    Summary phaseTime[SCAN_TRACK + 1];
+    for (int t = 0; t < trials; t++){
+      config.startDeg = starts[t];
+      board.reset(config, seed + t);
+      board.setWind(speed, directions[t]);
+      board.advance(10e6);          //Let the FS5 filter forget the last trial.
+      Serial.begin(9600);
+
+      Control controller(pinLS, IN1, IN2, IN3, IN4, pinFS5, U0, U50, v50, nFS5);
+      controller.setScanMode(mode ? SCAN_COARSE_FINE : SCAN_EXHAUSTIVE);
+      if (fixed){
+        controller.setMotion(1092, 0, 1092);
+      }
+      uint64_t start = board.now();
+      board.clearCounters();
+
+      //scan(), with the time of each phase.
+      double phaseUs[SCAN_TRACK + 1] = {0};
+      controller.begin();
+      ScanPhase phase = controller.phase();
+      uint64_t last = board.now();
+      while (controller.tick(micros())){
+        phaseUs[phase] += board.now() - last;
+        last = board.now();
+        phase = controller.phase();
+      }
+      phaseUs[phase] += board.now() - last;
+
+      timeToAlign.add((board.now() - start)*1e-6);
+      for (int p = SCAN_HOMING; p <= SCAN_TRACK; p++){
+        phaseTime[p].add(phaseUs[p]*1e-6);
+      }
+      steps.add(board.counters().steps);
+      lostSteps.add(board.counters().lostSteps);
+      adcReads.add(board.counters().analogReads);
+      absError.add(fabs(board.headingError()));
+      signedError.add(board.headingError());
+      if (showProfile && t == 0 && !fixed){
+        printf("profile of the first %s\n", modeNames[mode]);
+        printProfile(controller, config);
+      }
+    }
+
+    printf("%s\n", modeNames[variant]);
+    Summary::printHeader();
+    timeToAlign.printRow("time to align [s]");
+    for (int p = SCAN_HOMING; p <= SCAN_TRACK; p++){
+      if (phaseTime[p].mean() > 0){
+        phaseTime[p].printRow(phaseNames[p]);
+      }
+    }
+    steps.printRow("half-steps");
+    lostSteps.printRow("lost half-steps");
+    adcReads.printRow("ADC reads");
+    absError.printRow("|error| [deg]");
+    signedError.printRow("error [deg]");
+    meanSteps[variant] = steps.mean();
+    meanReads[variant] = adcReads.mean();
+  }
+  printf("coarse-to-fine against exhaustive, trapezoidal: %.2f of the half-steps, %.2f of the ADC reads\n",
+         meanSteps[3]/meanSteps[1], meanReads[3]/meanReads[1]);
+  printf("  the homing and the sweep up to the peak remain, only the sweep past it is cut\n");
+
+  //Decision latency, blocking scan against sampling between steps.
+  Summary blocking, ticked;
+  int missedBlocking = 0;
+  int missedTicked = 0;
+  for (int t = 0; t < trials/10; t++){
+    config.startDeg = startDeg(rng);
+    double direction = windDeg(rng);
+    for (int mode = 0; mode < 2; mode++){
+      board.reset(config, seed + t);
+      board.setWind(speed, direction);
+      board.advance(10e6);
+      Serial.begin(9600);
+      double latency = timeToLower(board, mode == 1, 30);
+      if (latency < 0){
+        (mode ? missedTicked : missedBlocking)++;
+      }
+      else {
+        (mode ? ticked : blocking).add(latency);
+      }
+    }
+  }
+  printf("time to first lower decision [s], %d trials, allowed %.1f m/s\n",
+         trials/10, allowedWindSpeed);
+  Summary::printHeader();
+  blocking.printRow("blocking scan()");
+  ticked.printRow("begin()/tick()");
+  printf("  no decision within 30 s: blocking %d, ticked %d\n", missedBlocking, missedTicked);
+
+  //Repeated loop() cycles in a veering wind.
+  const double runSeconds = argValue(argc, argv, "--track-seconds", 600);
+  const double center = (config.ccwStopDeg + sweepStart)/2;
+  WindField veering = [=](double t){
+    WindSample w;
+    w.speed = speed;
+    w.direction = center + 25*sin(2*M_PI*t/300) + (t > runSeconds/2 ? -35 : 35);
+    return w;
+  };
+  printf("loop() cycles for %.0f s, wind veering +-25 deg, 70 deg turn at %.0f s\n",
+         runSeconds, runSeconds/2);
+  const char* cycleNames[3] = {"exhaustive", "coarse-to-fine", "tracking"};
+  for (int variant = 0; variant < 3; variant++){
+    config.startDeg = 100;
+    board.reset(config, seed);
+    board.setWind(veering);
+    board.advance(10e6);
+    Serial.begin(9600);
+    Summary cycleTime, cycleSteps, cycleError;
+    int scans;
+    runCycles(board, variant ? SCAN_COARSE_FINE : SCAN_EXHAUSTIVE, variant == 2,
+              runSeconds, cycleTime, cycleSteps, cycleError, scans);
+    printf("%s: %d cycles, %d full scans\n", cycleNames[variant], (int)cycleTime.count(), scans);
+    Summary::printHeader();
+    cycleTime.printRow("time per cycle [s]");
+    cycleSteps.printRow("half-steps per cycle");
+    cycleError.printRow("|error| [deg]");
+  }
+  printf("  host wall time %.2f s\n", wall.seconds());
+  return 0;
+}
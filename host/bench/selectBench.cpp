@@ -0,0 +1,164 @@
+/* Filename:      selectBench.cpp
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Benchmark of Sorting::select() and Sorting::median() against
+ *    Sorting::quickSorting on worst case inputs: sorted, reversed,
+ *    constant, organ pipe, sawtooth and the median-of-three killer, plus
+ *    random data. Runs the templates on double, float and uint16_t and
+ *    checks every result against std::nth_element.
+ *
+ *    quickSorting recurses once per element on sorted and constant input;
+ *    the deepest recursion it reaches is reported next to its time.
+ *
+ * Usage:
+ *    select_bench [--reps N] [--seed S]
+ */
+
+#include "Arduino.h"
+#include "quickSort.h"
+#include "BenchStats.h"
+#include <random>
+
+enum Shape { RANDOM, SORTED, REVERSED, CONSTANT, ORGAN_PIPE, SAWTOOTH, MO3_KILLER, SHAPES };
+
+static const char* shapeNames[SHAPES] = {
+  "random", "sorted", "reversed", "constant", "organ pipe", "sawtooth", "mo3 killer"
+};
+
+static std::vector<double> makeInput(Shape shape, int n, std::mt19937& rng){
+  std::vector<double> a(n);
+  std::uniform_int_distribution<int> code(0, 1023);
+  int k = n/2;
+  for (int i = 0; i < n; i++){
+    switch (shape){
+      case RANDOM:     a[i] = code(rng); break;
+      case SORTED:     a[i] = i; break;
+      case REVERSED:   a[i] = n - i; break;
+      case CONSTANT:   a[i] = 512; break;
+      case ORGAN_PIPE: a[i] = i < k ? i : n - i; break;
+      case SAWTOOTH:   a[i] = i % 16; break;
+      default:         a[i] = 0; break;
+    }
+  }
+
+  //Musser's median-of-three killer sequence.
+  if (shape == MO3_KILLER){
+    for (int i = 1; i <= k; i++){
+      if (i % 2 == 1){
+        a[i - 1] = i;
+        a[i] = k + i;
+      }
+      a[k + i - 1] = 2*i;
+    }
+    if (n % 2){
+      a[n - 1] = n;
+    }
+  }
+  return a;
+}
+
+//Deepest recursion of quickSorting for the given input, measured on a copy
+//with the same partitioning as Sorting::part.
+static int recursionDepth(std::vector<double> a){
+  Sorting qs;
+  int deepest = 0;
+  std::vector<std::pair<int, int> > stack;
+  std::vector<int> depth;
+  stack.push_back(std::make_pair(0, (int)a.size() - 1));
+  depth.push_back(1);
+  while (!stack.empty()){
+    std::pair<int, int> range = stack.back();
+    int d = depth.back();
+    stack.pop_back();
+    depth.pop_back();
+    if (range.first < range.second){
+      deepest = std::max(deepest, d);
+      int p = qs.part(a.data(), range.first, range.second);
+      stack.push_back(std::make_pair(range.first, p - 1));
+      depth.push_back(d + 1);
+      stack.push_back(std::make_pair(p + 1, range.second));
+      depth.push_back(d + 1);
+    }
+  }
+  return deepest;
+}
+
+//Times select (median rank) for element type T. Returns false on mismatch.
+template<typename T>
+static bool timeSelect(const std::vector<double>& input, int reps, double& ns){
+  Sorting qs;
+  int n = (int)input.size();
+  std::vector<T> base(input.begin(), input.end());
+  std::vector<T> work(n);
+  std::vector<T> reference(base);
+  std::nth_element(reference.begin(), reference.begin() + (n - 1)/2, reference.end());
+
+  bool ok = true;
+  WallTimer timer;
+  for (int r = 0; r < reps; r++){
+    work = base;
+    T value = qs.select(work.data(), n, (n - 1)/2);
+    ok &= (value == reference[(n - 1)/2]);
+    keep(value);
+  }
+  ns = timer.seconds()/reps*1e9;
+  return ok;
+}
+
+int main(int argc, char** argv){
+  int reps = (int)argValue(argc, argv, "--reps", 200);
+  uint32_t seed = (uint32_t)argValue(argc, argv, "--seed", 1);
+  std::mt19937 rng(seed);
+  const int sizes[] = {11, 101, 1001, 10001};
+
+  printf("select benchmark: median of n elements, %d repetitions, seed %u\n", reps, seed);
+  printf("  %-11s %6s %14s %7s %12s %12s %12s %6s\n", "input", "n", "quicksort[ns]",
+         "depth", "double[ns]", "float[ns]", "uint16[ns]", "check");
+
+  bool ok = true;
+  for (int s = 0; s < SHAPES; s++){
+    for (int n : sizes){
+      std::vector<double> input = makeInput((Shape)s, n, rng);
+
+      //Full sort with the existing recursive quicksort.
+      Sorting qs;
+      std::vector<double> work(n);
+      int sortReps = std::max(1, reps*11/n);
+      WallTimer timer;
+      for (int r = 0; r < sortReps; r++){
+        work = input;
+        qs.quickSorting(work.data(), 0, n - 1);
+        keep(work[(n - 1)/2]);
+      }
+      double sortNs = timer.seconds()/sortReps*1e9;
+
+      double dNs, fNs, uNs;
+      bool match = timeSelect<double>(input, reps, dNs);
+      match &= timeSelect<float>(input, reps, fNs);
+      match &= timeSelect<uint16_t>(input, reps, uNs);
+
+      //median() must agree with the sorted array.
+      std::vector<double> sorted(input);
+      std::sort(sorted.begin(), sorted.end());
+      std::vector<double> copy(input);
+      match &= (qs.median(copy.data(), n) == sorted[(n - 1)/2]);
+
+      printf("  %-11s %6d %14.0f %7d %12.0f %12.0f %12.0f %6s\n", shapeNames[s], n,
+             sortNs, recursionDepth(input), dNs, fNs, uNs, match ? "ok" : "FAIL");
+      ok &= match;
+    }
+  }
+
+  //An empty array gives 0 and is never read.
+  Sorting qs;
+  double none[1] = {42};
+  bool empty = qs.select(none, 0, 0) == 0 && qs.median(none, 0) == 0 && qs.percentile(none, 0, 95) == 0;
+  printf("  %-11s %6d %58s\n", "empty", 0, empty ? "ok" : "FAIL");
+  ok &= empty;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,203 @@
+/* Filename:      stepperBench.cpp
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Compares the direct-port stepper driver, see FastStepper.h, with
+ *    CheapStepper on the simulated board.
+ *
+ *    The first part takes a turn of steps with each driver and counts
+ *    the time and the pin and port writes per step.
+ *
+ *    The second part steps at fixed rates while loop() does work of
+ *    random length, once paced by polling micros() in loop() and once by
+ *    the timer interrupt. The time between steps of the timer has to
+ *    stay within a microsecond of the period, and the position has to
+ *    be the steps the shaft moved.
+ *
+ *    The last part runs scans of the controller with the driver it is
+ *    built with, FastStepper or CheapStepper (FLAGPOLE_CHEAPSTEPPER).
+ *
+ * Usage:
+ *    stepper_bench [--trials N] [--steps S] [--work-us W] [--seed S]
+ */
+
+#include "Arduino.h"
+#include "CheapStepper.h"
+#include "FastStepper.h"
+#include "Controller.h"
+#include "SimBoard.h"
+#include "BenchStats.h"
+
+//Same setup as main.ino.
+static const int pinFS5 = A0;
+static const double U0 = 2.24;
+static const double U50 = 3.33;
+static const double v50 = 8;
+static const double nFS5 = 0.51;
+static const int IN1 = 10;
+static const int IN2 = 9;
+static const int IN3 = 8;
+static const int IN4 = 7;
+static const int pinLS = 12;
+
+static const double maxTimerJitterUs = 1;
+
+//Time and writes of one step of a driver. The first step only turns
+//the coils on.
+struct StepCost {
+  double us;
+  double digitalWrites;
+  double portWrites;
+  long shaft;
+};
+
+template <typename Driver>
+static StepCost stepCost(SimBoard& board, Driver& driver, long steps){
+  board.clearCounters();
+  long shaft = board.shaftSteps();
+  uint64_t start = board.now();
+  for (long s = 0; s < steps; s++){
+    driver.step(true);
+    delayMicroseconds(2000);        //Slow enough for full steps.
+  }
+  StepCost cost;
+  cost.us = (double)(board.now() - start)/steps - 2000;
+  cost.digitalWrites = (double)board.counters().digitalWrites/steps;
+  cost.portWrites = (double)board.counters().portWrites/steps;
+  cost.shaft = board.shaftSteps() - shaft;
+  return cost;
+}
+
+//Work of one pass of loop(), a reading and some random time.
+static void loopWork(std::mt19937& rng, unsigned int workUs){
+  analogRead(pinFS5);
+  delayMicroseconds(std::uniform_int_distribution<unsigned int>(0, workUs)(rng));
+}
+
+int main(int argc, char** argv){
+  int trials = (int)argValue(argc, argv, "--trials", 20);
+  long steps = (long)argValue(argc, argv, "--steps", 4096);
+  unsigned int workUs = (unsigned int)argValue(argc, argv, "--work-us", 300);
+  uint32_t seed = (uint32_t)argValue(argc, argv, "--seed", 1);
+  SimConfig config;
+  bool ok = true;
+
+  std::mt19937 rng(seed);
+  SimBoard board(config, seed);
+  board.makeCurrent();
+
+  //Cost of a step.
+  printf("Cost of one step, %ld steps each:\n", steps);
+  printf("  %-26s %12s %14s %12s %12s\n", "driver", "time [us]", "digitalWrite", "port writes", "half-steps");
+  {
+    board.reset(config, seed);
+    CheapStepper cheap(IN1, IN2, IN3, IN4);
+    StepCost cost = stepCost(board, cheap, steps);
+    printf("  %-26s %12.1f %14.2f %12.2f %12ld\n", "CheapStepper", cost.us,
+           cost.digitalWrites, cost.portWrites, cost.shaft);
+    ok &= cost.shaft == steps - 1;
+  }
+  for (int half = 1; half >= 0; half--){
+    board.reset(config, seed);
+    FastStepper fast(IN1, IN2, IN3, IN4, half != 0);
+    StepCost cost = stepCost(board, fast, steps);
+    bool pass = cost.shaft == (half ? 1 : 2)*(steps - 1) && fast.position() == steps &&
+                board.counters().lostSteps == 0 && cost.portWrites <= 2;
+    printf("  %-26s %12.1f %14.2f %12.2f %12ld  %s\n", half ? "FastStepper, half-steps" : "FastStepper, full steps",
+           cost.us, cost.digitalWrites, cost.portWrites, cost.shaft, pass ? "ok" : "FAIL");
+    ok &= pass;
+  }
+
+  //Pacing with loop() busy.
+  const unsigned int rates[3] = {400, 800, 1200};
+  printf("\nTime between steps with loop() busy up to %u us, %d runs of %ld steps each:\n", workUs, trials, steps/8);
+  printf("  %-12s %-10s %12s %12s %12s %12s\n", "rate [1/s]", "paced by", "period [us]", "p99 |err|", "max |err|", "lost steps");
+  for (int r = 0; r < 3; r++){
+    for (int timer = 0; timer < 2; timer++){
+      Summary error;
+      unsigned long lost = 0;
+      bool counted = true;
+      double period = 0;
+      for (int t = 0; t < trials; t++){
+        board.reset(config, seed + t);
+        FastStepper fast(IN1, IN2, IN3, IN4);
+        fast.step(true);            //Energize the coils.
+        delay(10);
+        board.clearCounters();
+        long shaft = board.shaftSteps();
+        long run = steps/8;
+        double last = -1;
+        unsigned long nextUs = micros() + 1000000/rates[r];
+        if (timer){
+          fast.run(run, rates[r]);
+        }
+        long taken = 0;
+        while (timer ? fast.running() : taken < run){
+          if (!timer && (long)(micros() - nextUs) >= 0){
+            fast.step(true);
+            nextUs += 1000000/rates[r];
+            taken++;
+          }
+          loopWork(rng, workUs);
+          long moved = board.shaftSteps() - shaft;
+          if (moved != 0){
+            double now = board.lastStepUs();
+            if (last >= 0 && moved == 1){
+              period = timer ? (double)((2000000 + rates[r]/2)/rates[r])/2 : 1e6/rates[r];
+              error.add(fabs(now - last - period));
+            }
+            last = moved == 1 ? now : -1;
+            shaft += moved;
+          }
+        }
+        lost += board.counters().lostSteps;
+        counted &= fast.position() == run + 1 && board.shaftSteps() == shaft;
+      }
+      bool pass = !timer || (error.max() <= maxTimerJitterUs && lost == 0 && counted);
+      printf("  %-12u %-10s %12.1f %12.1f %12.1f %12lu  %s\n", rates[r], timer ? "timer" : "loop()",
+             period, error.percentile(99), error.max(), lost, timer ? (pass ? "ok" : "FAIL") : "");
+      ok &= pass;
+    }
+  }
+
+  //Scans with the driver of the controller.
+#if FLAGPOLE_CHEAPSTEPPER
+  const char* driverName = "CheapStepper";
+#else
+  const char* driverName = "FastStepper";
+#endif
+  std::uniform_real_distribution<double> startDeg(config.ccwStopDeg + 1, config.cwStopDeg - 1);
+  std::uniform_real_distribution<double> windDeg(config.ccwStopDeg + 10, config.cwStopDeg - 10);
+  Summary scanSeconds, scanWrites, headingError;
+  int valid = 0;
+  for (int t = 0; t < trials; t++){
+    config.startDeg = startDeg(rng);
+    board.reset(config, seed + t);
+    board.setWind(6, windDeg(rng));
+    Control controller(pinLS, IN1, IN2, IN3, IN4, pinFS5, U0, U50, v50, nFS5);
+    controller.setMessages(false);
+    board.clearCounters();
+    uint64_t start = board.now();
+    controller.scan();
+    scanSeconds.add((board.now() - start)*1e-6);
+    scanWrites.add(board.counters().digitalWrites + board.counters().portWrites);
+    if (board.counters().lostSteps == 0){
+      valid++;
+      headingError.add(fabs(board.headingError()));
+    }
+  }
+  bool pass = valid == trials;
+  printf("\nScans with %s, %d trials, %d without lost steps  %s\n", driverName, trials, valid, pass ? "ok" : "FAIL");
+  Summary::printHeader();
+  scanSeconds.printRow("scan time [s]");
+  scanWrites.printRow("coil writes");
+  headingError.printRow("|error| [deg]");
+  ok &= pass;
+
+  printf("\nsteps counted and paced by the timer  %s\n", ok ? "ok" : "FAIL");
+  return ok ? 0 : 1;
+}
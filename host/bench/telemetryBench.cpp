@@ -0,0 +1,205 @@
+/* Filename:      telemetryBench.cpp
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Checks and benchmarks the binary telemetry of Telemetry.h.
+ *
+ *    The first part encodes and decodes random records and checks that
+ *    every field survives. It then flips 1 to 3 random bits of each frame
+ *    and checks that the decoder rejects all of them. Reports the host
+ *    time to encode and decode a frame.
+ *
+ *    The second part runs the loop() of main.ino on the simulated board
+ *    in a steady wind above the allowed speed, with tracking. The JSON
+ *    and text output at 9600 baud is compared with the binary records at
+ *    9600 and 115200 baud: bytes and time per loop, time the firmware is
+ *    blocked writing to the full UART buffer, and the time from a lower
+ *    decision until its report has left the UART. The binary stream is
+ *    captured and decoded, and must arrive without bad frames or gaps.
+ *    --dump writes the stream at 115200 baud to a file, as input for 
+ *    telemetry_decode.
+ *
+ * Usage:
+ *    telemetry_bench [--records N] [--seconds T] [--seed S] [--dump FILE]
+ */
+
+#include "LoopModel.h"
+#include "BenchStats.h"
+
+//True if two records have the same fields.
+static bool sameRecord(const TelemetryRecord& a, const TelemetryRecord& b){
+  return a.type == b.type && a.sequence == b.sequence && a.timeMs == b.timeMs
+      && a.windSpeed == b.windSpeed && a.status == b.status && a.heading == b.heading
+      && a.count == b.count && a.minSpeed == b.minSpeed && a.maxSpeed == b.maxSpeed
+      && a.durationMs == b.durationMs;
+}
+
+int main(int argc, char** argv){
+  long records = (long)argValue(argc, argv, "--records", 1e6);
+  double seconds = argValue(argc, argv, "--seconds", 300);
+  uint32_t seed = (uint32_t)argValue(argc, argv, "--seed", 1);
+  const char* dumpPath = 0;
+  for (int i = 1; i + 1 < argc; i++){
+    if (strcmp(argv[i], "--dump") == 0){
+      dumpPath = argv[i + 1];
+    }
+  }
+  bool ok = true;
+
+  //Codec round trip and corrupted frames.
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<uint32_t> bits32;
+  std::vector<TelemetryRecord> input(4096);
+  std::vector<uint8_t> frames(input.size()*telemetryFrameSize);
+  for (size_t i = 0; i < input.size(); i++){
+    uint32_t a = bits32(rng), b = bits32(rng), c = bits32(rng), d = bits32(rng);
+    TelemetryRecord& r = input[i];
+    r.type = a & 3;
+    r.sequence = (uint16_t)(a >> 16);
+    r.timeMs = b;
+    r.windSpeed = (uint16_t)c;
+    r.status = (uint8_t)(a >> 8) & 0x0F;
+    r.heading = (int16_t)(c >> 16);
+    r.count = (uint8_t)d;
+    r.minSpeed = (uint16_t)(d >> 8);
+    r.maxSpeed = (uint16_t)(d >> 12);
+    r.durationMs = (uint16_t)(b ^ d);
+    //Many zero bytes exercise the COBS encoding.
+    if (i % 4 == 0){
+      r.timeMs &= 0xFF00FF00;
+      r.windSpeed &= 0x00FF;
+      r.heading = 0;
+    }
+  }
+
+  long roundTrips = 0, mismatches = 0, undetected = 0, corrupted = 0;
+  long checksum = 0;
+  WallTimer encodeTimer;
+  for (long i = 0; i < records; i++){
+    checksum += Telemetry::encode(input[i & 4095], &frames[(i & 4095)*telemetryFrameSize]);
+  }
+  double encodeNs = encodeTimer.seconds()/records*1e9;
+  WallTimer decodeTimer;
+  for (long i = 0; i < records; i++){
+    TelemetryRecord out;
+    const uint8_t* frame = &frames[(i & 4095)*telemetryFrameSize];
+    bool decoded = Telemetry::decode(frame, telemetryFrameSize - 1, out);
+    roundTrips++;
+    mismatches += decoded && sameRecord(out, input[i & 4095]) ? 0 : 1;
+  }
+  double decodeNs = decodeTimer.seconds()/records*1e9;
+  keep(checksum);
+
+  std::uniform_int_distribution<int> flips(1, 3);
+  std::uniform_int_distribution<int> bitPos(0, (telemetryFrameSize - 1)*8 - 1);
+  for (size_t i = 0; i < input.size(); i++){
+    uint8_t frame[telemetryFrameSize];
+    Telemetry::encode(input[i], frame);
+    int n = flips(rng);
+    int flipped[3] = {-1, -1, -1};
+    for (int k = 0; k < n; k++){
+      int pos;
+      do {
+        pos = bitPos(rng);
+      } while (pos == flipped[0] || pos == flipped[1]);
+      flipped[k] = pos;
+      frame[pos/8] ^= (uint8_t)(1 << (pos % 8));
+    }
+    //A flip to zero splits the frame, both parts must be rejected.
+    size_t start = 0;
+    for (size_t k = 0; k <= telemetryFrameSize - 1; k++){
+      if (k == telemetryFrameSize - 1 || frame[k] == 0){
+        TelemetryRecord out;
+        if (k > start && Telemetry::decode(frame + start, (uint8_t)(k - start), out)){
+          undetected++;
+        }
+        start = k + 1;
+      }
+    }
+    corrupted++;
+  }
+
+  printf("codec, %ld records, %d byte frames\n", records, telemetryFrameSize);
+  printf("  encode %8.1f ns  decode %8.1f ns\n", encodeNs, decodeNs);
+  printf("  round trip mismatches        %ld  %s\n", mismatches, mismatches == 0 ? "ok" : "FAIL");
+  printf("  1-3 bit errors undetected    %ld of %ld  %s\n", undetected, corrupted,
+         undetected == 0 ? "ok" : "FAIL");
+  ok &= mismatches == 0 && undetected == 0;
+
+  //loop() with JSON and text against binary records.
+  printf("loop() for %.0f s, wind 6.0 m/s, tracking\n", seconds);
+  struct { const char* name; bool binary; unsigned long baud; } links[3] = {
+    {"JSON and text, 9600 baud", false, 9600},
+    {"binary, 9600 baud", true, 9600},
+    {"binary, 115200 baud", true, 115200}
+  };
+  SimConfig config;
+  SimBoard board(config, seed);
+  for (int l = 0; l < 3; l++){
+    board.reset(config, seed);
+    board.makeCurrent();
+    board.setWind(6, 100);
+    board.setSerialCapture(links[l].binary);
+    board.clearSerialOutput();
+    board.advance(1e6);
+
+    LoopModel model(links[l].binary, links[l].baud);
+    Summary bytes, cycle, blocked, latency;
+    uint64_t start = board.now();
+    while ((board.now() - start)*1e-6 < seconds){
+      board.clearCounters();
+      uint64_t cycleStart = board.now();
+      double blockedUs;
+      latency.add(model.loop(board, blockedUs));
+      cycle.add((board.now() - cycleStart)*1e-6);
+      bytes.add(board.counters().serialBytes);
+      blocked.add(blockedUs*1e-3);
+    }
+    printf("%s: %d loops\n", links[l].name, (int)cycle.count());
+    Summary::printHeader();
+    bytes.printRow("bytes per loop");
+    cycle.printRow("time per loop [s]");
+    blocked.printRow("blocked on serial [ms]");
+    latency.printRow("decision on the wire [s]");
+
+    //Decode the captured stream.
+    if (links[l].binary){
+      const std::string& stream = board.serialOutput();
+      long frames = 0, bad = 0, gaps = 0;
+      uint16_t next = 0;
+      size_t begin = 0;
+      for (size_t k = 0; k < stream.size(); k++){
+        if (stream[k] != 0){
+          continue;
+        }
+        TelemetryRecord out;
+        if (Telemetry::decode((const uint8_t*)stream.data() + begin, (uint8_t)(k - begin), out)){
+          gaps += out.sequence != next ? 1 : 0;
+          next = out.sequence + 1;
+          frames++;
+        }
+        else {
+          bad++;
+        }
+        begin = k + 1;
+      }
+      bool clean = bad == 0 && gaps == 0 && begin == stream.size();
+      printf("  decoded %ld records, %ld bad frames, %ld gaps  %s\n", frames, bad, gaps,
+             clean ? "ok" : "FAIL");
+      ok &= clean;
+      if (dumpPath && links[l].baud == 115200){
+        FILE* dump = fopen(dumpPath, "wb");
+        ok &= dump != 0;
+        if (dump){
+          fwrite(stream.data(), 1, stream.size(), dump);
+          fclose(dump);
+        }
+      }
+    }
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,246 @@
+/* Filename:      Arduino.cpp
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Host implementation of the Arduino API on top of SimBoard.
+ *
+ * Notes:
+ *    - Calls made while no board is current (static initialisation of
+ *      global objects) see a stopped clock and idle pins.
+ */
+
+#include "Arduino.h"
+#include "SimBoard.h"
+#include <stdio.h>
+
+HardwareSerial Serial;
+
+void pinMode(uint8_t pin, uint8_t mode){
+  SimBoard* board = SimBoard::current();
+  if (board){
+    board->pinMode(pin, mode);
+  }
+}
+
+void digitalWrite(uint8_t pin, uint8_t val){
+  SimBoard* board = SimBoard::current();
+  if (board){
+    board->digitalWrite(pin, val);
+  }
+}
+
+int digitalRead(uint8_t pin){
+  SimBoard* board = SimBoard::current();
+  return board ? board->digitalRead(pin) : LOW;
+}
+
+int analogRead(uint8_t pin){
+  SimBoard* board = SimBoard::current();
+  return board ? board->analogRead(pin) : 0;
+}
+
+uint8_t digitalPinToPort(uint8_t pin){
+  return SimBoard::pinPort(pin);
+}
+
+uint8_t digitalPinToBitMask(uint8_t pin){
+  return SimBoard::pinBit(pin);
+}
+
+void simAdcStart(uint8_t pin, void (*isr)(uint16_t conversion)){
+  SimBoard* board = SimBoard::current();
+  if (board){
+    board->adcStart(pin, isr);
+  }
+}
+
+void simAdcStop(){
+  SimBoard* board = SimBoard::current();
+  if (board){
+    board->adcStop();
+  }
+}
+
+void simPinChangeStart(uint8_t pin, void (*isr)()){
+  SimBoard* board = SimBoard::current();
+  if (board){
+    board->pinChangeStart(pin, isr);
+  }
+}
+
+void simPinChangeStop(){
+  SimBoard* board = SimBoard::current();
+  if (board){
+    board->pinChangeStop();
+  }
+}
+
+void simPortWrite(uint8_t port, uint8_t mask, uint8_t bits){
+  SimBoard* board = SimBoard::current();
+  if (board){
+    board->portWrite(port, mask, bits);
+  }
+}
+
+void simTimerStart(uint16_t compare, void (*isr)()){
+  SimBoard* board = SimBoard::current();
+  if (board){
+    board->timerStart((compare + 1)*0.5, isr);
+  }
+}
+
+void simTimerStop(){
+  SimBoard* board = SimBoard::current();
+  if (board){
+    board->timerStop();
+  }
+}
+
+void simSleep(unsigned long us, bool powerDown){
+  SimBoard* board = SimBoard::current();
+  if (board){
+    board->sleep(us, powerDown);
+  }
+}
+
+unsigned long micros(){
+  SimBoard* board = SimBoard::current();
+  return board ? (unsigned long)board->micros() : 0;
+}
+
+unsigned long millis(){
+  return micros()/1000;
+}
+
+void delay(unsigned long ms){
+  SimBoard* board = SimBoard::current();
+  if (board){
+    board->advance(ms*1000.0);
+  }
+}
+
+void delayMicroseconds(unsigned int us){
+  SimBoard* board = SimBoard::current();
+  if (board){
+    board->advance(us);
+  }
+}
+
+void HardwareSerial::begin(unsigned long baud){
+  SimBoard* board = SimBoard::current();
+  if (board){
+    board->serialBegin(baud);
+  }
+}
+
+void HardwareSerial::end(){
+}
+
+int HardwareSerial::available(){
+  return 0;
+}
+
+int HardwareSerial::read(){
+  return -1;
+}
+
+void HardwareSerial::flush(){
+  SimBoard* board = SimBoard::current();
+  if (board){
+    board->serialFlush();
+  }
+}
+
+size_t HardwareSerial::write(uint8_t c){
+  return write(&c, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size){
+  SimBoard* board = SimBoard::current();
+  if (board){
+    board->serialWrite(buffer, size);
+  }
+  return size;
+}
+
+size_t HardwareSerial::write(const char* str){
+  return write((const uint8_t*)str, strlen(str));
+}
+
+size_t HardwareSerial::print(const __FlashStringHelper* str){
+  return write(reinterpret_cast<const char*>(str));
+}
+
+size_t HardwareSerial::print(const char* str){
+  return write(str);
+}
+
+size_t HardwareSerial::print(char c){
+  return write((uint8_t)c);
+}
+
+size_t HardwareSerial::print(int value){
+  return print((long)value);
+}
+
+size_t HardwareSerial::print(unsigned int value){
+  return print((unsigned long)value);
+}
+
+size_t HardwareSerial::print(long value){
+  char text[24];
+  snprintf(text, sizeof(text), "%ld", value);
+  return write(text);
+}
+
+size_t HardwareSerial::print(unsigned long value){
+  char text[24];
+  snprintf(text, sizeof(text), "%lu", value);
+  return write(text);
+}
+
+size_t HardwareSerial::print(double value, int digits){
+  char text[48];
+  snprintf(text, sizeof(text), "%.*f", digits, value);
+  return write(text);
+}
+
+size_t HardwareSerial::println(){
+  return write("\r\n");
+}
+
+size_t HardwareSerial::println(const __FlashStringHelper* str){
+  return print(str) + println();
+}
+
+size_t HardwareSerial::println(const char* str){
+  return print(str) + println();
+}
+
+size_t HardwareSerial::println(char c){
+  return print(c) + println();
+}
+
+size_t HardwareSerial::println(int value){
+  return print(value) + println();
+}
+
+size_t HardwareSerial::println(unsigned int value){
+  return print(value) + println();
+}
+
+size_t HardwareSerial::println(long value){
+  return print(value) + println();
+}
+
+size_t HardwareSerial::println(unsigned long value){
+  return print(value) + println();
+}
+
+size_t HardwareSerial::println(double value, int digits){
+  return print(value, digits) + println();
+}
@@ -0,0 +1,141 @@
+/* Filename:      Arduino.h
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Host replacement for the Arduino core. Provides the subset of the
+ *    Arduino API that the flagpole libraries use and forwards every call
+ *    to the simulated board (see host/sim/Board.h), so that
+ *    Controller.cpp, FS5.cpp and quickSort.cpp compile unchanged on Linux.
+ *
+ * Notes:
+ *    - Time is virtual. Every HAL call charges the simulated clock with
+ *      roughly what the call costs on an ATmega328 at 16 MHz, and
+ *      delay()/delayMicroseconds() advance the clock without sleeping.
+ *    - Only used by the host build, never by the Arduino IDE.
+ */
+
+#ifndef Arduino_h       //Include guard.
+#define Arduino_h
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define HIGH          0x1
+#define LOW           0x0
+
+#define INPUT         0x0
+#define OUTPUT        0x1
+#define INPUT_PULLUP  0x2
+
+#define PI            3.1415926535897932384626433832795
+
+//Analog pin numbers of the Arduino Nano.
+static const uint8_t A0 = 14;
+static const uint8_t A1 = 15;
+static const uint8_t A2 = 16;
+static const uint8_t A3 = 17;
+static const uint8_t A4 = 18;
+static const uint8_t A5 = 19;
+static const uint8_t A6 = 20;
+static const uint8_t A7 = 21;
+
+//Ports of the ATmega328, numbered as in the Arduino core.
+#define NOT_A_PORT    0
+#define PB            2
+#define PC            3
+#define PD            4
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+//Program memory. The host has one address space, so data in PROGMEM is
+//read in place and F() only marks the string for the print overloads.
+#define PROGMEM
+#define PSTR(s)                 (s)
+class __FlashStringHelper;
+#define F(s)                    (reinterpret_cast<const __FlashStringHelper*>(PSTR(s)))
+#define pgm_read_byte(address)  (*(const uint8_t*)(address))
+#define pgm_read_word(address)  (*(const uint16_t*)(address))
+#define pgm_read_float(address) (*(const float*)(address))
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+
+//Port and bit of a pin of the Arduino Nano.
+uint8_t digitalPinToPort(uint8_t pin);
+uint8_t digitalPinToBitMask(uint8_t pin);
+
+unsigned long micros();
+unsigned long millis();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+//Serial port. Output is forwarded to the simulated board, which models
+//the transmit buffer and baud rate of the ATmega328 UART.
+class HardwareSerial {
+  public:
+    void begin(unsigned long baud);
+    void end();
+    int available();
+    int read();
+    void flush();
+
+    size_t write(uint8_t c);
+    size_t write(const uint8_t* buffer, size_t size);
+    size_t write(const char* str);
+
+    size_t print(const __FlashStringHelper* str);
+    size_t print(const char* str);
+    size_t print(char c);
+    size_t print(int value);
+    size_t print(unsigned int value);
+    size_t print(long value);
+    size_t print(unsigned long value);
+    size_t print(double value, int digits = 2);
+
+    size_t println();
+    size_t println(const __FlashStringHelper* str);
+    size_t println(const char* str);
+    size_t println(char c);
+    size_t println(int value);
+    size_t println(unsigned int value);
+    size_t println(long value);
+    size_t println(unsigned long value);
+    size_t println(double value, int digits = 2);
+};
+
+extern HardwareSerial Serial;
+
+//Free running ADC of the simulated board. Stands in for the ADC 
+//registers and ADC_vect of the ATmega328, see ADCSampler.cpp. Not part
+//of the Arduino API.
+void simAdcStart(uint8_t pin, void (*isr)(uint16_t conversion));
+void simAdcStop();
+
+//Pin change interrupt of the simulated board. Stands in for the pin
+//change mask and the PCINT vectors of the ATmega328, see LimitSwitch.cpp.
+//Not part of the Arduino API.
+void simPinChangeStart(uint8_t pin, void (*isr)());
+void simPinChangeStop();
+
+//Output registers and timer 1 of the simulated board. Stand in for
+//writing PORTB - PORTD and for timer 1 in CTC mode at 2 MHz with
+//TIMER1_COMPA_vect, see FastStepper.cpp. Not part of the Arduino API.
+void simPortWrite(uint8_t port, uint8_t mask, uint8_t bits);
+void simTimerStart(uint16_t compare, void (*isr)());
+void simTimerStop();
+
+//Sleep of the simulated board, idle or power down. Stands in for the 
+//sleep modes and the watchdog interrupt of the ATmega328, see 
+//PowerSave.cpp. Not part of the Arduino API.
+void simSleep(unsigned long us, bool powerDown);
+
+#endif
@@ -0,0 +1,91 @@
+/* Filename:      ArduinoJson.h
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Host stand-in for the part of the ArduinoJson library by Benoit
+ *    Blanchon (https://arduinojson.org) that main.ino uses: a flat
+ *    StaticJsonDocument of strings and numbers and serializeJson() to
+ *    the serial port. Lets main.ino compile on the host, see
+ *    size_report in host/CMakeLists.txt.
+ *
+ * Notes:
+ *    - Members are printed in the order they were set, numbers like
+ *      LoopModel.h prints them. Strings are not escaped.
+ */
+
+#ifndef ARDUINOJSON_H       //Include guard.
+#define ARDUINOJSON_H
+#include "Arduino.h"
+#include <stdio.h>
+
+template <size_t capacity>
+class StaticJsonDocument {
+  public:
+    //Value of one member, set by assignment.
+    class Member {
+      public:
+        Member(StaticJsonDocument* doc, uint8_t index) : _doc(doc), _index(index) {}
+
+        Member& operator=(const char* text){
+          snprintf(_doc->_values[_index], valueSize, "\"%s\"", text);
+          return *this;
+        }
+
+        Member& operator=(const __FlashStringHelper* text){
+          return *this = reinterpret_cast<const char*>(text);
+        }
+
+        Member& operator=(double value){
+          snprintf(_doc->_values[_index], valueSize, "%.9g", value);
+          return *this;
+        }
+
+      private:
+        StaticJsonDocument* _doc;
+        uint8_t _index;
+    };
+
+    StaticJsonDocument() : _count(0) {}
+
+    Member operator[](const char* key){
+      uint8_t i = 0;
+      while (i < _count && strcmp(_keys[i], key) != 0){
+        i++;
+      }
+      if (i == _count && _count < maxMembers){
+        _keys[_count] = key;
+        _values[_count][0] = 0;
+        _count++;
+      }
+      return Member(this, i < maxMembers ? i : maxMembers - 1);
+    }
+
+    //Print the document as an object.
+    size_t printTo(HardwareSerial& serial) const {
+      size_t size = serial.print('{');
+      for (uint8_t i = 0; i < _count; i++){
+        size += serial.print(i > 0 ? ",\"" : "\"");
+        size += serial.print(_keys[i]);
+        size += serial.print("\":");
+        size += serial.print(_values[i]);
+      }
+      return size + serial.print('}');
+    }
+
+  private:
+    static const uint8_t maxMembers = 8;
+    static const size_t valueSize = capacity < 96 ? capacity : 96;
+    const char* _keys[maxMembers];
+    char _values[maxMembers][valueSize];
+    uint8_t _count;
+};
+
+template <size_t capacity>
+size_t serializeJson(const StaticJsonDocument<capacity>& doc, HardwareSerial& serial){
+  return doc.printTo(serial);
+}
+#endif
@@ -0,0 +1,183 @@
+/* Filename:      CheapStepper.cpp
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Host stand-in for the CheapStepper library by tyhenry.
+ */
+
+#include "CheapStepper.h"
+
+CheapStepper::CheapStepper()
+  : stepN(0), totalSteps(4096), delay(900), seqN(-1), lastStepTime(0), stepsLeft(0) {
+  pins[0] = 8;
+  pins[1] = 9;
+  pins[2] = 10;
+  pins[3] = 11;
+  for (int p = 0; p < 4; p++){
+    pinMode(pins[p], OUTPUT);
+  }
+}
+
+CheapStepper::CheapStepper(int in1, int in2, int in3, int in4)
+  : stepN(0), totalSteps(4096), delay(900), seqN(-1), lastStepTime(0), stepsLeft(0) {
+  pins[0] = in1;
+  pins[1] = in2;
+  pins[2] = in3;
+  pins[3] = in4;
+  for (int p = 0; p < 4; p++){
+    pinMode(pins[p], OUTPUT);
+  }
+}
+
+void CheapStepper::setRpm(int rpm){
+  delay = calcDelay(rpm);
+}
+
+void CheapStepper::setTotalSteps(int numSteps){
+  totalSteps = numSteps;
+}
+
+void CheapStepper::move(bool clockwise, int numSteps){
+  for (int n = 0; n < numSteps; n++){
+    step(clockwise);
+  }
+}
+
+void CheapStepper::moveTo(bool clockwise, int toStep){
+  toStep %= totalSteps;
+  while (stepN != toStep){
+    step(clockwise);
+  }
+}
+
+void CheapStepper::moveDegrees(bool clockwise, int deg){
+  move(clockwise, (int)(deg*(float)totalSteps/360));
+}
+
+void CheapStepper::moveToDegree(bool clockwise, int toDegree){
+  moveTo(clockwise, (int)((toDegree % 360)*(float)totalSteps/360));
+}
+
+void CheapStepper::newMove(bool clockwise, int numSteps){
+  stepsLeft = clockwise ? numSteps : -numSteps;
+  lastStepTime = micros();
+}
+
+void CheapStepper::newMoveTo(bool clockwise, int toStep){
+  toStep %= totalSteps;
+  int steps = clockwise ? toStep - stepN : stepN - toStep;
+  if (steps < 0){
+    steps += totalSteps;
+  }
+  newMove(clockwise, steps);
+}
+
+void CheapStepper::newMoveDegrees(bool clockwise, int deg){
+  newMove(clockwise, (int)(deg*(float)totalSteps/360));
+}
+
+void CheapStepper::newMoveToDegree(bool clockwise, int toDegree){
+  newMoveTo(clockwise, (int)((toDegree % 360)*(float)totalSteps/360));
+}
+
+void CheapStepper::run(){
+  if (micros() - lastStepTime >= (unsigned long)delay){
+    if (stepsLeft > 0){
+      seqCW();
+      stepsLeft--;
+    }
+    else if (stepsLeft < 0){
+      seqCCW();
+      stepsLeft++;
+    }
+    lastStepTime = micros();
+  }
+}
+
+void CheapStepper::stop(){
+  stepsLeft = 0;
+}
+
+void CheapStepper::step(bool clockwise){
+  if (clockwise){
+    seqCW();
+  }
+  else {
+    seqCCW();
+  }
+}
+
+void CheapStepper::off(){
+  for (int p = 0; p < 4; p++){
+    digitalWrite(pins[p], 0);
+  }
+}
+
+int CheapStepper::getPin(int p){
+  return (p >= 0 && p < 4) ? pins[p] : 0;
+}
+
+int CheapStepper::calcDelay(int rpm){
+  if (rpm < 6){
+    return delay;               //Will overheat, no change.
+  }
+  if (rpm >= 24){
+    return 600;                 //Highest speed.
+  }
+  unsigned long d = 60000000UL/(totalSteps*(unsigned long)rpm);
+  return (int)d;
+}
+
+int CheapStepper::calcRpm(){
+  return calcRpm(delay);
+}
+
+int CheapStepper::calcRpm(int _delay){
+  unsigned long rpm = 60000000UL/(unsigned long)_delay/totalSteps;
+  return (int)rpm;
+}
+
+void CheapStepper::seqCW(){
+  seqN++;
+  if (seqN > 7){
+    seqN = 0;
+  }
+  seq(seqN);
+  stepN++;
+  if (stepN >= totalSteps){
+    stepN -= totalSteps;
+  }
+}
+
+void CheapStepper::seqCCW(){
+  seqN--;
+  if (seqN < 0){
+    seqN = 7;
+  }
+  seq(seqN);
+  stepN--;
+  if (stepN < 0){
+    stepN += totalSteps;
+  }
+}
+
+void CheapStepper::seq(int seqNum){
+  static const int pattern[8][4] = {
+    {1, 0, 0, 0},
+    {1, 1, 0, 0},
+    {0, 1, 0, 0},
+    {0, 1, 1, 0},
+    {0, 0, 1, 0},
+    {0, 0, 1, 1},
+    {0, 0, 0, 1},
+    {1, 0, 0, 1},
+  };
+  for (int p = 0; p < 4; p++){
+    digitalWrite(pins[p], pattern[seqNum][p]);
+  }
+  delayMicroseconds(delay);
+}
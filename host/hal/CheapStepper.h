@@ -0,0 +1,67 @@
+/* Filename:      CheapStepper.h
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Host stand-in for the CheapStepper library by tyhenry
+ *    (https://github.com/tyhenry/CheapStepper). Same public interface and
+ *    the same half-step sequence and timing: every step writes the four
+ *    coil pins with digitalWrite() and then waits the step delay, which
+ *    the simulated board turns into shaft motion and elapsed time.
+ */
+
+#ifndef CHEAPSTEPPER_H      //Include guard.
+#define CHEAPSTEPPER_H
+#include "Arduino.h"
+
+class CheapStepper {
+  public:
+    CheapStepper();
+    CheapStepper(int in1, int in2, int in3, int in4);
+
+    void setRpm(int rpm);
+    void set4076StepMode() { totalSteps = 4076; }
+    void setTotalSteps(int numSteps);
+
+    void move(bool clockwise, int numSteps);
+    void moveTo(bool clockwise, int toStep);
+    void moveDegrees(bool clockwise, int deg);
+    void moveToDegree(bool clockwise, int toDegree);
+
+    void newMove(bool clockwise, int numSteps);
+    void newMoveTo(bool clockwise, int toStep);
+    void newMoveDegrees(bool clockwise, int deg);
+    void newMoveToDegree(bool clockwise, int toDegree);
+
+    void run();
+    void stop();
+    void step(bool clockwise);
+    void off();
+
+    int getStep() { return stepN; }
+    int getDelay() { return delay; }
+    int getRpm() { return calcRpm(); }
+    int getPin(int p);
+    int getStepsLeft() { return stepsLeft; }
+
+  private:
+    int calcDelay(int rpm);
+    int calcRpm();
+    int calcRpm(int _delay);
+    void seqCW();
+    void seqCCW();
+    void seq(int seqNum);
+
+    int pins[4];                  //IN1 - IN4.
+    int stepN;                    //Current step, 0 to totalSteps-1.
+    int totalSteps;               //Steps per revolution.
+    int delay;                    //Delay after each step [us].
+    int seqN;                     //Position in the coil sequence.
+    unsigned long lastStepTime;   //Time of the last non-blocking step.
+    int stepsLeft;                //Steps left of a non-blocking move.
+};
+
+#endif
@@ -0,0 +1,38 @@
+/* Filename:      EEPROM.cpp
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Host stand-in for the EEPROM library on top of SimBoard.
+ */
+
+#include "EEPROM.h"
+#include "SimBoard.h"
+
+EEPROMClass EEPROM;
+
+uint8_t EEPROMClass::read(int idx){
+  SimBoard* board = SimBoard::current();
+  return board ? board->eepromRead(idx) : 0xFF;
+}
+
+void EEPROMClass::write(int idx, uint8_t val){
+  SimBoard* board = SimBoard::current();
+  if (board){
+    board->eepromWrite(idx, val);
+  }
+}
+
+void EEPROMClass::update(int idx, uint8_t val){
+  if (read(idx) != val){
+    write(idx, val);
+  }
+}
+
+uint16_t EEPROMClass::length(){
+  SimBoard* board = SimBoard::current();
+  return board ? board->eepromSize() : 0;
+}
@@ -0,0 +1,44 @@
+/* Filename:      EEPROM.h
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Host stand-in for the EEPROM library of the Arduino AVR core. The
+ *    bytes live in the simulated board, which charges the write time
+ *    and counts the writes of every byte, see SimBoard.
+ */
+
+#ifndef EEPROM_h          //Include guard.
+#define EEPROM_h
+#include "Arduino.h"
+
+class EEPROMClass {
+  public:
+    uint8_t read(int idx);
+    void write(int idx, uint8_t val);
+    void update(int idx, uint8_t val);
+    uint16_t length();
+
+    template<typename T> T& get(int idx, T& t){
+      uint8_t* p = (uint8_t*)&t;
+      for (size_t i = 0; i < sizeof(T); i++){
+        p[i] = read(idx + (int)i);
+      }
+      return t;
+    }
+
+    template<typename T> const T& put(int idx, const T& t){
+      const uint8_t* p = (const uint8_t*)&t;
+      for (size_t i = 0; i < sizeof(T); i++){
+        update(idx + (int)i, p[i]);
+      }
+      return t;
+    }
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
@@ -0,0 +1,77 @@
+/* Filename:      Filters.cpp
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Host stand-in for FilterOnePole of the Filters library.
+ */
+
+#include "Filters.h"
+
+FilterOnePole::FilterOnePole(FILTER_TYPE ft, float fc, float initialValue){
+  setFilter(ft, fc, initialValue);
+}
+
+void FilterOnePole::setFilter(FILTER_TYPE ft, float fc, float initialValue){
+  FT = ft;
+  TauSamps = 0;
+  ampFactor = 0;
+  ElapsedUS = 0;
+  setFrequency(fc);
+  setToNewValue(initialValue);
+}
+
+float FilterOnePole::input(float inVal){
+  long thisUS = micros();
+  ElapsedUS = float(thisUS - LastUS);
+  LastUS = thisUS;
+
+  //Shift the data values.
+  Ylast = Y;
+  Xlast = X;
+  X = inVal;
+
+  //The time constant is given in microseconds, convert it to samples.
+  TauSamps = TauUS/ElapsedUS;
+  ampFactor = exp(-1.0/TauSamps);
+  Y = (1.0 - ampFactor)*X + ampFactor*Ylast;
+  return output();
+}
+
+float FilterOnePole::output(){
+  switch (FT){
+    case LOWPASS:
+      return Y;
+    case HIGHPASS:
+      return X - Y;
+    case INTEGRATOR:
+      return Y*TauUS/1.0e6;
+    case DIFFERENTIATOR:
+      return (X - Y)/TauUS*1.0e6;
+  }
+  return 0;
+}
+
+void FilterOnePole::setFrequency(float newFrequency){
+  setTau(1.0/(2*PI*newFrequency));
+}
+
+void FilterOnePole::setTau(float newTau){
+  TauUS = newTau*1e6;
+}
+
+float FilterOnePole::getFrequency(){
+  return 1.0e6/(2*PI*TauUS);
+}
+
+float FilterOnePole::getTau(){
+  return TauUS/1e6;
+}
+
+void FilterOnePole::setToNewValue(float newVal){
+  Y = Ylast = X = Xlast = newVal;
+  LastUS = micros();
+}
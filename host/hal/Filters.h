@@ -0,0 +1,50 @@
+/* Filename:      Filters.h
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Host stand-in for the Filters library by hideakitai
+ *    (https://github.com/hideakitai/Filters). Only FilterOnePole is
+ *    provided. Like the original it derives its coefficient from the
+ *    time elapsed between inputs, measured with micros().
+ */
+
+#ifndef Filters_h       //Include guard.
+#define Filters_h
+#include "Arduino.h"
+
+enum FILTER_TYPE {
+  HIGHPASS,
+  LOWPASS,
+  INTEGRATOR,
+  DIFFERENTIATOR
+};
+
+struct FilterOnePole {
+  FILTER_TYPE FT;           //Type of filter.
+  float TauUS;              //Time constant [us].
+  float TauSamps;           //Time constant in samples.
+  float ampFactor;          //Weight of the previous output.
+  float X;                  //Latest input.
+  float Y;                  //Latest output.
+  float Ylast;              //Previous output.
+  float Xlast;              //Previous input.
+  long LastUS;              //Time of the previous input.
+  float ElapsedUS;          //Time between the last two inputs.
+
+  FilterOnePole(FILTER_TYPE ft = LOWPASS, float fc = 1.0, float initialValue = 0);
+
+  float input(float inVal);
+  float output();
+  void setFilter(FILTER_TYPE ft, float fc, float initialValue);
+  void setFrequency(float newFrequency);
+  void setTau(float newTau);
+  float getFrequency();
+  float getTau();
+  void setToNewValue(float newVal);
+};
+
+#endif
@@ -0,0 +1,151 @@
+/* Filename:      GustField.cpp
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Stochastic wind field, see GustField.h.
+ */
+
+#include "GustField.h"
+#include <math.h>
+
+static const double gridSeconds = 0.1;
+
+GustParams::GustParams(){
+  meanSpeed = 2;
+  drift = 0.3;
+  driftSeconds = 600;
+  intensity = 0.25;
+  turbulenceSeconds = 8;
+  gustsPerMinute = 0.5;
+  gustSpeed = 0.6;
+  gustSeconds = 6;
+  direction = 100;
+  directionSpread = 15;
+  directionSeconds = 30;
+}
+
+GustField::GustField(const GustParams& params, uint64_t seed)
+  : _params(params), _rng(seed), _normal(0.0, 1.0), _exponential(1.0) {
+  //Start the processes in their stationary distributions.
+  _drift = _normal(_rng);
+  _turbulence = _normal(_rng);
+  _veer = _normal(_rng);
+  _nextGust = params.gustsPerMinute > 0 ? _exponential(_rng)*60/params.gustsPerMinute : INFINITY;
+  _gustStart = _gustLength = _gustSize = 0;
+  _threshold = -1;
+  _window = 0;
+  _windowPoints = 0;
+  _points = 0;
+  stepGrid();
+}
+
+//One step of an Ornstein-Uhlenbeck process with unit variance.
+static double relax(double x, double seconds, double noise){
+  double a = exp(-gridSeconds/seconds);
+  return a*x + sqrt(1 - a*a)*noise;
+}
+
+/* Function:    void GustField::stepGrid()
+ * Purpose:     Generate the next grid point and follow the episodes.
+ *
+ * Input:       None
+ *
+ * Output:      None
+*/
+void GustField::stepGrid(){
+  long i = _points;
+  double t = i*gridSeconds;
+  if (i > 0){
+    _drift = relax(_drift, _params.driftSeconds, _normal(_rng));
+    _turbulence = relax(_turbulence, _params.turbulenceSeconds, _normal(_rng));
+    _veer = relax(_veer, _params.directionSeconds, _normal(_rng));
+  }
+  double mean = _params.meanSpeed*fmax(0.05, 1 + _params.drift*_drift);
+
+  //Gusts arrive as a Poisson process, with exponential sizes and lengths.
+  if (t >= _nextGust){
+    _gustStart = t;
+    _gustLength = fmax(1.0, _params.gustSeconds*_exponential(_rng));
+    _gustSize = _params.gustSpeed*mean*_exponential(_rng);
+    _nextGust = t + _exponential(_rng)*60/_params.gustsPerMinute;
+  }
+  double gust = 0;
+  if (t < _gustStart + _gustLength){
+    gust = 0.5*_gustSize*(1 - cos(2*M_PI*(t - _gustStart)/_gustLength));
+  }
+
+  int k = (int)(i & (history - 1));
+  _speed[k] = fmax(0.0, mean*(1 + _params.intensity*_turbulence) + gust);
+  _direction[k] = _params.direction + _params.directionSpread*_veer;
+  if (i == 0){
+    _sum[k] = 0;
+  }
+  else {
+    int previous = (int)((i - 1) & (history - 1));
+    _sum[k] = _sum[previous] + 0.5*(_speed[previous] + _speed[k])*gridSeconds;
+  }
+  _points++;
+
+  if (_threshold >= 0 && i >= _windowPoints){
+    int start = (int)((i - _windowPoints) & (history - 1));
+    bool above = (_sum[k] - _sum[start])/_window > _threshold;
+    bool open = !_episodes.empty() && _episodes.back().end < 0;
+    if (above && !open){
+      _episodes.push_back(GustEpisode{t, -1});
+    }
+    if (!above && open){
+      _episodes.back().end = t;
+    }
+  }
+}
+
+void GustField::extend(double t){
+  while ((_points - 1)*gridSeconds < t){
+    stepGrid();
+  }
+}
+
+//Integral of the speed from 0 to t.
+double GustField::integral(double t){
+  long i = (long)floor(t/gridSeconds);
+  long oldest = _points > history ? _points - history : 0;
+  i = i < oldest ? oldest : i;
+  i = i > _points - 2 ? _points - 2 : i;
+  i = i < 0 ? 0 : i;
+  int k = (int)(i & (history - 1));
+  int next = (int)((i + 1) & (history - 1));
+  double dt = fmin(fmax(t - i*gridSeconds, 0.0), gridSeconds);
+  double s = _speed[k] + (_speed[next] - _speed[k])*dt/gridSeconds;
+  return _sum[k] + 0.5*(_speed[k] + s)*dt;
+}
+
+WindSample GustField::at(double t){
+  t = fmax(t, 0.0);
+  extend(t + gridSeconds);
+  long i = (long)floor(t/gridSeconds);
+  long oldest = _points - history;
+  i = i < oldest ? oldest : i;
+  int k = (int)(i & (history - 1));
+  int next = (int)((i + 1) & (history - 1));
+  double f = fmin(fmax(t/gridSeconds - i, 0.0), 1.0);
+  return WindSample{_speed[k] + (_speed[next] - _speed[k])*f,
+                    _direction[k] + (_direction[next] - _direction[k])*f};
+}
+
+void GustField::setThreshold(double speed, double window){
+  _threshold = speed;
+  _windowPoints = lround(fmax(window, gridSeconds)/gridSeconds);
+  _window = _windowPoints*gridSeconds;
+  _episodes.clear();
+}
+
+double GustField::mean(double t, double window){
+  t = fmax(t, 0.0);
+  extend(t + gridSeconds);
+  double from = fmax(t - window, 0.0);
+  return t > from ? (integral(t) - integral(from))/(t - from) : at(t).speed;
+}
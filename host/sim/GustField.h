@@ -0,0 +1,116 @@
+/* Filename:      GustField.h
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Stochastic wind field for SimBoard::setWind(). The speed is a mean
+ *    that drifts over minutes, turbulence with a given intensity and
+ *    time scale, and discrete gusts of the "1 - cos" shape arriving at
+ *    random. The direction wanders around a mean direction.
+ *
+ *    The drift, the turbulence and the direction are Ornstein-Uhlenbeck
+ *    processes, updated exactly on a 0.1 s grid and interpolated
+ *    linearly in between. A field with the same parameters and seed
+ *    gives the same wind.
+ *
+ *    With a threshold set, the field also keeps the episodes in which
+ *    the true mean speed over a window, e.g. 3 s as for gusts in
+ *    meteorology, is above it. These are the times a perfect controller
+ *    would lower the flag.
+ *
+ * Notes:
+ *    - The field is generated forward in time. Only the last 100 s are
+ *      kept, so it has to be read at non-decreasing times give or take
+ *      that much, which is how SimBoard reads it.
+ */
+
+#ifndef GustField_h       //Include guard.
+#define GustField_h
+#include "SimBoard.h"
+#include <stdint.h>
+#include <random>
+#include <vector>
+
+//Parameters of the wind at one site.
+struct GustParams {
+  GustParams();
+
+  double meanSpeed;           //Long term mean speed [m/s].
+  double drift;               //Standard deviation of the mean over minutes, relative.
+  double driftSeconds;        //Time scale of the drift [s].
+  double intensity;           //Turbulence intensity, std/mean.
+  double turbulenceSeconds;   //Time scale of the turbulence [s].
+  double gustsPerMinute;      //Rate of discrete gusts.
+  double gustSpeed;           //Mean amplitude of a gust, relative to the mean.
+  double gustSeconds;         //Mean duration of a gust [s].
+  double direction;           //Mean direction [degrees].
+  double directionSpread;     //Standard deviation of the direction [degrees].
+  double directionSeconds;    //Time scale of the direction [s].
+};
+
+//A period with the true mean speed above the threshold.
+struct GustEpisode {
+  double start;               //[s]
+  double end;                 //[s], negative while it lasts.
+};
+
+//Class generating a gusty wind field.
+class GustField {
+  public:
+    GustField(const GustParams& params, uint64_t seed);
+
+    /* Function:    WindSample GustField::at(double t)
+     * Purpose:     The wind at a time, generating the field up to it.
+     *
+     * Input:       Simulated time [s]          (double t)
+     *
+     * Output:      Speed and direction.
+    */
+    WindSample at(double t);
+
+    /* Function:    void GustField::setThreshold(double speed, double window)
+     * Purpose:     Keep the episodes in which the mean speed over the
+     *              last window seconds is above a speed, from now on.
+     *
+     * Input:       Threshold [m/s]             (double speed)
+     *              Averaging window [s]        (double window)
+     *
+     * Output:      None
+    */
+    void setThreshold(double speed, double window);
+
+    //Mean speed over [t - window, t], with t within the last 100 s.
+    double mean(double t, double window);
+
+    const std::vector<GustEpisode>& episodes() const { return _episodes; }
+
+  private:
+    void extend(double t);
+    void stepGrid();
+    double integral(double t);
+
+    GustParams _params;
+    std::mt19937_64 _rng;
+    std::normal_distribution<double> _normal;
+    std::exponential_distribution<double> _exponential;
+
+    static const int history = 1024;          //Grid points kept, a power of two.
+    double _speed[history];                   //Speed at the grid points.
+    double _direction[history];               //Direction at the grid points.
+    double _sum[history];                     //Integral of the speed up to each point.
+    long _points;                             //Grid points generated.
+
+    double _drift, _turbulence, _veer;        //States of the processes.
+    double _nextGust;                         //Start of the next gust [s].
+    double _gustStart, _gustLength, _gustSize;  //Current gust.
+
+    double _threshold;                        //Negative if not watching.
+    double _window;
+    long _windowPoints;
+    std::vector<GustEpisode> _episodes;
+};
+
+#endif
@@ -0,0 +1,785 @@
+/* Filename:      SimBoard.cpp
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Simulated Arduino Nano with the flagpole hardware attached.
+ *
+ * Notes:
+ *    - The FS5 model inverts the transfer curve used by FS5sensor:
+ *      U = U0 * sqrt(1 + k * v^n), with k = ((U50/U0)^2 - 1) / v50^n.
+ *      The effective velocity seen by the sensor is the wind speed
+ *      scaled by a cosine response around the sensitive axis.
+ */
+
+#include "SimBoard.h"
+#include "Trace.h"
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+//Half-step coil sequence of the ULN2003, bit 0 = IN1 ... bit 3 = IN4.
+static const uint8_t coilSequence[8] = {0x1, 0x3, 0x2, 0x6, 0x4, 0xC, 0x8, 0x9};
+
+//Board used by the HAL of the calling thread.
+static thread_local SimBoard* currentBoard = 0;
+
+SimConfig::SimConfig(){
+  coilPins[0] = 10;
+  coilPins[1] = 9;
+  coilPins[2] = 8;
+  coilPins[3] = 7;
+  limitSwitchPin = 12;
+  fs5Pin = 14;            //A0.
+
+  stepsPerRev = 4096;
+  ccwStopDeg = 0;
+  cwStopDeg = 215;
+  startDeg = 100;
+  mountOffsetDeg = 0;
+  alignOffsetDeg = 300*360.0/4096;      //calibrationSteps of HotswapPole.
+  maxStepRate = 2000;
+  pullInRate = 1200;
+  maxAcceleration = 8000;
+
+  U0 = 2.24;
+  U50 = 3.33;
+  v50 = 8;
+  n = 0.51;
+  directionalFloor = 0.1;
+  noiseVolts = 0.005;
+  arraySensors = 0;
+  for (int i = 0; i < 8; i++){
+    arrayPins[i] = 0;
+    arrayDeg[i] = 0;
+  }
+
+  analogReadUs = 112;
+  digitalReadUs = 4;
+  microsUs = 4;
+  digitalWriteUs = 4;
+  adcConversionUs = 104;    //13 ADC clocks at 125 kHz.
+  adcIsrUs = 3;
+  pinChangeIsrUs = 3;
+  portWriteUs = 0.25;       //in, and, or, out.
+  timerIsrUs = 3;
+  eepromWriteUs = 3300;     //Erase and write, ATmega328 datasheet.
+  eepromSize = 1024;
+  switchBounces = 0;
+  switchBounceUs = 1000;
+}
+
+SimBoard::SimBoard(const SimConfig& config, uint32_t seed)
+  : _noise(0.0, 1.0), _clockUs(0), _adcIsr(0), _timerIsr(0), _pinChangeIsr(0), _recorder(0), _replay(0) {
+  memset(&_replayStatus, 0, sizeof(_replayStatus));
+  reset(config, seed);
+}
+
+void SimBoard::reset(const SimConfig& config, uint32_t seed){
+  _config = config;
+  _rng.seed(seed);
+  _noise.reset();
+  memset(_level, 0, sizeof(_level));
+  _coilPhase = -1;
+  _coilsPending = false;
+  _shaft = 0;
+  _lastStepUs = 0;
+  _shaftRate = 0;
+  _lead = 0;
+  _stalled = false;
+  _coilsOn = 0;
+  _baud = 0;
+  _txFreeUs = _clockUs;
+  _serialEcho = false;
+  _serialCapture = false;
+  _serialOut.clear();
+  _adcIsr = 0;
+  _timerIsr = 0;
+  _pinChangeIsr = 0;
+  _inPinChange = false;
+  _switchContact = limitSwitchClosed();
+  _switchPin = _switchContact;
+  _switchEdges.clear();
+  _switchEdge = 0;
+  if (_eeprom.size() != (size_t)config.eepromSize){
+    _eeprom.assign(config.eepromSize, 0xFF);
+    _eepromWear.assign(config.eepromSize, 0);
+  }
+  _eepromWritesLeft = -1;
+  _switchTraced = false;
+  _switchRecorded = false;
+  _replayCode = 0;
+  setWind(0, 0);
+  clearCounters();
+}
+
+/* Function:    void SimBoard::eepromWrite(int address, uint8_t value)
+ * Purpose:     Write one EEPROM byte. Takes eepromWriteUs and counts
+ *              the write. Writes after the limit of failEepromAfter()
+ *              are lost, as if power failed.
+ *
+ * Input:       Address                     (int address)
+ *              Value                       (uint8_t value)
+ *
+ * Output:      None
+*/
+void SimBoard::eepromWrite(int address, uint8_t value){
+  if (address < 0 || address >= (int)_eeprom.size() || _eepromWritesLeft == 0){
+    return;
+  }
+  if (_eepromWritesLeft > 0){
+    _eepromWritesLeft--;
+  }
+  advance(_config.eepromWriteUs);
+  _eeprom[address] = value;
+  _eepromWear[address]++;
+  _counters.eepromWrites++;
+}
+
+uint8_t SimBoard::eepromRead(int address) const {
+  return address >= 0 && address < (int)_eeprom.size() ? _eeprom[address] : 0xFF;
+}
+
+unsigned long SimBoard::eepromWear(int address) const {
+  return address >= 0 && address < (int)_eepromWear.size() ? _eepromWear[address] : 0;
+}
+
+void SimBoard::eraseEeprom(){
+  _eeprom.assign(_eeprom.size(), 0xFF);
+}
+
+bool SimBoard::record(const char* path, TraceWriter& writer){
+  TraceHeader header;
+  header.config = _config;
+  header.startUs = _clockUs;
+  header.eeprom = _eeprom;
+  if (!writer.open(path, header)){
+    return false;
+  }
+  _recorder = &writer;
+  _switchRecorded = false;
+  return true;
+}
+
+void SimBoard::stopRecording(){
+  if (_recorder){
+    _recorder->close();
+    _recorder = 0;
+  }
+}
+
+void SimBoard::replay(TraceReader& reader){
+  const TraceHeader& header = reader.header();
+  reset(header.config, 0);
+  _clockUs = header.startUs;
+  _txFreeUs = _clockUs;
+  _eeprom = header.eeprom;
+  _eepromWear.assign(_eeprom.size(), 0);
+  memset(&_replayStatus, 0, sizeof(_replayStatus));
+  _replay = &reader;
+}
+
+/* Function:    const TraceEvent* SimBoard::replayNext(uint8_t type, const char* what)
+ * Purpose:     Take the next event of the trace, which has to be of the
+ *              given type and happen now. Otherwise the replay has 
+ *              diverged.
+ *
+ * Input:       Expected type               (uint8_t type)
+ *              Name of the event           (const char* what)
+ *
+ * Output:      The event, 0 if the replay has ended or diverged. It is
+ *              consumed by the caller.
+*/
+const TraceEvent* SimBoard::replayNext(uint8_t type, const char* what){
+  if (_replayStatus.ended || _replayStatus.diverged){
+    return 0;
+  }
+  const TraceEvent* event = _replay->peek();
+  if (!event){
+    if (_replay->error()){
+      diverge("damaged trace");
+    }
+    _replayStatus.ended = true;
+    return 0;
+  }
+  static const char* names[4] = {"ADC", "switch", "step", "serial"};
+  uint64_t t = (uint64_t)llround(_clockUs);
+  if (event->type != type || event->timeUs != t){
+    char reason[96];
+    snprintf(reason, sizeof(reason), "%s at %llu us, trace has %s at %llu us", what,
+             (unsigned long long)t, names[event->type], (unsigned long long)event->timeUs);
+    diverge(reason);
+    return 0;
+  }
+  _replayStatus.events++;
+  return event;
+}
+
+void SimBoard::diverge(const char* reason){
+  _replayStatus.diverged = true;
+  _replayStatus.divergedUs = _clockUs;
+  snprintf(_replayStatus.reason, sizeof(_replayStatus.reason), "%s", reason);
+}
+
+/* Function:    bool SimBoard::switchLevel()
+ * Purpose:     The level of the limit switch read by the firmware. When
+ *              replaying it is taken from the trace, which holds the
+ *              reads with a new level.
+ *
+ * Input:       None
+ *
+ * Output:      True if closed.
+*/
+bool SimBoard::switchLevel(){
+  bool closed = _switchPin;
+  //Once the trace is left the switch follows the rotor again, so a sweep
+  //that is no longer in the trace still ends.
+  if (_replay && !_replayStatus.ended && !_replayStatus.diverged){
+    const TraceEvent* event = _replay->peek();
+    if (event && event->type == TRACE_SWITCH && event->timeUs <= (uint64_t)llround(_clockUs)){
+      event = replayNext(TRACE_SWITCH, "switch");
+      if (event){
+        _switchTraced = event->value != 0;
+        _replay->consume();
+      }
+    }
+    closed = _switchTraced;
+  }
+  if (_recorder && closed != _switchRecorded){
+    _recorder->limitSwitch(_clockUs, closed);
+    _switchRecorded = closed;
+  }
+  return closed;
+}
+
+void SimBoard::makeCurrent(){
+  currentBoard = this;
+}
+
+SimBoard* SimBoard::current(){
+  return currentBoard;
+}
+
+void SimBoard::advance(double us){
+  double until = _clockUs + (us > 0 ? us : 0);
+
+  //The interrupts due meanwhile run at their own time, earliest first,
+  //and take their time from the interrupted code.
+  while (true){
+    settleCoils();
+    double due = until;
+    int source = -1;
+    if (_adcIsr && _adcNextUs <= until){
+      due = _adcNextUs;
+      source = 0;
+    }
+    if (_timerIsr && _timerNextUs <= until && (source < 0 || _timerNextUs < due)){
+      due = _timerNextUs;
+      source = 1;
+    }
+    bool edge = !_inPinChange && _switchEdge < _switchEdges.size();
+    if (edge && _switchEdges[_switchEdge] <= until && (source < 0 || _switchEdges[_switchEdge] < due)){
+      due = _switchEdges[_switchEdge];
+      source = 2;
+    }
+    if (source < 0){
+      break;
+    }
+    if (due > _clockUs){
+      _clockUs = due;
+    }
+    double start = _clockUs;
+
+    if (source == 0){
+      //Conversion of the free running ADC.
+      _adcNextUs += _config.adcConversionUs;
+      _counters.adcConversions++;
+      _clockUs += _config.adcIsrUs;
+      _adcIsr((uint16_t)convert(_adcPin));
+    }
+    else if (source == 1){
+      //Compare match of the timer.
+      _timerNextUs += _timerPeriodUs;
+      _counters.timerInterrupts++;
+      _clockUs += _config.timerIsrUs;
+      _timerIsr();
+    }
+    else {
+      //Edges of the limit switch up to now. Edges during the handler 
+      //set the flag again, so it runs once more when it returns.
+      bool changed = false;
+      while (_switchEdge < _switchEdges.size() && _switchEdges[_switchEdge] <= _clockUs){
+        bool level = _switchEdge % 2 == 0 ? _switchContact : !_switchContact;
+        changed |= level != _switchPin;
+        _switchPin = level;
+        _switchEdge++;
+      }
+      if (changed && _pinChangeIsr && _pinChangePin == _config.limitSwitchPin){
+        _counters.pinChanges++;
+        _clockUs += _config.pinChangeIsrUs;
+        _inPinChange = true;
+        _pinChangeIsr();
+        _inPinChange = false;
+      }
+    }
+    until += _clockUs - start;
+  }
+  if (until > _clockUs){
+    _clockUs = until;
+  }
+}
+
+/* Function:    void SimBoard::switchMoved()
+ * Purpose:     Check the limit switch after the shaft moved. When the 
+ *              contact changes the pin follows at once and then bounces
+ *              switchBounces times within switchBounceUs. The bounce
+ *              times depend only on the time of the change, so a 
+ *              replay sees the same ones.
+ *
+ * Input:       None
+ *
+ * Output:      None
+*/
+void SimBoard::switchMoved(){
+  bool closed = limitSwitchClosed();
+  if (closed == _switchContact){
+    return;
+  }
+  _switchContact = closed;
+  _switchEdges.assign(1, _clockUs);
+  _switchEdge = 0;
+  if (_config.switchBounces > 0){
+    std::mt19937 rng((uint32_t)llround(_clockUs));
+    std::uniform_real_distribution<double> at(0, _config.switchBounceUs);
+    for (int b = 0; b < 2*_config.switchBounces; b++){
+      _switchEdges.push_back(_clockUs + at(rng));
+    }
+    std::sort(_switchEdges.begin() + 1, _switchEdges.end());
+  }
+  advance(0);
+}
+
+void SimBoard::timerStart(double periodUs, TimerIsr isr){
+  _timerPeriodUs = periodUs > 1 ? periodUs : 1;
+  _timerNextUs = _clockUs + _timerPeriodUs;
+  _timerIsr = isr;
+}
+
+void SimBoard::timerStop(){
+  _timerIsr = 0;
+}
+
+/* Function:    void SimBoard::sleep(double us, bool powerDown)
+ * Purpose:     Sleep the CPU for a time, idle or in power down, and count
+ *              the time asleep and the wake-ups.
+ *
+ * Input:       Time to sleep [us]          (double us)
+ *              Power down, else idle       (bool powerDown)
+ *
+ * Output:      None
+*/
+void SimBoard::sleep(double us, bool powerDown){
+  Counters before = _counters;
+  double start = _clockUs;
+  if (powerDown){
+    //The clocks of the ADC and timer 1 stop.
+    AdcIsr adcIsr = _adcIsr;
+    TimerIsr timerIsr = _timerIsr;
+    _adcIsr = 0;
+    _timerIsr = 0;
+    advance(us);
+    _adcIsr = adcIsr;
+    _timerIsr = timerIsr;
+    _adcNextUs += _clockUs - start;
+    _timerNextUs += _clockUs - start;
+  }
+  else {
+    advance(us);
+  }
+  unsigned long adc = _counters.adcConversions - before.adcConversions;
+  unsigned long timer = _counters.timerInterrupts - before.timerInterrupts;
+  unsigned long pinChanges = _counters.pinChanges - before.pinChanges;
+  unsigned long ticks = powerDown ? 0 : (unsigned long)((_clockUs - start)/1024);
+  double awakeUs = adc*_config.adcIsrUs + (timer + ticks)*_config.timerIsrUs + pinChanges*_config.pinChangeIsrUs;
+  double asleepUs = _clockUs - start - awakeUs;
+  if (powerDown){
+    _counters.powerDownUs += asleepUs > 0 ? asleepUs : 0;
+  }
+  else {
+    _counters.idleUs += asleepUs > 0 ? asleepUs : 0;
+  }
+  _counters.wakeups += adc + timer + ticks + pinChanges + 1;
+}
+
+void SimBoard::serialFlush(){
+  if (_baud > 0 && _txFreeUs > _clockUs){
+    advance(_txFreeUs - _clockUs);
+  }
+}
+
+uint8_t SimBoard::pinPort(uint8_t pin){
+  if (pin < 8){
+    return 4;               //PD
+  }
+  if (pin < 14){
+    return 2;               //PB
+  }
+  return pin < 20 ? 3 : 0;  //PC, A6 and A7 are analog only.
+}
+
+uint8_t SimBoard::pinBit(uint8_t pin){
+  if (pin < 8){
+    return 1 << pin;
+  }
+  if (pin < 14){
+    return 1 << (pin - 8);
+  }
+  return pin < 20 ? 1 << (pin - 14) : 0;
+}
+
+void SimBoard::portWrite(uint8_t port, uint8_t mask, uint8_t bits){
+  bool coils = false;
+  for (int c = 0; c < 4; c++){
+    uint8_t pin = _config.coilPins[c];
+    coils |= pin < 20 && pinPort(pin) == port && (pinBit(pin) & mask);
+  }
+  _coilsPending &= !coils;
+  advance(_config.portWriteUs);
+  _counters.portWrites++;
+  for (uint8_t pin = 0; pin < 20; pin++){
+    if (pinPort(pin) == port && (pinBit(pin) & mask)){
+      _level[pin] = (bits & pinBit(pin)) ? 1 : 0;
+    }
+  }
+  _coilsPending |= coils;
+}
+
+void SimBoard::pinChangeStart(uint8_t pin, PinChangeIsr isr){
+  _pinChangePin = pin;
+  _pinChangeIsr = isr;
+}
+
+void SimBoard::pinChangeStop(){
+  _pinChangeIsr = 0;
+}
+
+void SimBoard::adcStart(uint8_t pin, AdcIsr isr){
+  _adcPin = pin;
+  _adcIsr = isr;
+  _adcNextUs = _clockUs + _config.adcConversionUs;
+}
+
+void SimBoard::adcStop(){
+  _adcIsr = 0;
+}
+
+void SimBoard::pinMode(uint8_t pin, uint8_t mode){
+  (void)pin;
+  (void)mode;
+}
+
+void SimBoard::digitalWrite(uint8_t pin, uint8_t val){
+  bool coils = false;
+  for (int c = 0; c < 4; c++){
+    coils |= _config.coilPins[c] == pin;
+  }
+  _coilsPending &= !coils;
+  advance(_config.digitalWriteUs);
+  _counters.digitalWrites++;
+  if (pin >= sizeof(_level)){
+    return;
+  }
+  _level[pin] = val ? 1 : 0;
+  _coilsPending |= coils;
+}
+
+uint64_t SimBoard::micros(){
+  advance(_config.microsUs);
+  return now();
+}
+
+int SimBoard::digitalRead(uint8_t pin){
+  advance(_config.digitalReadUs);
+  _counters.digitalReads++;
+  if (pin == _config.limitSwitchPin){
+    return switchLevel() ? 1 : 0;
+  }
+  return pin < sizeof(_level) ? _level[pin] : 0;
+}
+
+int SimBoard::analogRead(uint8_t pin){
+  advance(_config.analogReadUs);
+  _counters.analogReads++;
+  if (_adcIsr){
+    _counters.adcConflicts++;     //Would hang on the ATmega328.
+  }
+  return convert(pin);
+}
+
+/* Function:    int SimBoard::convert(uint8_t pin)
+ * Purpose:     One conversion of the ADC: the voltage on the pin with
+ *              noise, quantised to 10 bits.
+ *
+ * Input:       Analog pin                  (uint8_t pin)
+ *
+ * Output:      ADC code, 0 to 1023.
+*/
+int SimBoard::convert(uint8_t pin){
+  double offset = 0;
+  if (pin != _config.fs5Pin){
+    int sensor = -1;
+    for (int i = 0; i < _config.arraySensors && i < 8; i++){
+      sensor = _config.arrayPins[i] == pin ? i : sensor;
+    }
+    if (sensor < 0){
+      return 0;
+    }
+    offset = _config.arrayDeg[sensor];
+  }
+  if (_replay){
+    const TraceEvent* event = replayNext(TRACE_ADC, "ADC");
+    if (event){
+      _replayCode = (int)event->value;
+      _replayStatus.adcSamples++;
+      _replay->consume();
+    }
+    if (_recorder){
+      _recorder->adc(_clockUs, _replayCode);
+    }
+    return _replayCode;
+  }
+  double U = sensorVoltage(offset) + _config.noiseVolts*_noise(_rng);
+  long code = lround(U/5.0*1023.0);
+  if (code < 0){
+    code = 0;
+  }
+  if (code > 1023){
+    code = 1023;
+  }
+  if (_recorder){
+    _recorder->adc(_clockUs, (int)code);
+  }
+  return (int)code;
+}
+
+void SimBoard::serialBegin(unsigned long baud){
+  _baud = baud;
+  _txFreeUs = _clockUs;
+}
+
+void SimBoard::serialWrite(const uint8_t* data, size_t size){
+  _counters.serialBytes += size;
+  if (_recorder){
+    _recorder->serial(_clockUs, data, size);
+  }
+  if (_replay){
+    const TraceEvent* event = replayNext(TRACE_SERIAL, "serial output");
+    if (event){
+      if (event->size != size || memcmp(event->data, data, size) != 0){
+        diverge("serial output differs");
+      }
+      _replay->consume();
+    }
+  }
+  if (_serialEcho){
+    fwrite(data, 1, size, stdout);
+  }
+  if (_serialCapture){
+    _serialOut.append((const char*)data, size);
+  }
+  if (_baud == 0){
+    return;
+  }
+
+  //The UART holds 64 bytes; a write into a full buffer blocks until one
+  //byte has been shifted out. One byte is 10 bits on the line.
+  const double byteUs = 10.0e6/_baud;
+  for (size_t i = 0; i < size; i++){
+    if (_txFreeUs < _clockUs){
+      _txFreeUs = _clockUs;
+    }
+    double queued = (_txFreeUs - _clockUs)/byteUs;
+    if (queued >= 64){
+      advance(_txFreeUs - 63*byteUs - _clockUs);
+    }
+    _txFreeUs += byteUs;
+  }
+}
+
+void SimBoard::setWind(const WindField& field){
+  _wind = field;
+}
+
+void SimBoard::setWind(double speed, double direction){
+  WindSample sample = {speed, direction};
+  _wind = [sample](double){ return sample; };
+}
+
+WindSample SimBoard::wind() const {
+  return _wind(_clockUs*1e-6);
+}
+
+double SimBoard::sensorVoltage(double offsetDeg) const {
+  WindSample w = wind();
+  double angle = (shaftDeg() + _config.mountOffsetDeg - offsetDeg - w.direction)*M_PI/180.0;
+  double response = _config.directionalFloor
+                  + (1 - _config.directionalFloor)*fmax(0.0, cos(angle));
+  double v = fmax(0.0, w.speed*response);
+  double k = (pow(_config.U50/_config.U0, 2) - 1)/pow(_config.v50, _config.n);
+  return _config.U0*sqrt(1 + k*pow(v, _config.n));
+}
+
+double SimBoard::shaftDeg() const {
+  return _config.startDeg + _shaft*360.0/_config.stepsPerRev;
+}
+
+double SimBoard::headingError() const {
+  double error = fmod(axisError() - _config.alignOffsetDeg + 180.0, 360.0);
+  if (error < 0){
+    error += 360.0;
+  }
+  return error - 180.0;
+}
+
+double SimBoard::axisError() const {
+  double error = fmod(shaftDeg() + _config.mountOffsetDeg - wind().direction + 180.0, 360.0);
+  if (error < 0){
+    error += 360.0;
+  }
+  return error - 180.0;
+}
+
+bool SimBoard::limitSwitchClosed() const {
+  double deg = shaftDeg();
+  return deg <= _config.ccwStopDeg || deg >= _config.cwStopDeg;
+}
+
+void SimBoard::clearCounters(){
+  memset(&_counters, 0, sizeof(_counters));
+  _coilUs = 0;
+  _coilsSinceUs = _clockUs;
+}
+
+double SimBoard::coilUs() const {
+  return _coilUs + _coilsOn*(_clockUs - _coilsSinceUs);
+}
+
+/* Function:    void SimBoard::settleCoils()
+ * Purpose:     Decode the coils written since the time last went on.
+ *              The writes of the coils right after each other, like the
+ *              ports of one step or the pins of off(), are decoded once,
+ *              since the rotor cannot follow the patterns in between.
+ *
+ * Input:       None
+ *
+ * Output:      None
+*/
+void SimBoard::settleCoils(){
+  if (_coilsPending){
+    _coilsPending = false;
+    coilsChanged();
+  }
+}
+
+/* Function:    void SimBoard::coilsChanged()
+ * Purpose:     Decode the coil pattern on IN1 - IN4 and move the shaft
+ *              when the pattern advanced along the half-step sequence.
+ *              Moves faster than maxStepRate are counted as lost steps,
+ *              and so are moves faster than pullInRate that were not
+ *              reached by accelerating at most maxAcceleration. After a
+ *              lost step the motor stalls until the rate is below
+ *              pullInRate again. The time the coils are on is counted
+ *              for coilUs().
+ *
+ * Input:       None
+ *
+ * Output:      None
+*/
+void SimBoard::coilsChanged(){
+  uint8_t pattern = 0;
+  for (int c = 0; c < 4; c++){
+    pattern |= _level[_config.coilPins[c]] << c;
+  }
+
+  //The coils on draw current whether the rotor moves or not.
+  _coilUs += _coilsOn*(_clockUs - _coilsSinceUs);
+  _coilsSinceUs = _clockUs;
+  _coilsOn = (pattern & 1) + (pattern >> 1 & 1) + (pattern >> 2 & 1) + (pattern >> 3 & 1);
+
+  int phase = -1;
+  for (int p = 0; p < 8; p++){
+    if (coilSequence[p] == pattern){
+      phase = p;
+    }
+  }
+  if (phase < 0){
+    return;                   //Coils off or in transition.
+  }
+
+  int delta = 0;
+  if (_coilPhase >= 0){
+    delta = (phase - _coilPhase + 8) % 8;
+    if (delta > 4){
+      delta -= 8;
+    }
+    if (delta == 4){
+      delta = 0;              //Opposite phase, the rotor does not move.
+    }
+  }
+  _coilPhase = phase;
+  if (delta == 0){
+    return;
+  }
+
+  //The rotor follows the coils with limited torque. It can take any
+  //rate up to the pull-in rate at once and faster rates by accelerating.
+  //Its inertia also limits how fast it slows down, so after a late step
+  //it runs ahead of the coils, at most one half-step before the field
+  //holds it. Where it falls behind by more than one full step it slips
+  //and stalls until the rate is below pull-in.
+  double dt = _lastStepUs != 0 ? _clockUs - _lastStepUs : 1e6;
+  dt = dt > 1 ? dt : 1;
+  double rate = 1e6*abs(delta)/dt;
+  if (_stalled && rate <= _config.pullInRate){
+    _stalled = false;
+    _shaftRate = 0;
+    _lead = 0;
+  }
+  double speed = (delta > 0) == (_shaftRate > 0) ? fabs(_shaftRate) : 0;
+  double reach = speed + _config.maxAcceleration*dt*1e-6;
+  reach = reach > _config.pullInRate ? reach : _config.pullInRate;
+  double coast = speed - _config.maxAcceleration*dt*1e-6;
+  double needed = rate + _lead*1e6/dt;
+  double follow = needed < reach ? needed : reach;
+  follow = follow > coast ? follow : coast;
+  _lead += abs(delta) - follow*dt*1e-6;
+  _lead = _lead > -1 ? _lead : -1;
+  if (_stalled || rate > _config.maxStepRate || _lead > 2){
+    _counters.lostSteps += abs(delta);
+    _stalled = true;
+    _lastStepUs = _clockUs;
+    return;
+  }
+  _shaftRate = delta > 0 ? follow : -follow;
+  _shaft += delta;
+  _counters.steps += abs(delta);
+  if (_recorder){
+    _recorder->step(_clockUs, _shaft);
+  }
+  if (_replay){
+    const TraceEvent* event = replayNext(TRACE_STEP, "step");
+    if (event){
+      if (event->value != _shaft){
+        diverge("shaft position differs");
+      }
+      _replay->consume();
+    }
+  }
+  _lastStepUs = _clockUs;
+  switchMoved();
+}
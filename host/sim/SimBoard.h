@@ -0,0 +1,390 @@
+/* Filename:      SimBoard.h
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Simulated Arduino Nano with the flagpole hardware attached. The host
+ *    HAL (host/hal) forwards every Arduino call to the current SimBoard.
+ *
+ *    The board models:
+ *      - A virtual microsecond clock.
+ *      - The 28byj-48 shaft, driven by decoding the ULN2003 coil pattern
+ *        written to IN1..IN4, so any stepper driver that toggles the coil
+ *        pins, with digitalWrite() or the port registers, moves the 
+ *        simulated shaft.
+ *      - Timer 1 with its compare interrupt.
+ *      - A limit switch that closes at or beyond two configurable angles,
+ *        with contact bounce and the pin change interrupt.
+ *      - A programmable wind field and an FS5 sensor model feeding
+ *        analogRead() on the FS5 pin, and on the pins of an array of
+ *        FS5 sensors mounted on the shaft at fixed angles to it.
+ *      - The UART transmit buffer, so serial output costs time at the
+ *        configured baud rate.
+ *      - The EEPROM, kept over reset(), with the write time and the
+ *        writes of every byte.
+ *      - Idle and power down sleep, with the time asleep and the
+ *        wake-ups counted for the duty cycle.
+ *
+ *    What the firmware reads, the ADC codes and the limit switch, and
+ *    what it does, the shaft moves and the serial output, can be
+ *    recorded to a trace and replayed, see Trace.h. The board is 
+ *    deterministic, so a replay through the same firmware takes the
+ *    same path with the same timing, and every event is checked against
+ *    the trace.
+ *
+ * Notes:
+ *    - Angles are in degrees and grow in the clockwise direction.
+ *    - Shaft positions are counted in half-steps (4096 per revolution).
+ *    - The current board is per thread, so boards can run in parallel,
+ *      one per thread at a time.
+ */
+
+#ifndef SimBoard_h        //Include guard.
+#define SimBoard_h
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+class TraceWriter;
+class TraceReader;
+
+//Wind at one instant: speed in m/s and the direction it blows from, in
+//degrees on the same scale as the shaft angle.
+struct WindSample {
+  double speed;
+  double direction;
+};
+
+//Wind field as a function of simulated time in seconds.
+typedef std::function<WindSample(double)> WindField;
+
+//Static description of the simulated hardware.
+struct SimConfig {
+  SimConfig();
+
+  uint8_t coilPins[4];        //Pins for IN1 - IN4 of the ULN2003.
+  uint8_t limitSwitchPin;     //Pin for the limit switch.
+  uint8_t fs5Pin;             //Analog pin for the FS5.
+
+  int stepsPerRev;            //Half-steps per shaft revolution.
+  double ccwStopDeg;          //Limit switch closes at or below this angle.
+  double cwStopDeg;           //Limit switch closes at or above this angle.
+  double startDeg;            //Shaft angle at power up.
+  double mountOffsetDeg;      //Angle between shaft and FS5 sensitive axis.
+  double alignOffsetDeg;      //The pole is aligned this far cw of the FS5 axis.
+  double maxStepRate;         //Step rate [steps/s] above which steps are lost.
+  double pullInRate;          //Step rate [steps/s] the motor follows from rest.
+  double maxAcceleration;     //Fastest change of the step rate [steps/s^2].
+
+  double U0;                  //Voltage of the simulated FS5 at 0 m/s.
+  double U50;                 //Voltage of the simulated FS5 at v50.
+  double v50;                 //Wind velocity at U50.
+  double n;                   //FS5 exponent n.
+  double directionalFloor;    //Relative FS5 response to wind from behind.
+  double noiseVolts;          //Standard deviation of the voltage noise.
+  uint8_t arraySensors;       //FS5 sensors of the array, 0 without one.
+  uint8_t arrayPins[8];       //Analog pins of the array.
+  double arrayDeg[8];         //Angles of the array ccw from the FS5, like the heading.
+
+  double analogReadUs;        //Cost of one analogRead().
+  double digitalReadUs;       //Cost of one digitalRead().
+  double microsUs;            //Cost of one micros() or millis().
+  double digitalWriteUs;      //Cost of one digitalWrite().
+  double adcConversionUs;     //Time of one conversion of the free running ADC.
+  double adcIsrUs;            //Cost of one ADC interrupt.
+  double pinChangeIsrUs;      //Cost of entering and leaving a pin change interrupt.
+  double portWriteUs;         //Cost of one read-modify-write of a port register.
+  double timerIsrUs;          //Cost of entering and leaving the timer interrupt.
+  double eepromWriteUs;       //Time to write one EEPROM byte.
+  int eepromSize;             //EEPROM size [bytes].
+
+  int switchBounces;          //Bounces of the limit switch after each change.
+  double switchBounceUs;      //Time the bounces are spread over.
+};
+
+//ADC interrupt handler, called with the result of every conversion.
+typedef void (*AdcIsr)(uint16_t conversion);
+
+//Pin change interrupt handler.
+typedef void (*PinChangeIsr)();
+
+//Timer compare interrupt handler.
+typedef void (*TimerIsr)();
+
+//Class simulating the board, the mechanics and the wind.
+class SimBoard {
+  public:
+    //Event counters, cleared by clearCounters().
+    struct Counters {
+      unsigned long steps;          //Half-steps the shaft actually moved.
+      unsigned long lostSteps;      //Half-steps commanded but not followed.
+      unsigned long analogReads;    //Calls to analogRead().
+      unsigned long digitalReads;   //Calls to digitalRead().
+      unsigned long digitalWrites;  //Calls to digitalWrite().
+      unsigned long portWrites;     //Writes of a port register.
+      unsigned long timerInterrupts;//Timer compare interrupts.
+      unsigned long serialBytes;    //Bytes written to the serial port.
+      unsigned long adcConversions; //Conversions of the free running ADC.
+      unsigned long adcConflicts;   //analogRead() while the ADC runs free.
+      unsigned long pinChanges;     //Pin change interrupts.
+      unsigned long eepromWrites;   //Bytes written to the EEPROM.
+      unsigned long wakeups;        //Wake-ups from sleep, by interrupts and the watchdog.
+      double idleUs;                //Time asleep in idle mode.
+      double powerDownUs;           //Time asleep in power down.
+    };
+
+    //Progress of a replay, see replay().
+    struct ReplayStatus {
+      uint64_t events;              //Events replayed.
+      uint64_t adcSamples;          //ADC conversions replayed.
+      bool ended;                   //The trace is used up.
+      bool diverged;                //The firmware left the recorded path.
+      double divergedUs;            //Time of the divergence.
+      char reason[96];              //What differed.
+    };
+
+    SimBoard(const SimConfig& config = SimConfig(), uint32_t seed = 1);
+
+    /* Function:    void SimBoard::reset(const SimConfig& config, uint32_t seed)
+     * Purpose:     Restart the simulated hardware with a new configuration.
+     *              The clock keeps running so that time seen by the
+     *              firmware stays monotonic across trials.
+     *
+     * Input:       Hardware configuration      (const SimConfig& config)
+     *              Seed for the noise source   (uint32_t seed)
+     *
+     * Output:      None
+    */
+    void reset(const SimConfig& config, uint32_t seed);
+
+    //Route the HAL of the calling thread to this board.
+    void makeCurrent();
+    static SimBoard* current();
+
+    //Clock.
+    uint64_t now() const { return (uint64_t)_clockUs; }
+    uint64_t micros();          //Read the clock from the firmware, costs microsUs.
+    void advance(double us);
+
+    //HAL entry points.
+    void pinMode(uint8_t pin, uint8_t mode);
+    void digitalWrite(uint8_t pin, uint8_t val);
+    int digitalRead(uint8_t pin);
+    int analogRead(uint8_t pin);
+    void serialBegin(unsigned long baud);
+    void serialWrite(const uint8_t* data, size_t size);
+
+    /* Function:    void SimBoard::adcStart(uint8_t pin, AdcIsr isr)
+     * Purpose:     Run the ADC free on a pin. While the clock advances,
+     *              isr is called once every adcConversionUs with a new
+     *              conversion, and every call is charged adcIsrUs.
+     *
+     * Input:       Analog pin to convert       (uint8_t pin)
+     *              Interrupt handler           (AdcIsr isr)
+     *
+     * Output:      None
+    */
+    void adcStart(uint8_t pin, AdcIsr isr);
+    void adcStop();
+
+    /* Function:    void SimBoard::pinChangeStart(uint8_t pin, PinChangeIsr isr)
+     * Purpose:     Enable the pin change interrupt of a pin. isr is 
+     *              called when the level of the pin has changed, once
+     *              for all edges since it was last called, and every
+     *              call is charged pinChangeIsrUs. Only the limit switch
+     *              changes by itself.
+     *
+     * Input:       Pin to watch                (uint8_t pin)
+     *              Interrupt handler           (PinChangeIsr isr)
+     *
+     * Output:      None
+    */
+    void pinChangeStart(uint8_t pin, PinChangeIsr isr);
+    void pinChangeStop();
+
+    /* Function:    void SimBoard::portWrite(uint8_t port, uint8_t mask, uint8_t bits)
+     * Purpose:     Write the bits of mask of a port register at once,
+     *              like a read-modify-write of PORTB - PORTD. Costs 
+     *              portWriteUs. The coils are decoded when the time goes
+     *              on, once for writes right after each other.
+     *
+     * Input:       Port, PB to PD              (uint8_t port)
+     *              Bits to write               (uint8_t mask)
+     *              New levels of the bits      (uint8_t bits)
+     *
+     * Output:      None
+    */
+    void portWrite(uint8_t port, uint8_t mask, uint8_t bits);
+
+    /* Function:    void SimBoard::timerStart(double periodUs, TimerIsr isr)
+     * Purpose:     Run the timer with a compare interrupt every periodUs,
+     *              the first one periodUs from now. Every call of isr is
+     *              charged timerIsrUs.
+     *
+     * Input:       Period [us]                 (double periodUs)
+     *              Interrupt handler           (TimerIsr isr)
+     *
+     * Output:      None
+    */
+    void timerStart(double periodUs, TimerIsr isr);
+    void timerStop();
+
+    /* Function:    void SimBoard::sleep(double us, bool powerDown)
+     * Purpose:     Sleep the CPU for a time. In idle mode the interrupts
+     *              run as usual and wake the CPU, and so does timer 0 of
+     *              millis() once every 1024 us. In power down the ADC and
+     *              timer 1 stand still and go on after the wake-up, only
+     *              the pin change interrupt runs. The time asleep, less
+     *              the time of the interrupts, is counted.
+     *
+     * Input:       Time to sleep [us]          (double us)
+     *              Power down, else idle       (bool powerDown)
+     *
+     * Output:      None
+    */
+    void sleep(double us, bool powerDown);
+
+    //Wait until the UART has sent every byte, like Serial.flush().
+    void serialFlush();
+
+    //Port and bit of a pin of the Arduino Nano, as in the Arduino core.
+    static uint8_t pinPort(uint8_t pin);
+    static uint8_t pinBit(uint8_t pin);
+
+    //World.
+    void setWind(const WindField& field);
+    void setWind(double speed, double direction);
+    WindSample wind() const;
+    double sensorVoltage(double offsetDeg = 0) const;   //Sensor offsetDeg ccw from the FS5.
+    double shaftDeg() const;
+    long shaftSteps() const { return _shaft; }
+    double lastStepUs() const { return _lastStepUs; }     //Time of the last shaft move.
+    double headingError() const;          //Wind to the aligned heading.
+    double axisError() const;             //Wind to the FS5 axis.
+    bool limitSwitchClosed() const;       //The contact, without the bounces.
+    const SimConfig& config() const { return _config; }
+
+    //Statistics.
+    const Counters& counters() const { return _counters; }
+    void clearCounters();
+    double coilUs() const;                //Time the coils were on, summed over the coils.
+
+    //Serial output.
+    void setSerialEcho(bool echo) { _serialEcho = echo; }
+    void setSerialCapture(bool capture) { _serialCapture = capture; }
+    const std::string& serialOutput() const { return _serialOut; }
+    void clearSerialOutput() { _serialOut.clear(); }
+    double serialIdleUs() const { return _txFreeUs > _clockUs ? _txFreeUs : _clockUs; }   //Last byte sent.
+
+    //EEPROM. The contents survive reset(), like a power cycle does.
+    uint8_t eepromRead(int address) const;
+    void eepromWrite(int address, uint8_t value);
+    uint16_t eepromSize() const { return (uint16_t)_eeprom.size(); }
+    unsigned long eepromWear(int address) const;    //Writes of one byte since construction.
+    void eraseEeprom();
+    void failEepromAfter(long writes) { _eepromWritesLeft = writes; }  //Power lost, -1 never.
+
+    /* Function:    bool SimBoard::record(const char* path, TraceWriter& writer)
+     * Purpose:     Record the ADC conversions on the FS5 pin, the new
+     *              levels of the limit switch read by the firmware, the
+     *              shaft moves and the serial output to a trace. Call
+     *              right after reset(), before the firmware starts.
+     *
+     * Input:       Path of the trace           (const char* path)
+     *              Writer to use               (TraceWriter& writer)
+     *
+     * Output:      True if the trace could be created.
+    */
+    bool record(const char* path, TraceWriter& writer);
+    void stopRecording();
+
+    /* Function:    void SimBoard::replay(TraceReader& reader)
+     * Purpose:     Reset the board to the state at the start of the trace
+     *              and take the ADC codes and the limit switch from it 
+     *              instead of the wind and the shaft. The shaft moves 
+     *              and the serial output are compared with the trace and
+     *              so are the times of all events. At the first 
+     *              difference the replay stops and the status tells 
+     *              why, see replayStatus(). After the end of the trace,
+     *              or a divergence, the ADC repeats its last code and 
+     *              the limit switch follows the shaft again.
+     *
+     * Input:       Open trace                  (TraceReader& reader)
+     *
+     * Output:      None
+    */
+    void replay(TraceReader& reader);
+    void stopReplay() { _replay = 0; }
+    const ReplayStatus& replayStatus() const { return _replayStatus; }
+
+  private:
+    void settleCoils();
+    void coilsChanged();
+    void switchMoved();
+    int convert(uint8_t pin);
+    bool switchLevel();
+    const struct TraceEvent* replayNext(uint8_t type, const char* what);
+    void diverge(const char* reason);
+
+    SimConfig _config;
+    std::mt19937 _rng;
+    std::normal_distribution<double> _noise;
+    WindField _wind;
+
+    double _clockUs;              //Clock in microseconds.
+
+    AdcIsr _adcIsr;               //Handler of the free running ADC, 0 if stopped.
+    uint8_t _adcPin;              //Pin of the free running ADC.
+    double _adcNextUs;            //Time of the next conversion.
+
+    TimerIsr _timerIsr;           //Handler of the timer interrupt, 0 if stopped.
+    double _timerPeriodUs;        //Period of the timer.
+    double _timerNextUs;          //Time of the next compare match.
+
+    PinChangeIsr _pinChangeIsr;   //Handler of the pin change interrupt, 0 if off.
+    uint8_t _pinChangePin;        //Pin watched by the interrupt.
+    bool _inPinChange;            //The handler runs, edges wait for it.
+    bool _switchContact;          //Level the limit switch settles at.
+    bool _switchPin;              //Level of the limit switch pin, bounces included.
+    std::vector<double> _switchEdges;   //Times of the edges of the last change.
+    size_t _switchEdge;           //Next edge to happen.
+
+    uint8_t _level[32];           //Output level of each pin.
+    int _coilPhase;               //Last valid coil phase, -1 if none.
+    bool _coilsPending;           //Coils written, not decoded yet.
+    long _shaft;                  //Shaft position in half-steps.
+    double _lastStepUs;           //Time of the last shaft movement.
+    double _shaftRate;            //Rate of the rotor, signed [steps/s].
+    double _lead;                 //Half-steps the coils lead the rotor.
+    bool _stalled;                //The rotor slipped and does not follow.
+    int _coilsOn;                 //Coils energized.
+    double _coilsSinceUs;         //Time _coilsOn last changed.
+    double _coilUs;               //Coil time up to _coilsSinceUs.
+
+    unsigned long _baud;          //Serial baud rate, 0 if not started.
+    double _txFreeUs;             //Time when the transmit buffer is empty.
+
+    Counters _counters;
+    bool _serialEcho;
+    bool _serialCapture;
+    std::string _serialOut;
+
+    std::vector<uint8_t> _eeprom;             //EEPROM contents.
+    std::vector<unsigned long> _eepromWear;   //Writes of each byte.
+    long _eepromWritesLeft;                   //Writes until power is lost, -1 never.
+
+    TraceWriter* _recorder;       //Trace being recorded, 0 if none.
+    TraceReader* _replay;         //Trace being replayed, 0 if none.
+    ReplayStatus _replayStatus;
+    bool _switchTraced;           //Level of the limit switch in the replayed trace.
+    bool _switchRecorded;         //Level of the limit switch in the recorded trace.
+    int _replayCode;              //Last ADC code replayed.
+};
+
+#endif
@@ -0,0 +1,314 @@
+/* Filename:      Trace.cpp
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Writer and memory mapped reader of trace files, see Trace.h.
+ */
+
+#include "Trace.h"
+#include <fcntl.h>
+#include <math.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <type_traits>
+#include <unistd.h>
+
+static_assert(std::is_trivially_copyable<SimConfig>::value, "the header stores SimConfig as bytes");
+
+static const char traceMagic[7] = {'F', 'P', 'T', 'R', 'A', 'C', 'E'};
+static const uint8_t traceVersion = 1;
+
+//Pages behind the cursor are dropped in chunks of this size.
+static const uint64_t releaseChunk = 64ull << 20;
+
+//Zigzag mapping of signed values to unsigned ones, small either way.
+static uint64_t zigzag(long value){
+  return value >= 0 ? (uint64_t)value << 1 : (((uint64_t)(-(value + 1))) << 1) | 1;
+}
+
+static long unzigzag(uint64_t value){
+  return (value & 1) ? -(long)(value >> 1) - 1 : (long)(value >> 1);
+}
+
+TraceWriter::TraceWriter() : _file(0), _lastUs(0), _lastCode(0), _lastPosition(0),
+                             _events(0), _bytes(0) {
+}
+
+TraceWriter::~TraceWriter(){
+  close();
+}
+
+bool TraceWriter::open(const char* path, const TraceHeader& header){
+  close();
+  _file = fopen(path, "wb");
+  if (!_file){
+    return false;
+  }
+  setvbuf(_file, 0, _IOFBF, 1 << 20);
+  _lastUs = (uint64_t)llround(header.startUs);
+  _lastCode = 0;
+  _lastPosition = 0;
+  _events = 0;
+  _bytes = 0;
+
+  uint32_t configSize = sizeof(SimConfig);
+  uint32_t eepromSize = (uint32_t)header.eeprom.size();
+  put((const uint8_t*)traceMagic, sizeof(traceMagic));
+  put(&traceVersion, 1);
+  put((const uint8_t*)&configSize, sizeof(configSize));
+  put((const uint8_t*)&header.config, sizeof(SimConfig));
+  put((const uint8_t*)&header.startUs, sizeof(header.startUs));
+  put((const uint8_t*)&eepromSize, sizeof(eepromSize));
+  put(header.eeprom.data(), header.eeprom.size());
+  return true;
+}
+
+void TraceWriter::close(){
+  if (_file){
+    fclose(_file);
+    _file = 0;
+  }
+}
+
+void TraceWriter::put(const uint8_t* data, size_t size){
+  if (_file && size > 0){
+    fwrite(data, 1, size, _file);
+    _bytes += size;
+  }
+}
+
+void TraceWriter::putVarint(uint64_t value){
+  uint8_t buffer[10];
+  size_t size = 0;
+  while (value >= 0x80){
+    buffer[size++] = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  buffer[size++] = (uint8_t)value;
+  put(buffer, size);
+}
+
+void TraceWriter::putSigned(long value){
+  putVarint(zigzag(value));
+}
+
+//Write the tag and the time since the previous event.
+void TraceWriter::begin(uint8_t tag, double timeUs){
+  uint64_t t = (uint64_t)llround(timeUs);
+  put(&tag, 1);
+  putVarint(t > _lastUs ? t - _lastUs : 0);
+  _lastUs = t > _lastUs ? t : _lastUs;
+  _events++;
+}
+
+void TraceWriter::adc(double timeUs, int code){
+  begin(TRACE_ADC, timeUs);
+  putSigned(code - _lastCode);
+  _lastCode = code;
+}
+
+void TraceWriter::limitSwitch(double timeUs, bool closed){
+  begin(TRACE_SWITCH | (closed ? 4 : 0), timeUs);
+}
+
+void TraceWriter::step(double timeUs, long position){
+  begin(TRACE_STEP, timeUs);
+  putSigned(position - _lastPosition);
+  _lastPosition = position;
+}
+
+void TraceWriter::serial(double timeUs, const uint8_t* data, size_t size){
+  begin(TRACE_SERIAL, timeUs);
+  putVarint(size);
+  put(data, size);
+}
+
+TraceReader::TraceReader() : _base(0), _cursor(0), _end(0), _released(0), _size(0),
+                             _eventEnd(0), _lastUs(0), _lastCode(0), _lastPosition(0),
+                             _error(false) {
+}
+
+TraceReader::~TraceReader(){
+  close();
+}
+
+/* Function:    bool TraceReader::open(const char* path)
+ * Purpose:     Map the file read only and read the header. The kernel
+ *              is told the file is read once from start to end.
+ *
+ * Input:       Path of the trace           (const char* path)
+ *
+ * Output:      True if the file is a trace of this version.
+*/
+bool TraceReader::open(const char* path){
+  close();
+  int fd = ::open(path, O_RDONLY);
+  if (fd < 0){
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0){
+    ::close(fd);
+    return false;
+  }
+  void* map = mmap(0, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED){
+    return false;
+  }
+  madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+  _base = (const uint8_t*)map;
+  _size = (uint64_t)st.st_size;
+  _end = _base + _size;
+  _cursor = _base;
+  _released = _base;
+  _error = false;
+  _eventEnd = 0;
+
+  //Header.
+  uint32_t configSize, eepromSize;
+  size_t fixed = sizeof(traceMagic) + 1 + sizeof(configSize);
+  if (_size < fixed || memcmp(_base, traceMagic, sizeof(traceMagic)) != 0
+      || _base[sizeof(traceMagic)] != traceVersion){
+    close();
+    return false;
+  }
+  memcpy(&configSize, _base + sizeof(traceMagic) + 1, sizeof(configSize));
+  _cursor = _base + fixed;
+  if (configSize != sizeof(SimConfig) || (uint64_t)(_end - _cursor) < configSize + sizeof(double) + sizeof(eepromSize)){
+    close();
+    return false;
+  }
+  memcpy((void*)&_header.config, _cursor, sizeof(SimConfig));
+  _cursor += sizeof(SimConfig);
+  memcpy(&_header.startUs, _cursor, sizeof(double));
+  _cursor += sizeof(double);
+  memcpy(&eepromSize, _cursor, sizeof(eepromSize));
+  _cursor += sizeof(eepromSize);
+  if ((uint64_t)(_end - _cursor) < eepromSize){
+    close();
+    return false;
+  }
+  _header.eeprom.assign(_cursor, _cursor + eepromSize);
+  _cursor += eepromSize;
+  _lastUs = (uint64_t)llround(_header.startUs);
+  _lastCode = 0;
+  _lastPosition = 0;
+  return true;
+}
+
+void TraceReader::close(){
+  if (_base){
+    munmap((void*)_base, (size_t)_size);
+  }
+  _base = _cursor = _end = _released = 0;
+  _eventEnd = 0;
+  _size = 0;
+}
+
+bool TraceReader::getVarint(uint64_t& value){
+  value = 0;
+  for (int shift = 0; shift < 64; shift += 7){
+    if (_eventEnd >= _end){
+      return false;
+    }
+    uint8_t byte = *_eventEnd++;
+    value |= (uint64_t)(byte & 0x7F) << shift;
+    if (!(byte & 0x80)){
+      return true;
+    }
+  }
+  return false;
+}
+
+/* Function:    const TraceEvent* TraceReader::peek()
+ * Purpose:     Decode the event at the cursor, once, and return it.
+ *
+ * Input:       None
+ *
+ * Output:      The event, 0 at the end of the trace or on a damaged
+ *              event.
+*/
+const TraceEvent* TraceReader::peek(){
+  if (_eventEnd){
+    return &_event;
+  }
+  if (!_base || _cursor >= _end || _error){
+    return 0;
+  }
+  _eventEnd = _cursor;
+  uint8_t tag = *_eventEnd++;
+  uint64_t dt, value;
+  if (!getVarint(dt)){
+    _error = true;
+    _eventEnd = 0;
+    return 0;
+  }
+  _event.type = tag & 3;
+  _event.timeUs = _lastUs + dt;
+  _event.data = 0;
+  _event.size = 0;
+  bool ok = true;
+  switch (_event.type){
+    case TRACE_ADC:
+      ok = getVarint(value);
+      _event.value = _lastCode + unzigzag(value);
+    break;
+    case TRACE_SWITCH:
+      _event.value = (tag >> 2) & 1;
+    break;
+    case TRACE_STEP:
+      ok = getVarint(value);
+      _event.value = _lastPosition + unzigzag(value);
+    break;
+    case TRACE_SERIAL:
+      ok = getVarint(value) && value <= (uint64_t)(_end - _eventEnd);
+      if (ok){
+        _event.data = _eventEnd;
+        _event.size = (uint32_t)value;
+        _eventEnd += value;
+      }
+    break;
+  }
+  if (!ok){
+    _error = true;
+    _eventEnd = 0;
+    return 0;
+  }
+  return &_event;
+}
+
+//Move the cursor past the event returned by peek().
+void TraceReader::consume(){
+  if (!_eventEnd){
+    return;
+  }
+  _lastUs = _event.timeUs;
+  if (_event.type == TRACE_ADC){
+    _lastCode = (int)_event.value;
+  }
+  if (_event.type == TRACE_STEP){
+    _lastPosition = _event.value;
+  }
+  _cursor = _eventEnd;
+  _eventEnd = 0;
+  if ((uint64_t)(_cursor - _released) >= releaseChunk){
+    release();
+  }
+}
+
+//Drop the pages that have been read, the mapping stays valid.
+void TraceReader::release(){
+  long page = sysconf(_SC_PAGESIZE);
+  uint64_t done = (uint64_t)(_cursor - _base) / page * page;
+  uint64_t from = (uint64_t)(_released - _base);
+  if (done > from){
+    madvise((void*)(_base + from), (size_t)(done - from), MADV_DONTNEED);
+    _released = _base + done;
+  }
+}
@@ -0,0 +1,135 @@
+/* Filename:      Trace.h
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Binary traces of what the firmware reads from and does to the
+ *    simulated board, for deterministic replay, see SimBoard::record()
+ *    and SimBoard::replay().
+ *
+ *    A trace starts with a header: the magic "FPTRACE", the format
+ *    version, the SimConfig of the board, the clock and the EEPROM
+ *    contents when the recording started. Then follow the events in the
+ *    order they happened:
+ *
+ *      tag    bits 0-1 type, bit 2 level of a TRACE_SWITCH event
+ *      dt     varint, microseconds since the previous event
+ *      value  TRACE_ADC: zigzag varint, change of the ADC code
+ *             TRACE_STEP: zigzag varint, change of the shaft position
+ *             TRACE_SERIAL: varint length, then the bytes written
+ *
+ *    Varints are LEB128, 7 bits per byte, low bits first. An ADC event
+ *    is usually 3 bytes and a step 3 bytes.
+ *
+ * Notes:
+ *    - The reader maps the file into memory and drops the pages behind
+ *      the cursor, so traces larger than the RAM stream through.
+ *    - Host only, POSIX mmap().
+ */
+
+#ifndef Trace_h           //Include guard.
+#define Trace_h
+#include "SimBoard.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+//Event types.
+enum TraceType {
+  TRACE_ADC,            //A conversion of the ADC on the FS5 pin.
+  TRACE_SWITCH,         //The limit switch was read with a new level.
+  TRACE_STEP,           //The shaft moved.
+  TRACE_SERIAL          //Bytes written to the serial port.
+};
+
+//One decoded event. The data of a TRACE_SERIAL event points into the
+//mapped file and is valid until the reader is closed.
+struct TraceEvent {
+  uint8_t type;               //TraceType.
+  uint64_t timeUs;            //Clock of the board, rounded [us].
+  long value;                 //ADC code, switch level or shaft position.
+  const uint8_t* data;        //Serial bytes.
+  uint32_t size;              //Number of serial bytes.
+};
+
+//State of the board when the recording started.
+struct TraceHeader {
+  SimConfig config;           //Configuration of the board.
+  double startUs;             //Clock [us].
+  std::vector<uint8_t> eeprom;  //EEPROM contents.
+};
+
+//Writes a trace file.
+class TraceWriter {
+  public:
+    TraceWriter();
+    ~TraceWriter();
+
+    //Create the file and write the header. False if it cannot be created.
+    bool open(const char* path, const TraceHeader& header);
+    void close();
+
+    void adc(double timeUs, int code);
+    void limitSwitch(double timeUs, bool closed);
+    void step(double timeUs, long position);
+    void serial(double timeUs, const uint8_t* data, size_t size);
+
+    uint64_t events() const { return _events; }
+    uint64_t bytes() const { return _bytes; }
+
+  private:
+    void begin(uint8_t tag, double timeUs);
+    void putVarint(uint64_t value);
+    void putSigned(long value);
+    void put(const uint8_t* data, size_t size);
+
+    FILE* _file;
+    uint64_t _lastUs;           //Time of the previous event.
+    int _lastCode;              //Code of the previous ADC event.
+    long _lastPosition;         //Position of the previous step event.
+    uint64_t _events;
+    uint64_t _bytes;
+};
+
+//Reads a trace file from a memory mapping, one event at a time.
+class TraceReader {
+  public:
+    TraceReader();
+    ~TraceReader();
+
+    //Map the file and read the header. False if it is not a trace.
+    bool open(const char* path);
+    void close();
+    const TraceHeader& header() const { return _header; }
+
+    //The next event without consuming it, 0 at the end of the trace or
+    //if the event is damaged, see error().
+    const TraceEvent* peek();
+    void consume();
+
+    bool error() const { return _error; }
+    uint64_t offset() const { return (uint64_t)(_cursor - _base); }
+    uint64_t size() const { return _size; }
+
+  private:
+    bool getVarint(uint64_t& value);
+    void release();
+
+    TraceHeader _header;
+    const uint8_t* _base;       //Start of the mapping.
+    const uint8_t* _cursor;     //Start of the next event.
+    const uint8_t* _end;        //End of the mapping.
+    const uint8_t* _released;   //Pages before this are dropped.
+    uint64_t _size;
+    TraceEvent _event;          //Decoded next event.
+    const uint8_t* _eventEnd;   //End of the decoded event, 0 if none.
+    uint64_t _lastUs;
+    int _lastCode;
+    long _lastPosition;
+    bool _error;
+};
+
+#endif
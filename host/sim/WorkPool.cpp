@@ -0,0 +1,79 @@
+/* Filename:      WorkPool.cpp
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Work stealing thread pool, see WorkPool.h.
+ */
+
+#include "WorkPool.h"
+#include <thread>
+
+WorkPool::WorkPool(unsigned threads) : _steals(0) {
+  _threads = threads > 0 ? threads : std::thread::hardware_concurrency();
+  _threads = _threads > 0 ? _threads : 1;
+  _queues = std::vector<Queue>(_threads);
+}
+
+/* Function:    bool WorkPool::take(size_t self, size_t& job)
+ * Purpose:     Take the next job of a thread, or steal one from the
+ *              others, trying them in turn from the next thread on.
+ *
+ * Input:       Index of the thread         (size_t self)
+ *              The job taken               (size_t& job)
+ *
+ * Output:      False when no job is left anywhere.
+*/
+bool WorkPool::take(size_t self, size_t& job){
+  {
+    Queue& own = _queues[self];
+    std::lock_guard<std::mutex> guard(own.lock);
+    if (!own.jobs.empty()){
+      job = own.jobs.back();
+      own.jobs.pop_back();
+      return true;
+    }
+  }
+  for (size_t k = 1; k < _threads; k++){
+    Queue& victim = _queues[(self + k) % _threads];
+    std::lock_guard<std::mutex> guard(victim.lock);
+    if (!victim.jobs.empty()){
+      job = victim.jobs.front();
+      victim.jobs.pop_front();
+      _steals++;
+      return true;
+    }
+  }
+  return false;
+}
+
+void WorkPool::work(size_t self, const std::function<void(size_t)>& job){
+  size_t next;
+  while (take(self, next)){
+    job(next);
+  }
+}
+
+void WorkPool::run(size_t jobs, const std::function<void(size_t)>& job){
+  _steals = 0;
+  //Contiguous ranges, so neighbouring jobs stay on one thread until
+  //they are stolen.
+  for (size_t t = 0; t < _threads; t++){
+    std::lock_guard<std::mutex> guard(_queues[t].lock);
+    _queues[t].jobs.clear();
+    for (size_t i = jobs*t/_threads; i < jobs*(t + 1)/_threads; i++){
+      _queues[t].jobs.push_back(i);
+    }
+  }
+  std::vector<std::thread> helpers;
+  for (size_t t = 1; t < _threads; t++){
+    helpers.push_back(std::thread(&WorkPool::work, this, t, std::cref(job)));
+  }
+  work(0, job);
+  for (size_t t = 0; t < helpers.size(); t++){
+    helpers[t].join();
+  }
+}
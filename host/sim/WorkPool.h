@@ -0,0 +1,70 @@
+/* Filename:      WorkPool.h
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Work stealing thread pool for running many simulated boards in
+ *    parallel, see host/tools/fleetSim.cpp.
+ *
+ *    run() splits the jobs into one contiguous range per thread. Each
+ *    thread takes jobs from the back of its own range and, when that is
+ *    empty, steals from the front of the others. Jobs that take longer,
+ *    e.g. a pole that scans more, so do not leave threads idle.
+ *
+ * Notes:
+ *    - Which thread runs a job is not deterministic. Jobs that write
+ *      only to their own result slot and seed from their index give the
+ *      same results with any number of threads.
+ */
+
+#ifndef WorkPool_h        //Include guard.
+#define WorkPool_h
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+//Class running jobs on a fixed number of threads.
+class WorkPool {
+  public:
+    //Threads to use, 0 for one per hardware thread.
+    explicit WorkPool(unsigned threads = 0);
+
+    /* Function:    void WorkPool::run(size_t jobs, const std::function<void(size_t)>& job)
+     * Purpose:     Call job(i) for every i below jobs and wait for all of
+     *              them. The calling thread works as one of the threads.
+     *
+     * Input:       Number of jobs              (size_t jobs)
+     *              Job                         (const std::function<void(size_t)>& job)
+     *
+     * Output:      None
+    */
+    void run(size_t jobs, const std::function<void(size_t)>& job);
+
+    unsigned threads() const { return _threads; }
+
+    //Jobs taken from another thread's range in the last run().
+    uint64_t steals() const { return _steals; }
+
+  private:
+    //Jobs of one thread, guarded by its own lock.
+    struct Queue {
+      std::mutex lock;
+      std::deque<size_t> jobs;
+    };
+
+    bool take(size_t self, size_t& job);
+    void work(size_t self, const std::function<void(size_t)>& job);
+
+    unsigned _threads;
+    std::vector<Queue> _queues;
+    std::atomic<uint64_t> _steals;
+};
+
+#endif
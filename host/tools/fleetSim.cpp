@@ -0,0 +1,424 @@
+/* Filename:      fleetSim.cpp
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Runs a fleet of simulated flagpoles, each the loop() of main.ino
+ *    with its own Control, FS5sensor and SimBoard, in a gusty wind, see
+ *    GustField.h, to tune the allowed wind speed, the window size N, the
+ *    scan strategy and the decision before deployment.
+ *
+ *    Every combination of the settings runs the same poles: pole p has
+ *    the same site, mean wind, gusts and sensor noise in all of them.
+ *    The mean wind of a site is drawn from a Weibull distribution with
+ *    shape 2. The poles run on a work stealing pool, see WorkPool.h, and
+ *    the results only depend on the seed, not on the number of threads.
+ *
+ *    A decision is judged against the true mean speed over the last
+ *    --truth seconds when it is made:
+ *      false lower   lower although the true mean is below the allowed
+ *                    speed, per decision with the true mean below
+ *      missed lower  not lower although it is above, per decision with
+ *                    the true mean above
+ *    An episode is a period with the true mean above the allowed speed.
+ *    It is caught by a lower decision within it, and the time to
+ *    decision (ttd) is from its start to that decision. The measuring
+ *    sequence (seq) is the time from the end of the scan to the
+ *    decision of the loop.
+ *
+ *    The decision is the median of a full window of N samples like in
+ *    main.ino, or sequential, see WindDecision.h, where N is the most
+ *    samples it takes. For every case run both ways the
+ *    reduction of the times by the sequential decision is printed, the
+ *    ttd over the episodes that both caught.
+ *
+ * Usage:
+ *    fleet_sim [--poles P] [--seconds T] [--seed S] [--threads T]
+ *              [--allowed 2,3] [--window 5,11,21] [--scan exhaustive,coarse]
+ *              [--decision sequential,fixed] [--site 2.2] [--truth 3]
+ *              [--scaling] [--no-check]
+ *
+ *    Windows of 3, 5, 7, 9, 11, 15, 21 and 31 samples are built in.
+ */
+
+#include "LoopModel.h"
+#include "BenchStats.h"
+#include "GustField.h"
+#include "WorkPool.h"
+#include <stdlib.h>
+
+//One combination of the settings.
+struct FleetCase {
+  double allowed;             //Allowed wind speed [m/s].
+  int window;                 //Samples in the median window.
+  ScanMode scan;              //Scan strategy.
+  bool sequential;            //Sequential decision, else the median of the window.
+};
+
+//What one pole did.
+struct PoleResult {
+  unsigned decisions;
+  unsigned lowers;
+  unsigned truthLower;        //Decisions with the true mean above allowed.
+  unsigned falseLower;
+  unsigned missedLower;
+  unsigned episodes;
+  unsigned caught;
+  std::vector<double> latencies;  //Time to decision of caught episodes [s].
+  std::vector<double> episodeTimes; //Time to decision of every episode, -1 if missed [s].
+  std::vector<double> sequences;  //Time of the measuring sequences [s].
+  double firstDecision;       //Time from power up to the first decision [s].
+  unsigned long lostSteps;
+  uint64_t digest;            //Hash of every decision.
+};
+
+struct FleetOptions {
+  double seconds;
+  double site;                //Scale of the Weibull distribution of the mean wind.
+  double truth;               //Averaging window of the true speed [s].
+  uint64_t seed;
+};
+
+//SplitMix64, to derive independent seeds.
+static uint64_t mix(uint64_t x){
+  x += 0x9E3779B97F4A7C15ull;
+  x = (x ^ (x >> 30))*0xBF58476D1CE4E5B9ull;
+  x = (x ^ (x >> 27))*0x94D049BB133111EBull;
+  return x ^ (x >> 31);
+}
+
+static uint64_t hash(uint64_t digest, uint64_t value){
+  return (digest ^ value)*0x100000001B3ull;
+}
+
+//Comma separated list of numbers.
+static std::vector<double> argList(int argc, char** argv, const char* name, const char* fallback){
+  const char* text = fallback;
+  for (int i = 1; i + 1 < argc; i++){
+    if (strcmp(argv[i], name) == 0){
+      text = argv[i + 1];
+    }
+  }
+  std::vector<double> values;
+  char* end;
+  for (const char* p = text; *p; p = *end ? end + 1 : end){
+    values.push_back(strtod(p, &end));
+    if (end == p){
+      break;
+    }
+  }
+  return values;
+}
+
+/* Function:    void runPole(const FleetCase& c, const FleetOptions& options, uint64_t poleSeed, PoleResult& result)
+ * Purpose:     Run one pole with a window of W samples on a board of
+ *              the calling thread.
+ *
+ * Input:       Settings                    (const FleetCase& c)
+ *              Fleet options               (const FleetOptions& options)
+ *              Seed of the pole            (uint64_t poleSeed)
+ *              Result to fill              (PoleResult& result)
+ *
+ * Output:      None
+*/
+template <uint8_t W>
+static void runPole(const FleetCase& c, const FleetOptions& options, uint64_t poleSeed, PoleResult& result){
+  std::mt19937_64 rng(poleSeed);
+  GustParams params;
+  params.meanSpeed = std::weibull_distribution<double>(2.0, options.site)(rng);
+  params.direction = std::uniform_real_distribution<double>(40, 175)(rng);
+  GustField field(params, mix(poleSeed));
+  field.setThreshold(c.allowed, options.truth);
+
+  SimBoard board(SimConfig(), (uint32_t)mix(poleSeed + 1));
+  board.makeCurrent();
+  board.setWind([&field](double t){ return field.at(t); });
+
+  result = PoleResult();
+  result.digest = 0xCBF29CE484222325ull;
+  result.firstDecision = -1;
+  std::vector<double> lowerTimes;
+  LoopModelN<W> model(true, 115200);
+  model.setAllowedWindSpeed(c.allowed);
+  model.setSequential(c.sequential);
+  model.controller().setScanMode(c.scan);
+  model.onDecision([&](double windSpeed, bool lower){
+    double t = board.now()*1e-6;
+    bool truth = field.mean(t, options.truth) > c.allowed;
+    result.decisions++;
+    result.lowers += lower;
+    result.truthLower += truth;
+    result.falseLower += lower && !truth;
+    result.missedLower += !lower && truth;
+    if (result.firstDecision < 0){
+      result.firstDecision = t;
+    }
+    if (lower){
+      lowerTimes.push_back(t);
+    }
+    result.digest = hash(hash(result.digest, board.now()), (uint64_t)llround(windSpeed*1e6)*2 + lower);
+  });
+  double blockedUs;
+  while (board.now()*1e-6 < options.seconds){
+    model.loop(board, blockedUs);
+    result.sequences.push_back(model.sequenceUs()*1e-6);
+  }
+  result.lostSteps = board.counters().lostSteps;
+
+  //Episodes starting near the end had no fair chance. The last loop
+  //runs past the end, by different times in different cases.
+  size_t next = 0;
+  const std::vector<GustEpisode>& episodes = field.episodes();
+  for (size_t e = 0; e < episodes.size(); e++){
+    double end = episodes[e].end < 0 ? board.now()*1e-6 : episodes[e].end;
+    if (episodes[e].start > options.seconds - 10){
+      continue;
+    }
+    result.episodes++;
+    while (next < lowerTimes.size() && lowerTimes[next] < episodes[e].start){
+      next++;
+    }
+    double latency = -1;
+    if (next < lowerTimes.size() && lowerTimes[next] <= end){
+      result.caught++;
+      latency = lowerTimes[next] - episodes[e].start;
+      result.latencies.push_back(latency);
+    }
+    result.episodeTimes.push_back(latency);
+  }
+}
+
+static const int builtInWindows[] = {3, 5, 7, 9, 11, 15, 21, 31};
+
+static bool builtIn(int window){
+  for (size_t i = 0; i < sizeof(builtInWindows)/sizeof(builtInWindows[0]); i++){
+    if (builtInWindows[i] == window){
+      return true;
+    }
+  }
+  return false;
+}
+
+static void runPole(const FleetCase& c, const FleetOptions& options, uint64_t poleSeed, PoleResult& result){
+  switch (c.window){
+    case 3: runPole<3>(c, options, poleSeed, result); break;
+    case 5: runPole<5>(c, options, poleSeed, result); break;
+    case 7: runPole<7>(c, options, poleSeed, result); break;
+    case 9: runPole<9>(c, options, poleSeed, result); break;
+    case 11: runPole<11>(c, options, poleSeed, result); break;
+    case 15: runPole<15>(c, options, poleSeed, result); break;
+    case 21: runPole<21>(c, options, poleSeed, result); break;
+    case 31: runPole<31>(c, options, poleSeed, result); break;
+  }
+}
+
+//Run poles of every case, case-major, and return the wall time [s].
+static double runFleet(WorkPool& pool, const std::vector<FleetCase>& cases, int poles,
+                       const FleetOptions& options, std::vector<PoleResult>& results){
+  results.assign(cases.size()*poles, PoleResult());
+  WallTimer timer;
+  pool.run(results.size(), [&](size_t job){
+    runPole(cases[job/poles], options, mix(options.seed*1000003 + job%poles), results[job]);
+  });
+  return timer.seconds();
+}
+
+static uint64_t fleetDigest(const std::vector<PoleResult>& results, size_t begin, size_t end){
+  uint64_t digest = 0xCBF29CE484222325ull;
+  for (size_t i = begin; i < end; i++){
+    digest = hash(digest, results[i].digest);
+  }
+  return digest;
+}
+
+static const char* scanName(ScanMode scan){
+  return scan == SCAN_COARSE_FINE ? "coarse" : "exhaustive";
+}
+
+//Times of one case over all poles.
+struct CaseTimes {
+  Summary latency;            //Time to decision of caught episodes [s].
+  Summary sequence;           //Time of the measuring sequences [s].
+};
+
+//Times to decision of the episodes both cases caught.
+static void pairLatencies(const std::vector<PoleResult>& results, size_t a, size_t b, int poles,
+                          Summary& first, Summary& second){
+  for (int p = 0; p < poles; p++){
+    const std::vector<double>& x = results[a*poles + p].episodeTimes;
+    const std::vector<double>& y = results[b*poles + p].episodeTimes;
+    for (size_t e = 0; e < x.size() && e < y.size(); e++){
+      if (x[e] >= 0 && y[e] >= 0){
+        first.add(x[e]);
+        second.add(y[e]);
+      }
+    }
+  }
+}
+
+static double reduction(double sequential, double fixed){
+  return fixed > 0 ? 100*(1 - sequential/fixed) : 0;
+}
+
+int main(int argc, char** argv){
+  FleetOptions options;
+  int poles = (int)argValue(argc, argv, "--poles", 24);
+  options.seconds = argValue(argc, argv, "--seconds", 600);
+  options.seed = (uint64_t)argValue(argc, argv, "--seed", 1);
+  options.site = argValue(argc, argv, "--site", 2.2);
+  options.truth = argValue(argc, argv, "--truth", 3);
+  WorkPool pool((unsigned)argValue(argc, argv, "--threads", 0));
+
+  std::vector<double> allowed = argList(argc, argv, "--allowed", "2");
+  std::vector<double> windows = argList(argc, argv, "--window", "5,11,21");
+  std::vector<ScanMode> scans;
+  const char* scanText = "exhaustive,coarse";
+  for (int i = 1; i + 1 < argc; i++){
+    if (strcmp(argv[i], "--scan") == 0){
+      scanText = argv[i + 1];
+    }
+  }
+  if (strstr(scanText, "exhaustive")){
+    scans.push_back(SCAN_EXHAUSTIVE);
+  }
+  if (strstr(scanText, "coarse")){
+    scans.push_back(SCAN_COARSE_FINE);
+  }
+  std::vector<bool> decisions;
+  const char* decisionText = "sequential,fixed";
+  for (int i = 1; i + 1 < argc; i++){
+    if (strcmp(argv[i], "--decision") == 0){
+      decisionText = argv[i + 1];
+    }
+  }
+  if (strstr(decisionText, "sequential")){
+    decisions.push_back(true);
+  }
+  if (strstr(decisionText, "fixed")){
+    decisions.push_back(false);
+  }
+
+  std::vector<FleetCase> cases;
+  for (size_t a = 0; a < allowed.size(); a++){
+    for (size_t w = 0; w < windows.size(); w++){
+      for (size_t s = 0; s < scans.size(); s++){
+        for (size_t d = 0; d < decisions.size(); d++){
+          FleetCase c = {allowed[a], (int)windows[w], scans[s], decisions[d]};
+          if (!builtIn(c.window)){
+            fprintf(stderr, "no window of %d samples built in\n", c.window);
+            return 2;
+          }
+          cases.push_back(c);
+        }
+      }
+    }
+  }
+  if (cases.empty() || poles < 1){
+    fprintf(stderr, "nothing to run\n");
+    return 2;
+  }
+
+  printf("%d poles x %zu cases x %.0f s, site mean wind Weibull(2, %.2f m/s), truth over %.1f s,"
+         " seed %llu, %u threads\n", poles, cases.size(), options.seconds, options.site,
+         options.truth, (unsigned long long)options.seed, pool.threads());
+  std::vector<PoleResult> results;
+  double wall = runFleet(pool, cases, poles, options, results);
+
+  printf("\n  %7s %6s %-10s %-10s %9s %8s %8s %8s %7s %8s %9s %9s %9s %9s %6s\n", "allowed", "window",
+         "scan", "decision", "decisions", "lowers", "false", "missed", "episod", "caught", "ttd mean",
+         "ttd p99", "seq mean", "seq p99", "first");
+  std::vector<CaseTimes> times(cases.size());
+  for (size_t c = 0; c < cases.size(); c++){
+    unsigned decisions = 0, lowers = 0, truthLower = 0, falseLower = 0, missedLower = 0;
+    unsigned episodes = 0, caught = 0;
+    unsigned long lost = 0;
+    Summary& latency = times[c].latency;
+    Summary& sequence = times[c].sequence;
+    Summary first;
+    for (int p = 0; p < poles; p++){
+      const PoleResult& r = results[c*poles + p];
+      decisions += r.decisions;
+      lowers += r.lowers;
+      truthLower += r.truthLower;
+      falseLower += r.falseLower;
+      missedLower += r.missedLower;
+      episodes += r.episodes;
+      caught += r.caught;
+      lost += r.lostSteps;
+      for (size_t k = 0; k < r.latencies.size(); k++){
+        latency.add(r.latencies[k]);
+      }
+      for (size_t k = 0; k < r.sequences.size(); k++){
+        sequence.add(r.sequences[k]);
+      }
+      if (r.firstDecision >= 0){
+        first.add(r.firstDecision);
+      }
+    }
+    unsigned truthBelow = decisions - truthLower;
+    printf("  %7.2f %6d %-10s %-10s %9u %8u %7.2f%% %7.2f%% %7u %7.1f%% %8.2fs %8.2fs %8.2fs %8.2fs %5.1fs%s\n",
+           cases[c].allowed, cases[c].window, scanName(cases[c].scan),
+           cases[c].sequential ? "sequential" : "fixed", decisions, lowers,
+           truthBelow > 0 ? 100.0*falseLower/truthBelow : 0.0,
+           truthLower > 0 ? 100.0*missedLower/truthLower : 0.0, episodes,
+           episodes > 0 ? 100.0*caught/episodes : 0.0, latency.mean(), latency.percentile(99),
+           sequence.mean(), sequence.percentile(99), first.mean(), lost > 0 ? "  lost steps" : "");
+  }
+
+  //Reduction of the times by the sequential decision.
+  bool compared = false;
+  for (size_t c = 0; c < cases.size(); c++){
+    for (size_t f = 0; f < cases.size() && cases[c].sequential; f++){
+      if (cases[f].sequential || cases[f].allowed != cases[c].allowed ||
+          cases[f].window != cases[c].window || cases[f].scan != cases[c].scan){
+        continue;
+      }
+      if (!compared){
+        printf("\n  Reduction of the time to decision by the sequential decision, ttd of the"
+               " episodes caught by both:\n");
+        printf("  %7s %6s %-10s %7s %10s %10s %10s %10s\n", "allowed", "window", "scan",
+               "both", "ttd mean", "ttd p99", "seq mean", "seq p99");
+        compared = true;
+      }
+      Summary sequential, fixed;
+      pairLatencies(results, c, f, poles, sequential, fixed);
+      printf("  %7.2f %6d %-10s %7zu %9.1f%% %9.1f%% %9.1f%% %9.1f%%\n", cases[c].allowed,
+             cases[c].window, scanName(cases[c].scan), sequential.count(),
+             reduction(sequential.mean(), fixed.mean()),
+             reduction(sequential.percentile(99), fixed.percentile(99)),
+             reduction(times[c].sequence.mean(), times[f].sequence.mean()),
+             reduction(times[c].sequence.percentile(99), times[f].sequence.percentile(99)));
+    }
+  }
+  double simSeconds = results.size()*options.seconds;
+  printf("\n%zu poles in %.2f s: %.0f simulated seconds per second, %llu jobs stolen\n",
+         results.size(), wall, simSeconds/wall, (unsigned long long)pool.steals());
+
+  //Throughput of the first case with 1, 2, 4 ... threads.
+  if (argFlag(argc, argv, "--scaling")){
+    std::vector<FleetCase> one(1, cases[0]);
+    std::vector<PoleResult> again;
+    double single = 0;
+    for (unsigned threads = 1; threads <= pool.threads(); threads *= 2){
+      WorkPool scaled(threads);
+      double seconds = runFleet(scaled, one, poles, options, again);
+      single = threads == 1 ? seconds : single;
+      printf("  %3u threads: %7.2f s, speedup %5.2f\n", threads, seconds, single/seconds);
+    }
+  }
+
+  //The first case again on a different number of threads.
+  bool ok = true;
+  if (!argFlag(argc, argv, "--no-check")){
+    std::vector<FleetCase> one(1, cases[0]);
+    std::vector<PoleResult> again;
+    WorkPool other(pool.threads() == 1 ? 3 : 1);
+    runFleet(other, one, poles, options, again);
+    ok = fleetDigest(again, 0, again.size()) == fleetDigest(results, 0, poles);
+    printf("same decisions on %u threads: %s\n", other.threads(), ok ? "ok" : "FAIL");
+  }
+  return ok ? 0 : 1;
+}
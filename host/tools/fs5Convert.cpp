@@ -0,0 +1,63 @@
+/* Filename:      fs5Convert.cpp
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Converts an FS5 log of voltages or ADC codes to wind velocities with
+ *    FS5Batch, see LogReader.h for the formats. The velocities are
+ *    written as binary little endian floats, or one per line with --text.
+ *    The calibration defaults to that of main.ino.
+ *
+ * Usage:
+ *    fs5_convert [--csv COLUMN | --f32 | --u16] [--codes] [--text]
+ *                [--U0 V] [--U50 V] [--v50 V] [--n N] IN OUT
+ */
+
+#include "FS5Batch.h"
+#include "LogReader.h"
+#include "BenchStats.h"
+
+int main(int argc, char** argv){
+  if (argc < 3){
+    fprintf(stderr, "usage: fs5_convert [--csv COLUMN | --f32 | --u16] [--codes] [--text] IN OUT\n");
+    return 2;
+  }
+  const char* in = argv[argc - 2];
+  const char* out = argv[argc - 1];
+  LogFormat format = argFlag(argc, argv, "--f32") ? LOG_F32 : (argFlag(argc, argv, "--u16") ? LOG_U16 : LOG_CSV);
+  bool codes = format == LOG_U16 || argFlag(argc, argv, "--codes");
+  bool text = argFlag(argc, argv, "--text");
+  FS5Batch batch(argValue(argc, argv, "--U0", 2.24), argValue(argc, argv, "--U50", 3.33),
+                 argValue(argc, argv, "--v50", 8), argValue(argc, argv, "--n", 0.51));
+
+  LogReader reader;
+  if (!reader.open(in, format, (int)argValue(argc, argv, "--csv", 0))){
+    fprintf(stderr, "cannot open %s\n", in);
+    return 1;
+  }
+  FILE* file = fopen(out, text ? "w" : "wb");
+  if (!file){
+    fprintf(stderr, "cannot create %s\n", out);
+    return 1;
+  }
+  WallTimer timer;
+  uint64_t samples = convertLog(reader, batch, codes, [&](const float* v, size_t n){
+    if (text){
+      for (size_t i = 0; i < n; i++){
+        fprintf(file, "%.4f\n", v[i]);
+      }
+    }
+    else {
+      fwrite(v, sizeof(float), n, file);
+    }
+  });
+  fclose(file);
+  double seconds = timer.seconds();
+  fprintf(stderr, "%llu samples, %llu lines skipped, %.2f s, %.1f MB/s\n",
+          (unsigned long long)samples, (unsigned long long)reader.skipped(), seconds,
+          reader.bytes()/seconds*1e-6);
+  return 0;
+}
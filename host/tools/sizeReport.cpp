@@ -0,0 +1,259 @@
+/* Filename:      sizeReport.cpp
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    RAM and flash used by the object files of the firmware, read from
+ *    the symbol tables with nm and the section sizes with size. Prints
+ *    the bytes of every object file and then the largest objects in RAM,
+ *    e.g. the profile of Control or the velocity table of the FS5, and
+ *    checks them against a budget.
+ *
+ *    .data and .bss are counted as RAM, .text, .rodata and .progmem as
+ *    flash, and .data also as flash for its initial values. Read-only
+ *    data with relocations, e.g. vtables, is counted as RAM since the
+ *    ATmega328 keeps it there. Bytes of a section without a symbol, 
+ *    e.g. string literals, are counted as "(unnamed)" of the object 
+ *    file, so strings in RAM show up there unless they are in flash 
+ *    with F().
+ *
+ * Usage:
+ *    size_report [--nm NM] [--size SIZE] [--title T] [--ram BYTES] 
+ *                [--flash BYTES] [--top N] OBJECT...
+ *
+ *    SIZE defaults to the size next to NM, e.g. avr-size for avr-nm.
+ *
+ *    Exits with 1 if the RAM or flash exceeds a given budget.
+ *
+ * Notes:
+ *    - The host build has 4 byte ints and 8 byte doubles and pointers,
+ *      the ATmega328 2, 4 and 2. Use the host numbers to compare builds
+ *      and objects, or give the nm of an AVR toolchain and its objects
+ *      or linked firmware, see firmware_size_avr in CMakeLists.txt.
+ *      main.ino checks only its big buffers in the sizes of the
+ *      ATmega328 at compile time, not the whole RAM.
+ *    - The RAM is that of the globals. The stack comes on top, so give
+ *      a RAM budget that leaves room for it.
+ *    - Functions that the linker would drop are counted, inline and
+ *      template functions once for all object files.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+//Bytes of one object file.
+struct ObjectSize {
+  std::string name;
+  unsigned long ram = 0;
+  unsigned long flash = 0;
+};
+
+//A symbol in RAM.
+struct RamSymbol {
+  std::string name;
+  std::string object;
+  unsigned long size;
+};
+
+static bool startsWith(const std::string& text, const char* prefix){
+  return text.compare(0, strlen(prefix), prefix) == 0;
+}
+
+static std::string trim(const std::string& text){
+  size_t first = text.find_first_not_of(' ');
+  size_t last = text.find_last_not_of(' ');
+  return first == std::string::npos ? "" : text.substr(first, last - first + 1);
+}
+
+static std::string baseName(const std::string& path){
+  size_t slash = path.find_last_of('/');
+  return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+static bool inRam(const std::string& section){
+  return startsWith(section, ".data") || startsWith(section, ".bss") || startsWith(section, ".tbss") ||
+         startsWith(section, ".tdata");
+}
+
+static bool inFlash(const std::string& section){
+  return startsWith(section, ".text") || startsWith(section, ".rodata") || startsWith(section, ".progmem") ||
+         startsWith(section, ".data");
+}
+
+//Reads the section sizes of an object file with "size -A".
+static bool readSections(const std::string& size, const std::string& path,
+                         std::map<std::string, unsigned long>& sections){
+  std::string command = size + " -A '" + path + "' 2>/dev/null";
+  FILE* pipe = popen(command.c_str(), "r");
+  if (!pipe){
+    return false;
+  }
+  char line[4096];
+  while (fgets(line, sizeof(line), pipe)){
+    char name[1024];
+    unsigned long bytes, address;
+    if (sscanf(line, "%1023s %lu %lu", name, &bytes, &address) == 3 && name[0] == '.'){
+      sections[name] += bytes;
+    }
+  }
+  return pclose(pipe) == 0;
+}
+
+//Reads the symbols of an object file with "nm --format=sysv", one line
+//per symbol: name|value|class|type|size|line|section.
+static bool readObject(const std::string& nm, const std::string& size, const std::string& path, 
+                       ObjectSize& object, std::vector<RamSymbol>& ramSymbols, std::set<std::string>& seen){
+  std::map<std::string, unsigned long> sections;
+  if (!readSections(size, path, sections)){
+    return false;
+  }
+  std::map<std::string, unsigned long> named;
+  std::string command = nm + " --format=sysv --defined-only -C '" + path + "' 2>/dev/null";
+  FILE* pipe = popen(command.c_str(), "r");
+  if (!pipe){
+    return false;
+  }
+  object.name = baseName(path);
+  char line[4096];
+  while (fgets(line, sizeof(line), pipe)){
+    std::vector<std::string> fields;
+    char* start = line;
+    for (char* bar = strchr(start, '|'); bar; bar = strchr(start, '|')){
+      fields.push_back(trim(std::string(start, bar - start)));
+      start = bar + 1;
+    }
+    fields.push_back(trim(std::string(start, strcspn(start, "\n"))));
+    if (fields.size() < 7 || fields[4].empty()){
+      continue;
+    }
+    std::string name = fields[0];
+    std::string section = fields[6];
+    unsigned long bytes = strtoul(fields[4].c_str(), 0, 16);
+    named[section] += bytes;
+
+    //Inline and template code is in every object that uses it.
+    bool weak = fields[2] == "W" || fields[2] == "w" || fields[2] == "V" || fields[2] == "v" || fields[2] == "u";
+    if (weak && !seen.insert(name).second){
+      continue;
+    }
+    if (inRam(section)){
+      object.ram += bytes;
+      ramSymbols.push_back({name, object.name, bytes});
+    }
+    if (inFlash(section)){
+      object.flash += bytes;
+    }
+  }
+  if (pclose(pipe) != 0){
+    return false;
+  }
+
+  //Bytes without a symbol.
+  unsigned long unnamedRam = 0;
+  for (const auto& section : sections){
+    unsigned long bytes = section.second > named[section.first] ? section.second - named[section.first] : 0;
+    unnamedRam += inRam(section.first) ? bytes : 0;
+    object.ram += inRam(section.first) ? bytes : 0;
+    object.flash += inFlash(section.first) ? bytes : 0;
+  }
+  if (unnamedRam > 0){
+    ramSymbols.push_back({"(unnamed)", object.name, unnamedRam});
+  }
+  return true;
+}
+
+int main(int argc, char** argv){
+  std::string nm = "nm";
+  std::string size;
+  std::string title = "firmware";
+  unsigned long ramBudget = 0, flashBudget = 0;
+  size_t top = 12;
+  std::vector<std::string> paths;
+  for (int i = 1; i < argc; i++){
+    bool value = i + 1 < argc;
+    if (strcmp(argv[i], "--nm") == 0 && value){
+      nm = argv[++i];
+    }
+    else if (strcmp(argv[i], "--size") == 0 && value){
+      size = argv[++i];
+    }
+    else if (strcmp(argv[i], "--title") == 0 && value){
+      title = argv[++i];
+    }
+    else if (strcmp(argv[i], "--ram") == 0 && value){
+      ramBudget = strtoul(argv[++i], 0, 10);
+    }
+    else if (strcmp(argv[i], "--flash") == 0 && value){
+      flashBudget = strtoul(argv[++i], 0, 10);
+    }
+    else if (strcmp(argv[i], "--top") == 0 && value){
+      top = strtoul(argv[++i], 0, 10);
+    }
+    else {
+      paths.push_back(argv[i]);
+    }
+  }
+  if (paths.empty()){
+    fprintf(stderr, "usage: size_report [--nm NM] [--size SIZE] [--title T] [--ram BYTES] [--flash BYTES] "
+            "[--top N] OBJECT...\n");
+    return 2;
+  }
+  if (size.empty()){
+    size = nm.size() >= 2 && nm.compare(nm.size() - 2, 2, "nm") == 0 ? nm.substr(0, nm.size() - 2) + "size" : "size";
+  }
+
+  std::vector<ObjectSize> objects;
+  std::vector<RamSymbol> ramSymbols;
+  std::set<std::string> seen;
+  for (const std::string& path : paths){
+    ObjectSize object;
+    if (!readObject(nm, size, path, object, ramSymbols, seen)){
+      fprintf(stderr, "size_report: cannot read %s with %s and %s\n", path.c_str(), nm.c_str(), size.c_str());
+      return 2;
+    }
+    objects.push_back(object);
+  }
+  std::sort(objects.begin(), objects.end(), [](const ObjectSize& a, const ObjectSize& b){ return a.name < b.name; });
+  std::stable_sort(ramSymbols.begin(), ramSymbols.end(),
+                   [](const RamSymbol& a, const RamSymbol& b){ return a.size > b.size; });
+
+  printf("RAM and flash of %s\n", title.c_str());
+  printf("  %-28s %10s %10s\n", "object file", "RAM [B]", "flash [B]");
+  unsigned long ram = 0, flash = 0;
+  for (const ObjectSize& object : objects){
+    printf("  %-28s %10lu %10lu\n", object.name.c_str(), object.ram, object.flash);
+    ram += object.ram;
+    flash += object.flash;
+  }
+  printf("  %-28s %10lu %10lu\n", "total", ram, flash);
+
+  printf("\nLargest objects in RAM:\n");
+  printf("  %-40s %-22s %8s\n", "object", "object file", "RAM [B]");
+  for (size_t i = 0; i < ramSymbols.size() && i < top; i++){
+    std::string name = ramSymbols[i].name.size() > 40 ? ramSymbols[i].name.substr(0, 37) + "..." : ramSymbols[i].name;
+    printf("  %-40s %-22s %8lu\n", name.c_str(), ramSymbols[i].object.c_str(), ramSymbols[i].size);
+  }
+
+  bool ok = true;
+  if (ramBudget > 0 || flashBudget > 0){
+    printf("\n");
+  }
+  if (ramBudget > 0){
+    printf("RAM %lu of %lu bytes  %s\n", ram, ramBudget, ram <= ramBudget ? "ok" : "OVER");
+    ok &= ram <= ramBudget;
+  }
+  if (flashBudget > 0){
+    printf("flash %lu of %lu bytes  %s\n", flash, flashBudget, flash <= flashBudget ? "ok" : "OVER");
+    ok &= flash <= flashBudget;
+  }
+  return ok ? 0 : 1;
+}
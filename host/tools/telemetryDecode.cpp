@@ -0,0 +1,203 @@
+/* Filename:      telemetryDecode.cpp
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Decoder and recorder for the binary telemetry of the firmware, see
+ *    Telemetry.h. Reads a stream of frames from a file, from stdin or
+ *    from a serial port, and prints one line per record, as JSON or CSV.
+ *    With --raw the bytes are also written unchanged to a file, so a
+ *    session can be recorded and decoded again later.
+ *
+ *    Bad frames, e.g. text between the frames or bytes lost on the
+ *    line, are skipped up to the next zero byte. Gaps in the sequence
+ *    numbers are counted as lost records, steps back as a restart of
+ *    the firmware. A summary is printed on stderr at the end.
+ *
+ * Usage:
+ *    telemetry_decode [--format json|csv] [--baud B] [--raw FILE] [INPUT]
+ *
+ *    INPUT is a file or a serial port, stdin if left out or "-". A
+ *    serial port is set to raw mode at the baud rate, 115200 by default.
+ */
+
+#include "Telemetry.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+//Names of the record types.
+static const char* typeName(uint8_t type){
+  switch (type){
+    case TELEMETRY_HELLO: return "HELLO";
+    case TELEMETRY_SAMPLE: return "SAMPLE";
+    case TELEMETRY_DECISION: return "DECISION";
+    case TELEMETRY_SCAN: return "SCAN";
+    case TELEMETRY_GUST: return "GUST";
+    default: return "UNKNOWN";
+  }
+}
+
+//Sets a serial port to raw mode at the baud rate. Returns false if the
+//baud rate is not supported.
+static bool setupPort(int fd, unsigned long baud){
+  struct { unsigned long baud; speed_t speed; } rates[] = {
+    {9600, B9600}, {19200, B19200}, {38400, B38400}, {57600, B57600},
+    {115200, B115200}, {230400, B230400}, {460800, B460800}, {500000, B500000},
+    {921600, B921600}, {1000000, B1000000}
+  };
+  for (size_t i = 0; i < sizeof(rates)/sizeof(rates[0]); i++){
+    if (rates[i].baud == baud){
+      termios tty;
+      if (tcgetattr(fd, &tty) != 0){
+        return false;
+      }
+      cfmakeraw(&tty);
+      cfsetispeed(&tty, rates[i].speed);
+      cfsetospeed(&tty, rates[i].speed);
+      tty.c_cc[VMIN] = 1;
+      tty.c_cc[VTIME] = 0;
+      return tcsetattr(fd, TCSANOW, &tty) == 0;
+    }
+  }
+  return false;
+}
+
+//Prints one record. The fields of a GUST record are named after the
+//statistics in JSON, in CSV they keep the columns of the layout.
+static void printRecord(const TelemetryRecord& r, bool csv){
+  if (!csv && r.type == TELEMETRY_GUST){
+    printf("{\"seq\":%u,\"type\":\"GUST\",\"time_ms\":%lu,\"window\":%u,\"window_full\":%s,"
+           "\"mean\":%.2f,\"deviation\":%.2f,\"peak\":%.2f,\"percentile\":%.2f}\n",
+           r.sequence, (unsigned long)r.timeMs, r.count, (r.status & TELEMETRY_FULL) ? "true" : "false",
+           r.windSpeed/100.0, r.minSpeed/100.0, r.maxSpeed/100.0, r.durationMs/100.0);
+    return;
+  }
+  if (csv){
+    printf("%u,%s,%lu,%.2f,%d,%d,%d,%d,%d,%u,%.2f,%.2f,%u\n", r.sequence, typeName(r.type),
+           (unsigned long)r.timeMs, r.windSpeed/100.0, (r.status & TELEMETRY_LOWER) != 0,
+           (r.status & TELEMETRY_FULL) != 0, (r.status & TELEMETRY_TRACKING) != 0,
+           (r.status & TELEMETRY_SCANNING) != 0, r.heading, r.count, r.minSpeed/100.0,
+           r.maxSpeed/100.0, r.durationMs);
+    return;
+  }
+  printf("{\"seq\":%u,\"type\":\"%s\",\"time_ms\":%lu,\"wind_speed\":%.2f,"
+         "\"lower\":%s,\"window_full\":%s,\"tracking\":%s,\"scanning\":%s,"
+         "\"heading\":%d,\"count\":%u,\"min_speed\":%.2f,\"max_speed\":%.2f,\"duration_ms\":%u}\n",
+         r.sequence, typeName(r.type), (unsigned long)r.timeMs, r.windSpeed/100.0,
+         (r.status & TELEMETRY_LOWER) ? "true" : "false",
+         (r.status & TELEMETRY_FULL) ? "true" : "false",
+         (r.status & TELEMETRY_TRACKING) ? "true" : "false",
+         (r.status & TELEMETRY_SCANNING) ? "true" : "false",
+         r.heading, r.count, r.minSpeed/100.0, r.maxSpeed/100.0, r.durationMs);
+}
+
+int main(int argc, char** argv){
+  bool csv = false;
+  unsigned long baud = 115200;
+  const char* rawPath = 0;
+  const char* input = "-";
+  for (int i = 1; i < argc; i++){
+    if (strcmp(argv[i], "--format") == 0 && i + 1 < argc){
+      csv = strcmp(argv[++i], "csv") == 0;
+    }
+    else if (strcmp(argv[i], "--baud") == 0 && i + 1 < argc){
+      baud = strtoul(argv[++i], 0, 10);
+    }
+    else if (strcmp(argv[i], "--raw") == 0 && i + 1 < argc){
+      rawPath = argv[++i];
+    }
+    else if (argv[i][0] != '-' || strcmp(argv[i], "-") == 0){
+      input = argv[i];
+    }
+    else {
+      fprintf(stderr, "usage: telemetry_decode [--format json|csv] [--baud B] [--raw FILE] [INPUT]\n");
+      return 2;
+    }
+  }
+
+  int fd = strcmp(input, "-") == 0 ? 0 : open(input, O_RDONLY | O_NOCTTY);
+  if (fd < 0){
+    perror(input);
+    return 1;
+  }
+  if (isatty(fd) && !setupPort(fd, baud)){
+    fprintf(stderr, "%s: cannot set %lu baud\n", input, baud);
+    return 1;
+  }
+  FILE* raw = 0;
+  if (rawPath){
+    raw = fopen(rawPath, "wb");
+    if (!raw){
+      perror(rawPath);
+      return 1;
+    }
+  }
+
+  if (csv){
+    printf("seq,type,time_ms,wind_speed,lower,window_full,tracking,scanning,"
+           "heading,count,min_speed,max_speed,duration_ms\n");
+  }
+
+  //Collect bytes up to each zero byte. Longer runs are not frames.
+  uint8_t frame[telemetryFrameSize];
+  size_t size = 0;
+  bool overlong = false;
+  unsigned long records = 0, badFrames = 0, lost = 0;
+  unsigned long perType[5] = {0, 0, 0, 0, 0};
+  bool haveSequence = false;
+  uint16_t nextSequence = 0;
+  uint8_t buffer[4096];
+  ssize_t got;
+  while ((got = read(fd, buffer, sizeof(buffer))) > 0){
+    if (raw){
+      fwrite(buffer, 1, got, raw);
+    }
+    for (ssize_t i = 0; i < got; i++){
+      if (buffer[i] != 0){
+        if (size < sizeof(frame)){
+          frame[size++] = buffer[i];
+        }
+        else {
+          overlong = true;
+        }
+        continue;
+      }
+
+      TelemetryRecord record;
+      if (size > 0 && !overlong && Telemetry::decode(frame, (uint8_t)size, record)){
+        //A HELLO record or a step back starts a new sequence after a
+        //reset.
+        uint16_t gap = record.sequence - nextSequence;
+        if (haveSequence && record.type != TELEMETRY_HELLO && gap < 0x8000){
+          lost += gap;
+        }
+        haveSequence = true;
+        nextSequence = record.sequence + 1;
+        records++;
+        perType[record.type < 5 ? record.type : 0] += record.type < 5 ? 1 : 0;
+        printRecord(record, csv);
+      }
+      else if (size > 0 || overlong){
+        badFrames++;
+      }
+      size = 0;
+      overlong = false;
+    }
+  }
+  if (raw){
+    fclose(raw);
+  }
+  fflush(stdout);
+  fprintf(stderr, "%lu records (hello %lu, sample %lu, decision %lu, scan %lu, gust %lu), "
+          "%lu bad frames, %lu lost records\n", records, perType[TELEMETRY_HELLO],
+          perType[TELEMETRY_SAMPLE], perType[TELEMETRY_DECISION], perType[TELEMETRY_SCAN],
+          perType[TELEMETRY_GUST], badFrames, lost);
+  return 0;
+}
@@ -0,0 +1,120 @@
+/* Filename:      traceReplay.cpp
+ * Project Name:  Compact Safety system for automatic flagpole
+ * Contributors:  Carl Jensen and David Strom
+ * Programme:     Design and Product Realisation (CDEPR)
+ * University:    KTH Royal Institute of Technology
+ * Course:        MF133X Degree Project in Mechatronics
+ *
+ * Purpose:
+ *    Replays a trace, see Trace.h, through the loop() of main.ino, the
+ *    Control and the FS5sensor on the simulated board. Prints every
+ *    decision, where the firmware left the recorded path if it did, and
+ *    the replay throughput. With --record a trace of the simulated wind
+ *    is made first, e.g. to replay it later through changed firmware.
+ *
+ *    The output format and baud rate have to be those of the recording,
+ *    otherwise the replay diverges at the first serial output.
+ *
+ * Usage:
+ *    trace_replay [--text] [--coarse] TRACE
+ *    trace_replay --record [--seconds T] [--seed S] [--wind V] [--text] TRACE
+ */
+
+#include "LoopModel.h"
+#include "BenchStats.h"
+#include "Trace.h"
+
+int main(int argc, char** argv){
+  bool text = argFlag(argc, argv, "--text");
+  bool coarse = argFlag(argc, argv, "--coarse");
+  const char* path = argc > 1 ? argv[argc - 1] : 0;
+  if (!path || path[0] == '-'){
+    fprintf(stderr, "usage: trace_replay [--record] [--text] [--coarse] TRACE\n");
+    return 2;
+  }
+  unsigned long baud = text ? 9600 : 115200;
+
+  if (argFlag(argc, argv, "--record")){
+    double seconds = argValue(argc, argv, "--seconds", 600);
+    double speed = argValue(argc, argv, "--wind", 6);
+    SimBoard board(SimConfig(), (uint32_t)argValue(argc, argv, "--seed", 1));
+    board.makeCurrent();
+    board.setWind([speed](double t){ return WindSample{speed*(1 + 0.3*sin(t/5)), 100 + 0.1*t}; });
+    TraceWriter writer;
+    if (!board.record(path, writer)){
+      fprintf(stderr, "cannot create %s\n", path);
+      return 1;
+    }
+    LoopModel model(!text, baud);
+    if (coarse){
+      model.controller().setScanMode(SCAN_COARSE_FINE);
+    }
+    double blockedUs;
+    while (board.now()*1e-6 < seconds){
+      model.loop(board, blockedUs);
+    }
+    fprintf(stderr, "%llu events, %.2f MB\n", (unsigned long long)writer.events(), writer.bytes()/1e6);
+    board.stopRecording();
+    return 0;
+  }
+
+  TraceReader reader;
+  if (!reader.open(path)){
+    fprintf(stderr, "%s is not a trace\n", path);
+    return 1;
+  }
+  SimBoard board;
+  board.makeCurrent();
+  board.replay(reader);
+  board.setSerialCapture(true);
+  LoopModel model(!text, baud);
+  if (coarse){
+    model.controller().setScanMode(SCAN_COARSE_FINE);
+  }
+
+  //Print the decisions of each loop that stayed within the trace.
+  WallTimer timer;
+  const SimBoard::ReplayStatus& status = board.replayStatus();
+  size_t begin = 0;
+  while (!status.ended && !status.diverged){
+    double blockedUs;
+    model.loop(board, blockedUs);
+    if (status.ended || status.diverged){
+      break;                    //This loop ran past the trace.
+    }
+    const std::string& stream = board.serialOutput();
+    for (size_t k = begin; k < stream.size(); k++){
+      if (text){
+        if (stream[k] == '{'){
+          size_t end = stream.find('}', k);
+          printf("%s\n", stream.substr(k, end == std::string::npos ? std::string::npos : end - k + 1).c_str());
+          k = end == std::string::npos ? stream.size() : end;
+        }
+        continue;
+      }
+      if (stream[k] == 0){
+        TelemetryRecord record;
+        if (k > begin && k - begin < 256
+            && Telemetry::decode((const uint8_t*)stream.data() + begin, (uint8_t)(k - begin), record)
+            && record.type == TELEMETRY_DECISION){
+          printf("{\"time\":%lu,\"speed\":%.2f,\"lower\":%s,\"heading\":%d}\n",
+                 (unsigned long)record.timeMs, record.windSpeed/100.0,
+                 record.status & TELEMETRY_LOWER ? "true" : "false", record.heading);
+        }
+        begin = k + 1;
+      }
+    }
+    if (text){
+      begin = stream.size();
+    }
+  }
+  double seconds = timer.seconds();
+
+  if (status.diverged){
+    fprintf(stderr, "diverged at %.0f us: %s\n", status.divergedUs, status.reason);
+  }
+  fprintf(stderr, "%llu events, %llu ADC samples, %.2f s, %.2f M samples/s, %.0f MB/s\n",
+          (unsigned long long)status.events, (unsigned long long)status.adcSamples, seconds,
+          status.adcSamples/seconds*1e-6, reader.size()/seconds*1e-6);
+  return status.diverged ? 1 : 0;
+}
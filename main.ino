@@ -11,32 +11,98 @@
  *   prototype for Hotswaps automatic flagpole. 
  * 
  *   First, the code conducts a scan for the wind current and aligns the 
- *   FS5 sensor accordingly to the wind current. 
+ *   FS5 sensor accordingly to the wind current. The scan runs step by 
+ *   step, so the wind is sampled and lower flag decisions are made while 
+ *   the sensor is still moving. The following loops track the wind 
+ *   around the current heading and only scan again when the wind is 
+ *   lost. 
  * 
- *   It then records the wind velocity in intervalls and stores all 
- *   recorded values in an array. The array is then sorted and the 
- *   median wind velocity, which represent the current wind 
- *   velocity, can be determined by the middle element of the sorted array.
+ *   It then records the wind velocity in intervalls. Every sample is 
+ *   added to a sliding window, whose median represent the current wind 
+ *   velocity. The median is reported at once when it crosses the 
+ *   allowed wind velocity, and at the end of the measuring sequence. 
  * 
- *   If the current wind velocity exceeds the maxiumum allowed wind 
- *   velocity a JSON array is created and printed to the serial monitor 
- *   with a status to lower the flag. 
+ *   With sequentialDecision set, every sample instead goes to a 
+ *   sequential test, see WindDecision.h. The test decides after at most
+ *   N samples, and after a few when the wind is far above or below the
+ *   limit. The decision is reported at once with the mean of the test.
+ *   After a decision to keep the flag the sequence goes on with a new 
+ *   test up to N samples, and a decision to lower ends it. 
  * 
- *   Else, if the current wind velocity is in the allowed span, a JSON 
- *   array is created and printed to the serial monitor with a status to 
- *   not lower the flag. 
+ *   Every sample also goes to the gust statistics of the last 3 s, 
+ *   1 min and 10 min, see GustStats.h: the mean, the standard 
+ *   deviation, the peak and a high percentile. They are sent after 
+ *   every decision, and with allowedGust set a statistic above it 
+ *   lowers the flag even if the median or the test would keep it. 
+ * 
+ *   The time between samples and between scans follows the wind, see 
+ *   Cadence.h: dense near the limit, sparse in calm air, where the 
+ *   heading is also scanned less often. The MCU sleeps between the 
+ *   samples, in power down for long pauses, see PowerSave.h. The coils
+ *   of the motor are turned off when a scan ends, see Control::tick(). 
+ * 
+ *   If the wind velocity exceeds the maxiumum allowed wind velocity a 
+ *   JSON array is created and printed to the serial monitor with a 
+ *   status to lower the flag. During the scan this is done as soon as 
+ *   it is seen, without waiting for the scan to end.
+ * 
+ *   Else, if the wind velocity is in the allowed span, a JSON array is 
+ *   created and printed to the serial monitor with a status to not 
+ *   lower the flag. 
+ * 
+ *   With binary telemetry the samples, scans and decisions are instead 
+ *   sent as compact binary records at a higher baud rate, see 
+ *   Telemetry.h, and no text is printed. 
+ * 
+ *   The heading and the FS5 calibration are kept in EEPROM, see 
+ *   Storage.h. After a reset the first loop samples the wind at the 
+ *   stored heading without scanning, so the first decision comes after
+ *   one measuring sequence. A full scan later verifies the heading.
  * 
  * Hardware:      
  *    MCU:          ATmega328 
  *    Clock Speed:  16 MHz
  *    Board:        Arduino Nano 3.x
- *    Used pins:    A0, 7, 8, 9, 10, 12
+ *    Used pins:    A0, 7, 8, 9, 10, 12, and A1, A2, A3, A6 with the
+ *                  array of FS5 sensors
+ *    Watchdog:     Wakes the MCU from power down
  *    
  * Notes: 
- *   - The values U0, U50 and v50 are measured values and can vary. 
+ *   - The pins and the FS5 calibration are those of the pole in 
+ *     FlagpoleConfig.h. The values U0, U50 and v50 are measured values 
+ *     and can vary. 
+ *   - With FLAGPOLE_FIXED_CONFIG set to 1, see FlagpoleConfig.h, the FS5 
+ *     calibration and velocity table are fixed at compile time and kept
+ *     in flash, see FS5Fixed.h. The stored calibration is then not used.
+ *   - The text and JSON messages are kept in flash with F(). 
+ *     size_report in host/ prints the RAM and flash of every object.
+ *     The big buffers are checked against ramBudget at compile time,
+ *     the whole RAM only by firmware_size_avr on the linked firmware. 
  *   - See Controller.cpp and FS5.cpp for a more thorough 
  *     understanding of the logic behind the scan- and 
  *     wind measuring procedure.
+ *   - A stored calibration is used instead of U0, U50, v50 and n of 
+ *     the pole. After changing them, clear the EEPROM or change 
+ *     storageVersion in Storage.h.
+ *   - With FLAGPOLE_PROFILE set to 1, see Profiler.h, sending 'p' on 
+ *     the serial port prints the timing statistics.
+ *   - The sequential decision reaches a decision sooner on average, 
+ *     but with fleet_sim in host/ its false lowers are higher than 
+ *     those of the median with an exhaustive scan, so it is not the 
+ *     default. 
+ *   - With adaptiveCadence false the samples are samplePeriod apart 
+ *     with delay(), and every loop scans. 
+ *   - The gust windows and the window of the sequential decision are 
+ *     kept in time, so they cover 3 s, 1 min, 10 min and N samples of 
+ *     the dense cadence however sparse the samples are. 
+ *   - With useArray true the pole carries four more FS5 sensors at 
+ *     90 degree steps around the shaft, and the wind direction comes 
+ *     from one pass over them instead of probing with the motor, see 
+ *     FS5Array.h and Control::useArray(). Their readings are converted
+ *     by the FS5, with its table and stored calibration.
+ *   - The stepper motor is driven through the port registers, see 
+ *     FastStepper.h. With FLAGPOLE_CHEAPSTEPPER set to 1, see 
+ *     Controller.h, the CheapStepper library is used instead.
 */
  
  
@@ -44,106 +110,448 @@
  
  
 //Include libraries.
+#include "FlagpoleConfig.h"
 #include "Controller.h"
 #include "FS5.h"
-#include "CheapStepper.h"
-#include "quickSort.h"
+#include "FS5Fixed.h"
+#include "FS5Array.h"
+#include "FastStepper.h"
+#include "LimitSwitch.h"
+#include "RunningMedian.h"
+#include "ADCSampler.h"
+#include "Telemetry.h"
+#include "Storage.h"
+#include "Profiler.h"
+#include "WindDecision.h"
+#include "GustStats.h"
+#include "Cadence.h"
+#include "PowerSave.h"
 #include <ArduinoJson.h>
 
-//The input pin for the FS5 sensor.
-int pinFS5 = A0;
-
-//The measured value for the voltage output from the FS5 sensor at wind speed 0%  [V].
-double U0 = 2.24;   
-
-//The measured value for the voltage output from the FS5 sensor at wind speed 50% [V].
-double U50 = 3.33;  
+//The pins and the FS5 calibration, see FlagpoleConfig.h.
+typedef FLAGPOLE_CONFIG Pole;
 
-//The measured value for the  wind speed at 50% [m/s].
-double v50 = 8;     
+#if FLAGPOLE_FIXED_CONFIG
+//Initialize the FS5, calibration and velocity table in flash.
+FS5Fixed<Pole> FS5;
+#else
+//Initialize the FS5.
+FS5sensor FS5(Pole::pinFS5, Pole::U0, Pole::U50, Pole::v50, Pole::n);      
 
-//The constant to the FS5 calibrartion. 
-double nFS5 = 0.51; 
+//Velocity table for the FS5, filled in setup().
+FS5Table FS5VelocityTable;
+#endif
 
-//Pins for the stepper motor.
-int IN1 = 10;
-int IN2 = 9;
-int IN3 = 8;
-int IN4 = 7;
+//Background sampler for the FS5, 3 extra bits by oversampling.
+ADCSampler FS5Sampler(Pole::pinFS5, 3);
+            
+//Only the pin change interrupt of LIMIT_SWITCH_PIN is defined, see 
+//LimitSwitch.h.
+static_assert(Pole::limitSwitch == LIMIT_SWITCH_PIN, "set LIMIT_SWITCH_PIN to the limit switch pin of the pole");
 
-//Pin for the limit switch input.
-int pinLS = 12;
+//Intialize the controlling unit.
+Control controller(Pole::limitSwitch, Pole::IN1, Pole::IN2, Pole::IN3, Pole::IN4, 
+                   Pole::pinFS5, Pole::U0, Pole::U50, Pole::v50, Pole::n);     
 
-//Initialize the quicksort algorithm.
-Sorting qs; 
+//Fixed array of FS5 sensors for the wind direction.
+bool useArray = false;                  //The pole carries the array.
+const uint8_t arrayPins[4] = {A1, A2, A3, A6};
+const double arrayAngles[4] = {0, 90, 180, 270};  //Ccw from the FS5 [degrees].
+FS5Array directionArray(arrayPins, arrayAngles, 4, &FS5);
 
-//Initialize the FS5.
-FS5sensor FS5(pinFS5, U0, U50, v50, nFS5);      
-            
-//Intialize the controlling unit.
-Control controller(pinLS,IN1,IN2,IN3,IN4,pinFS5,U0,U50,v50,nFS5);     
+//State kept in EEPROM over a reset.
+Storage storage;
 
 //Declaring the variables.
 double currentWindSpeed;          //The current wind speed. 
 double allowedWindSpeed = 2;     //The allowed wind speed. 
-double FS5ValArray[11] = {0};   //Array for storing FS5 data.
-int N = sizeof(FS5ValArray)/sizeof(FS5ValArray[0]); //The number of elements in the array
+const uint8_t N = 11;             //The number of samples in the window.
+RunningMedian<double, N> windWindow;  //Sliding window of FS5 data.
+unsigned long samplePeriod = 100; //Time between samples [ms].
+bool lowerReported;               //Lower flag already reported this loop.
 
+//Sequential lower flag decision, at most N samples.
+bool sequentialDecision = false;  //Else the median of the window.
+double windMargin = 0.3;          //Half width of the indifference zone [m/s].
+double windSigma = 0.5;           //Spread of the samples [m/s].
+double falseLowerRate = 0.005;    //Aimed probability of a false lower.
+double missedLowerRate = 0.05;    //Aimed probability of a missed lower.
+double windHysteresis = 0.2;      //Limit less this after a lower [m/s].
+WindDecisionN<N> windDecision(allowedWindSpeed, windMargin, windSigma);
 
-void setup() {
-  Serial.begin(9600);
-}
+//Gust statistics over 3 s, 1 min and 10 min.
+double gustPercentile = 0.9;      //Percentile of the samples to estimate.
+double allowedGust = 0;           //Lower above this [m/s], 0 to only report.
+uint8_t gustWindow = GUST_SHORT;  //Window of the lower flag statistic.
+uint8_t gustStatistic = GUST_PERCENTILE;  //Statistic compared to allowedGust.
+GustStats gusts(gustPercentile);
 
-void loop() {
-  Serial.println("//////////////////////////////////////////////////////////");
-  
-  //Scans the area for the highest wind speed,
-  controller.scan(); 
+//Adaptive time between samples and scans.
+bool adaptiveCadence = true;           //Else samplePeriod and a scan every loop.
+unsigned int sparsePeriod = 4000;      //Longest time between samples [ms].
+double windRise = 0.5;                 //Fastest rise of the wind assumed [m/s per s].
+unsigned long maxRescanPeriod = 60000; //Longest time between scans [ms].
+unsigned int powerDownPeriod = 500;    //Power down for pauses this long [ms].
+Cadence cadence(allowedWindSpeed, windSigma);
+
+//Send binary telemetry records instead of JSON and text.
+bool binaryTelemetry = true;
+unsigned long telemetryBaud = 115200;   //Baud rate of the binary telemetry.
+unsigned long textBaud = 9600;          //Baud rate of the JSON and text.
+Telemetry telemetry;
 
-  Serial.println("Start wind measuring sequence...");
+//Statistics of the samples since the last decision.
+double sampleMin;                 //Lowest sample.
+double sampleMax;                 //Highest sample.
+uint8_t sampleCount;              //Number of samples.
 
-  //Recording the wind speed at the the given point and stores the values in a array. 
-  for(int k = 0; k < N; k++) {         
-    FS5ValArray[k] = FS5.velocity();  
-    Serial.println(FS5ValArray[k]); 
-    delay(100); 
+//RAM of the big buffers in the sizes of the ATmega328, 2 byte ints and
+//4 byte doubles: the scan profile, the velocity table unless it is in 
+//flash, the six gust accumulators and the window of the decision. They
+//are kept to half of its 2 KB, also when built on the host. This does
+//not bound the whole RAM: the rest of Control, the filters, the median
+//window, the ring of the sampler, the telemetry, the Arduino core and
+//the stack come on top. firmware_size_avr checks the linked firmware.
+const unsigned int ramBudget = 1024;
+const unsigned int bufferRam = Control::profileSize*2 + 
+                               (FLAGPOLE_FIXED_CONFIG ? 0 : FS5_TABLE_SIZE*4) + 
+                               GUST_WINDOWS*2*40 + N*(4 + 2);
+static_assert(bufferRam <= ramBudget, "the big buffers take more than half the RAM of the ATmega328");
+
+
+/* Function:    void message(const __FlashStringHelper* text)
+ * Purpose:     Prints a line of text to the Serial monitor, unless the
+ *              port carries binary telemetry.
+ * 
+ * Input:       The text in flash, from F() (const __FlashStringHelper* text)
+ * 
+ * Output:      None
+*/
+void message(const __FlashStringHelper* text){
+  if (!binaryTelemetry){
+    Serial.println(text);
   }
-  
-  Serial.println("Measuring sequence complete");
-  
-  Serial.println("Determine the median value of the measuring sequence...");
-  
-  //Sorting the array.
-  qs.quickSorting(FS5ValArray, 0, N-1); 
+}
 
-  //Declares the current wind speed as the median value from the recorded session.
-  currentWindSpeed = FS5ValArray[(N-1)/2+1];  
-  
-  Serial.println("Create and print JSON array...");
-  Serial.println("");
+/* Function:    void sendRecord(uint8_t type, double windSpeed, uint8_t status, unsigned int durationMs)
+ * Purpose:     Fills a telemetry record with the current heading, the
+ *              window and the sample statistics and sends it.
+ * 
+ * Input:       The record type             (uint8_t type)
+ *              The wind speed              (double windSpeed)
+ *              The status flags            (uint8_t status)
+ *              The duration [ms]           (unsigned int durationMs)
+ * 
+ * Output:      None
+*/
+void sendRecord(uint8_t type, double windSpeed, uint8_t status, unsigned int durationMs){
+  TelemetryRecord record;
+  record.type = type;
+  record.timeMs = millis();
+  record.windSpeed = Telemetry::speed(windSpeed);
+  record.status = status | (windWindow.full() ? TELEMETRY_FULL : 0);
+  record.heading = controller.heading();
+  record.count = windWindow.count();
+  record.minSpeed = Telemetry::speed(sampleCount > 0 ? sampleMin : 0);
+  record.maxSpeed = Telemetry::speed(sampleCount > 0 ? sampleMax : 0);
+  record.durationMs = durationMs;
+  telemetry.send(record);
+}
+
+/* Function:    void sendGusts()
+ * Purpose:     Sends a GUST record with the statistics of every window,
+ *              see Telemetry.h.
+ * 
+ * Input:       None
+ * 
+ * Output:      None
+*/
+void sendGusts(){
+  for (uint8_t w = 0; w < GUST_WINDOWS; w++){
+    TelemetryRecord record;
+    record.type = TELEMETRY_GUST;
+    record.timeMs = millis();
+    record.windSpeed = Telemetry::speed(gusts.statistic(w, GUST_MEAN));
+    record.status = gusts.full(w) ? TELEMETRY_FULL : 0;
+    record.heading = controller.heading();
+    record.count = w;
+    record.minSpeed = Telemetry::speed(gusts.statistic(w, GUST_DEVIATION));
+    record.maxSpeed = Telemetry::speed(gusts.statistic(w, GUST_PEAK));
+    record.durationMs = Telemetry::speed(gusts.statistic(w, GUST_PERCENTILE));
+    telemetry.send(record);
+  }
+}
+
+
+/* Function:    void reportWindSpeed(double windSpeed, bool lower)
+ * Purpose:     Creates a JSON array with information about the given
+ *              wind speed and decision and prints it to the Serial 
+ *              monitor. With binary telemetry a DECISION record and the
+ *              GUST records are sent instead.
+ * 
+ * Input:       The current wind speed      (double windSpeed)
+ *              Lower the flag              (bool lower)
+ * 
+ * Output:      None
+*/
+void reportWindSpeed(double windSpeed, bool lower){
+  PROFILE_SCOPE(PROFILE_REPORT);
+  if (binaryTelemetry){
+    sendRecord(TELEMETRY_DECISION, windSpeed, lower ? TELEMETRY_LOWER : 0, 0);
+    sendGusts();
+    sampleCount = 0;
+    return;
+  }
 
-  //Creates a JSON array with information about the current 
-  //windspeed and prints it to the Serial monitor.
-  if ( currentWindSpeed > allowedWindSpeed){    
+  if (lower){    
     StaticJsonDocument<200> doc;
     doc["Sensor"] = "FS5"; 
-    doc["Wind Speed"] = currentWindSpeed; 
+    doc["Wind Speed"] = windSpeed; 
     doc["Status"] = "True"; 
-    doc["Info"] = "Wind speed is NOT in the allowed span. Lower the flag."; 
+    doc["Info"] = F("Wind speed is NOT in the allowed span. Lower the flag."); 
     serializeJson(doc,Serial);  
   }
   
-  
-  
   else{
     StaticJsonDocument<200> doc;
     doc["Sensor"] = "FS5"; 
-    doc["Wind Speed"] = currentWindSpeed; 
+    doc["Wind Speed"] = windSpeed; 
     doc["Status"] = "False"; 
-    doc["Info"] = "Wind speed is in the allowed span. "; 
+    doc["Info"] = F("Wind speed is in the allowed span. "); 
     serializeJson(doc,Serial); 
   }
   Serial.println(" ");
-  Serial.println(" ");
-  Serial.println("Program complete");
+  sampleCount = 0;
+}
+
+/* Function:    WindVerdict sampleWind()
+ * Purpose:     Records one wind speed sample, updates the median of the
+ *              window and the gust statistics and adds the sample to 
+ *              the sequential decision, if used. Else a full window 
+ *              with the median above the allowed wind speed is a 
+ *              decision to lower. With allowedGust set, a gust 
+ *              statistic above it is a decision to lower. Samples
+ *              taken during a scan go only to the telemetry, the 
+ *              window, the gust statistics, the decision and the 
+ *              cadence keep to the samples at the wind.
+ * 
+ * Input:       None
+ * 
+ * Output:      The decision, WIND_UNDECIDED while more samples are 
+ *              needed.
+*/
+WindVerdict sampleWind(){
+  PROFILE_INTERVAL(micros(), samplePeriod*1000);
+  double sample = FS5.velocity();
+  //Samples at the headings of a scan are off the wind and would pull 
+  //the median, the gusts, the decision and the level down.
+  bool scanning = controller.scanning();
+  {
+    PROFILE_SCOPE(PROFILE_MEDIAN);
+    if (!scanning){
+      windWindow.add(sample);  
+
+      //Declares the current wind speed as the median value of the window.
+      currentWindSpeed = windWindow.median();
+      gusts.add(sample, millis());
+    }
+  }
+  if (!scanning){
+    cadence.add(sample, millis());
+  }
+  sampleMin = (sampleCount == 0 || sample < sampleMin) ? sample : sampleMin;
+  sampleMax = (sampleCount == 0 || sample > sampleMax) ? sample : sampleMax;
+  sampleCount += sampleCount < 255 ? 1 : 0;
+  if (binaryTelemetry){
+    sendRecord(TELEMETRY_SAMPLE, sample, scanning ? TELEMETRY_SCANNING : 0, 0);
+  }
+  else{
+    Serial.println(sample); 
+  }
+  WindVerdict verdict = WIND_UNDECIDED;
+  if (scanning){
+    //No decision on the headings of a scan.
+  }
+  else if (sequentialDecision){
+    verdict = windDecision.add(sample, millis());
+  }
+  else if (windWindow.full() && currentWindSpeed > allowedWindSpeed){
+    verdict = WIND_LOWER;
+  }
+  if (!scanning && allowedGust > 0 && gusts.statistic(gustWindow, gustStatistic) > allowedGust){
+    verdict = WIND_LOWER;
+  }
+  return verdict;
+}
+
+/* Function:    double decidedWindSpeed()
+ * Purpose:     The wind speed to report with a decision.
+ * 
+ * Input:       None
+ * 
+ * Output:      The mean of the sequential test, else the median of the
+ *              window [m/s].
+*/
+double decidedWindSpeed(){
+  return sequentialDecision ? windDecision.mean() : currentWindSpeed;
+}
+
+/* Function:    void pause()
+ * Purpose:     Waits until the next sample of the measuring sequence. 
+ *              With the adaptive cadence the wait is the period of the 
+ *              cadence with the MCU asleep, in power down with the 
+ *              sampler stopped for long waits. Else it is samplePeriod
+ *              with delay().
+ * 
+ * Input:       None
+ * 
+ * Output:      None
+*/
+void pause(){
+  if (!adaptiveCadence){
+    delay(samplePeriod);
+    return;
+  }
+  unsigned int period = cadence.period();
+  if (period >= powerDownPeriod){
+    FS5Sampler.end();
+    PowerSave::powerDown(period);
+    FS5Sampler.begin();
+  }
+  else{
+    PowerSave::idle(period);
+  }
+}
+
+void setup() {
+  if (binaryTelemetry){
+    telemetry.begin(telemetryBaud);
+    controller.setMessages(false);
+  }
+  else{
+    Serial.begin(textBaud);
+  }
+
+  //Resume from the stored heading and calibration, and save them as 
+  //they change.
+  StoredState state;
+  if (storage.load(state)){
+    FS5.loadCalibration(state);
+    controller.resume(state);
+  }
+  controller.useStorage(&storage);
+
+  //Bounds and hysteresis of the lower flag decision.
+  windDecision.setBounds(falseLowerRate, missedLowerRate);
+  windDecision.setHysteresis(windHysteresis);
+  windDecision.setSpan(N*samplePeriod);
+
+  //Gust windows of 3 s, 1 min and 10 min.
+  gusts.setWindow(GUST_SHORT, 3000);
+  gusts.setWindow(GUST_MINUTE, 60000);
+  gusts.setWindow(GUST_LONG, 600000);
+
+  //Dense and sparse cadence.
+  cadence.setPeriods(samplePeriod, sparsePeriod);
+  cadence.setRise(windRise);
+  cadence.setRescan(maxRescanPeriod);
+
+#if !FLAGPOLE_FIXED_CONFIG
+  //Convert voltage to wind velocity by table instead of pow().
+  FS5.useTable(&FS5VelocityTable);
+#endif
+
+  //Follow the wind around the heading instead of scanning every loop.
+  controller.setTracking(true);
+
+  //Sample the FS5 in the background. Both the FS5 and the controller 
+  //read from the sampler, since analogRead() cannot be used meanwhile.
+  FS5Sampler.begin();
+  FS5.useSampler(&FS5Sampler);
+  controller.useSampler(&FS5Sampler);
+
+  //Find the direction with the array instead of probing with the 
+  //motor. The sampler is stopped during a pass of the array.
+  if (useArray){
+    directionArray.useSampler(&FS5Sampler);
+    controller.useArray(&directionArray);
+  }
+}
+
+void loop() {
+#if FLAGPOLE_PROFILE
+  //Print the timing statistics when 'p' is received.
+  if (Serial.available() > 0 && Serial.read() == 'p'){
+    Profiler::report();
+  }
+#endif
+  message(F("//////////////////////////////////////////////////////////"));
+  
+  lowerReported = false;
+
+  //Scans the area for the highest wind speed. The wind is sampled 
+  //between the steps, so a strong wind is reported without waiting for 
+  //the scan to complete. With the adaptive cadence only when a scan is
+  //due.
+  if (!adaptiveCadence || cadence.rescanDue(millis())){
+    controller.begin();
+    bool tracking = controller.phase() == SCAN_TRACK;
+    unsigned long scanStart = millis();
+    unsigned long lastSample = scanStart;
+    while(controller.tick(micros())){
+      if(millis() - lastSample >= samplePeriod){
+        lastSample = millis();
+        if (sampleWind() == WIND_LOWER && !lowerReported){
+          reportWindSpeed(decidedWindSpeed(), true);
+          lowerReported = true;
+        }
+      }
+    }
+    if (binaryTelemetry){
+      unsigned long scanTime = millis() - scanStart;
+      sendRecord(TELEMETRY_SCAN, 0, tracking ? TELEMETRY_TRACKING : 0, scanTime > 65535 ? 65535 : scanTime);
+    }
+    cadence.scanned(millis());
+  }
+
+  message(F("Start wind measuring sequence..."));
+
+  //Recording the wind speed at the the given point. A decision to lower
+  //is reported at once by a JSON array with information about the 
+  //current windspeed. With the sequential decision the first decision
+  //of the test is reported at once, and sampling goes on until N 
+  //samples or a decision to lower, so a rising wind is still reported
+  //at once. Else the median is reported after N samples. The pause 
+  //between the samples follows the cadence.
+  windDecision.restart();
+  bool reported = false;
+  {
+    PROFILE_SCOPE(PROFILE_SEQUENCE);
+    for(int k = 0; k < N; k++) {         
+      WindVerdict verdict = sampleWind();
+      if (verdict == WIND_LOWER && sequentialDecision){
+        reportWindSpeed(decidedWindSpeed(), true);
+        break;
+      }
+      if (verdict == WIND_LOWER && !lowerReported){
+        reportWindSpeed(decidedWindSpeed(), true);
+        lowerReported = true;
+      }
+      if (verdict == WIND_KEEP && !reported){
+        reportWindSpeed(decidedWindSpeed(), false);
+        reported = true;
+      }
+      pause(); 
+    }
+  }
+  
+  message(F("Measuring sequence complete"));
+
+  //Creates a JSON array with information about the current windspeed
+  //and prints it to the Serial monitor.
+  if (!sequentialDecision){
+    reportWindSpeed(currentWindSpeed, currentWindSpeed > allowedWindSpeed);
+  }
+  message(F(" "));
+  message(F("Program complete"));
 }
@@ -8,6 +8,11 @@
  * 
  * Purpose : 
  *    Header for the quickSort library.
+ * 
+ * Notes: 
+ *    - select(), percentile() and median() are templates and are
+ *      therefore defined in this header. They work on any element type
+ *      with operator<, e.g. float, double or uint16_t ADC codes.
  */
 
 //Include libraries. 
@@ -76,6 +81,180 @@ class Sorting{
      *          [Accessed: 01- May- 2019].
     */
     void switchElements(double* left, double* right);
+
+    /* Function:    select(T Array[], int count, int k)
+     * Purpose:     Find the k:th smallest element of the array without
+     *              sorting it. The array is partially reordered so that
+     *              every element left of index k is not greater and every
+     *              element right of index k is not smaller than Array[k].
+     *
+     *              The partitioning is done in a loop, not recursively,
+     *              so the stack use is constant. The pivot is the median
+     *              of the first, middle and last element, which keeps
+     *              sorted and constant arrays (a calm day) at O(n).
+     *              After a split that removes less than a quarter of the
+     *              partition, the pivot sample is taken at a
+     *              pseudo-random position instead.
+     *              Partitions of at most selectCutoff elements are
+     *              finished with insertion sort.
+     * 
+     * Input:       An array with elements.         T Array[]
+     *              Number of elements.             int count
+     *              Rank of the wanted element.     int k (0 to count-1)
+     *                
+     * Output:      The k:th smallest element, 0 if the array is empty. A
+     *              k outside the array is moved to its nearest end.
+    */
+    template<typename T>
+    T select(T Array[], int count, int k);
+
+    /* Function:    percentile(T Array[], int count, float p)
+     * Purpose:     Find the p:th percentile of the array by nearest rank,
+     *              using select(). The array is partially reordered.
+     * 
+     * Input:       An array with elements.         T Array[]
+     *              Number of elements.             int count
+     *              Percentile between 0 and 100.   float p
+     *                
+     * Output:      The element at rank p/100*(count-1), rounded, 0 if
+     *              the array is empty.
+    */
+    template<typename T>
+    T percentile(T Array[], int count, float p);
+
+    /* Function:    median(T Array[], int count)
+     * Purpose:     Find the median of the array using select(). For an
+     *              even number of elements, the mean of the two middle
+     *              elements. The array is partially reordered.
+     * 
+     * Input:       An array with elements.         T Array[]
+     *              Number of elements.             int count
+     *                
+     * Output:      The median, 0 if the array is empty.
+    */
+    template<typename T>
+    T median(T Array[], int count);
+
+    //Partitions with at most this many elements are insertion sorted.
+    static const int selectCutoff = 8;
 };
 
+template<typename T>
+T Sorting::select(T Array[], int count, int k){
+  if (count <= 0){
+    return 0;
+  }
+  if (k < 0){
+    k = 0;
+  }
+  if (k > count - 1){
+    k = count - 1;
+  }
+  int left = 0;                 //Lowest index of the partition holding k.
+  int right = count - 1;        //Highest index of the partition holding k.
+  uint16_t seed = 0xACE1;       //State for pivot sampling after bad splits.
+  bool badSplit = false;        //Last partition shrank by less than 1/4.
+  
+  while (right - left >= selectCutoff){
+    int middle = left + (right - left)/2;
+    T temp;
+
+    //Inputs built against median-of-three (e.g. the median-of-three
+    //killer) give bad splits. Then sample the middle element elsewhere.
+    if (badSplit){
+      seed = seed*25173 + 13849;
+      int pick = left + 1 + (int)(seed % (uint16_t)(right - left - 1));
+      temp = Array[middle]; Array[middle] = Array[pick]; Array[pick] = temp;
+    }
+
+    //Order the first, middle and last element and use the middle as pivot.
+    if (Array[middle] < Array[left]){
+      temp = Array[middle]; Array[middle] = Array[left]; Array[left] = temp;
+    }
+    if (Array[right] < Array[left]){
+      temp = Array[right]; Array[right] = Array[left]; Array[left] = temp;
+    }
+    if (Array[right] < Array[middle]){
+      temp = Array[right]; Array[right] = Array[middle]; Array[middle] = temp;
+    }
+    T piv = Array[middle];
+
+    //Move smaller elements left and greater right. Elements equal to the
+    //pivot are swapped too, so equal runs split in the middle.
+    int i = left;
+    int j = right;
+    while (i <= j){
+      while (Array[i] < piv){
+        i++;
+      }
+      while (piv < Array[j]){
+        j--;
+      }
+      if (i <= j){
+        temp = Array[i]; Array[i] = Array[j]; Array[j] = temp;
+        i++;
+        j--;
+      }
+    }
+
+    //Continue in the part holding k. Between j and i all equal the pivot.
+    int size = right - left;
+    if (k <= j){
+      right = j;
+    }
+    else if (k >= i){
+      left = i;
+    }
+    else {
+      return Array[k];
+    }
+    badSplit = (right - left) > size - size/4;
+  }
+
+  //Insertion sort of the last small partition.
+  for (int i = left + 1; i <= right; i++){
+    T value = Array[i];
+    int j = i - 1;
+    while (j >= left && value < Array[j]){
+      Array[j + 1] = Array[j];
+      j--;
+    }
+    Array[j + 1] = value;
+  }
+  return Array[k];
+}
+
+template<typename T>
+T Sorting::percentile(T Array[], int count, float p){
+  if (p < 0){
+    p = 0;
+  }
+  if (p > 100){
+    p = 100;
+  }
+  int k = (int)(p/100*(count - 1) + 0.5f);
+  return select(Array, count, k);
+}
+
+template<typename T>
+T Sorting::median(T Array[], int count){
+  if (count <= 0){
+    return 0;
+  }
+  int k = (count - 1)/2;
+  T lower = select(Array, count, k);
+  if (count % 2){
+    return lower;
+  }
+
+  //Everything right of k is not smaller, the upper middle is its minimum.
+  T upper = Array[k + 1];
+  for (int i = k + 2; i < count; i++){
+    if (Array[i] < upper){
+      upper = Array[i];
+    }
+  }
+  return (lower + upper)/2;
+}
+
 #endif